@@ -0,0 +1,1088 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * FDCA (Fangzheng Distributed Computing Architecture) Copy Engine
+ *
+ * Copyright (C) 2024 Fangzheng Technology Co., Ltd.
+ *
+ * 主机内存与 VRAM 之间的异步拷贝
+ *
+ * 本模块负责：
+ * 1. 校验 (源, 目的, 大小) 区域列表并固定涉及的 GEM 对象
+ * 2. 把区域切分为不超过 FDCA_COPY_CHUNK_SIZE 的描述符，按批执行
+ * 3. 经 drm_gpu_scheduler 异步执行，输入/输出 syncobj 与计算作业衔接
+ * 4. 拷贝吞吐统计
+ * 5. 经双缓冲暂存区的 pwrite/pread
+ *
+ * 当前硬件没有可编程的 DMA 引擎，描述符由 CPU 执行：VRAM 一侧经 BAR
+ * 写合并映射，系统内存一侧逐页映射。拷贝在调度器工作线程中进行，ioctl
+ * 不阻塞，计算作业可与之重叠。后备解析、BAR 映射和中转页都在提交时
+ * 完成，调度器工作线程中不分配内存。
+ *
+ * Author: FDCA Kernel Team
+ * Date: 2024
+ */
+
+#include <linux/slab.h>
+#include <linux/highmem.h>
+#include <linux/io.h>
+#include <linux/log2.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include <drm/drm_gem.h>
+#include <drm/gpu_scheduler.h>
+
+#include "fdca_drv.h"
+#include "fdca_uapi.h"
+
+/*
+ * ============================================================================
+ * 拷贝作业
+ * ============================================================================
+ */
+
+/* 每批描述符数，批次之间让出 CPU */
+#define FDCA_COPY_BATCH         64
+
+/**
+ * struct fdca_copy_desc - 一个拷贝描述符
+ *
+ * 偏移为对象内偏移，执行时按对象当前后备解析
+ */
+struct fdca_copy_desc {
+    u32 region;                         /* 所属区域 */
+    u32 size;                           /* 字节数，不超过 FDCA_COPY_CHUNK_SIZE */
+    u64 src_offset;                     /* 源对象内偏移 */
+    u64 dst_offset;                     /* 目的对象内偏移 */
+};
+
+/**
+ * struct fdca_copy_side - 区域一侧在执行期间的后备
+ */
+struct fdca_copy_side {
+    struct page **pages;                /* 系统内存页，驻留 VRAM 时为 NULL */
+    void __iomem *io;                   /* 区域在 BAR 中的映射 */
+    u64 base;                           /* io 对应的对象内偏移 */
+};
+
+/**
+ * struct fdca_copy_item - 已校验并固定的一个区域
+ *
+ * 固定期间对象后备不变，两侧后备在提交时解析
+ */
+struct fdca_copy_item {
+    struct fdca_copy_region region;     /* 区域 */
+    struct fdca_copy_side src;          /* 源后备 */
+    struct fdca_copy_side dst;          /* 目的后备 */
+};
+
+/**
+ * struct fdca_copy_job - 一次拷贝提交对应的调度器作业
+ *
+ * 作业持有各对象的引用、固定和 BAR 映射，在 free_job 中释放。执行时
+ * 用到的内存都在提交时准备好，run_job 中不分配内存
+ */
+struct fdca_copy_job {
+    struct drm_sched_job base;          /* 调度器作业 */
+    struct fdca_device *fdev;           /* 所属设备 */
+    void *bounce;                       /* VRAM 之间拷贝的中转页，不需要时为 NULL */
+    u64 bytes;                          /* 总字节数 */
+    u32 num_items;                      /* 已校验并固定的区域数 */
+    struct fdca_copy_item items[];      /* 区域数组 */
+};
+
+static inline struct fdca_copy_job *to_fdca_copy_job(struct drm_sched_job *job)
+{
+    return container_of(job, struct fdca_copy_job, base);
+}
+
+static void fdca_copy_side_unmap(struct fdca_copy_side *side);
+
+static void fdca_copy_job_free(struct fdca_copy_job *job)
+{
+    struct fdca_copy_item *item;
+    u32 i;
+
+    drm_sched_job_cleanup(&job->base);
+
+    for (i = 0; i < job->num_items; i++) {
+        item = &job->items[i];
+        fdca_copy_side_unmap(&item->dst);
+        fdca_copy_side_unmap(&item->src);
+        fdca_gem_object_unpin(item->region.src);
+        fdca_gem_object_unpin(item->region.dst);
+        drm_gem_object_put(item->region.src);
+        drm_gem_object_put(item->region.dst);
+    }
+
+    if (job->bounce)
+        free_page((unsigned long)job->bounce);
+
+    kvfree(job);
+}
+
+/*
+ * ============================================================================
+ * CPU 执行
+ * ============================================================================
+ */
+
+/**
+ * fdca_copy_side_map() - 解析区域一侧的后备
+ * @fdev: FDCA 设备
+ * @side: 输出
+ * @gem: 对象 (已固定)
+ * @offset: 区域在对象内的起始偏移
+ * @size: 区域字节数
+ *
+ * 提交时调用：补齐系统内存页、建立 BAR 映射都可能分配内存
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_copy_side_map(struct fdca_device *fdev, struct fdca_copy_side *side,
+                              struct drm_gem_object *gem, u64 offset, u64 size)
+{
+    u64 vram_offset;
+    int ret;
+
+    ret = fdca_gem_object_get_pages(gem, &vram_offset, &side->pages);
+    if (ret)
+        return ret;
+
+    side->base = offset;
+    side->io = NULL;
+    if (side->pages)
+        return 0;
+
+    side->io = ioremap_wc(fdev->vram_base + vram_offset + offset, size);
+    if (!side->io)
+        return -ENOMEM;
+
+    return 0;
+}
+
+static void fdca_copy_side_unmap(struct fdca_copy_side *side)
+{
+    if (side->io)
+        iounmap(side->io);
+}
+
+/**
+ * fdca_copy_desc_cpu() - 以 CPU 执行一个描述符
+ * @src: 源后备
+ * @dst: 目的后备
+ * @desc: 描述符
+ * @bounce: VRAM 之间拷贝的中转页
+ *
+ * 系统内存一侧按页映射，每段不跨页；VRAM 之间经中转页拷贝
+ */
+static void fdca_copy_desc_cpu(const struct fdca_copy_side *src,
+                               const struct fdca_copy_side *dst,
+                               const struct fdca_copy_desc *desc, void *bounce)
+{
+    u64 src_off = desc->src_offset, dst_off = desc->dst_offset;
+    u32 len = desc->size;
+    void *s, *d;
+    u32 n;
+
+    while (len) {
+        n = len;
+        if (src->pages)
+            n = min_t(u32, n, PAGE_SIZE - offset_in_page(src_off));
+        if (dst->pages)
+            n = min_t(u32, n, PAGE_SIZE - offset_in_page(dst_off));
+        if (!src->pages && !dst->pages)
+            n = min_t(u32, n, PAGE_SIZE);
+
+        s = src->pages ? kmap_local_page(src->pages[src_off >> PAGE_SHIFT]) +
+                         offset_in_page(src_off) : NULL;
+        d = dst->pages ? kmap_local_page(dst->pages[dst_off >> PAGE_SHIFT]) +
+                         offset_in_page(dst_off) : NULL;
+
+        if (s && d) {
+            memcpy(d, s, n);
+        } else if (s) {
+            memcpy_toio(dst->io + (dst_off - dst->base), s, n);
+        } else if (d) {
+            memcpy_fromio(d, src->io + (src_off - src->base), n);
+        } else {
+            memcpy_fromio(bounce, src->io + (src_off - src->base), n);
+            memcpy_toio(dst->io + (dst_off - dst->base), bounce, n);
+        }
+
+        /* 按映射的相反顺序解除 */
+        if (d)
+            kunmap_local(d);
+        if (s)
+            kunmap_local(s);
+
+        src_off += n;
+        dst_off += n;
+        len -= n;
+    }
+}
+
+/**
+ * fdca_copy_execute() - 切分并执行作业的全部区域
+ * @job: 拷贝作业
+ *
+ * 后备和中转页已在提交时准备好，不分配内存，不会失败
+ */
+static void fdca_copy_execute(struct fdca_copy_job *job)
+{
+    struct fdca_copy_engine *engine = &job->fdev->copy;
+    struct fdca_copy_desc descs[FDCA_COPY_BATCH];
+    struct fdca_copy_region *region;
+    struct fdca_copy_item *item;
+    u64 done, num_descs = 0;
+    u32 i, n, k;
+
+    for (i = 0; i < job->num_items; i++) {
+        item = &job->items[i];
+        region = &item->region;
+
+        for (done = 0; done < region->size; ) {
+            /* 填满一批描述符 */
+            for (n = 0; n < FDCA_COPY_BATCH && done < region->size; n++) {
+                descs[n].region = i;
+                descs[n].size = min_t(u64, region->size - done, FDCA_COPY_CHUNK_SIZE);
+                descs[n].src_offset = region->src_offset + done;
+                descs[n].dst_offset = region->dst_offset + done;
+                done += descs[n].size;
+            }
+
+            for (k = 0; k < n; k++)
+                fdca_copy_desc_cpu(&item->src, &item->dst, &descs[k], job->bounce);
+
+            num_descs += n;
+            cond_resched();
+        }
+    }
+
+    atomic64_add(num_descs, &engine->descs);
+    atomic64_add(job->bytes, &engine->bytes);
+}
+
+/*
+ * 拷贝由 CPU 同步完成，返回 NULL 时调度器立即触发完成 fence。
+ * run_job 位于 fence 触发路径上，这里不分配内存
+ */
+static struct dma_fence *fdca_copy_run_job(struct drm_sched_job *sched_job)
+{
+    struct fdca_copy_job *job = to_fdca_copy_job(sched_job);
+    u64 start_ns;
+
+    /* 实体被销毁时未执行的作业已带错误码 */
+    if (sched_job->s_fence->finished.error)
+        return NULL;
+
+    start_ns = ktime_get_ns();
+    fdca_copy_execute(job);
+    atomic64_add(ktime_get_ns() - start_ns, &job->fdev->copy.busy_ns);
+
+    return NULL;
+}
+
+static enum drm_gpu_sched_stat fdca_copy_timedout_job(struct drm_sched_job *sched_job)
+{
+    /* run_job 返回时作业已完成，不会超时 */
+    return DRM_GPU_SCHED_STAT_NOMINAL;
+}
+
+static void fdca_copy_free_job(struct drm_sched_job *sched_job)
+{
+    fdca_copy_job_free(to_fdca_copy_job(sched_job));
+}
+
+static const struct drm_sched_backend_ops fdca_copy_sched_ops = {
+    .run_job = fdca_copy_run_job,
+    .timedout_job = fdca_copy_timedout_job,
+    .free_job = fdca_copy_free_job,
+};
+
+/*
+ * ============================================================================
+ * 提交
+ * ============================================================================
+ */
+
+/**
+ * fdca_copy_region_check() - 校验区域并固定两侧对象
+ * @region: 区域，对象引用由调用者持有
+ *
+ * 后备可能被 CPU 页表变化或导出者撤销的对象不支持拷贝
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_copy_region_check(const struct fdca_copy_region *region)
+{
+    struct drm_gem_object *src = region->src, *dst = region->dst;
+    int ret;
+
+    if (!region->size ||
+        region->size > src->size || region->src_offset > src->size - region->size ||
+        region->size > dst->size || region->dst_offset > dst->size - region->size)
+        return -EINVAL;
+
+    /* 同一对象内的重叠区域没有确定的结果 */
+    if (src == dst && region->src_offset < region->dst_offset + region->size &&
+        region->dst_offset < region->src_offset + region->size)
+        return -EINVAL;
+
+    if (fdca_gem_object_revocable(src) || fdca_gem_object_revocable(dst) ||
+        fdca_gem_object_readonly(dst))
+        return -EINVAL;
+
+    ret = fdca_gem_object_pin(src);
+    if (ret)
+        return ret;
+
+    ret = fdca_gem_object_pin(dst);
+    if (ret)
+        fdca_gem_object_unpin(src);
+
+    return ret;
+}
+
+/**
+ * fdca_copy_job_create() - 创建拷贝作业
+ * @fdev: FDCA 设备
+ * @entity: 调度实体
+ * @num_regions: 区域数
+ *
+ * Return: 作业或 ERR_PTR
+ */
+static struct fdca_copy_job *fdca_copy_job_create(struct fdca_device *fdev,
+                                                  struct drm_sched_entity *entity,
+                                                  u32 num_regions)
+{
+    struct fdca_copy_job *job;
+    int ret;
+
+    job = kvzalloc(struct_size(job, items, num_regions), GFP_KERNEL);
+    if (!job)
+        return ERR_PTR(-ENOMEM);
+
+    ret = drm_sched_job_init(&job->base, entity, 1, NULL);
+    if (ret) {
+        kvfree(job);
+        return ERR_PTR(ret);
+    }
+
+    job->fdev = fdev;
+    return job;
+}
+
+/**
+ * fdca_copy_job_add() - 校验区域、解析两侧后备并加入作业
+ * @job: 拷贝作业
+ * @region: 区域，成功时对象引用转交给作业
+ *
+ * 两侧都驻留 VRAM 时在这里分配中转页
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_copy_job_add(struct fdca_copy_job *job, const struct fdca_copy_region *region)
+{
+    struct fdca_copy_item *item = &job->items[job->num_items];
+    int ret;
+
+    ret = fdca_copy_region_check(region);
+    if (ret)
+        return ret;
+
+    ret = fdca_copy_side_map(job->fdev, &item->src, region->src, region->src_offset,
+                             region->size);
+    if (ret)
+        goto err_unpin;
+
+    ret = fdca_copy_side_map(job->fdev, &item->dst, region->dst, region->dst_offset,
+                             region->size);
+    if (ret)
+        goto err_unmap_src;
+
+    if (!item->src.pages && !item->dst.pages && !job->bounce) {
+        job->bounce = (void *)__get_free_page(GFP_KERNEL);
+        if (!job->bounce) {
+            ret = -ENOMEM;
+            goto err_unmap_dst;
+        }
+    }
+
+    item->region = *region;
+    job->num_items++;
+    job->bytes += region->size;
+
+    return 0;
+
+err_unmap_dst:
+    fdca_copy_side_unmap(&item->dst);
+err_unmap_src:
+    fdca_copy_side_unmap(&item->src);
+err_unpin:
+    fdca_gem_object_unpin(region->src);
+    fdca_gem_object_unpin(region->dst);
+    return ret;
+}
+
+/* 作业在此被消耗，返回完成 fence 的引用 */
+static struct dma_fence *fdca_copy_job_push(struct fdca_copy_job *job)
+{
+    struct fdca_copy_engine *engine = &job->fdev->copy;
+    struct dma_fence *fence;
+
+    mutex_lock(&engine->push_lock);
+    drm_sched_job_arm(&job->base);
+    fence = dma_fence_get(&job->base.s_fence->finished);
+    drm_sched_entity_push_job(&job->base);
+    mutex_unlock(&engine->push_lock);
+
+    atomic64_inc(&engine->jobs);
+
+    return fence;
+}
+
+/**
+ * fdca_copy_submit() - 内核内部提交一批拷贝
+ * @fdev: FDCA 设备
+ * @regions: 区域数组，对象引用仍由调用者持有
+ * @num_regions: 区域数
+ * @dep: 开始前等待的 fence，可为 NULL
+ *
+ * 作业自行获取对象引用并固定对象，调用者可在返回后放下自己的引用
+ *
+ * Return: 完成 fence 或 ERR_PTR，调用者负责放下引用
+ */
+struct dma_fence *fdca_copy_submit(struct fdca_device *fdev,
+                                   const struct fdca_copy_region *regions,
+                                   u32 num_regions, struct dma_fence *dep)
+{
+    struct fdca_copy_job *job;
+    u32 i;
+    int ret;
+
+    if (!num_regions)
+        return ERR_PTR(-EINVAL);
+
+    job = fdca_copy_job_create(fdev, &fdev->copy.kernel_entity, num_regions);
+    if (IS_ERR(job))
+        return ERR_CAST(job);
+
+    for (i = 0; i < num_regions; i++) {
+        drm_gem_object_get(regions[i].src);
+        drm_gem_object_get(regions[i].dst);
+        ret = fdca_copy_job_add(job, &regions[i]);
+        if (ret) {
+            drm_gem_object_put(regions[i].src);
+            drm_gem_object_put(regions[i].dst);
+            goto err_free_job;
+        }
+    }
+
+    if (dep) {
+        ret = drm_sched_job_add_dependency(&job->base, dma_fence_get(dep));
+        if (ret)
+            goto err_free_job;
+    }
+
+    return fdca_copy_job_push(job);
+
+err_free_job:
+    fdca_copy_job_free(job);
+    return ERR_PTR(ret);
+}
+
+/**
+ * fdca_copy() - 处理用户态拷贝请求
+ * @file: DRM 文件
+ * @entity: 上下文的拷贝实体
+ * @args: 拷贝参数
+ *
+ * 区域在 ioctl 中完成校验和对象固定，拷贝在输入 syncobj 触发后由
+ * 拷贝调度器执行，ioctl 不阻塞。同一上下文的拷贝按提交顺序执行
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_copy(struct drm_file *file, struct drm_sched_entity *entity,
+              struct drm_fdca_copy *args)
+{
+    struct fdca_device *fdev = drm_to_fdca(file->minor->dev);
+    struct drm_fdca_copy_region *uregions;
+    struct drm_fdca_syncobj *syncs;
+    struct fdca_syncobj_out *out = NULL;
+    struct fdca_copy_region region;
+    struct fdca_copy_job *job;
+    struct dma_fence *fence;
+    u32 i;
+    int ret;
+
+    if (!args->regions_ptr || !args->num_regions ||
+        args->num_regions > FDCA_COPY_MAX_REGIONS || args->flags)
+        return -EINVAL;
+
+    uregions = kvmalloc_array(args->num_regions, sizeof(*uregions), GFP_KERNEL);
+    if (!uregions)
+        return -ENOMEM;
+
+    if (copy_from_user(uregions, u64_to_user_ptr(args->regions_ptr),
+                       args->num_regions * sizeof(*uregions))) {
+        ret = -EFAULT;
+        goto out_free_uregions;
+    }
+
+    job = fdca_copy_job_create(fdev, entity, args->num_regions);
+    if (IS_ERR(job)) {
+        ret = PTR_ERR(job);
+        goto out_free_uregions;
+    }
+
+    for (i = 0; i < args->num_regions; i++) {
+        region.src = drm_gem_object_lookup(file, uregions[i].src_handle);
+        region.dst = drm_gem_object_lookup(file, uregions[i].dst_handle);
+        region.src_offset = uregions[i].src_offset;
+        region.dst_offset = uregions[i].dst_offset;
+        region.size = uregions[i].size;
+
+        ret = region.src && region.dst ? fdca_copy_job_add(job, &region) : -ENOENT;
+        if (ret) {
+            drm_gem_object_put(region.src);
+            drm_gem_object_put(region.dst);
+            goto err_free_job;
+        }
+    }
+
+    if (args->num_in_syncs) {
+        syncs = fdca_syncobj_copy(args->in_syncs_ptr, args->num_in_syncs);
+        if (IS_ERR(syncs)) {
+            ret = PTR_ERR(syncs);
+            goto err_free_job;
+        }
+
+        ret = fdca_syncobj_add_deps(file, &job->base, syncs, args->num_in_syncs);
+        kvfree(syncs);
+        if (ret)
+            goto err_free_job;
+    }
+
+    /* 输出 syncobj 先行查找并预分配，入队之后不再失败 */
+    if (args->num_out_syncs) {
+        syncs = fdca_syncobj_copy(args->out_syncs_ptr, args->num_out_syncs);
+        if (IS_ERR(syncs)) {
+            ret = PTR_ERR(syncs);
+            goto err_free_job;
+        }
+
+        out = kvcalloc(args->num_out_syncs, sizeof(*out), GFP_KERNEL);
+        if (!out) {
+            kvfree(syncs);
+            ret = -ENOMEM;
+            goto err_free_job;
+        }
+
+        ret = fdca_syncobj_out_prepare(file, syncs, args->num_out_syncs, out);
+        kvfree(syncs);
+        if (ret)
+            goto err_free_out;
+    }
+
+    fence = fdca_copy_job_push(job);
+    fdca_syncobj_out_signal(out, args->num_out_syncs, fence);
+    dma_fence_put(fence);
+
+    fdca_syncobj_out_free(out, args->num_out_syncs);
+    kvfree(out);
+    kvfree(uregions);
+    return 0;
+
+err_free_out:
+    fdca_syncobj_out_free(out, args->num_out_syncs);
+    kvfree(out);
+err_free_job:
+    fdca_copy_job_free(job);
+out_free_uregions:
+    kvfree(uregions);
+    return ret;
+}
+
+/*
+ * ============================================================================
+ * 暂存缓冲
+ * ============================================================================
+ *
+ * pwrite/pread 经常驻的 GTT 暂存对象中转: 用户数据拷入一个缓冲时，
+ * 拷贝引擎正在搬运上一个缓冲，两者重叠。每个缓冲记录最近一次使用它的
+ * 拷贝 fence，复用前等待。暂存区分为 FDCA_STAGING_LANES 个通道，每次
+ * pwrite/pread 独占一个通道的双缓冲，不同调用者的用户态拷贝可以并行，
+ * 只在通道全部繁忙时排队
+ */
+
+/* 获取一个空闲通道，全部繁忙时等待轮到的通道 */
+static struct fdca_staging_lane *fdca_staging_lane_get(struct fdca_staging *staging)
+{
+    u32 first = atomic_inc_return(&staging->next_lane);
+    struct fdca_staging_lane *lane;
+    u32 i;
+    int ret;
+
+    for (i = 0; i < FDCA_STAGING_LANES; i++) {
+        lane = &staging->lanes[(first + i) % FDCA_STAGING_LANES];
+        if (mutex_trylock(&lane->lock))
+            return lane;
+    }
+
+    lane = &staging->lanes[first % FDCA_STAGING_LANES];
+    ret = mutex_lock_interruptible(&lane->lock);
+    if (ret)
+        return ERR_PTR(ret);
+
+    return lane;
+}
+
+static void fdca_staging_lane_put(struct fdca_staging_lane *lane)
+{
+    mutex_unlock(&lane->lock);
+}
+
+/* 等待缓冲上一次的拷贝完成，返回拷贝的错误码 */
+static int fdca_staging_slot_wait(struct fdca_staging_slot *slot)
+{
+    long ret;
+
+    if (!slot->fence)
+        return 0;
+
+    ret = dma_fence_wait(slot->fence, true);
+    if (ret)
+        return ret;
+
+    ret = slot->fence->error;
+    dma_fence_put(slot->fence);
+    slot->fence = NULL;
+
+    return ret;
+}
+
+/**
+ * fdca_staging_slot_copy() - 在暂存缓冲与对象之间提交一次拷贝
+ * @fdev: FDCA 设备
+ * @slot: 暂存缓冲 (空闲)
+ * @gem: 对象
+ * @offset: 对象内偏移
+ * @len: 字节数，不超过 FDCA_STAGING_CHUNK_SIZE
+ * @to_obj: true 表示从暂存缓冲拷入对象
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_staging_slot_copy(struct fdca_device *fdev, struct fdca_staging_slot *slot,
+                                  struct drm_gem_object *gem, u64 offset, u32 len,
+                                  bool to_obj)
+{
+    struct fdca_copy_region region = {
+        .src = to_obj ? &slot->obj->base : gem,
+        .dst = to_obj ? gem : &slot->obj->base,
+        .src_offset = to_obj ? 0 : offset,
+        .dst_offset = to_obj ? offset : 0,
+        .size = len,
+    };
+    struct dma_fence *fence;
+
+    fence = fdca_copy_submit(fdev, &region, 1, NULL);
+    if (IS_ERR(fence))
+        return PTR_ERR(fence);
+
+    slot->fence = fence;
+    return 0;
+}
+
+static void fdca_staging_perf_add(struct fdca_staging_perf *perf, u64 size, u64 start_ns)
+{
+    u32 bucket = min_t(u32, ilog2(size) > PAGE_SHIFT ? ilog2(size) - PAGE_SHIFT : 0,
+                       FDCA_STAGING_PERF_BUCKETS - 1);
+
+    atomic64_inc(&perf[bucket].calls);
+    atomic64_add(size, &perf[bucket].bytes);
+    atomic64_add(ktime_get_ns() - start_ns, &perf[bucket].ns);
+}
+
+/* 校验 pwrite/pread 参数并查找对象 */
+static struct drm_gem_object *fdca_staging_lookup(struct drm_file *file, u32 handle,
+                                                  u32 pad, u64 offset, u64 size,
+                                                  u64 data_ptr)
+{
+    struct drm_gem_object *gem;
+
+    if (pad || !size)
+        return ERR_PTR(-EINVAL);
+
+    if (!access_ok(u64_to_user_ptr(data_ptr), size))
+        return ERR_PTR(-EFAULT);
+
+    gem = drm_gem_object_lookup(file, handle);
+    if (!gem)
+        return ERR_PTR(-ENOENT);
+
+    if (size > gem->size || offset > gem->size - size) {
+        drm_gem_object_put(gem);
+        return ERR_PTR(-EINVAL);
+    }
+
+    return gem;
+}
+
+/**
+ * fdca_gem_pwrite() - 把用户数据写入对象
+ * @file: DRM 文件
+ * @args: pwrite 参数
+ *
+ * 返回时数据已写入对象
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_gem_pwrite(struct drm_file *file, struct drm_fdca_gem_pwrite *args)
+{
+    struct fdca_device *fdev = drm_to_fdca(file->minor->dev);
+    struct fdca_staging *staging = &fdev->copy.staging;
+    char __user *user_data = u64_to_user_ptr(args->data_ptr);
+    struct fdca_staging_lane *lane;
+    struct fdca_staging_slot *slot;
+    struct drm_gem_object *gem;
+    u64 start_ns = ktime_get_ns();
+    u64 done;
+    u32 i, len;
+    int ret, err;
+
+    gem = fdca_staging_lookup(file, args->handle, args->pad, args->offset,
+                              args->size, args->data_ptr);
+    if (IS_ERR(gem))
+        return PTR_ERR(gem);
+
+    lane = fdca_staging_lane_get(staging);
+    if (IS_ERR(lane)) {
+        ret = PTR_ERR(lane);
+        goto out_put;
+    }
+
+    for (done = 0; done < args->size; done += len) {
+        slot = &lane->slots[div_u64(done, FDCA_STAGING_CHUNK_SIZE) % FDCA_STAGING_SLOTS];
+        len = min_t(u64, args->size - done, FDCA_STAGING_CHUNK_SIZE);
+
+        ret = fdca_staging_slot_wait(slot);
+        if (ret)
+            break;
+
+        if (copy_from_user(slot->vaddr, user_data + done, len)) {
+            ret = -EFAULT;
+            break;
+        }
+
+        ret = fdca_staging_slot_copy(fdev, slot, gem, args->offset + done, len, true);
+        if (ret)
+            break;
+    }
+
+    /* 出错时也要收回已提交的拷贝，错误以先发生的为准 */
+    for (i = 0; i < FDCA_STAGING_SLOTS; i++) {
+        err = fdca_staging_slot_wait(&lane->slots[i]);
+        if (!ret)
+            ret = err;
+    }
+
+    fdca_staging_lane_put(lane);
+
+    if (!ret)
+        fdca_staging_perf_add(staging->pwrite_perf, args->size, start_ns);
+out_put:
+    drm_gem_object_put(gem);
+    return ret;
+}
+
+/**
+ * fdca_gem_pread() - 把对象内容读到用户内存
+ * @file: DRM 文件
+ * @args: pread 参数
+ *
+ * 拷贝引擎最多领先 FDCA_STAGING_SLOTS 个缓冲，拷给用户的同时搬运后续数据
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_gem_pread(struct drm_file *file, struct drm_fdca_gem_pread *args)
+{
+    struct fdca_device *fdev = drm_to_fdca(file->minor->dev);
+    struct fdca_staging *staging = &fdev->copy.staging;
+    char __user *user_data = u64_to_user_ptr(args->data_ptr);
+    struct fdca_staging_lane *lane;
+    struct fdca_staging_slot *slot;
+    struct drm_gem_object *gem;
+    u64 start_ns = ktime_get_ns();
+    u64 submitted = 0, done;
+    u32 i, len;
+    int ret, err;
+
+    gem = fdca_staging_lookup(file, args->handle, args->pad, args->offset,
+                              args->size, args->data_ptr);
+    if (IS_ERR(gem))
+        return PTR_ERR(gem);
+
+    lane = fdca_staging_lane_get(staging);
+    if (IS_ERR(lane)) {
+        ret = PTR_ERR(lane);
+        goto out_put;
+    }
+
+    for (done = 0; done < args->size; done += len) {
+        /* 让拷贝引擎领先，填满空闲缓冲 */
+        while (submitted < args->size &&
+               submitted - done < FDCA_STAGING_SLOTS * FDCA_STAGING_CHUNK_SIZE) {
+            slot = &lane->slots[div_u64(submitted, FDCA_STAGING_CHUNK_SIZE) %
+                                FDCA_STAGING_SLOTS];
+            len = min_t(u64, args->size - submitted, FDCA_STAGING_CHUNK_SIZE);
+
+            ret = fdca_staging_slot_wait(slot);
+            if (!ret)
+                ret = fdca_staging_slot_copy(fdev, slot, gem, args->offset + submitted,
+                                             len, false);
+            if (ret)
+                goto out_drain;
+            submitted += len;
+        }
+
+        slot = &lane->slots[div_u64(done, FDCA_STAGING_CHUNK_SIZE) % FDCA_STAGING_SLOTS];
+        len = min_t(u64, args->size - done, FDCA_STAGING_CHUNK_SIZE);
+
+        ret = fdca_staging_slot_wait(slot);
+        if (ret)
+            break;
+
+        if (copy_to_user(user_data + done, slot->vaddr, len)) {
+            ret = -EFAULT;
+            break;
+        }
+    }
+
+out_drain:
+    for (i = 0; i < FDCA_STAGING_SLOTS; i++) {
+        err = fdca_staging_slot_wait(&lane->slots[i]);
+        if (!ret)
+            ret = err;
+    }
+
+    fdca_staging_lane_put(lane);
+
+    if (!ret)
+        fdca_staging_perf_add(staging->pread_perf, args->size, start_ns);
+out_put:
+    drm_gem_object_put(gem);
+    return ret;
+}
+
+/**
+ * fdca_staging_fini() - 释放暂存缓冲
+ * @fdev: FDCA 设备
+ */
+static void fdca_staging_fini(struct fdca_device *fdev)
+{
+    struct fdca_staging *staging = &fdev->copy.staging;
+    struct fdca_staging_slot *slot;
+    u32 i, j;
+
+    for (i = 0; i < FDCA_STAGING_LANES; i++) {
+        for (j = 0; j < FDCA_STAGING_SLOTS; j++) {
+            slot = &staging->lanes[i].slots[j];
+            if (!slot->obj)
+                continue;
+
+            if (slot->fence) {
+                dma_fence_wait(slot->fence, false);
+                dma_fence_put(slot->fence);
+                slot->fence = NULL;
+            }
+
+            vunmap(slot->vaddr);
+            fdca_gem_object_unpin(&slot->obj->base);
+            drm_gem_object_put(&slot->obj->base);
+            slot->obj = NULL;
+        }
+    }
+}
+
+/**
+ * fdca_staging_init() - 分配并常驻固定暂存缓冲
+ * @fdev: FDCA 设备
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_staging_init(struct fdca_device *fdev)
+{
+    struct fdca_staging *staging = &fdev->copy.staging;
+    struct fdca_staging_slot *slot;
+    struct page **pages;
+    u64 vram_offset;
+    u32 i, j;
+    int ret;
+
+    for (i = 0; i < FDCA_STAGING_LANES; i++)
+        mutex_init(&staging->lanes[i].lock);
+    atomic_set(&staging->next_lane, 0);
+
+    for (i = 0; i < FDCA_STAGING_PERF_BUCKETS; i++) {
+        atomic64_set(&staging->pwrite_perf[i].calls, 0);
+        atomic64_set(&staging->pwrite_perf[i].bytes, 0);
+        atomic64_set(&staging->pwrite_perf[i].ns, 0);
+        atomic64_set(&staging->pread_perf[i].calls, 0);
+        atomic64_set(&staging->pread_perf[i].bytes, 0);
+        atomic64_set(&staging->pread_perf[i].ns, 0);
+    }
+
+    for (i = 0; i < FDCA_STAGING_LANES; i++) {
+        for (j = 0; j < FDCA_STAGING_SLOTS; j++) {
+            slot = &staging->lanes[i].slots[j];
+
+            slot->obj = fdca_gem_object_create(fdev, FDCA_STAGING_CHUNK_SIZE,
+                                               FDCA_GEM_CREATE_GTT);
+            if (IS_ERR(slot->obj)) {
+                ret = PTR_ERR(slot->obj);
+                slot->obj = NULL;
+                goto err_fini;
+            }
+
+            ret = fdca_gem_object_pin(&slot->obj->base);
+            if (ret)
+                goto err_put;
+
+            ret = fdca_gem_object_get_pages(&slot->obj->base, &vram_offset,
+                                            &pages);
+            if (ret)
+                goto err_unpin;
+
+            slot->vaddr = vmap(pages, FDCA_STAGING_CHUNK_SIZE >> PAGE_SHIFT,
+                               VM_MAP, PAGE_KERNEL);
+            if (!slot->vaddr) {
+                ret = -ENOMEM;
+                goto err_unpin;
+            }
+        }
+    }
+
+    return 0;
+
+err_unpin:
+    fdca_gem_object_unpin(&slot->obj->base);
+err_put:
+    drm_gem_object_put(&slot->obj->base);
+    slot->obj = NULL;
+err_fini:
+    fdca_err(fdev, "暂存缓冲分配失败: %d\n", ret);
+    fdca_staging_fini(fdev);
+    return ret;
+}
+
+/*
+ * ============================================================================
+ * 初始化和清理
+ * ============================================================================
+ */
+
+/**
+ * fdca_copy_entity_init() - 创建上下文的拷贝实体
+ * @fdev: FDCA 设备
+ * @entity: 实体
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_copy_entity_init(struct fdca_device *fdev, struct drm_sched_entity *entity)
+{
+    struct drm_gpu_scheduler *sched = &fdev->copy.sched;
+
+    return drm_sched_entity_init(entity, DRM_SCHED_PRIORITY_NORMAL, &sched, 1, NULL);
+}
+
+/**
+ * fdca_copy_entity_fini() - 销毁上下文的拷贝实体
+ * @entity: 实体
+ *
+ * 返回后不会再有该实体的作业执行，未执行的作业以错误触发
+ */
+void fdca_copy_entity_fini(struct drm_sched_entity *entity)
+{
+    drm_sched_entity_destroy(entity);
+}
+
+/**
+ * fdca_copy_init() - 创建拷贝调度器
+ * @fdev: FDCA 设备
+ *
+ * 所有上下文共用一个调度器，每个上下文一个实体，内核提交另用一个实体
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_copy_init(struct fdca_device *fdev)
+{
+    struct fdca_copy_engine *engine = &fdev->copy;
+    const struct drm_sched_init_args args = {
+        .ops = &fdca_copy_sched_ops,
+        .num_rqs = DRM_SCHED_PRIORITY_COUNT,
+        .credit_limit = 1,
+        .timeout = MAX_SCHEDULE_TIMEOUT,
+        .name = "fdca-copy",
+        .dev = fdev->dev,
+    };
+    int ret;
+
+    mutex_init(&engine->push_lock);
+    atomic64_set(&engine->jobs, 0);
+    atomic64_set(&engine->descs, 0);
+    atomic64_set(&engine->bytes, 0);
+    atomic64_set(&engine->busy_ns, 0);
+
+    ret = drm_sched_init(&engine->sched, &args);
+    if (ret) {
+        fdca_err(fdev, "拷贝调度器初始化失败: %d\n", ret);
+        return ret;
+    }
+
+    ret = fdca_copy_entity_init(fdev, &engine->kernel_entity);
+    if (ret) {
+        fdca_err(fdev, "拷贝实体初始化失败: %d\n", ret);
+        goto err_sched_fini;
+    }
+
+    ret = fdca_staging_init(fdev);
+    if (ret)
+        goto err_entity_fini;
+
+    return 0;
+
+err_entity_fini:
+    fdca_copy_entity_fini(&engine->kernel_entity);
+err_sched_fini:
+    drm_sched_fini(&engine->sched);
+    return ret;
+}
+
+/**
+ * fdca_copy_fini() - 销毁拷贝调度器
+ * @fdev: FDCA 设备
+ *
+ * 调用前所有上下文必须已销毁
+ */
+void fdca_copy_fini(struct fdca_device *fdev)
+{
+    fdca_staging_fini(fdev);
+    fdca_copy_entity_fini(&fdev->copy.kernel_entity);
+    drm_sched_fini(&fdev->copy.sched);
+}
+
+/*
+ * ============================================================================
+ * 导出符号
+ * ============================================================================
+ */
+
+EXPORT_SYMBOL_GPL(fdca_copy_submit);
+EXPORT_SYMBOL_GPL(fdca_copy);
+EXPORT_SYMBOL_GPL(fdca_gem_pwrite);
+EXPORT_SYMBOL_GPL(fdca_gem_pread);
+EXPORT_SYMBOL_GPL(fdca_copy_entity_init);
+EXPORT_SYMBOL_GPL(fdca_copy_entity_fini);
+EXPORT_SYMBOL_GPL(fdca_copy_init);
+EXPORT_SYMBOL_GPL(fdca_copy_fini);
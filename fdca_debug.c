@@ -4,9 +4,12 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-resv.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include "fdca_drv.h"
+#include "fdca_queue.h"
 
 static struct dentry *fdca_debugfs_root = NULL;
 
@@ -55,6 +58,7 @@ static int fdca_debugfs_memory_show(struct seq_file *m, void *data)
 {
     struct fdca_device *fdev = m->private;
     struct fdca_memory_total_stats stats;
+    u64 pins, pin_pages, pin_ns;
     
     if (fdev->mem_mgr) {
         fdca_memory_get_total_stats(fdev, &stats);
@@ -64,7 +68,8 @@ static int fdca_debugfs_memory_show(struct seq_file *m, void *data)
         seq_printf(m, "VRAM 使用: %llu MB (%.1f%%)\n", 
                    stats.vram_used >> 20,
                    (float)stats.vram_used * 100.0 / stats.vram_total);
-        seq_printf(m, "VRAM 碎片率: %u%%\n", stats.vram_fragmentation);
+        seq_printf(m, "VRAM 碎片率: %u%% (最大空闲块 %llu KB)\n",
+                   stats.vram_fragmentation, stats.vram_largest_free >> 10);
         
         seq_printf(m, "\nGTT 总量: %llu MB\n", stats.gtt_total >> 20);
         seq_printf(m, "GTT 使用: %llu MB (%.1f%%)\n",
@@ -73,6 +78,59 @@ static int fdca_debugfs_memory_show(struct seq_file *m, void *data)
         
         seq_printf(m, "\n总分配: %lld 字节\n", stats.total_allocated);
         seq_printf(m, "峰值使用: %lld 字节\n", stats.peak_usage);
+        
+        seq_printf(m, "\n=== CPU 映射 ===\n");
+        seq_printf(m, "4KB 缺页: %lld (映射 %lld 页)\n",
+                   atomic64_read(&fdev->stats.gem_faults),
+                   atomic64_read(&fdev->stats.gem_fault_pages));
+        seq_printf(m, "2MB 缺页: %lld\n",
+                   atomic64_read(&fdev->stats.gem_huge_faults));
+        seq_printf(m, "GTT 对象已分配页: %lld\n",
+                   atomic64_read(&fdev->stats.gem_gtt_pages));
+        
+        seq_printf(m, "\n=== VRAM 驱逐 ===\n");
+        seq_printf(m, "驱逐: %lld 次, %lld 字节\n",
+                   atomic64_read(&fdev->mem_mgr->evictions),
+                   atomic64_read(&fdev->mem_mgr->evicted_bytes));
+        seq_printf(m, "迁回: %lld 次, %lld 字节\n",
+                   atomic64_read(&fdev->mem_mgr->restores),
+                   atomic64_read(&fdev->mem_mgr->restored_bytes));
+        seq_printf(m, "碎片整理搬移: %lld 次, %lld 字节\n",
+                   atomic64_read(&fdev->mem_mgr->vram.defrag_moves),
+                   atomic64_read(&fdev->mem_mgr->vram.defrag_bytes));
+        
+        seq_printf(m, "\n=== GEM 对象缓存 ===\n");
+        seq_printf(m, "缓存对象: %u 个, %llu KB\n",
+                   READ_ONCE(fdev->mem_mgr->cache_count),
+                   READ_ONCE(fdev->mem_mgr->cache_bytes) >> 10);
+        seq_printf(m, "命中: %lld, 未命中: %lld, 过期释放: %lld\n",
+                   atomic64_read(&fdev->mem_mgr->cache_hits),
+                   atomic64_read(&fdev->mem_mgr->cache_misses),
+                   atomic64_read(&fdev->mem_mgr->cache_expired));
+        
+        pins = atomic64_read(&fdev->mem_mgr->userptr_pins);
+        pin_pages = atomic64_read(&fdev->mem_mgr->userptr_pin_pages);
+        pin_ns = atomic64_read(&fdev->mem_mgr->userptr_pin_ns);
+        seq_printf(m, "\n=== 用户指针对象 ===\n");
+        seq_printf(m, "固定: %llu 次, %llu 页, 平均每次 %llu us, 每页 %llu ns\n",
+                   pins, pin_pages,
+                   pins ? div64_u64(pin_ns, pins) / NSEC_PER_USEC : 0,
+                   pin_pages ? div64_u64(pin_ns, pin_pages) : 0);
+        seq_printf(m, "通知撤销: %lld\n",
+                   atomic64_read(&fdev->mem_mgr->userptr_invalidations));
+        
+        seq_printf(m, "\n=== dma-buf ===\n");
+        seq_printf(m, "导出迁出 VRAM: %lld, 导入: %lld, 导出者撤销映射: %lld\n",
+                   atomic64_read(&fdev->mem_mgr->prime_exports),
+                   atomic64_read(&fdev->mem_mgr->prime_imports),
+                   atomic64_read(&fdev->mem_mgr->prime_move_notifies));
+        
+        seq_printf(m, "\n=== 向量内存缓冲池 ===\n");
+        seq_printf(m, "分配: 256B %lld, 4KB %lld, 64KB %lld, 直接分配 %lld\n",
+                   atomic64_read(&fdev->vmem_pools.allocs[0]),
+                   atomic64_read(&fdev->vmem_pools.allocs[1]),
+                   atomic64_read(&fdev->vmem_pools.allocs[2]),
+                   atomic64_read(&fdev->vmem_pools.fallbacks));
     } else {
         seq_printf(m, "内存管理器未初始化\n");
     }
@@ -93,6 +151,50 @@ static const struct file_operations fdca_debugfs_memory_fops = {
     .release = single_release,
 };
 
+/* VRAM 空闲块分布 - 每阶空闲块数量，用于判断大块分配能否成功 */
+static int fdca_debugfs_vram_free_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    struct fdca_vram_stats stats;
+    u32 order;
+    
+    if (!fdev->mem_mgr)
+        return 0;
+    
+    fdca_vram_get_stats(fdev, &stats);
+    
+    seq_printf(m, "可用: %llu KB, 最大空闲块: %llu KB, 碎片率: %u%%\n",
+               stats.available_size >> 10, stats.largest_free >> 10,
+               stats.fragmentation);
+    seq_printf(m, "每 CPU 缓存: %lld KB, 命中 %lld, 补充 %lld, 归还 %lld\n",
+               atomic64_read(&fdev->mem_mgr->vram.mag_cached) >> 10,
+               atomic64_read(&fdev->mem_mgr->vram.mag_hits),
+               atomic64_read(&fdev->mem_mgr->vram.mag_refills),
+               atomic64_read(&fdev->mem_mgr->vram.mag_flushes));
+    seq_printf(m, "%-6s %12s %10s\n", "order", "block_kb", "free");
+    
+    for (order = 0; order < stats.num_orders; order++) {
+        seq_printf(m, "%-6u %12llu %10u\n", order,
+                   (stats.min_block_size << order) >> 10,
+                   stats.free_blocks[order]);
+    }
+    
+    return 0;
+}
+
+static int fdca_debugfs_vram_free_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_vram_free_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_vram_free_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_vram_free_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
 /* 寄存器转储 */
 static int fdca_debugfs_regs_show(struct seq_file *m, void *data)
 {
@@ -137,6 +239,628 @@ static const struct file_operations fdca_debugfs_regs_fops = {
     .release = single_release,
 };
 
+/* 队列提交统计 - 提交速率和单次提交延迟 */
+static int fdca_debugfs_queues_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    struct fdca_context *ctx;
+    struct fdca_queue *queue;
+    int id, i;
+    
+    seq_printf(m, "%-6s %-4s %-4s %-4s %12s %12s %12s %12s %12s %10s %10s\n",
+               "ctx", "type", "id", "sim", "submits", "doorbells",
+               "completed", "submits/s", "avg_ns", "seqno", "hw_seqno");
+    
+    mutex_lock(&fdev->ctx_lock);
+    idr_for_each_entry(&fdev->ctx_idr, ctx, id) {
+        for (i = 0; i < FDCA_QUEUE_MAX; i++) {
+            u64 submits, elapsed_ns;
+            
+            queue = READ_ONCE(ctx->queues[i]);
+            if (!queue)
+                continue;
+            
+            submits = atomic64_read(&queue->submit_count);
+            elapsed_ns = ktime_get_ns() - queue->create_time_ns;
+            
+            seq_printf(m, "%-6u %-4d %-4u %-4s %12llu %12lld %12lld %12llu %12llu %10u %10u\n",
+                       ctx->ctx_id, queue->type, queue->id,
+                       queue->simulated ? "yes" : "no",
+                       submits,
+                       atomic64_read(&queue->doorbell_count),
+                       atomic64_read(&queue->complete_count),
+                       elapsed_ns ? div64_u64(submits * NSEC_PER_SEC, elapsed_ns) : 0,
+                       submits ? div64_u64(atomic64_read(&queue->submit_ns), submits) : 0,
+                       READ_ONCE(queue->seqno), fdca_queue_completed_seqno(queue));
+        }
+    }
+    mutex_unlock(&fdev->ctx_lock);
+    
+    return 0;
+}
+
+static int fdca_debugfs_queues_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_queues_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_queues_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_queues_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* GPU 地址空间 - 每上下文页表占用与已映射字节数 */
+static int fdca_debugfs_vm_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    struct fdca_context *ctx;
+    int id;
+    
+    seq_printf(m, "%-6s %-6s %14s %14s %10s %10s %10s\n", "ctx", "asid",
+               "mapped_kb", "pt_kb", "binds", "bind_ops", "bind_waits");
+    
+    mutex_lock(&fdev->ctx_lock);
+    idr_for_each_entry(&fdev->ctx_idr, ctx, id) {
+        if (!ctx->vm)
+            continue;
+        seq_printf(m, "%-6u %-6u %14lld %14lld %10lld %10lld %10lld\n",
+                   ctx->ctx_id, ctx->vm->asid,
+                   atomic64_read(&ctx->vm->mapped_bytes) >> 10,
+                   atomic64_read(&ctx->vm->pt_bytes) >> 10,
+                   atomic64_read(&ctx->vm->bind_jobs),
+                   atomic64_read(&ctx->vm->bind_ops),
+                   atomic64_read(&ctx->vm->bind_waits));
+    }
+    mutex_unlock(&fdev->ctx_lock);
+    
+    return 0;
+}
+
+static int fdca_debugfs_vm_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_vm_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_vm_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_vm_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* GTT 映射吞吐 - 按映射大小分档的页/秒 */
+static void fdca_debugfs_gtt_perf_row(struct seq_file *m, const struct fdca_gtt_perf *perf)
+{
+    u64 calls = atomic64_read(&perf->calls);
+    u64 pages = atomic64_read(&perf->pages);
+    u64 ns = atomic64_read(&perf->ns);
+    
+    seq_printf(m, " %10llu %14llu", calls,
+               ns ? mul_u64_u64_div_u64(pages, NSEC_PER_SEC, ns) : 0);
+}
+
+static int fdca_debugfs_gtt_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    struct fdca_gtt_manager *gtt;
+    int i;
+    
+    if (!fdev->mem_mgr)
+        return 0;
+    
+    gtt = &fdev->mem_mgr->gtt;
+    seq_printf(m, "PTE: 2MB %lld, 4KB %lld\n\n", atomic64_read(&gtt->large_ptes),
+               atomic64_read(&gtt->small_ptes));
+    seq_printf(m, "%-10s %10s %14s %10s %14s\n", "size_kb", "maps",
+               "map_pages/s", "unmaps", "unmap_pages/s");
+    
+    for (i = 0; i < FDCA_GTT_PERF_BUCKETS; i++) {
+        seq_printf(m, "%-10lu", (PAGE_SIZE >> 10) << i);
+        fdca_debugfs_gtt_perf_row(m, &gtt->map_perf[i]);
+        fdca_debugfs_gtt_perf_row(m, &gtt->unmap_perf[i]);
+        seq_putc(m, '\n');
+    }
+    
+    return 0;
+}
+
+static int fdca_debugfs_gtt_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_gtt_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_gtt_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_gtt_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* 按大小分档输出 pwrite/pread 吞吐，单位 GB/s */
+static void fdca_debugfs_staging_perf_show(struct seq_file *m, const char *name,
+                                           struct fdca_staging_perf *perf)
+{
+    u64 calls, bytes, ns, gbps;
+    u32 i, rem;
+    
+    seq_printf(m, "\n%s:\n", name);
+    seq_printf(m, "  %-10s %10s %16s %10s\n", "size", "calls", "bytes", "GB/s");
+    
+    for (i = 0; i < FDCA_STAGING_PERF_BUCKETS; i++) {
+        calls = atomic64_read(&perf[i].calls);
+        if (!calls)
+            continue;
+        
+        bytes = atomic64_read(&perf[i].bytes);
+        ns = atomic64_read(&perf[i].ns);
+        gbps = ns ? mul_u64_u64_div_u64(bytes, 100 * NSEC_PER_SEC, ns) >> 30 : 0;
+        gbps = div_u64_rem(gbps, 100, &rem);
+        
+        seq_printf(m, "  %-8lluKB %10llu %16llu %7llu.%02u\n",
+                   (u64)SZ_4K << i >> 10, calls, bytes, gbps, rem);
+    }
+}
+
+/* 拷贝引擎统计 - 执行期间的吞吐 */
+static int fdca_debugfs_copy_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    struct fdca_copy_engine *engine = &fdev->copy;
+    u64 bytes = atomic64_read(&engine->bytes);
+    u64 busy_ns = atomic64_read(&engine->busy_ns);
+    
+    seq_printf(m, "jobs:             %lld\n", atomic64_read(&engine->jobs));
+    seq_printf(m, "descs:            %lld\n", atomic64_read(&engine->descs));
+    seq_printf(m, "bytes:            %llu\n", bytes);
+    seq_printf(m, "busy_ns:          %llu\n", busy_ns);
+    seq_printf(m, "throughput_mb_s:  %llu\n",
+               busy_ns ? mul_u64_u64_div_u64(bytes, NSEC_PER_SEC, busy_ns) >> 20 : 0);
+    
+    fdca_debugfs_staging_perf_show(m, "pwrite", engine->staging.pwrite_perf);
+    fdca_debugfs_staging_perf_show(m, "pread", engine->staging.pread_perf);
+    
+    return 0;
+}
+
+static int fdca_debugfs_copy_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_copy_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_copy_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_copy_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* fence 统计 - 触发到唤醒延迟 */
+static int fdca_debugfs_fences_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    u64 waits = atomic64_read(&fdev->stats.fence_waits);
+    
+    seq_printf(m, "created:          %lld\n", atomic64_read(&fdev->stats.fences_created));
+    seq_printf(m, "signaled:         %lld\n", atomic64_read(&fdev->stats.fences_signaled));
+    seq_printf(m, "waits:            %llu\n", waits);
+    seq_printf(m, "wakeup_avg_ns:    %llu\n",
+               waits ? div64_u64(atomic64_read(&fdev->stats.fence_wakeup_ns), waits) : 0);
+    seq_printf(m, "wakeup_max_ns:    %lld\n", READ_ONCE(fdev->stats.fence_wakeup_max_ns));
+    
+    return 0;
+}
+
+static int fdca_debugfs_fences_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_fences_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_fences_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_fences_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* fence 等待直方图 - 轮询命中与睡眠唤醒的耗时分布 */
+static int fdca_debugfs_wait_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    int i;
+    
+    seq_printf(m, "%-14s %12s %12s\n", "wait_us", "spin", "sleep");
+    for (i = 0; i < FDCA_WAIT_HIST_BUCKETS; i++) {
+        char range[16];
+        
+        if (!i)
+            snprintf(range, sizeof(range), "<1");
+        else if (i == FDCA_WAIT_HIST_BUCKETS - 1)
+            snprintf(range, sizeof(range), ">=%u", 1U << (i - 1));
+        else
+            snprintf(range, sizeof(range), "%u-%u", 1U << (i - 1), (1U << i) - 1);
+        
+        seq_printf(m, "%-14s %12lld %12lld\n", range,
+                   atomic64_read(&fdev->stats.wait_spin_hist[i]),
+                   atomic64_read(&fdev->stats.wait_sleep_hist[i]));
+    }
+    seq_printf(m, "timeouts:      %lld\n", atomic64_read(&fdev->stats.wait_timeouts));
+    
+    return 0;
+}
+
+static int fdca_debugfs_wait_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_wait_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_wait_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_wait_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* 调度器统计 - 每个计算单元一个 drm_gpu_scheduler */
+static int fdca_debugfs_sched_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    struct fdca_scheduler *fsched;
+    int unit;
+    
+    seq_printf(m, "%-10s %8s %10s %12s %10s %14s\n",
+               "sched", "credits", "tslice_us", "jobs", "timeouts", "avg_queue_ns");
+    
+    for (unit = 0; unit < FDCA_UNIT_MAX; unit++) {
+        u64 jobs;
+        
+        fsched = fdev->schedulers[unit];
+        if (!fsched)
+            continue;
+        
+        jobs = atomic64_read(&fsched->schedule_count);
+        seq_printf(m, "%-10s %8u %10u %12llu %10lld %14llu\n",
+                   fsched->base.name, fsched->base.credit_limit,
+                   fsched->time_slice_us, jobs,
+                   atomic64_read(&fsched->timeout_count),
+                   jobs ? div64_u64(atomic64_read(&fsched->total_schedule_time), jobs) : 0);
+    }
+    
+    return 0;
+}
+
+static int fdca_debugfs_sched_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_sched_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_sched_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_sched_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* 内核命令队列统计 - 每批次平均命令数反映消费者的合并效果 */
+static int fdca_debugfs_cmdq_show(struct seq_file *m, void *data)
+{
+    struct fdca_device *fdev = m->private;
+    struct fdca_queue_manager *mgr;
+    int unit;
+    
+    seq_printf(m, "%-5s %-4s %12s %12s %10s %10s %12s\n",
+               "unit", "id", "submitted", "completed", "failed",
+               "batches", "cmds/batch");
+    
+    for (unit = FDCA_UNIT_CAU; unit <= FDCA_UNIT_CFU; unit++) {
+        u64 batches;
+        
+        mgr = fdev->queue_mgrs[unit];
+        if (!mgr)
+            continue;
+        
+        batches = atomic64_read(&mgr->drained_batches);
+        seq_printf(m, "%-5s %-4u %12lld %12lld %10lld %10llu %12llu\n",
+                   unit == FDCA_UNIT_CAU ? "CAU" : "CFU", mgr->queue->id,
+                   atomic64_read(&mgr->submitted_cmds),
+                   atomic64_read(&mgr->completed_cmds),
+                   atomic64_read(&mgr->failed_cmds), batches,
+                   batches ? div64_u64(atomic64_read(&mgr->completed_cmds) +
+                                       atomic64_read(&mgr->failed_cmds), batches) : 0);
+    }
+    
+    return 0;
+}
+
+static int fdca_debugfs_cmdq_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fdca_debugfs_cmdq_show, inode->i_private);
+}
+
+static const struct file_operations fdca_debugfs_cmdq_fops = {
+    .owner = THIS_MODULE,
+    .open = fdca_debugfs_cmdq_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/*
+ * 内核命令队列基准 - 写入 "<cau|cfu> <提交者数> <每个提交者的命令数>"，
+ * 由相应数量的工作项并发提交空命令，全部完成后写操作才返回。
+ * 用户态据写操作耗时计算提交速率，批次合并效果见 cmdq 文件。
+ * 空命令没有硬件语义，只在模拟队列上运行
+ */
+#define FDCA_CMDQ_BENCH_MAX_THREADS 64
+#define FDCA_CMDQ_BENCH_WINDOW      32      /* 每个提交者的在途命令数 */
+
+struct fdca_cmdq_bench {
+    struct work_struct work;
+    struct fdca_device *fdev;
+    enum fdca_unit_type unit;
+    u32 cmds;
+    int ret;
+};
+
+static void fdca_cmdq_bench_work(struct work_struct *work)
+{
+    struct fdca_cmdq_bench *bench = container_of(work, struct fdca_cmdq_bench, work);
+    struct fdca_command *window[FDCA_CMDQ_BENCH_WINDOW];
+    static const u64 payload[2];
+    u32 done = 0, n, i;
+    int ret;
+    
+    while (done < bench->cmds) {
+        n = min_t(u32, bench->cmds - done, FDCA_CMDQ_BENCH_WINDOW);
+        
+        /* 可睡眠的分配从 mempool 取描述符，不会失败 */
+        for (i = 0; i < n; i++) {
+            window[i] = fdca_command_alloc(0, payload, sizeof(payload), GFP_KERNEL);
+            ret = fdca_queue_submit_command(bench->fdev, bench->unit, window[i]);
+            if (ret) {
+                fdca_command_free(window[i]);
+                window[i] = NULL;
+                bench->ret = bench->ret ?: ret;
+            }
+        }
+        
+        for (i = 0; i < n; i++) {
+            if (!window[i])
+                continue;
+            ret = fdca_queue_wait_command(bench->fdev, bench->unit, window[i]);
+            if (ret)
+                bench->ret = bench->ret ?: ret;
+            fdca_command_free(window[i]);
+        }
+        
+        done += n;
+    }
+}
+
+static ssize_t fdca_debugfs_cmdq_bench_write(struct file *file, const char __user *ubuf,
+                                             size_t len, loff_t *ppos)
+{
+    struct fdca_device *fdev = file->private_data;
+    struct fdca_cmdq_bench *benches;
+    struct workqueue_struct *wq;
+    enum fdca_unit_type unit;
+    u32 threads, cmds, i;
+    char buf[32], name[4];
+    int ret = 0;
+    
+    if (len >= sizeof(buf))
+        return -EINVAL;
+    if (copy_from_user(buf, ubuf, len))
+        return -EFAULT;
+    buf[len] = '\0';
+    
+    if (sscanf(buf, "%3s %u %u", name, &threads, &cmds) != 3 ||
+        !threads || threads > FDCA_CMDQ_BENCH_MAX_THREADS || !cmds)
+        return -EINVAL;
+    
+    if (!strcasecmp(name, "cau"))
+        unit = FDCA_UNIT_CAU;
+    else if (!strcasecmp(name, "cfu"))
+        unit = FDCA_UNIT_CFU;
+    else
+        return -EINVAL;
+    
+    if (!fdev->queue_mgrs[unit])
+        return -ENODEV;
+    if (!fdev->queue_mgrs[unit]->queue->simulated)
+        return -EOPNOTSUPP;
+    
+    benches = kcalloc(threads, sizeof(*benches), GFP_KERNEL);
+    if (!benches)
+        return -ENOMEM;
+    
+    /* 每个提交者一个工作项，max_active 保证它们同时运行 */
+    wq = alloc_workqueue("fdca-cmdq-bench", WQ_UNBOUND, threads);
+    if (!wq) {
+        kfree(benches);
+        return -ENOMEM;
+    }
+    
+    for (i = 0; i < threads; i++) {
+        INIT_WORK(&benches[i].work, fdca_cmdq_bench_work);
+        benches[i].fdev = fdev;
+        benches[i].unit = unit;
+        benches[i].cmds = cmds;
+        queue_work(wq, &benches[i].work);
+    }
+    
+    /* 等待全部提交者结束 */
+    destroy_workqueue(wq);
+    
+    for (i = 0; i < threads && !ret; i++)
+        ret = benches[i].ret;
+    kfree(benches);
+    
+    return ret ? ret : len;
+}
+
+static const struct file_operations fdca_debugfs_cmdq_bench_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .write = fdca_debugfs_cmdq_bench_write,
+    .llseek = noop_llseek,
+};
+
+/*
+ * GTT 映射基准 - 写入 "<映射大小 KB> <次数>"，分配一组系统页后反复
+ * fdca_gtt_map_pages() 和 fdca_gtt_unmap_pages()。每次的耗时按大小分档
+ * 计入 gtt 文件的 map_pages/s 和 unmap_pages/s。页面尽量按 2MB 成块分配，
+ * 使映射有机会使用大页项
+ */
+#define FDCA_GTT_BENCH_ORDER        get_order(FDCA_LARGE_PAGE_SIZE)
+
+static void fdca_gtt_bench_free_pages(struct page **pages, u32 num_pages)
+{
+    u32 i;
+    
+    for (i = 0; i < num_pages; i++)
+        __free_page(pages[i]);
+    kvfree(pages);
+}
+
+static struct page **fdca_gtt_bench_alloc_pages(u32 num_pages)
+{
+    struct page **pages, *page;
+    u32 i = 0, j;
+    
+    pages = kvmalloc_array(num_pages, sizeof(*pages), GFP_KERNEL);
+    if (!pages)
+        return NULL;
+    
+    while (i < num_pages) {
+        /* 整块拆成单页，释放时逐页归还 */
+        if (num_pages - i >= (1U << FDCA_GTT_BENCH_ORDER)) {
+            page = alloc_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+                               FDCA_GTT_BENCH_ORDER);
+            if (page) {
+                split_page(page, FDCA_GTT_BENCH_ORDER);
+                for (j = 0; j < (1U << FDCA_GTT_BENCH_ORDER); j++)
+                    pages[i++] = page + j;
+                continue;
+            }
+        }
+    
+        page = alloc_page(GFP_KERNEL);
+        if (!page) {
+            fdca_gtt_bench_free_pages(pages, i);
+            return NULL;
+        }
+        pages[i++] = page;
+    }
+    
+    return pages;
+}
+
+static ssize_t fdca_debugfs_gtt_bench_write(struct file *file, const char __user *ubuf,
+                                            size_t len, loff_t *ppos)
+{
+    struct fdca_device *fdev = file->private_data;
+    struct fdca_gtt_entry *entry;
+    struct page **pages;
+    u32 size_kb, count, num_pages, i;
+    char buf[32];
+    int ret = 0;
+    
+    if (len >= sizeof(buf))
+        return -EINVAL;
+    if (copy_from_user(buf, ubuf, len))
+        return -EFAULT;
+    buf[len] = '\0';
+    
+    if (sscanf(buf, "%u %u", &size_kb, &count) != 2 || !count ||
+        size_kb < (PAGE_SIZE >> 10) || !is_power_of_2(size_kb))
+        return -EINVAL;
+    
+    num_pages = size_kb / (PAGE_SIZE >> 10);
+    if (num_pages > BIT(FDCA_GTT_PERF_BUCKETS - 1))
+        return -EINVAL;
+    
+    if (!fdev->mem_mgr)
+        return -ENODEV;
+    
+    pages = fdca_gtt_bench_alloc_pages(num_pages);
+    if (!pages)
+        return -ENOMEM;
+    
+    for (i = 0; i < count; i++) {
+        entry = fdca_gtt_map_pages(fdev, pages, num_pages, DMA_BIDIRECTIONAL, "gtt_bench");
+        if (IS_ERR(entry)) {
+            ret = PTR_ERR(entry);
+            break;
+        }
+        fdca_gtt_unmap_pages(fdev, entry, DMA_BIDIRECTIONAL);
+    
+        if (fatal_signal_pending(current)) {
+            ret = -EINTR;
+            break;
+        }
+        cond_resched();
+    }
+    
+    fdca_gtt_bench_free_pages(pages, num_pages);
+    
+    return ret ? ret : len;
+}
+
+static const struct file_operations fdca_debugfs_gtt_bench_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .write = fdca_debugfs_gtt_bench_write,
+    .llseek = noop_llseek,
+};
+
+/*
+ * dma-buf 搬移通知 - 写入本进程的一个 dma-buf 文件描述符，持有预留锁调用
+ * dma_buf_move_notify()，如同导出者搬移了后备。该 dma-buf 的全部动态
+ * 附着撤销映射，导入对象在下次使用时重新映射。udmabuf 等导出者从不
+ * 搬移后备，借此测试导入路径的 move_notify
+ */
+static ssize_t fdca_debugfs_prime_move_notify_write(struct file *file,
+                                                    const char __user *ubuf,
+                                                    size_t len, loff_t *ppos)
+{
+    struct dma_buf *dmabuf;
+    int fd, ret;
+    
+    ret = kstrtoint_from_user(ubuf, len, 0, &fd);
+    if (ret)
+        return ret;
+    
+    dmabuf = dma_buf_get(fd);
+    if (IS_ERR(dmabuf))
+        return PTR_ERR(dmabuf);
+    
+    ret = dma_resv_lock_interruptible(dmabuf->resv, NULL);
+    if (!ret) {
+        dma_buf_move_notify(dmabuf);
+        dma_resv_unlock(dmabuf->resv);
+    }
+    
+    dma_buf_put(dmabuf);
+    
+    return ret ? ret : len;
+}
+
+static const struct file_operations fdca_debugfs_prime_move_notify_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .write = fdca_debugfs_prime_move_notify_write,
+    .llseek = noop_llseek,
+};
+
 /**
  * fdca_debugfs_init() - 初始化 debugfs 接口
  */
@@ -154,24 +878,47 @@ int fdca_debugfs_init(struct fdca_device *fdev)
         }
     }
     
-    /* 创建设备目录 */
-    snprintf(name, sizeof(name), "card%d", fdev->drm.primary->index);
+    /* 创建设备目录 - 计算加速设备没有 primary 节点，使用 PCI 地址命名 */
+    snprintf(name, sizeof(name), "%s", dev_name(fdev->dev));
     device_dir = debugfs_create_dir(name, fdca_debugfs_root);
     if (IS_ERR(device_dir)) {
         fdca_err(fdev, "无法创建设备 debugfs 目录\n");
         return PTR_ERR(device_dir);
     }
+    fdev->debug.root = device_dir;
     
     /* 创建调试文件 */
     debugfs_create_file("device", 0444, device_dir, fdev, &fdca_debugfs_device_fops);
     debugfs_create_file("memory", 0444, device_dir, fdev, &fdca_debugfs_memory_fops);
+    debugfs_create_file("vram_free", 0444, device_dir, fdev, &fdca_debugfs_vram_free_fops);
     debugfs_create_file("registers", 0444, device_dir, fdev, &fdca_debugfs_regs_fops);
+    debugfs_create_file("queues", 0444, device_dir, fdev, &fdca_debugfs_queues_fops);
+    debugfs_create_file("vm", 0444, device_dir, fdev, &fdca_debugfs_vm_fops);
+    debugfs_create_file("gtt", 0444, device_dir, fdev, &fdca_debugfs_gtt_fops);
+    debugfs_create_file("gtt_bench", 0200, device_dir, fdev, &fdca_debugfs_gtt_bench_fops);
+    debugfs_create_file("copy", 0444, device_dir, fdev, &fdca_debugfs_copy_fops);
+    debugfs_create_file("fences", 0444, device_dir, fdev, &fdca_debugfs_fences_fops);
+    debugfs_create_file("wait", 0444, device_dir, fdev, &fdca_debugfs_wait_fops);
+    debugfs_create_file("sched", 0444, device_dir, fdev, &fdca_debugfs_sched_fops);
+    debugfs_create_file("cmdq", 0444, device_dir, fdev, &fdca_debugfs_cmdq_fops);
+    debugfs_create_file("cmdq_bench", 0200, device_dir, fdev, &fdca_debugfs_cmdq_bench_fops);
+    debugfs_create_file("prime_move_notify", 0200, device_dir, fdev,
+                        &fdca_debugfs_prime_move_notify_fops);
     
     fdca_info(fdev, "debugfs 接口初始化完成: /sys/kernel/debug/fdca/%s\n", name);
     
     return 0;
 }
 
+/**
+ * fdca_debugfs_device_fini() - 移除单个设备的 debugfs 目录
+ */
+void fdca_debugfs_device_fini(struct fdca_device *fdev)
+{
+    debugfs_remove_recursive(fdev->debug.root);
+    fdev->debug.root = NULL;
+}
+
 /**
  * fdca_debugfs_fini() - 清理 debugfs 接口
  */
@@ -182,4 +929,5 @@ void fdca_debugfs_fini(void)
 }
 
 EXPORT_SYMBOL_GPL(fdca_debugfs_init);
+EXPORT_SYMBOL_GPL(fdca_debugfs_device_fini);
 EXPORT_SYMBOL_GPL(fdca_debugfs_fini);
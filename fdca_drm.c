@@ -24,6 +24,9 @@
 #include <linux/anon_inodes.h>
 #include <linux/file.h>
 #include <linux/sync_file.h>
+#include <linux/uaccess.h>
+#include <linux/dma-fence.h>
+#include <linux/mman.h>
 
 #include <drm/drm_device.h>
 #include <drm/drm_file.h>
@@ -35,6 +38,11 @@
 #include <drm/drm_managed.h>
 
 #include "fdca_drv.h"
+#include "fdca_uapi.h"
+#include "fdca_queue.h"
+
+#define CREATE_TRACE_POINTS
+#include "fdca_trace.h"
 
 /*
  * ============================================================================
@@ -49,66 +57,17 @@ static void fdca_drm_postclose(struct drm_device *drm, struct drm_file *file);
 /* IOCTL 处理函数 */
 static int fdca_ioctl_get_param(struct drm_device *drm, void *data, struct drm_file *file);
 static int fdca_ioctl_gem_create(struct drm_device *drm, void *data, struct drm_file *file);
+static int fdca_ioctl_gem_userptr(struct drm_device *drm, void *data, struct drm_file *file);
 static int fdca_ioctl_gem_mmap(struct drm_device *drm, void *data, struct drm_file *file);
 static int fdca_ioctl_submit(struct drm_device *drm, void *data, struct drm_file *file);
 static int fdca_ioctl_wait(struct drm_device *drm, void *data, struct drm_file *file);
-
-/*
- * ============================================================================
- * IOCTL 定义
- * ============================================================================
- */
-
-/* FDCA 特定的 IOCTL 命令 */
-#define DRM_FDCA_GET_PARAM      0x00
-#define DRM_FDCA_GEM_CREATE     0x01
-#define DRM_FDCA_GEM_MMAP       0x02
-#define DRM_FDCA_SUBMIT         0x03
-#define DRM_FDCA_WAIT           0x04
-
-/* IOCTL 参数结构 */
-struct drm_fdca_get_param {
-    __u32 param;        /* 参数类型 */
-    __u32 pad;          /* 填充字节 */
-    __u64 value;        /* 参数值 */
-};
-
-struct drm_fdca_gem_create {
-    __u64 size;         /* 对象大小 */
-    __u32 flags;        /* 创建标志 */
-    __u32 handle;       /* 输出：对象句柄 */
-};
-
-struct drm_fdca_gem_mmap {
-    __u32 handle;       /* 对象句柄 */
-    __u32 flags;        /* 映射标志 */
-    __u64 offset;       /* 输出：映射偏移 */
-};
-
-struct drm_fdca_submit {
-    __u64 commands;     /* 命令缓冲区指针 */
-    __u32 commands_size;/* 命令大小 */
-    __u32 queue_id;     /* 队列 ID */
-    __u32 fence_out;    /* 输出：fence 句柄 */
-    __u32 flags;        /* 提交标志 */
-};
-
-struct drm_fdca_wait {
-    __u32 fence;        /* fence 句柄 */
-    __u32 flags;        /* 等待标志 */
-    __u64 timeout_ns;   /* 超时时间(纳秒) */
-};
-
-/* 参数类型定义 */
-#define FDCA_PARAM_DEVICE_ID            0   /* 设备 ID */
-#define FDCA_PARAM_REVISION             1   /* 硬件版本 */
-#define FDCA_PARAM_RVV_VLEN             2   /* RVV 向量长度 */
-#define FDCA_PARAM_RVV_ELEN             3   /* RVV 元素长度 */
-#define FDCA_PARAM_RVV_LANES            4   /* RVV Lane 数量 */
-#define FDCA_PARAM_CAU_QUEUES           5   /* CAU 队列数量 */
-#define FDCA_PARAM_CFU_QUEUES           6   /* CFU 队列数量 */
-#define FDCA_PARAM_VRAM_SIZE            7   /* VRAM 大小 */
-#define FDCA_PARAM_GTT_SIZE             8   /* GTT 大小 */
+static int fdca_ioctl_umq_create(struct drm_device *drm, void *data, struct drm_file *file);
+static int fdca_ioctl_umq_destroy(struct drm_device *drm, void *data, struct drm_file *file);
+static int fdca_ioctl_vm_bind(struct drm_device *drm, void *data, struct drm_file *file);
+static int fdca_ioctl_copy(struct drm_device *drm, void *data, struct drm_file *file);
+static int fdca_ioctl_gem_pwrite(struct drm_device *drm, void *data, struct drm_file *file);
+static int fdca_ioctl_gem_pread(struct drm_device *drm, void *data, struct drm_file *file);
+static int fdca_ioctl_get_memory_stats(struct drm_device *drm, void *data, struct drm_file *file);
 
 /*
  * ============================================================================
@@ -126,7 +85,7 @@ struct drm_fdca_wait {
  */
 int fdca_device_init(struct fdca_device *fdev)
 {
-    int ret;
+    int unit, ret;
     
     fdca_info(fdev, "开始初始化 FDCA 设备\n");
     
@@ -144,11 +103,30 @@ int fdca_device_init(struct fdca_device *fdev)
         goto err_memory;
     }
     
-    /* 初始化 NoC 管理器 */
+    /* 初始化地址空间更新调度器 */
+    ret = fdca_vm_bind_init(fdev);
+    if (ret)
+        goto err_scheduler;
+    
+    /* 初始化拷贝引擎 */
+    ret = fdca_copy_init(fdev);
+    if (ret)
+        goto err_vm_bind;
+    
+    /* 初始化内核命令队列管理器 - 缺少的计算单元不影响设备工作 */
+    for (unit = FDCA_UNIT_CAU; unit <= FDCA_UNIT_CFU; unit++) {
+        ret = fdca_queue_manager_init(fdev, unit);
+        if (ret && ret != -ENODEV) {
+            fdca_err(fdev, "队列管理器初始化失败: %d\n", ret);
+            goto err_queue_mgr;
+        }
+    }
+    
+    /* 初始化 NoC 管理器 - 没有 NoC 单元时 (包括模拟队列) 跳过 */
     ret = fdca_noc_manager_init(fdev);
-    if (ret) {
+    if (ret && ret != -ENODEV) {
         fdca_err(fdev, "NoC 管理器初始化失败: %d\n", ret);
-        goto err_scheduler;
+        goto err_queue_mgr;
     }
     
     /* 初始化 RVV 状态管理 */
@@ -158,20 +136,37 @@ int fdca_device_init(struct fdca_device *fdev)
         goto err_noc;
     }
     
+    /* 创建向量内存操作的 DMA 缓冲池 */
+    ret = fdca_vector_mem_init(fdev);
+    if (ret)
+        goto err_rvv;
+    
     /* 注册 DRM 设备 */
     ret = drm_dev_register(&fdev->drm, 0);
     if (ret) {
         fdca_err(fdev, "DRM 设备注册失败: %d\n", ret);
-        goto err_rvv;
+        goto err_vector_mem;
     }
     
+    /* debugfs 失败不影响设备工作 */
+    if (fdca_debugfs_init(fdev))
+        fdca_warn(fdev, "debugfs 初始化失败\n");
+    
     fdca_info(fdev, "FDCA 设备初始化完成\n");
     return 0;
     
+err_vector_mem:
+    fdca_vector_mem_fini(fdev);
 err_rvv:
     fdca_rvv_state_fini(fdev);
 err_noc:
     fdca_noc_manager_fini(fdev);
+err_queue_mgr:
+    for (unit = FDCA_UNIT_CAU; unit <= FDCA_UNIT_CFU; unit++)
+        fdca_queue_manager_fini(fdev, unit);
+    fdca_copy_fini(fdev);
+err_vm_bind:
+    fdca_vm_bind_fini(fdev);
 err_scheduler:
     fdca_scheduler_fini(fdev);
 err_memory:
@@ -187,14 +182,23 @@ err_memory:
  */
 void fdca_device_fini(struct fdca_device *fdev)
 {
+    int unit;
+    
     fdca_info(fdev, "开始清理 FDCA 设备\n");
     
+    fdca_debugfs_device_fini(fdev);
+    
     /* 注销 DRM 设备 */
     drm_dev_unregister(&fdev->drm);
     
     /* 清理子系统 - 按相反顺序 */
+    fdca_vector_mem_fini(fdev);
     fdca_rvv_state_fini(fdev);
     fdca_noc_manager_fini(fdev);
+    for (unit = FDCA_UNIT_CAU; unit <= FDCA_UNIT_CFU; unit++)
+        fdca_queue_manager_fini(fdev, unit);
+    fdca_copy_fini(fdev);
+    fdca_vm_bind_fini(fdev);
     fdca_scheduler_fini(fdev);
     fdca_memory_manager_fini(fdev);
     
@@ -233,16 +237,39 @@ static int fdca_drm_open(struct drm_device *drm, struct drm_file *file)
     
     /* 初始化上下文 */
     kref_init(&ctx->ref);
+    INIT_WORK(&ctx->release_work, fdca_context_release_work);
     ctx->fdev = fdev;
     ctx->file = file;
     ctx->pid = get_task_pid(current, PIDTYPE_PID);
+    ctx->nice = task_nice(current);
     
     /* 初始化锁和列表 */
     mutex_init(&ctx->queue_lock);
     mutex_init(&ctx->vma_lock);
-    mutex_init(&ctx->sync_lock);
     INIT_LIST_HEAD(&ctx->vma_list);
-    idr_init(&ctx->sync_idr);
+    fdca_fence_table_init(&ctx->fences, fdev);
+    xa_init_flags(&ctx->umqs, XA_FLAGS_ALLOC1);
+    
+    ctx->arena = fdca_submit_arena_create();
+    if (!ctx->arena) {
+        put_pid(ctx->pid);
+        kfree(ctx);
+        return -ENOMEM;
+    }
+    
+    /* 每个上下文独立的 GPU 地址空间 */
+    ctx->vm = fdca_vm_create(fdev);
+    if (IS_ERR(ctx->vm)) {
+        ret = PTR_ERR(ctx->vm);
+        fdca_submit_arena_put(ctx->arena);
+        put_pid(ctx->pid);
+        kfree(ctx);
+        return ret;
+    }
+    
+    ret = fdca_copy_entity_init(fdev, &ctx->copy_entity);
+    if (ret)
+        goto err_destroy_vm;
     
     /* 初始化 RVV 状态 */
     memset(&ctx->rvv_state, 0, sizeof(ctx->rvv_state));
@@ -260,7 +287,7 @@ static int fdca_drm_open(struct drm_device *drm, struct drm_file *file)
     if (ret < 0) {
         mutex_unlock(&fdev->ctx_lock);
         fdca_err(fdev, "无法分配上下文 ID: %d\n", ret);
-        goto err_free_ctx;
+        goto err_fini_copy;
     }
     ctx->ctx_id = ret;
     atomic_inc(&fdev->ctx_count);
@@ -276,31 +303,48 @@ static int fdca_drm_open(struct drm_device *drm, struct drm_file *file)
     
     return 0;
     
-err_free_ctx:
+err_fini_copy:
+    fdca_copy_entity_fini(&ctx->copy_entity);
+err_destroy_vm:
+    fdca_vm_destroy(ctx->vm);
+    fdca_submit_arena_put(ctx->arena);
     put_pid(ctx->pid);
     kfree(ctx);
     return ret;
 }
 
 /**
- * fdca_context_release() - 释放上下文
- * @ref: 上下文引用计数
+ * fdca_context_free() - 销毁上下文
+ * @ctx: 上下文
  */
-static void fdca_context_release(struct kref *ref)
+static void fdca_context_free(struct fdca_context *ctx)
 {
-    struct fdca_context *ctx = container_of(ref, struct fdca_context, ref);
     struct fdca_device *fdev = ctx->fdev;
+    int i;
     
     fdca_info(fdev, "释放上下文 %u\n", ctx->ctx_id);
     
-    /* 清理同步对象 */
-    idr_destroy(&ctx->sync_idr);
+    /* 先销毁调度实体，再释放队列 - 在途批次的 fence 会被触发 */
+    for (i = 0; i < FDCA_QUEUE_MAX; i++) {
+        if (!ctx->queues[i])
+            continue;
+        fdca_sched_entity_fini(ctx, i);
+        fdca_queue_destroy(ctx->queues[i]);
+        ctx->queues[i] = NULL;
+    }
+    
+    /* 未执行的拷贝作业以错误触发并解除对象固定 */
+    fdca_copy_entity_fini(&ctx->copy_entity);
+    
+    /* 队列已停止，解除全部 GPU 映射 */
+    fdca_vm_destroy(ctx->vm);
+    ctx->vm = NULL;
     
-    /* 清理 VMA 列表 */
-    // TODO: 实现 VMA 清理
+    /* 清理同步对象 */
+    fdca_fence_table_fini(&ctx->fences);
     
-    /* 释放队列 */
-    // TODO: 实现队列清理
+    /* 仍在调度器中的作业归还内存块后内存池才会释放 */
+    fdca_submit_arena_put(ctx->arena);
     
     /* 释放 PID */
     put_pid(ctx->pid);
@@ -309,6 +353,45 @@ static void fdca_context_release(struct kref *ref)
     kfree(ctx);
 }
 
+/**
+ * fdca_context_release() - 释放上下文
+ * @ref: 上下文引用计数
+ */
+static void fdca_context_release(struct kref *ref)
+{
+    fdca_context_free(container_of(ref, struct fdca_context, ref));
+}
+
+static void fdca_context_release_work(struct work_struct *work)
+{
+    struct fdca_context *ctx = container_of(work, struct fdca_context, release_work);
+    struct drm_device *drm = &ctx->fdev->drm;
+    
+    fdca_context_free(ctx);
+    drm_dev_put(drm);
+}
+
+static void fdca_context_release_async(struct kref *ref)
+{
+    struct fdca_context *ctx = container_of(ref, struct fdca_context, ref);
+    
+    /* 文件可能已经全部关闭，销毁完成前保持 DRM 设备 */
+    drm_dev_get(&ctx->fdev->drm);
+    queue_work(system_unbound_wq, &ctx->release_work);
+}
+
+/**
+ * fdca_context_put_async() - 在调度器回调中释放上下文引用
+ * @ctx: 上下文
+ * 
+ * 销毁上下文要销毁调度实体，不能在调度器的工作线程中进行，
+ * 最后一个引用在工作队列中释放
+ */
+void fdca_context_put_async(struct fdca_context *ctx)
+{
+    kref_put(&ctx->ref, fdca_context_release_async);
+}
+
 /**
  * fdca_drm_postclose() - DRM 设备关闭后处理
  * @drm: DRM 设备
@@ -320,12 +403,22 @@ static void fdca_drm_postclose(struct drm_device *drm, struct drm_file *file)
 {
     struct fdca_device *fdev = drm_to_fdca(drm);
     struct fdca_context *ctx = file->driver_priv;
+    int i;
     
     if (!ctx)
         return;
     
     fdca_info(fdev, "用户进程关闭设备，清理上下文 %u\n", ctx->ctx_id);
     
+    /*
+     * 作业持有上下文引用，上下文在最后一个作业释放后才销毁。这里先等待
+     * 已入队作业下发，进程被杀死时丢弃剩余作业
+     */
+    for (i = 0; i < FDCA_QUEUE_MAX; i++) {
+        if (ctx->queues[i])
+            drm_sched_entity_flush(&ctx->entities[i], MAX_WAIT_SCHED_ENTITY_Q_EMPTY);
+    }
+    
     /* 从设备上下文列表中移除 */
     mutex_lock(&fdev->ctx_lock);
     idr_remove(&fdev->ctx_idr, ctx->ctx_id);
@@ -335,6 +428,9 @@ static void fdca_drm_postclose(struct drm_device *drm, struct drm_file *file)
     /* 减少电源管理引用计数 */
     atomic_dec(&fdev->pm.usage_count);
     
+    /* 用户态提交队列的映射授权与文件绑定，必须在文件释放前撤销 */
+    fdca_umq_ctx_fini(ctx, file);
+    
     /* 释放上下文引用 */
     kref_put(&ctx->ref, fdca_context_release);
     
@@ -367,19 +463,19 @@ static int fdca_ioctl_get_param(struct drm_device *drm, void *data, struct drm_f
         args->value = fdev->device_id;
         break;
         
-    case FDCA_PARAM_REVISION:
+    case FDCA_PARAM_REVISION_ID:
         args->value = fdev->revision;
         break;
         
-    case FDCA_PARAM_RVV_VLEN:
+    case FDCA_PARAM_VLEN:
         args->value = fdev->rvv_available ? fdev->rvv_config.vlen : 0;
         break;
         
-    case FDCA_PARAM_RVV_ELEN:
+    case FDCA_PARAM_ELEN:
         args->value = fdev->rvv_available ? fdev->rvv_config.elen : 0;
         break;
         
-    case FDCA_PARAM_RVV_LANES:
+    case FDCA_PARAM_NUM_LANES:
         args->value = fdev->rvv_available ? fdev->rvv_config.num_lanes : 0;
         break;
         
@@ -441,7 +537,8 @@ static int fdca_ioctl_gem_create(struct drm_device *drm, void *data, struct drm_
              args->size, args->flags);
     
     /* 参数验证 */
-    if (!args->size || args->size > FDCA_VRAM_SIZE_MAX) {
+    if (!args->size || args->size > FDCA_GTT_SIZE_MAX ||
+        (!(args->flags & FDCA_GEM_CREATE_GTT) && args->size > FDCA_VRAM_SIZE_MAX)) {
         fdca_err(fdev, "无效的 GEM 对象大小: %llu\n", args->size);
         return -EINVAL;
     }
@@ -476,6 +573,54 @@ static int fdca_ioctl_gem_create(struct drm_device *drm, void *data, struct drm_
     return 0;
 }
 
+/**
+ * fdca_ioctl_gem_userptr() - 以用户态内存创建 GEM 对象
+ * @drm: DRM 设备
+ * @data: IOCTL 数据
+ * @file: DRM 文件
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ioctl_gem_userptr(struct drm_device *drm, void *data, struct drm_file *file)
+{
+    struct fdca_device *fdev = drm_to_fdca(drm);
+    struct drm_fdca_gem_userptr *args = data;
+    struct fdca_gem_object *obj;
+    u32 handle;
+    int ret;
+    
+    fdca_dbg(fdev, "创建用户指针对象: 地址=0x%llx, 大小=%llu, 标志=0x%x\n",
+             args->addr, args->size, args->flags);
+    
+    if (args->flags & ~(FDCA_USERPTR_READONLY | FDCA_USERPTR_NOTIFIER))
+        return -EINVAL;
+    
+    if (!args->size || args->size > FDCA_GTT_SIZE_MAX ||
+        !PAGE_ALIGNED(args->addr) || !PAGE_ALIGNED(args->size))
+        return -EINVAL;
+    
+    if (!access_ok(u64_to_user_ptr(args->addr), args->size))
+        return -EFAULT;
+    
+    obj = fdca_gem_userptr_create(fdev, args->addr, args->size, args->flags);
+    if (IS_ERR(obj)) {
+        ret = PTR_ERR(obj);
+        fdca_dbg(fdev, "用户指针对象创建失败: %d\n", ret);
+        return ret;
+    }
+    
+    ret = drm_gem_handle_create(file, &obj->base, &handle);
+    drm_gem_object_put(&obj->base);
+    if (ret) {
+        fdca_err(fdev, "GEM 句柄创建失败: %d\n", ret);
+        return ret;
+    }
+    
+    args->handle = handle;
+    
+    return 0;
+}
+
 /**
  * fdca_ioctl_gem_mmap() - 映射 GEM 对象
  * @drm: DRM 设备
@@ -488,14 +633,363 @@ static int fdca_ioctl_gem_mmap(struct drm_device *drm, void *data, struct drm_fi
 {
     struct fdca_device *fdev = drm_to_fdca(drm);
     struct drm_fdca_gem_mmap *args = data;
+    struct drm_gem_object *gem;
+    int ret;
+    
+    if (args->pad || args->addr_ptr)
+        return -EINVAL;
+    
+    gem = drm_gem_object_lookup(file, args->handle);
+    if (!gem)
+        return -ENOENT;
+    
+    /* 页表在缺页时建立，这里只分配伪偏移 */
+    ret = drm_gem_create_mmap_offset(gem);
+    if (ret) {
+        fdca_err(fdev, "分配映射偏移失败: %d\n", ret);
+        goto out_put;
+    }
+    
+    args->offset = drm_vma_node_offset_addr(&gem->vma_node);
+    args->size = gem->size;
+    
+    fdca_dbg(fdev, "映射 GEM 对象: 句柄=%u, 偏移=0x%llx, 大小=%llu\n",
+             args->handle, args->offset, args->size);
+    
+out_put:
+    drm_gem_object_put(gem);
+    return ret;
+}
+
+/**
+ * fdca_drm_get_unmapped_area() - 为 GEM 映射选择用户地址
+ * @file: 设备文件
+ * @addr: 地址提示
+ * @len: 映射长度
+ * @pgoff: 伪偏移
+ * @flags: mmap 标志
+ * 
+ * 不小于 2MB 的映射多申请 PMD_SIZE 并把起始地址对齐到 2MB，
+ * 使大页 VRAM 对象能以 PMD 映射
+ */
+static unsigned long fdca_drm_get_unmapped_area(struct file *file,
+                                                unsigned long addr,
+                                                unsigned long len,
+                                                unsigned long pgoff,
+                                                unsigned long flags)
+{
+    unsigned long ret;
+    
+    if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE) || len < PMD_SIZE ||
+        addr || (flags & MAP_FIXED) || len + PMD_SIZE < len)
+        return mm_get_unmapped_area(current->mm, file, addr, len, pgoff, flags);
+    
+    ret = mm_get_unmapped_area(current->mm, file, 0, len + PMD_SIZE, pgoff, flags);
+    if (IS_ERR_VALUE(ret))
+        return mm_get_unmapped_area(current->mm, file, addr, len, pgoff, flags);
+    
+    return ALIGN(ret, PMD_SIZE);
+}
+
+/**
+ * fdca_ioctl_get_memory_stats() - 获取内存统计
+ * @drm: DRM 设备
+ * @data: IOCTL 数据
+ * @file: DRM 文件
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ioctl_get_memory_stats(struct drm_device *drm, void *data, struct drm_file *file)
+{
+    struct fdca_device *fdev = drm_to_fdca(drm);
+    struct drm_fdca_memory_stats *args = data;
+    struct fdca_vram_stats vram_stats;
+    struct fdca_gtt_stats gtt_stats;
+    
+    BUILD_BUG_ON(ARRAY_SIZE(args->vram_free_blocks) != FDCA_VRAM_HIST_ORDERS);
+    
+    if (!fdev->mem_mgr)
+        return -ENODEV;
+    
+    fdca_vram_get_stats(fdev, &vram_stats);
+    fdca_gtt_get_stats(fdev, &gtt_stats);
+    
+    memset(args, 0, sizeof(*args));
+    args->vram_total = vram_stats.total_size;
+    args->vram_used = vram_stats.used_size;
+    args->vram_available = vram_stats.available_size;
+    args->vram_fragmentation = vram_stats.fragmentation;
+    args->vram_largest_free = vram_stats.largest_free;
+    args->vram_min_block = vram_stats.min_block_size;
+    args->vram_num_orders = vram_stats.num_orders;
+    memcpy(args->vram_free_blocks, vram_stats.free_blocks,
+           sizeof(args->vram_free_blocks));
+    
+    args->gtt_total = gtt_stats.total_size;
+    args->gtt_used = gtt_stats.used_size;
+    args->gtt_available = gtt_stats.available_size;
+    
+    return 0;
+}
+
+/**
+ * fdca_submit_queue_type() - 根据提交标志选择队列类型
+ * @flags: 提交标志
+ * @type: 输出：队列类型
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_submit_queue_type(u32 flags, enum fdca_queue_type *type)
+{
+    switch (flags & (FDCA_SUBMIT_CAU | FDCA_SUBMIT_CFU)) {
+    case FDCA_SUBMIT_CAU:
+        *type = FDCA_QUEUE_CAU_COMPUTE;
+        return 0;
+    case FDCA_SUBMIT_CFU:
+        *type = FDCA_QUEUE_CFU_VECTOR;
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
+
+/**
+ * fdca_context_get_queue() - 获取上下文的硬件队列，首次使用时创建
+ * @ctx: 上下文
+ * @type: 队列类型
+ * 
+ * 队列和对应的调度实体一起创建，一旦发布便在上下文生命周期内保持不变，
+ * 快速路径无需加锁
+ * 
+ * Return: 队列指针或 ERR_PTR
+ */
+static struct fdca_queue *fdca_context_get_queue(struct fdca_context *ctx,
+                                                 enum fdca_queue_type type)
+{
+    struct fdca_queue *queue;
+    int ret;
+    
+    queue = smp_load_acquire(&ctx->queues[type]);
+    if (likely(queue))
+        return queue;
+    
+    mutex_lock(&ctx->queue_lock);
+    queue = ctx->queues[type];
+    if (!queue) {
+        queue = fdca_queue_create(ctx->fdev, type);
+        if (IS_ERR(queue))
+            goto out_unlock;
+        
+        fdca_queue_set_vm(queue, ctx->vm);
+        
+        ret = fdca_sched_entity_init(ctx, queue);
+        if (ret) {
+            fdca_queue_destroy(queue);
+            queue = ERR_PTR(ret);
+            goto out_unlock;
+        }
+        
+        smp_store_release(&ctx->queues[type], queue);
+    }
+out_unlock:
+    mutex_unlock(&ctx->queue_lock);
+    
+    return queue;
+}
+
+/**
+ * fdca_submit_copy() - 把用户态数组拷贝到提交内存块
+ * @block: 提交内存块
+ * @uptr: 用户态指针
+ * @count: 元素数量 (调用者已校验上限)
+ * @size: 元素大小
+ *
+ * Return: 内核副本或 ERR_PTR
+ */
+static void *fdca_submit_copy(struct fdca_arena_block *block, u64 uptr,
+                              u32 count, size_t size)
+{
+    void *ptr;
+    
+    if (!uptr)
+        return ERR_PTR(-EINVAL);
+    
+    ptr = fdca_arena_alloc(block, count * size);
+    if (!ptr)
+        return ERR_PTR(-ENOMEM);
+    
+    if (copy_from_user(ptr, u64_to_user_ptr(uptr), count * size))
+        return ERR_PTR(-EFAULT);
+    
+    return ptr;
+}
+
+/**
+ * fdca_submit_add_fence() - 把上下文内的 fence 加入作业依赖
+ */
+static int fdca_submit_add_fence(struct fdca_context *ctx, struct fdca_job *job, u32 id)
+{
+    struct dma_fence *fence;
+    
+    fence = fdca_fence_lookup(&ctx->fences, id);
+    if (IS_ERR(fence))
+        return PTR_ERR(fence);
+    
+    /* NULL 表示已触发并回收 */
+    if (!fence)
+        return 0;
+    
+    return drm_sched_job_add_dependency(&job->base, fence);
+}
+
+/**
+ * fdca_submit_add_deps() - 把提交的输入 fence、命令依赖和 syncobj 加入作业依赖
+ * @num_deps: 输出：命令依赖总数
+ * 
+ * 批次内命令按顺序执行，命令依赖对整个作业生效
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_submit_add_deps(struct drm_file *file, struct fdca_context *ctx,
+                                struct fdca_job *job, struct drm_fdca_submit *args,
+                                const struct drm_fdca_command *cmds, u32 *num_deps)
+{
+    struct drm_fdca_syncobj *syncs;
+    u32 *deps, total = 0, i, j;
+    int ret;
     
-    fdca_dbg(fdev, "映射 GEM 对象: 句柄=%u, 标志=0x%x\n",
-             args->handle, args->flags);
+    if (args->fence_in) {
+        ret = fdca_submit_add_fence(ctx, job, args->fence_in);
+        if (ret)
+            return ret;
+    }
     
-    // TODO: 实现 GEM 对象映射
-    // 这将在实现内存管理器后完成
+    for (i = 0; i < args->num_cmds; i++) {
+        if (!cmds[i].num_deps)
+            continue;
+        
+        total += cmds[i].num_deps;
+        if (cmds[i].num_deps > FDCA_SUBMIT_MAX_DEPS || total > FDCA_SUBMIT_MAX_DEPS)
+            return -E2BIG;
+        
+        deps = fdca_submit_copy(job->block, cmds[i].deps_ptr,
+                                cmds[i].num_deps, sizeof(*deps));
+        if (IS_ERR(deps))
+            return PTR_ERR(deps);
+        
+        for (j = 0; j < cmds[i].num_deps; j++) {
+            ret = fdca_submit_add_fence(ctx, job, deps[j]);
+            if (ret)
+                return ret;
+        }
+    }
+    *num_deps = total;
     
-    return -ENOSYS;  /* 暂时未实现 */
+    if (!args->num_in_syncs)
+        return 0;
+    
+    if (args->num_in_syncs > FDCA_SYNCOBJ_MAX)
+        return -EINVAL;
+    
+    syncs = fdca_submit_copy(job->block, args->in_syncs_ptr,
+                             args->num_in_syncs, sizeof(*syncs));
+    if (IS_ERR(syncs))
+        return PTR_ERR(syncs);
+    
+    return fdca_syncobj_add_deps(file, &job->base, syncs, args->num_in_syncs);
+}
+
+/**
+ * fdca_submit_pin_bos() - 查找并固定提交引用的 GEM 对象
+ * 
+ * 被驱逐到 GTT 的对象在此迁回 VRAM。已固定的对象记录在作业中，
+ * 失败时由作业释放路径解除
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_submit_pin_bos(struct drm_file *file, struct fdca_job *job,
+                               struct drm_fdca_submit *args)
+{
+    struct drm_gem_object *gem;
+    u32 *handles;
+    u32 i;
+    int ret;
+    
+    if (!args->num_bos)
+        return 0;
+    
+    if (args->num_bos > FDCA_SUBMIT_MAX_BOS || args->pad)
+        return -EINVAL;
+    
+    handles = fdca_submit_copy(job->block, args->bos_ptr, args->num_bos,
+                               sizeof(*handles));
+    if (IS_ERR(handles))
+        return PTR_ERR(handles);
+    
+    job->bos = fdca_arena_alloc(job->block, args->num_bos * sizeof(*job->bos));
+    if (!job->bos)
+        return -ENOMEM;
+    
+    for (i = 0; i < args->num_bos; i++) {
+        gem = drm_gem_object_lookup(file, handles[i]);
+        if (!gem)
+            return -ENOENT;
+        
+        ret = fdca_gem_object_pin(gem);
+        if (ret) {
+            drm_gem_object_put(gem);
+            return ret;
+        }
+        
+        job->bos[job->num_bos++] = gem;
+    }
+    
+    return 0;
+}
+
+/**
+ * fdca_submit_out_prepare() - 拷贝并预处理输出 syncobj
+ * @nr_chains: 输出：预分配的时间线链节点数
+ * 
+ * Return: 输出数组 (位于提交内存块)，无输出时返回 NULL，失败返回 ERR_PTR
+ */
+static struct fdca_syncobj_out *fdca_submit_out_prepare(struct drm_file *file,
+                                                        struct fdca_arena_block *block,
+                                                        struct drm_fdca_submit *args,
+                                                        u32 *nr_chains)
+{
+    struct drm_fdca_syncobj *syncs;
+    struct fdca_syncobj_out *out;
+    u32 i;
+    int ret;
+    
+    *nr_chains = 0;
+    if (!args->num_out_syncs)
+        return NULL;
+    
+    if (args->num_out_syncs > FDCA_SYNCOBJ_MAX)
+        return ERR_PTR(-EINVAL);
+    
+    syncs = fdca_submit_copy(block, args->out_syncs_ptr,
+                             args->num_out_syncs, sizeof(*syncs));
+    if (IS_ERR(syncs))
+        return ERR_CAST(syncs);
+    
+    out = fdca_arena_alloc(block, args->num_out_syncs * sizeof(*out));
+    if (!out)
+        return ERR_PTR(-ENOMEM);
+    
+    ret = fdca_syncobj_out_prepare(file, syncs, args->num_out_syncs, out);
+    if (ret) {
+        fdca_syncobj_out_free(out, args->num_out_syncs);
+        return ERR_PTR(ret);
+    }
+    
+    for (i = 0; i < args->num_out_syncs; i++)
+        if (out[i].chain)
+            (*nr_chains)++;
+    
+    return out;
 }
 
 /**
@@ -504,6 +998,11 @@ static int fdca_ioctl_gem_mmap(struct drm_device *drm, void *data, struct drm_fi
  * @data: IOCTL 数据
  * @file: DRM 文件
  * 
+ * 命令负载被拷贝到提交内存块，输入依赖交给调度器解析，依赖满足后
+ * 整批命令写入上下文队列的环形缓冲区，只写一次门铃。作业、命令描述符
+ * 和依赖数组都在上下文的提交内存块中切分，内存块在上下文内复用；
+ * 作业 fence 和调度器的 s_fence 仍然每次分配
+ * 
  * Return: 0 表示成功，负数表示错误
  */
 static int fdca_ioctl_submit(struct drm_device *drm, void *data, struct drm_file *file)
@@ -511,24 +1010,120 @@ static int fdca_ioctl_submit(struct drm_device *drm, void *data, struct drm_file
     struct fdca_device *fdev = drm_to_fdca(drm);
     struct fdca_context *ctx = file->driver_priv;
     struct drm_fdca_submit *args = data;
+    struct drm_fdca_command *cmds;
+    struct fdca_syncobj_out *out_syncs;
+    struct fdca_arena_block *block;
+    enum fdca_queue_type type;
+    struct fdca_queue *queue;
+    struct fdca_job *job;
+    struct dma_fence *fence;
+    u32 fence_id, num_deps = 0, nr_chains, i;
+    int ret;
     
-    fdca_dbg(fdev, "提交命令: 大小=%u, 队列=%u\n",
-             args->commands_size, args->queue_id);
+    fdca_dbg(fdev, "提交命令: 数量=%u, 标志=0x%x\n",
+             args->num_cmds, args->flags);
     
     /* 参数验证 */
-    if (!args->commands || !args->commands_size) {
+    if (!args->cmds_ptr || !args->num_cmds ||
+        args->num_cmds > FDCA_SUBMIT_MAX_CMDS) {
         fdca_err(fdev, "无效的命令参数\n");
         return -EINVAL;
     }
     
+    if (args->ctx_id && args->ctx_id != ctx->ctx_id)
+        return -EINVAL;
+    
+    /* 未定义的标志和保留字段必须为 0，fence ID 为 32 位 */
+    if (args->flags & ~FDCA_SUBMIT_FLAGS || args->pad || args->fence_in > U32_MAX)
+        return -EINVAL;
+    
+    ret = fdca_submit_queue_type(args->flags, &type);
+    if (ret)
+        return ret;
+    
+    queue = fdca_context_get_queue(ctx, type);
+    if (IS_ERR(queue))
+        return PTR_ERR(queue);
+    
+    block = fdca_arena_block_get(ctx->arena);
+    if (!block)
+        return -ENOMEM;
+    
+    job = fdca_job_create(ctx, type, block);
+    if (IS_ERR(job)) {
+        ret = PTR_ERR(job);
+        goto out_put_block;
+    }
+    
+    /* 拷贝命令描述符，负载在入队时拷贝 */
+    cmds = fdca_submit_copy(block, args->cmds_ptr, args->num_cmds, sizeof(*cmds));
+    if (IS_ERR(cmds)) {
+        ret = PTR_ERR(cmds);
+        goto out_free_job;
+    }
+    
+    for (i = 0; i < args->num_cmds; i++) {
+        if (cmds[i].pad) {
+            ret = -EINVAL;
+            goto out_free_job;
+        }
+    }
+    
+    ret = fdca_submit_pin_bos(file, job, args);
+    if (ret)
+        goto out_free_job;
+    
+    /* 输出 syncobj 先行查找并预分配，入队之后不再失败 */
+    out_syncs = fdca_submit_out_prepare(file, block, args, &nr_chains);
+    if (IS_ERR(out_syncs)) {
+        ret = PTR_ERR(out_syncs);
+        goto out_free_job;
+    }
+    
+    ret = fdca_submit_add_deps(file, ctx, job, args, cmds, &num_deps);
+    if (ret)
+        goto out_free_syncs_job;
+    
+    /* 作业在此被消耗，内存块由本函数持有的引用保持有效 */
+    ret = fdca_job_push(job, cmds, args->num_cmds, &fence, &fence_id);
+    if (ret)
+        goto out_free_syncs;
+    
+    args->fence_out = fence_id;
+    fdca_syncobj_out_signal(out_syncs, args->num_out_syncs, fence);
+    
     /* 更新上下文活动时间 */
     ctx->last_activity = ktime_get_boottime_seconds();
     atomic64_inc(&ctx->submit_count);
+    fdca_stats_add(fdev, total_commands, args->num_cmds);
+    
+    /* 另加作业 fence 和 drm_sched_job_init() 分配的 s_fence */
+    trace_fdca_submit_alloc(ctx->ctx_id, args->num_cmds, num_deps,
+                            block->allocs + nr_chains + 2, block->used);
+    
+    /*
+     * 同步提交: 等待批次完成。作业已经入队，重启 ioctl 会再提交一次，
+     * 被信号打断时返回 -EINTR，用户态经 fence_out 继续等待
+     */
+    if (args->flags & FDCA_SUBMIT_SYNC) {
+        ret = fdca_fence_wait_timeout(fdev, fence, MAX_SCHEDULE_TIMEOUT);
+        if (ret == -ERESTARTSYS)
+            ret = -EINTR;
+    }
     
-    // TODO: 实现命令提交
-    // 这将在实现队列管理器后完成
+    dma_fence_put(fence);
+out_free_syncs:
+    fdca_syncobj_out_free(out_syncs, args->num_out_syncs);
+out_put_block:
+    fdca_arena_block_put(block);
+    return ret;
     
-    return -ENOSYS;  /* 暂时未实现 */
+out_free_syncs_job:
+    fdca_syncobj_out_free(out_syncs, args->num_out_syncs);
+out_free_job:
+    fdca_job_free(job);
+    fdca_arena_block_put(block);
+    return ret;
 }
 
 /**
@@ -537,20 +1132,171 @@ static int fdca_ioctl_submit(struct drm_device *drm, void *data, struct drm_file
  * @data: IOCTL 数据
  * @file: DRM 文件
  * 
- * Return: 0 表示成功，负数表示错误
+ * 相对超时在入口处换算为绝对截止时间；被信号打断时写回绝对截止时间，
+ * 系统调用重启后不会重新计时
+ * 
+ * Return: 0 表示成功，-ETIME 表示超时，负数表示错误
  */
 static int fdca_ioctl_wait(struct drm_device *drm, void *data, struct drm_file *file)
 {
     struct fdca_device *fdev = drm_to_fdca(drm);
+    struct fdca_context *ctx = file->driver_priv;
     struct drm_fdca_wait *args = data;
+    ktime_t now, deadline;
+    int ret;
     
-    fdca_dbg(fdev, "等待 fence: %u, 超时=%llu ns\n",
-             args->fence, args->timeout_ns);
+    fdca_dbg(fdev, "等待 fence: %u, 超时=%llu ns, 标志=0x%x\n",
+             args->fence_id, args->timeout_ns, args->flags);
     
-    // TODO: 实现 fence 等待
-    // 这将在实现同步对象管理后完成
+    if (args->flags & ~(FDCA_WAIT_ABSOLUTE | FDCA_WAIT_NO_SPIN))
+        return -EINVAL;
+    
+    if (args->ctx_id && args->ctx_id != ctx->ctx_id)
+        return -EINVAL;
+    
+    if (args->flags & FDCA_WAIT_ABSOLUTE) {
+        deadline = min_t(u64, args->timeout_ns, KTIME_MAX);
+    } else {
+        now = ktime_get();
+        deadline = args->timeout_ns >= (u64)(KTIME_MAX - now) ?
+                   KTIME_MAX : ktime_add_ns(now, args->timeout_ns);
+    }
+    
+    ret = fdca_fence_wait_deadline(ctx, args->fence_id, deadline,
+                                   args->flags, &args->result);
+    if (ret == -ERESTARTSYS && !(args->flags & FDCA_WAIT_ABSOLUTE)) {
+        args->timeout_ns = deadline;
+        args->flags |= FDCA_WAIT_ABSOLUTE;
+    }
     
-    return -ENOSYS;  /* 暂时未实现 */
+    return ret;
+}
+
+/**
+ * fdca_ioctl_umq_create() - 创建用户态提交队列
+ * @drm: DRM 设备
+ * @data: IOCTL 数据
+ * @file: DRM 文件
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ioctl_umq_create(struct drm_device *drm, void *data, struct drm_file *file)
+{
+    struct fdca_device *fdev = drm_to_fdca(drm);
+    struct fdca_context *ctx = file->driver_priv;
+    struct drm_fdca_umq_create *args = data;
+    enum fdca_queue_type type;
+    int ret;
+    
+    fdca_dbg(fdev, "创建用户态队列: 标志=0x%x\n", args->flags);
+    
+    if (args->flags & ~(FDCA_SUBMIT_CAU | FDCA_SUBMIT_CFU) || args->pad)
+        return -EINVAL;
+    
+    ret = fdca_submit_queue_type(args->flags, &type);
+    if (ret)
+        return ret;
+    
+    return fdca_umq_create(ctx, file, type, args);
+}
+
+/**
+ * fdca_ioctl_umq_destroy() - 销毁用户态提交队列
+ * @drm: DRM 设备
+ * @data: IOCTL 数据
+ * @file: DRM 文件
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ioctl_umq_destroy(struct drm_device *drm, void *data, struct drm_file *file)
+{
+    struct fdca_context *ctx = file->driver_priv;
+    struct drm_fdca_umq_destroy *args = data;
+    
+    if (args->pad)
+        return -EINVAL;
+    
+    return fdca_umq_destroy(ctx, file, args->umq_id);
+}
+
+/**
+ * fdca_ioctl_vm_bind() - 异步更新上下文地址空间
+ * @drm: DRM 设备
+ * @data: IOCTL 数据
+ * @file: DRM 文件
+ * 
+ * 页表在输入依赖满足后异步更新，完成情况通过输出 syncobj 获取
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ioctl_vm_bind(struct drm_device *drm, void *data, struct drm_file *file)
+{
+    struct fdca_device *fdev = drm_to_fdca(drm);
+    struct fdca_context *ctx = file->driver_priv;
+    struct drm_fdca_vm_bind *args = data;
+    
+    fdca_dbg(fdev, "VM_BIND: 操作数=%u, 输入=%u, 输出=%u\n",
+             args->num_ops, args->num_in_syncs, args->num_out_syncs);
+    
+    return fdca_vm_bind(file, ctx->vm, args);
+}
+
+/**
+ * fdca_ioctl_copy() - 异步拷贝
+ * @drm: DRM 设备
+ * @data: IOCTL 数据
+ * @file: DRM 文件
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ioctl_copy(struct drm_device *drm, void *data, struct drm_file *file)
+{
+    struct fdca_device *fdev = drm_to_fdca(drm);
+    struct fdca_context *ctx = file->driver_priv;
+    struct drm_fdca_copy *args = data;
+    
+    fdca_dbg(fdev, "拷贝: 区域数=%u, 输入=%u, 输出=%u\n",
+             args->num_regions, args->num_in_syncs, args->num_out_syncs);
+    
+    return fdca_copy(file, &ctx->copy_entity, args);
+}
+
+/**
+ * fdca_ioctl_gem_pwrite() - 把用户数据写入对象
+ * @drm: DRM 设备
+ * @data: IOCTL 数据
+ * @file: DRM 文件
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ioctl_gem_pwrite(struct drm_device *drm, void *data, struct drm_file *file)
+{
+    struct fdca_device *fdev = drm_to_fdca(drm);
+    struct drm_fdca_gem_pwrite *args = data;
+    
+    fdca_dbg(fdev, "pwrite: handle=%u, 偏移=0x%llx, 大小=%llu\n",
+             args->handle, args->offset, args->size);
+    
+    return fdca_gem_pwrite(file, args);
+}
+
+/**
+ * fdca_ioctl_gem_pread() - 把对象内容读到用户内存
+ * @drm: DRM 设备
+ * @data: IOCTL 数据
+ * @file: DRM 文件
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ioctl_gem_pread(struct drm_device *drm, void *data, struct drm_file *file)
+{
+    struct fdca_device *fdev = drm_to_fdca(drm);
+    struct drm_fdca_gem_pread *args = data;
+    
+    fdca_dbg(fdev, "pread: handle=%u, 偏移=0x%llx, 大小=%llu\n",
+             args->handle, args->offset, args->size);
+    
+    return fdca_gem_pread(file, args);
 }
 
 /*
@@ -563,9 +1309,17 @@ static int fdca_ioctl_wait(struct drm_device *drm, void *data, struct drm_file *
 static const struct drm_ioctl_desc fdca_ioctls[] = {
     DRM_IOCTL_DEF_DRV(FDCA_GET_PARAM, fdca_ioctl_get_param, DRM_RENDER_ALLOW),
     DRM_IOCTL_DEF_DRV(FDCA_GEM_CREATE, fdca_ioctl_gem_create, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(FDCA_GEM_USERPTR, fdca_ioctl_gem_userptr, DRM_RENDER_ALLOW),
     DRM_IOCTL_DEF_DRV(FDCA_GEM_MMAP, fdca_ioctl_gem_mmap, DRM_RENDER_ALLOW),
     DRM_IOCTL_DEF_DRV(FDCA_SUBMIT, fdca_ioctl_submit, DRM_RENDER_ALLOW),
     DRM_IOCTL_DEF_DRV(FDCA_WAIT, fdca_ioctl_wait, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(FDCA_GET_MEMORY_STATS, fdca_ioctl_get_memory_stats, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(FDCA_UMQ_CREATE, fdca_ioctl_umq_create, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(FDCA_UMQ_DESTROY, fdca_ioctl_umq_destroy, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(FDCA_VM_BIND, fdca_ioctl_vm_bind, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(FDCA_COPY, fdca_ioctl_copy, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(FDCA_GEM_PWRITE, fdca_ioctl_gem_pwrite, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(FDCA_GEM_PREAD, fdca_ioctl_gem_pread, DRM_RENDER_ALLOW),
 };
 
 /* DRM 文件操作 */
@@ -578,16 +1332,21 @@ static const struct file_operations fdca_drm_fops = {
     .poll = drm_poll,
     .read = drm_read,
     .mmap = drm_gem_mmap,
+    .get_unmapped_area = fdca_drm_get_unmapped_area,
 };
 
 /* DRM 驱动结构 */
 const struct drm_driver fdca_drm_driver = {
-    .driver_features = DRIVER_GEM | DRIVER_COMPUTE_ACCEL | DRIVER_SYNCOBJ,
+    .driver_features = DRIVER_GEM | DRIVER_COMPUTE_ACCEL |
+                       DRIVER_SYNCOBJ | DRIVER_SYNCOBJ_TIMELINE,
     
     /* 文件操作 */
     .open = fdca_drm_open,
     .postclose = fdca_drm_postclose,
     
+    /* dma-buf 导入，导出使用默认的 drm_gem_prime_handle_to_fd() */
+    .gem_prime_import = fdca_gem_prime_import,
+    
     /* IOCTL */
     .ioctls = fdca_ioctls,
     .num_ioctls = ARRAY_SIZE(fdca_ioctls),
@@ -606,45 +1365,10 @@ const struct drm_driver fdca_drm_driver = {
 
 /*
  * ============================================================================
- * 临时桩函数 - 这些将在后续模块中实现
+ * 子系统包装
  * ============================================================================
  */
 
-/* 这些函数在后续模块中实现，这里提供临时桩函数以避免链接错误 */
-
-int fdca_memory_manager_init(struct fdca_device *fdev)
-{
-    fdca_info(fdev, "内存管理器初始化 (桩函数)\n");
-    return 0;
-}
-
-void fdca_memory_manager_fini(struct fdca_device *fdev)
-{
-    fdca_info(fdev, "内存管理器清理 (桩函数)\n");
-}
-
-int fdca_scheduler_init(struct fdca_device *fdev)
-{
-    fdca_info(fdev, "调度器初始化 (桩函数)\n");
-    return 0;
-}
-
-void fdca_scheduler_fini(struct fdca_device *fdev)
-{
-    fdca_info(fdev, "调度器清理 (桩函数)\n");
-}
-
-int fdca_noc_manager_init(struct fdca_device *fdev)
-{
-    fdca_info(fdev, "NoC 管理器初始化 (桩函数)\n");
-    return 0;
-}
-
-void fdca_noc_manager_fini(struct fdca_device *fdev)
-{
-    fdca_info(fdev, "NoC 管理器清理 (桩函数)\n");
-}
-
 int fdca_rvv_state_init(struct fdca_device *fdev)
 {
     fdca_info(fdev, "RVV 状态管理初始化\n");
@@ -660,4 +1384,5 @@ void fdca_rvv_state_fini(struct fdca_device *fdev)
 /* 导出符号供其他模块使用 */
 EXPORT_SYMBOL_GPL(fdca_device_init);
 EXPORT_SYMBOL_GPL(fdca_device_fini);
+EXPORT_SYMBOL_GPL(fdca_context_put_async);
 EXPORT_SYMBOL_GPL(fdca_drm_driver);
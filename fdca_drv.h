@@ -23,6 +23,8 @@
 #include <linux/spinlock.h>
 #include <linux/workqueue.h>
 #include <linux/idr.h>
+#include <linux/xarray.h>
+#include <linux/llist.h>
 #include <linux/kref.h>
 #include <linux/dma-mapping.h>
 #include <linux/firmware.h>
@@ -33,12 +35,16 @@
 #include <drm/drm_mm.h>
 #include <drm/drm_buddy.h>
 #include <drm/drm_gem.h>
+#include <drm/drm_gpuvm.h>
+#include <drm/gpu_scheduler.h>
 
 /* 前向声明 - 避免循环依赖 */
 struct fdca_device;
 struct fdca_context;
 struct fdca_queue;
 struct fdca_scheduler;
+struct fdca_queue_manager;
+struct fdca_submit_arena;
 struct fdca_memory_manager;
 struct fdca_rvv_state;
 struct fdca_sync_object;
@@ -47,7 +53,21 @@ struct fdca_vram_stats;
 struct fdca_gtt_entry;
 struct fdca_gtt_stats;
 struct fdca_gem_object;
+struct fdca_vm;
+struct fdca_vm_pt;
 struct fdca_memory_total_stats;
+struct fdca_ring_fence;
+struct dma_buf;
+struct dma_pool;
+struct dma_fence;
+struct dma_fence_chain;
+struct drm_syncobj;
+struct drm_exec;
+struct drm_fdca_syncobj;
+struct drm_fdca_vm_bind;
+struct drm_fdca_copy;
+struct drm_fdca_gem_pwrite;
+struct drm_fdca_gem_pread;
 
 /*
  * ============================================================================
@@ -66,6 +86,7 @@ struct fdca_memory_total_stats;
 #define FDCA_MAX_QUEUES         64      /* 每个单元最大队列数 */
 #define FDCA_MAX_CONTEXTS       1024    /* 最大上下文数量 */
 #define FDCA_MAX_SYNC_OBJECTS   4096    /* 最大同步对象数量 */
+#define FDCA_WAIT_HIST_BUCKETS  16      /* 等待耗时直方图桶数(按 2 的幂微秒) */
 
 /* RISC-V 向量扩展常量 */
 #define FDCA_RVV_MAX_VLEN       65536   /* 最大向量长度(bits) - RVV标准 */
@@ -78,6 +99,39 @@ struct fdca_memory_total_stats;
 #define FDCA_GTT_SIZE_MAX       (256ULL << 30)   /* 最大256GB虚拟地址空间 */
 #define FDCA_PAGE_SIZE          4096              /* 基础页大小 */
 #define FDCA_LARGE_PAGE_SIZE    (2 << 20)        /* 大页大小(2MB) */
+#define FDCA_GTT_START_ADDR     0x100000000ULL   /* 全局 GTT 窗口起始地址 (4GB) */
+
+/* GTT 页表项定义，全局 GTT 和上下文页表共用 */
+#define FDCA_GTT_PTE_VALID      BIT_ULL(0)      /* 页表项有效 */
+#define FDCA_GTT_PTE_READABLE   BIT_ULL(1)      /* 可读 */
+#define FDCA_GTT_PTE_WRITABLE   BIT_ULL(2)      /* 可写 */
+#define FDCA_GTT_PTE_CACHEABLE  BIT_ULL(3)      /* 可缓存 */
+#define FDCA_GTT_PTE_LARGE      BIT_ULL(4)      /* 大页: L0/L1 级的叶子项；全局 GTT 中 2MB 对齐项覆盖其后 2MB */
+#define FDCA_GTT_PTE_VRAM       BIT_ULL(5)      /* 地址为 VRAM 偏移而非系统 DMA 地址 */
+#define FDCA_GTT_PTE_ADDR_MASK  GENMASK_ULL(51, 12) /* 地址掩码 */
+
+/* 页表级别 */
+#define FDCA_GTT_LEVEL_0        0               /* L0: 1GB 页 */
+#define FDCA_GTT_LEVEL_1        1               /* L1: 2MB 页 */
+#define FDCA_GTT_LEVEL_2        2               /* L2: 4KB 页 */
+#define FDCA_GTT_MAX_LEVELS     3
+
+/* VRAM 块大小定义 */
+#define FDCA_VRAM_MIN_BLOCK_SIZE    PAGE_SIZE           /* 最小块: 4KB */
+#define FDCA_VRAM_LARGE_BLOCK_SIZE  (2 << 20)           /* 大页块: 2MB */
+#define FDCA_VRAM_HUGE_BLOCK_SIZE   (1 << 30)           /* 巨页块: 1GB */
+
+/* VRAM 空闲块直方图阶数 */
+#define FDCA_VRAM_HIST_ORDERS       32
+
+/* GEM 对象缓存分桶数，按对象页数的阶分桶，最后一桶收纳更大的对象 */
+#define FDCA_GEM_CACHE_BUCKETS      16
+
+/* VRAM 分配标志 */
+#define FDCA_VRAM_ALLOC_CONTIGUOUS  BIT(0)              /* 连续分配 */
+#define FDCA_VRAM_ALLOC_LARGE_PAGE  BIT(1)              /* 大页分配 */
+#define FDCA_VRAM_ALLOC_PINNED      BIT(2)              /* 固定内存 */
+#define FDCA_VRAM_ALLOC_CACHED      BIT(3)              /* 缓存内存 */
 
 /*
  * ============================================================================
@@ -190,6 +244,12 @@ struct fdca_vram_stats {
     u64 alloc_count;        /* 分配次数 */
     u64 free_count;         /* 释放次数 */
     u64 large_page_count;   /* 大页分配次数 */
+    
+    /* 空闲块分布 */
+    u64 largest_free;       /* 最大空闲块 */
+    u64 min_block_size;     /* 0 阶块大小 */
+    u32 num_orders;         /* free_blocks 有效项数 */
+    u32 free_blocks[FDCA_VRAM_HIST_ORDERS]; /* 每阶空闲块数 */
 };
 
 /**
@@ -212,6 +272,7 @@ struct fdca_memory_total_stats {
     u64 vram_used;          /* VRAM 已使用 */
     u64 vram_available;     /* VRAM 可用 */
     u32 vram_fragmentation; /* VRAM 碎片率 */
+    u64 vram_largest_free;  /* VRAM 最大空闲块 */
     u64 gtt_total;          /* GTT 总大小 */
     u64 gtt_used;           /* GTT 已使用 */
     u64 gtt_available;      /* GTT 可用 */
@@ -219,6 +280,38 @@ struct fdca_memory_total_stats {
     u64 peak_usage;         /* 峰值使用量 */
 };
 
+/**
+ * struct fdca_vram_owner_ops - VRAM 对象所有者回调
+ * 
+ * 碎片整理搬移对象时通过这些回调与所有者同步，未注册回调的对象不会被搬移
+ */
+struct fdca_vram_owner_ops {
+    /* 在自旋锁下调用，不能睡眠；所有者正在释放时返回 false */
+    bool (*get)(void *priv);
+    void (*put)(void *priv);
+    /* 锁定所有者并撤销其对 @obj 的全部映射，返回非 0 表示当前不可搬移 */
+    int (*begin_move)(void *priv, struct fdca_vram_object *obj);
+    /* 搬移结束，所有者按新偏移重建映射 */
+    void (*end_move)(void *priv, struct fdca_vram_object *obj);
+};
+
+/* VRAM 每 CPU 小块缓存: 4K/64K/2M 三个规格 */
+#define FDCA_VRAM_NR_CLASSES        3
+#define FDCA_VRAM_MAG_MAX           32      /* 单个缓存的块数上限 */
+
+/**
+ * struct fdca_vram_mag - 单个规格的每 CPU 块缓存
+ */
+struct fdca_vram_mag {
+    spinlock_t lock;            /* 清空缓存时可能被其它 CPU 获取 */
+    u32 count;
+    struct drm_buddy_block *blocks[FDCA_VRAM_MAG_MAX];
+};
+
+struct fdca_vram_pcp {
+    struct fdca_vram_mag mags[FDCA_VRAM_NR_CLASSES];
+};
+
 /**
  * struct fdca_vram_manager - VRAM内存管理器
  * 
@@ -239,9 +332,33 @@ struct fdca_vram_manager {
     atomic64_t free_count;      /* 释放次数 */
     atomic64_t large_page_count;/* 大页分配次数 */
     
+    /* 每 CPU 小块缓存 */
+    struct fdca_vram_pcp __percpu *pcp;
+    atomic64_t mag_cached;      /* 缓存中的字节数 (已从 buddy 分出) */
+    atomic64_t mag_hits;        /* 直接从缓存分配的次数 */
+    atomic64_t mag_refills;     /* 批量补充次数 */
+    atomic64_t mag_flushes;     /* 批量归还次数 */
+    
     /* 碎片管理 */
+    spinlock_t objects_lock;    /* 保护 objects 及对象的块、偏移和所有者 */
+    struct list_head objects;   /* 已分配对象 */
     struct work_struct defrag_work; /* 碎片整理工作 */
     bool defrag_in_progress;    /* 碎片整理进行中 */
+    u64 defrag_cursor;          /* 本轮整理只处理此偏移以下的对象 */
+    atomic64_t defrag_moves;    /* 搬移的对象数 */
+    atomic64_t defrag_bytes;    /* 搬移的字节数 */
+};
+
+/* GTT 吞吐统计分档数，第 i 档为 4KB << i 起的映射，最后一档为 1GB 及以上 */
+#define FDCA_GTT_PERF_BUCKETS   19
+
+/**
+ * struct fdca_gtt_perf - 一档映射大小的累计耗时
+ */
+struct fdca_gtt_perf {
+    atomic64_t calls;           /* 次数 */
+    atomic64_t pages;           /* 页数 */
+    atomic64_t ns;              /* 耗时 */
 };
 
 /**
@@ -266,6 +383,43 @@ struct fdca_gtt_manager {
     /* 映射统计 */
     atomic64_t map_count;       /* 映射次数 */
     atomic64_t unmap_count;     /* 解映射次数 */
+    atomic64_t large_ptes;      /* 当前有效的 2MB 页表项 */
+    atomic64_t small_ptes;      /* 当前有效的 4KB 页表项 */
+    
+    /* 按映射大小分档的吞吐统计 */
+    struct fdca_gtt_perf map_perf[FDCA_GTT_PERF_BUCKETS];
+    struct fdca_gtt_perf unmap_perf[FDCA_GTT_PERF_BUCKETS];
+};
+
+/**
+ * struct fdca_vm - 上下文 GPU 虚拟地址空间
+ * 
+ * 地址区间由 drm_gpuvm 管理，页表为 FDCA_GTT_LEVEL_0/1/2 三级，
+ * 叶子项分别映射 1GB/2MB/4KB，页表随映射按需分配、随解映射回收。
+ * 锁顺序: GEM 对象锁 -> 预留锁 -> lock -> GEM VA 锁 -> pt_lock。
+ * lock、VA 锁和 pt_lock 持有期间不分配内存，VM_BIND 作业执行时只获取这三把
+ */
+struct fdca_vm {
+    struct drm_gpuvm base;          /* 地址区间管理 */
+    struct fdca_device *fdev;       /* 关联设备 */
+    struct mutex lock;              /* 串行化映射和解映射 */
+    struct mutex pt_lock;           /* 保护页表，对象迁移时也会获取 */
+    struct fdca_vm_pt *root;        /* L0 页表 */
+    struct list_head pt_free;       /* 等待 TLB 失效后释放的页表 */
+    u32 asid;                       /* 硬件地址空间 ID */
+    
+    /* 异步绑定 */
+    struct drm_sched_entity bind_entity; /* VM_BIND 作业按提交顺序执行 */
+    struct mutex bind_lock;         /* 串行化 VM_BIND 作业入队 */
+    spinlock_t bind_pending_lock;   /* 保护 bind_pending */
+    struct list_head bind_pending;  /* 已入队、尚未修改区间树的 VM_BIND 作业 */
+    
+    /* 统计信息 */
+    atomic64_t pt_bytes;            /* 页表占用的内存 */
+    atomic64_t mapped_bytes;        /* 已映射的字节数 */
+    atomic64_t bind_jobs;           /* VM_BIND 作业数 */
+    atomic64_t bind_ops;            /* VM_BIND 操作数 */
+    atomic64_t bind_waits;          /* 需等待在途作业的 VM_BIND 数 */
 };
 
 /**
@@ -284,10 +438,37 @@ struct fdca_memory_manager {
     struct gen_pool *small_pool;    /* 小块内存池 */
     struct gen_pool *large_pool;    /* 大块内存池 */
     
-    /* 缓存管理 */
-    struct list_head cached_objects;   /* 缓存对象列表 */
-    struct work_struct cache_cleanup;   /* 缓存清理工作 */
+    /* GEM 对象缓存 */
+    struct list_head cached_objects;   /* 已释放对象留下的待复用 VRAM 后备，按释放先后排列 */
+    struct list_head cache_buckets[FDCA_GEM_CACHE_BUCKETS]; /* 按大小分桶 */
+    spinlock_t cache_lock;              /* 保护缓存链表和 cache_bytes */
+    u64 cache_bytes;                    /* 缓存后备占用的 VRAM 字节数 */
+    u32 cache_count;                    /* 缓存后备数 */
+    struct delayed_work cache_cleanup;  /* 缓存过期清理工作 */
+    atomic64_t cache_hits;              /* 创建时命中缓存的次数 */
+    atomic64_t cache_misses;            /* 创建时未命中缓存的次数 */
+    atomic64_t cache_expired;           /* 过期或超出上限被释放的对象数 */
+    
+    /* VRAM 驱逐 */
+    struct list_head vram_lru;      /* 驻留 VRAM 的 GEM 对象，表头最冷 */
+    spinlock_t lru_lock;            /* 保护 vram_lru */
+    atomic64_t evictions;           /* 驱逐到 GTT 的对象数 */
+    atomic64_t evicted_bytes;       /* 驱逐迁移的字节数 */
+    atomic64_t restores;            /* 迁回 VRAM 的对象数 */
+    atomic64_t restored_bytes;      /* 迁回 VRAM 的字节数 */
     
+    /* 用户指针对象 */
+    atomic64_t userptr_pins;        /* 固定用户页面的次数 */
+    atomic64_t userptr_pin_pages;   /* 固定的页数 */
+    atomic64_t userptr_pin_ns;      /* 固定累计耗时 */
+    atomic64_t userptr_invalidations; /* 通知模式对象被撤销的次数 */
+    
+    /* dma-buf */
+    atomic64_t prime_exports;       /* 导出时迁出 VRAM 的次数 */
+    atomic64_t prime_imports;       /* 导入的外部 dma-buf 数 */
+    atomic64_t prime_move_notifies; /* 导入对象被导出者撤销映射的次数 */
+    
+
     /* 统计信息 */
     atomic64_t total_allocated;    /* 总分配量 */
     atomic64_t peak_usage;         /* 峰值使用量 */
@@ -311,6 +492,10 @@ struct fdca_queue_ops {
     int (*wait_idle)(struct fdca_queue *queue, unsigned long timeout);
     void (*reset)(struct fdca_queue *queue);
     u64 (*get_timestamp)(struct fdca_queue *queue);
+    
+    /* 环形缓冲区硬件接口 */
+    void (*ring_doorbell)(struct fdca_queue *queue, u32 wptr);
+    u32 (*get_rptr)(struct fdca_queue *queue);
 };
 
 /**
@@ -337,11 +522,32 @@ struct fdca_queue {
     void *cmd_buffer;               /* 命令缓冲区虚拟地址 */
     dma_addr_t cmd_buffer_dma;      /* 命令缓冲区DMA地址 */
     size_t cmd_buffer_size;         /* 缓冲区大小 */
-    u32 head;                       /* 队列头指针 */
-    u32 tail;                       /* 队列尾指针 */
+    u32 head;                       /* 队列头指针(硬件已消费位置) */
+    u32 tail;                       /* 队列尾指针(已发布给硬件的位置) */
+    u32 reserve;                    /* 预留指针(生产者 cmpxchg 无锁推进) */
+    
+    /* 完成序号 - 硬件在批次完成后把序号写入一致性内存页 */
+    u32 *fence_cpu;                 /* fence 页虚拟地址 */
+    dma_addr_t fence_dma;           /* fence 页 DMA 地址 */
+    u32 seqno;                      /* 最后发布的批次序号 */
+    u32 retired_seqno;              /* 最后回收的批次序号 */
+    bool user_mode;                 /* 用户态提交队列: 环由用户态写入，内核不发布批次 */
+    
+    /* 在途批次 - 按提交顺序记录每个批次的结束位置和 fence */
+    struct fdca_ring_fence *inflight;   /* 在途批次数组 */
+    u32 inflight_size;              /* 数组容量(2 的幂) */
+    u32 inflight_head;              /* 最早未完成批次 */
+    u32 inflight_tail;              /* 下一个写入位置 */
+    
+    /* 软件模拟后端 */
+    bool simulated;                 /* 是否使用模拟 MMIO */
+    u32 sim_wptr;                   /* 模拟门铃写指针 */
+    u32 sim_rptr;                   /* 模拟硬件读指针 */
+    struct work_struct sim_work;    /* 模拟设备消费工作 */
     
     /* 同步和状态 */
     spinlock_t lock;                /* 队列锁 */
+    struct mutex submit_lock;       /* 保证预留顺序与调度器入队顺序一致 */
     wait_queue_head_t wait_queue;   /* 等待队列 */
     bool active;                    /* 队列是否活跃 */
     u64 last_activity;              /* 最后活动时间 */
@@ -349,7 +555,11 @@ struct fdca_queue {
     /* 性能统计 */
     atomic64_t submit_count;        /* 提交计数 */
     atomic64_t complete_count;      /* 完成计数 */
+    atomic64_t doorbell_count;      /* 门铃写入次数 */
+    atomic64_t submit_ns;           /* 累计提交耗时(纳秒) */
+    u64 create_time_ns;             /* 创建时间(纳秒) */
     u64 total_exec_time;            /* 总执行时间 */
+    u32 time_slice_us;              /* 硬件轮转时间片 */
     
     /* RVV相关 */
     struct fdca_rvv_state *rvv_state;   /* 当前RVV状态 */
@@ -357,47 +567,27 @@ struct fdca_queue {
     u32 element_width;              /* 当前元素宽度 */
 };
 
-/**
- * struct fdca_scheduler_ops - 调度器操作接口
- */
-struct fdca_scheduler_ops {
-    int (*init)(struct fdca_scheduler *sched);
-    void (*fini)(struct fdca_scheduler *sched);
-    int (*schedule)(struct fdca_scheduler *sched, struct fdca_queue *queue);
-    void (*preempt)(struct fdca_scheduler *sched, struct fdca_queue *queue);
-    void (*priority_update)(struct fdca_scheduler *sched, struct fdca_queue *queue, int priority);
-};
-
 /**
  * struct fdca_scheduler - 调度器基础结构
  * 
- * 管理队列调度和资源分配，支持不同的调度策略
+ * 每个计算单元一个 drm_gpu_scheduler，各上下文在每种队列上拥有一个实体，
+ * 多进程共享单元时由调度器在实体间公平轮转并在执行的同时解析依赖
  */
 struct fdca_scheduler {
+    struct drm_gpu_scheduler base;  /* DRM GPU 调度器 */
+    
     /* 基础信息 */
     struct fdca_device *fdev;       /* 关联设备 */
     enum fdca_unit_type unit;       /* 调度的计算单元 */
-    const struct fdca_scheduler_ops *ops;   /* 操作接口 */
-    
-    /* 队列管理 */
-    struct list_head active_queues; /* 活跃队列列表 */
-    struct list_head pending_queues;/* 待调度队列列表 */
-    spinlock_t queue_lock;          /* 队列列表锁 */
     
     /* 调度策略 */
-    int default_priority;           /* 默认优先级 */
-    u32 time_slice_us;              /* 时间片(微秒) */
-    u32 preemption_threshold;       /* 抢占阈值 */
-    
-    /* 工作线程 */
-    struct workqueue_struct *wq;    /* 工作队列 */
-    struct work_struct schedule_work;   /* 调度工作 */
-    bool schedule_pending;          /* 调度待处理 */
+    enum drm_sched_priority default_priority; /* 默认优先级 */
+    u32 time_slice_us;              /* 普通优先级的硬件时间片(微秒) */
     
     /* 性能统计 */
-    atomic64_t schedule_count;      /* 调度次数 */
-    atomic64_t preemption_count;    /* 抢占次数 */
-    u64 total_schedule_time;        /* 总调度时间 */
+    atomic64_t schedule_count;      /* 下发到硬件的作业数 */
+    atomic64_t timeout_count;       /* 作业超时次数 */
+    atomic64_t total_schedule_time; /* 作业入队到下发的累计时间(纳秒) */
 };
 
 /*
@@ -496,6 +686,133 @@ struct fdca_sync_object {
     const char *debug_name;         /* 调试名称 */
 };
 
+/**
+ * struct fdca_fence_table - 每上下文 fence 表
+ * 
+ * 以 dma_fence 为基础，xarray 索引，RCU 查找，触发路径无表锁
+ */
+struct fdca_fence_table {
+    struct fdca_device *fdev;       /* 关联设备 */
+    struct xarray xa;               /* fence ID -> fdca_fence */
+    atomic_t next_id;               /* 单调递增的 fence ID */
+    u64 context;                    /* dma_fence 上下文基值(每队列类型一条) */
+    atomic64_t seqno[FDCA_QUEUE_MAX]; /* 各时间线序号 */
+    struct llist_head gc_list;      /* 已触发待回收的 fence */
+    struct work_struct gc_work;     /* 回收工作 */
+};
+
+/**
+ * struct fdca_syncobj_out - 提交的输出 syncobj
+ * 
+ * 时间线链节点在提交前预分配，批次入队后挂接 fence 不会失败
+ */
+struct fdca_syncobj_out {
+    struct drm_syncobj *syncobj;    /* 输出 syncobj */
+    struct dma_fence_chain *chain;  /* 时间线链节点，二值 syncobj 为 NULL */
+    u64 point;                      /* 时间线点 */
+};
+
+/*
+ * ============================================================================
+ * 拷贝引擎
+ * ============================================================================
+ */
+
+/* 单个拷贝描述符的最大字节数 */
+#define FDCA_COPY_CHUNK_SIZE    SZ_1M
+
+/**
+ * struct fdca_copy_region - 一段对象间拷贝
+ */
+struct fdca_copy_region {
+    struct drm_gem_object *src;     /* 源对象 */
+    struct drm_gem_object *dst;     /* 目的对象 */
+    u64 src_offset;                 /* 源对象内偏移 */
+    u64 dst_offset;                 /* 目的对象内偏移 */
+    u64 size;                       /* 字节数 */
+};
+
+/* pwrite/pread 暂存通道数，以及每个通道的缓冲个数和大小 */
+#define FDCA_STAGING_LANES          4
+#define FDCA_STAGING_SLOTS          2
+#define FDCA_STAGING_CHUNK_SIZE     SZ_4M
+
+/* 吞吐统计按大小分档: 4KB, 8KB, ..., 1GB 及以上 */
+#define FDCA_STAGING_PERF_BUCKETS   19
+
+/**
+ * struct fdca_staging_slot - 一个暂存缓冲
+ */
+struct fdca_staging_slot {
+    struct fdca_gem_object *obj;    /* 常驻固定的 GTT 对象 */
+    void *vaddr;                    /* 内核线性映射 */
+    struct dma_fence *fence;        /* 最近一次使用该缓冲的拷贝 */
+};
+
+/**
+ * struct fdca_staging_perf - 一档大小的 pwrite/pread 吞吐统计
+ */
+struct fdca_staging_perf {
+    atomic64_t calls;               /* 调用次数 */
+    atomic64_t bytes;               /* 字节数 */
+    atomic64_t ns;                  /* 累计耗时 */
+};
+
+/**
+ * struct fdca_staging_lane - 一组双缓冲，同一时间只供一次 pwrite/pread 使用
+ */
+struct fdca_staging_lane {
+    struct mutex lock;              /* 串行化本通道的使用 */
+    struct fdca_staging_slot slots[FDCA_STAGING_SLOTS];
+};
+
+/**
+ * struct fdca_staging - pwrite/pread 暂存区
+ */
+struct fdca_staging {
+    struct fdca_staging_lane lanes[FDCA_STAGING_LANES];
+    atomic_t next_lane;             /* 下一次优先尝试的通道 */
+    struct fdca_staging_perf pwrite_perf[FDCA_STAGING_PERF_BUCKETS];
+    struct fdca_staging_perf pread_perf[FDCA_STAGING_PERF_BUCKETS];
+};
+
+/**
+ * struct fdca_copy_engine - 异步拷贝引擎
+ */
+struct fdca_copy_engine {
+    struct drm_gpu_scheduler sched; /* 拷贝调度器 */
+    struct drm_sched_entity kernel_entity; /* 内核提交实体 */
+    struct mutex push_lock;         /* 保证 arm 与 push 的顺序一致 */
+    
+    /* 统计 */
+    atomic64_t jobs;                /* 提交的作业数 */
+    atomic64_t descs;               /* 执行的描述符数 */
+    atomic64_t bytes;               /* 成功拷贝的字节数 */
+    atomic64_t busy_ns;             /* 执行累计耗时 */
+
+    struct fdca_staging staging;    /* pwrite/pread 暂存区 */
+};
+
+/*
+ * ============================================================================
+ * 向量内存操作
+ * ============================================================================
+ */
+
+/* DMA 缓冲池尺寸档数: 256B, 4KB, 64KB */
+#define FDCA_VMEM_POOL_CLASSES  3
+
+/**
+ * struct fdca_vmem_pools - 向量内存操作的分档 DMA 缓冲池
+ * 
+ * 索引数组和数据暂存按大小从对应的池分配，释放后复用
+ */
+struct fdca_vmem_pools {
+    struct dma_pool *pools[FDCA_VMEM_POOL_CLASSES]; /* 各档缓冲池 */
+    atomic64_t allocs[FDCA_VMEM_POOL_CLASSES]; /* 各档分配次数 */
+    atomic64_t fallbacks;           /* 超过最大档的直接一致性分配次数 */
+};
+
 /*
  * ============================================================================
  * 上下文管理
@@ -508,7 +825,8 @@ struct fdca_sync_object {
  * 管理单个进程在设备上的资源和状态
  */
 struct fdca_context {
-    struct kref ref;                /* 引用计数 */
+    struct kref ref;                /* 引用计数，文件和每个调度器作业各持有一个 */
+    struct work_struct release_work; /* 作业释放最后一个引用时延后销毁 */
     struct fdca_device *fdev;       /* 关联设备 */
     
     /* 进程信息 */
@@ -518,7 +836,12 @@ struct fdca_context {
     
     /* 队列分配 */
     struct fdca_queue *queues[FDCA_QUEUE_MAX]; /* 队列数组 */
+    struct drm_sched_entity entities[FDCA_QUEUE_MAX]; /* 调度实体，与队列同时创建 */
     struct mutex queue_lock;        /* 队列分配锁 */
+    int nice;                       /* 打开设备时的进程 nice 值，决定调度优先级 */
+    struct fdca_submit_arena *arena; /* 提交内存池 */
+    struct xarray umqs;             /* 用户态提交队列 */
+    struct drm_sched_entity copy_entity; /* 拷贝作业实体 */
     
     /* RVV状态 */
     struct fdca_rvv_csr_state rvv_state; /* RVV CSR状态 */
@@ -526,12 +849,12 @@ struct fdca_context {
     u32 vector_context_id;          /* 向量上下文ID */
     
     /* 内存映射 */
+    struct fdca_vm *vm;             /* GPU 虚拟地址空间 */
     struct list_head vma_list;      /* VMA列表 */
     struct mutex vma_lock;          /* VMA锁 */
     
     /* 同步对象 */
-    struct idr sync_idr;            /* 同步对象IDR */
-    struct mutex sync_lock;         /* 同步对象锁 */
+    struct fdca_fence_table fences; /* fence 表 */
     
     /* 调试和统计 */
     atomic64_t submit_count;        /* 提交计数 */
@@ -579,6 +902,7 @@ struct fdca_device {
         int irq;                    /* 中断号 */
         u32 num_queues;             /* 队列数量 */
         u32 compute_units;          /* 计算单元数量 */
+        struct ida queue_ida;       /* 硬件队列 ID 分配 */
     } units[FDCA_UNIT_MAX];
     
     /* RVV配置 */
@@ -588,10 +912,15 @@ struct fdca_device {
     /* 子系统管理器 */
     struct fdca_memory_manager *mem_mgr;    /* 内存管理器 */
     struct fdca_scheduler *schedulers[FDCA_UNIT_MAX]; /* 调度器数组 */
+    struct drm_gpu_scheduler vm_bind_sched; /* 地址空间更新调度器 */
+    struct fdca_copy_engine copy;           /* 拷贝引擎 */
+    struct fdca_vmem_pools vmem_pools;      /* 向量内存操作 DMA 缓冲池 */
+    struct fdca_queue_manager *queue_mgrs[FDCA_UNIT_MAX]; /* 内核命令队列管理器 */
     struct fdca_noc_manager *noc_mgr;       /* NoC管理器 */
     
     /* 上下文管理 */
     struct idr ctx_idr;             /* 上下文IDR */
+    struct ida vm_ida;              /* GPU 地址空间 ID 分配 */
     struct mutex ctx_lock;          /* 上下文锁 */
     atomic_t ctx_count;             /* 活跃上下文数量 */
     
@@ -624,6 +953,18 @@ struct fdca_device {
         atomic64_t total_interrupts;/* 总中断数 */
         u64 uptime_start;           /* 启动时间 */
         u64 total_compute_time;     /* 总计算时间 */
+        atomic64_t fences_created;  /* 创建的 fence 数 */
+        atomic64_t fences_signaled; /* 触发的 fence 数 */
+        atomic64_t fence_waits;     /* 睡眠等待并被唤醒的次数 */
+        atomic64_t fence_wakeup_ns; /* 累计触发到唤醒延迟 */
+        s64 fence_wakeup_max_ns;    /* 最大触发到唤醒延迟 */
+        atomic64_t wait_spin_hist[FDCA_WAIT_HIST_BUCKETS];  /* 轮询命中耗时分布 */
+        atomic64_t wait_sleep_hist[FDCA_WAIT_HIST_BUCKETS]; /* 睡眠唤醒耗时分布 */
+        atomic64_t wait_timeouts;   /* 等待超时次数 */
+        atomic64_t gem_faults;      /* GEM CPU 映射缺页次数 (4KB 路径) */
+        atomic64_t gem_fault_pages; /* 4KB 路径实际映射的页数 (含预映射) */
+        atomic64_t gem_huge_faults; /* 以 2MB PMD 映射的缺页次数 */
+        atomic64_t gem_gtt_pages;   /* GTT 对象当前已分配的页数 */
     } stats;
     
     /* 错误恢复 */
@@ -697,6 +1038,7 @@ struct fdca_device {
 /* 核心初始化函数 */
 int fdca_device_init(struct fdca_device *fdev);
 void fdca_device_fini(struct fdca_device *fdev);
+void fdca_context_put_async(struct fdca_context *ctx);
 
 /* 子系统初始化函数 - 这些将在后续模块中实现 */
 int fdca_memory_manager_init(struct fdca_device *fdev);
@@ -709,6 +1051,13 @@ struct fdca_vram_object *fdca_vram_alloc(struct fdca_device *fdev,
                                          size_t size, u32 flags,
                                          const char *debug_name);
 void fdca_vram_free(struct fdca_device *fdev, struct fdca_vram_object *obj);
+u64 fdca_vram_object_offset(const struct fdca_vram_object *obj);
+bool fdca_vram_object_is_large(const struct fdca_vram_object *obj);
+int fdca_vram_copy_pages(struct fdca_device *fdev, struct fdca_vram_object *obj,
+                         struct page **pages, u32 num_pages, bool to_vram);
+int fdca_vram_clear(struct fdca_device *fdev, struct fdca_vram_object *obj);
+void fdca_vram_set_owner(struct fdca_device *fdev, struct fdca_vram_object *obj,
+                         const struct fdca_vram_owner_ops *ops, void *priv);
 int fdca_vram_map(struct fdca_device *fdev, struct fdca_vram_object *obj);
 void fdca_vram_unmap(struct fdca_device *fdev, struct fdca_vram_object *obj);
 void fdca_vram_get_stats(struct fdca_device *fdev, struct fdca_vram_stats *stats);
@@ -723,24 +1072,99 @@ struct fdca_gtt_entry *fdca_gtt_map_pages(struct fdca_device *fdev,
                                           const char *debug_name);
 void fdca_gtt_unmap_pages(struct fdca_device *fdev, struct fdca_gtt_entry *entry,
                          enum dma_data_direction direction);
+u64 fdca_gtt_entry_gpu_addr(const struct fdca_gtt_entry *entry);
 void fdca_gtt_get_stats(struct fdca_device *fdev, struct fdca_gtt_stats *stats);
 void fdca_gtt_print_stats(struct fdca_device *fdev);
 
 /* 统一内存管理函数 */
 struct fdca_gem_object *fdca_gem_object_create(struct fdca_device *fdev,
                                                size_t size, u32 flags);
+int fdca_gem_object_bind(struct drm_gem_object *gem, u64 *gpu_addr);
+int fdca_gem_object_pin(struct drm_gem_object *gem);
+void fdca_gem_object_unpin(struct drm_gem_object *gem);
+void fdca_gem_object_lock(struct drm_gem_object *gem);
+void fdca_gem_object_unlock(struct drm_gem_object *gem);
+void fdca_gem_object_va_lock(struct drm_gem_object *gem);
+void fdca_gem_object_va_unlock(struct drm_gem_object *gem);
+int fdca_gem_object_get_backing(struct drm_gem_object *gem, u64 *vram_offset,
+                                struct sg_table **sgt);
+int fdca_gem_object_peek_backing(struct drm_gem_object *gem, u64 *vram_offset,
+                                 struct sg_table **sgt);
+int fdca_gem_object_get_pages(struct drm_gem_object *gem, u64 *vram_offset,
+                              struct page ***pages);
+bool fdca_gem_object_revocable(struct drm_gem_object *gem);
+int fdca_gem_object_validate(struct drm_gem_object *gem);
+bool fdca_gem_object_readonly(struct drm_gem_object *gem);
+struct fdca_gem_object *fdca_gem_userptr_create(struct fdca_device *fdev,
+                                                u64 addr, u64 size, u32 flags);
+struct drm_gem_object *fdca_gem_prime_import(struct drm_device *drm,
+                                             struct dma_buf *dma_buf);
 void fdca_memory_get_total_stats(struct fdca_device *fdev,
                                 struct fdca_memory_total_stats *stats);
 void fdca_memory_print_total_stats(struct fdca_device *fdev);
 
+/* GPU 虚拟地址空间函数 */
+struct fdca_vm *fdca_vm_create(struct fdca_device *fdev);
+void fdca_vm_destroy(struct fdca_vm *vm);
+int fdca_vm_bo_update(struct drm_gem_object *gem);
+int fdca_vm_bo_lock_idle(struct drm_gem_object *gem, struct drm_exec *exec);
+void fdca_vm_bo_unlock(struct drm_exec *exec);
+void fdca_vm_bo_wait_idle(struct drm_gem_object *gem);
+void fdca_vm_bo_invalidate(struct drm_gem_object *gem);
+dma_addr_t fdca_vm_pt_base(const struct fdca_vm *vm);
+int fdca_vm_bind_init(struct fdca_device *fdev);
+void fdca_vm_bind_fini(struct fdca_device *fdev);
+int fdca_vm_bind(struct drm_file *file, struct fdca_vm *vm,
+                 struct drm_fdca_vm_bind *args);
+
+/* 拷贝引擎函数 */
+int fdca_copy_init(struct fdca_device *fdev);
+void fdca_copy_fini(struct fdca_device *fdev);
+int fdca_copy_entity_init(struct fdca_device *fdev, struct drm_sched_entity *entity);
+void fdca_copy_entity_fini(struct drm_sched_entity *entity);
+struct dma_fence *fdca_copy_submit(struct fdca_device *fdev,
+                                   const struct fdca_copy_region *regions,
+                                   u32 num_regions, struct dma_fence *dep);
+int fdca_copy(struct drm_file *file, struct drm_sched_entity *entity,
+              struct drm_fdca_copy *args);
+int fdca_gem_pwrite(struct drm_file *file, struct drm_fdca_gem_pwrite *args);
+int fdca_gem_pread(struct drm_file *file, struct drm_fdca_gem_pread *args);
+
+/* 同步对象函数 */
+void fdca_fence_table_init(struct fdca_fence_table *table, struct fdca_device *fdev);
+void fdca_fence_table_fini(struct fdca_fence_table *table);
+struct dma_fence *fdca_fence_create(struct fdca_fence_table *table,
+                                    enum fdca_queue_type type, u32 *id);
+struct dma_fence *fdca_fence_lookup(struct fdca_fence_table *table, u32 id);
+int fdca_fence_wait(struct fdca_fence_table *table, u32 id, long timeout);
+int fdca_fence_wait_timeout(struct fdca_device *fdev, struct dma_fence *fence,
+                            long timeout);
+int fdca_fence_wait_deadline(struct fdca_context *ctx, u32 id, ktime_t deadline,
+                             u32 flags, u32 *result);
+
+/* drm_syncobj 时间线函数 */
+int fdca_syncobj_add_deps(struct drm_file *file, struct drm_sched_job *job,
+                          const struct drm_fdca_syncobj *syncs, u32 count);
+struct drm_fdca_syncobj *fdca_syncobj_copy(u64 syncs_ptr, u32 count);
+int fdca_syncobj_out_prepare(struct drm_file *file,
+                             const struct drm_fdca_syncobj *syncs, u32 count,
+                             struct fdca_syncobj_out *out);
+void fdca_syncobj_out_signal(struct fdca_syncobj_out *out, u32 count,
+                             struct dma_fence *fence);
+void fdca_syncobj_out_free(struct fdca_syncobj_out *out, u32 count);
+
 int fdca_scheduler_init(struct fdca_device *fdev);
 void fdca_scheduler_fini(struct fdca_device *fdev);
+int fdca_sched_entity_init(struct fdca_context *ctx, struct fdca_queue *queue);
+void fdca_sched_entity_fini(struct fdca_context *ctx, enum fdca_queue_type type);
 
 int fdca_noc_manager_init(struct fdca_device *fdev);
 void fdca_noc_manager_fini(struct fdca_device *fdev);
 
 int fdca_rvv_state_init(struct fdca_device *fdev);
 void fdca_rvv_state_fini(struct fdca_device *fdev);
+int fdca_vector_mem_init(struct fdca_device *fdev);
+void fdca_vector_mem_fini(struct fdca_device *fdev);
 
 /* RVV 状态管理函数 */
 int fdca_rvv_state_manager_init(struct fdca_device *fdev);
@@ -757,6 +1181,9 @@ struct fdca_device *fdca_find_device_by_id(u32 device_id);
 int fdca_get_device_count(void);
 
 /* 调试函数 */
+int fdca_debugfs_init(struct fdca_device *fdev);
+void fdca_debugfs_device_fini(struct fdca_device *fdev);
+void fdca_debugfs_fini(void);
 void fdca_set_debug_level(unsigned int level);
 unsigned int fdca_get_debug_level(void);
 void fdca_dump_devices(void);
@@ -27,6 +27,7 @@
 
 #include <drm/drm_mm.h>
 #include <drm/drm_cache.h>
+#include <drm/drm_prime.h>
 
 #include "fdca_drv.h"
 
@@ -36,24 +37,20 @@
  * ============================================================================
  */
 
-/* GTT 页表项定义 */
-#define FDCA_GTT_PTE_VALID      BIT_ULL(0)      /* 页表项有效 */
-#define FDCA_GTT_PTE_READABLE   BIT_ULL(1)      /* 可读 */
-#define FDCA_GTT_PTE_WRITABLE   BIT_ULL(2)      /* 可写 */
-#define FDCA_GTT_PTE_CACHEABLE  BIT_ULL(3)      /* 可缓存 */
-#define FDCA_GTT_PTE_LARGE      BIT_ULL(4)      /* 大页 */
-#define FDCA_GTT_PTE_ADDR_MASK  GENMASK_ULL(51, 12) /* 地址掩码 */
-
-/* GTT 地址空间配置 */
-#define FDCA_GTT_START_ADDR     0x100000000ULL  /* 4GB 起始地址 */
+/* GTT 地址空间配置，页表项格式见 fdca_drv.h */
 #define FDCA_GTT_APERTURE_SIZE  (4ULL << 30)    /* 4GB 孔径大小 */
 #define FDCA_GTT_MAX_SIZE       (256ULL << 30)  /* 最大 256GB */
 
-/* 页表级别 */
-#define FDCA_GTT_LEVEL_0        0               /* L0: 1GB 页 */
-#define FDCA_GTT_LEVEL_1        1               /* L1: 2MB 页 */
-#define FDCA_GTT_LEVEL_2        2               /* L2: 4KB 页 */
-#define FDCA_GTT_MAX_LEVELS     3
+/* 全局 GTT 的 TLB 范围失效，写入页数时触发 */
+#define FDCA_GTT_REG_TLB_INV_ADDR_LO    0x114
+#define FDCA_GTT_REG_TLB_INV_ADDR_HI    0x118
+#define FDCA_GTT_REG_TLB_INV_PAGES      0x11C
+
+/*
+ * 全局 GTT 是单级页表。索引按 2MB 对齐的项带 FDCA_GTT_PTE_LARGE 时，
+ * 设备用它翻译其后整个 2MB，组内其余 511 项保持为 0
+ */
+#define FDCA_GTT_PTES_PER_LARGE (FDCA_LARGE_PAGE_SIZE / PAGE_SIZE)
 
 /*
  * ============================================================================
@@ -73,17 +70,15 @@ struct fdca_gtt_entry {
     /* 映射信息 */
     u64 gpu_addr;                       /* GPU 虚拟地址 */
     struct page **pages;                /* 页面数组 */
-    dma_addr_t *dma_addrs;              /* DMA 地址数组 */
+    struct sg_table *sgt;               /* DMA 映射后的散列表 */
     u32 num_pages;                      /* 页面数量 */
+    u32 num_large;                      /* 2MB 页表项数量 */
     
     /* 属性 */
     u32 flags;                          /* 映射标志 */
     bool coherent;                      /* 是否一致性映射 */
     bool large_pages;                   /* 是否使用大页 */
     
-    /* 页表信息 */
-    u32 *pte_indices;                   /* 页表项索引数组 */
-    
     /* 统计信息 */
     u64 map_time;                       /* 映射时间 */
     atomic_t access_count;              /* 访问计数 */
@@ -213,6 +208,10 @@ int fdca_gtt_manager_init(struct fdca_device *fdev)
     /* 初始化统计信息 */
     atomic64_set(&gtt->map_count, 0);
     atomic64_set(&gtt->unmap_count, 0);
+    atomic64_set(&gtt->large_ptes, 0);
+    atomic64_set(&gtt->small_ptes, 0);
+    memset(gtt->map_perf, 0, sizeof(gtt->map_perf));
+    memset(gtt->unmap_perf, 0, sizeof(gtt->unmap_perf));
     
     fdca_info(fdev, "GTT 管理器初始化完成: 基址=0x%llx, 大小=%llu MB\n",
               gtt->base, gtt->size >> 20);
@@ -351,67 +350,121 @@ static u32 fdca_gtt_get_pte_index(struct fdca_gtt_manager *gtt, u64 gpu_addr)
 }
 
 /**
- * fdca_gtt_set_pte() - 设置页表项
- * @fdev: FDCA 设备
- * @index: 页表项索引
- * @dma_addr: DMA 地址
- * @flags: 标志
+ * fdca_gtt_pte_flags() - 根据 DMA 方向构造页表项权限位
+ * @direction: DMA 方向
  */
-static void fdca_gtt_set_pte(struct fdca_device *fdev, u32 index,
-                             dma_addr_t dma_addr, u32 flags)
+static u64 fdca_gtt_pte_flags(enum dma_data_direction direction)
 {
-    struct fdca_gtt_manager *gtt = &fdev->mem_mgr->gtt;
-    u64 pte_value = 0;
-    
-    if (index >= gtt->num_entries) {
-        fdca_err(fdev, "页表项索引越界: %u >= %u\n", index, gtt->num_entries);
-        return;
-    }
-    
-    /* 构造页表项 */
-    pte_value = (dma_addr & FDCA_GTT_PTE_ADDR_MASK) | FDCA_GTT_PTE_VALID;
-    
-    if (flags & DMA_TO_DEVICE) {
-        pte_value |= FDCA_GTT_PTE_READABLE;
-    }
-    if (flags & DMA_FROM_DEVICE) {
-        pte_value |= FDCA_GTT_PTE_WRITABLE;
+    switch (direction) {
+    case DMA_TO_DEVICE:
+        return FDCA_GTT_PTE_VALID | FDCA_GTT_PTE_READABLE;
+    case DMA_FROM_DEVICE:
+        return FDCA_GTT_PTE_VALID | FDCA_GTT_PTE_WRITABLE;
+    default:
+        return FDCA_GTT_PTE_VALID | FDCA_GTT_PTE_READABLE | FDCA_GTT_PTE_WRITABLE;
     }
-    if (flags & DMA_BIDIRECTIONAL) {
-        pte_value |= FDCA_GTT_PTE_READABLE | FDCA_GTT_PTE_WRITABLE;
+}
+
+/**
+ * fdca_gtt_write_ptes() - 按 DMA 段批量写入连续的页表项
+ * @gtt: GTT 管理器
+ * @index: 首个页表项索引
+ * @sgt: 已 DMA 映射的散列表
+ * @num_pages: 散列表覆盖的页数
+ * @pte_flags: 权限位
+ *
+ * 每个 DMA 连续段内，GTT 索引和 DMA 地址都按 2MB 对齐且剩余不少于
+ * 2MB 的部分写成大页项，其余逐页写入。整段只做一次越界检查和一次
+ * 写屏障，调用者随后按范围失效 TLB
+ *
+ * Return: 写入的大页项数量
+ */
+static u32 fdca_gtt_write_ptes(struct fdca_gtt_manager *gtt, u32 index,
+                               struct sg_table *sgt, u32 num_pages, u64 pte_flags)
+{
+    const bool large_ok = IS_ENABLED(CONFIG_DRM_FDCA_LARGE_PAGE_SUPPORT);
+    u64 *pte = (u64 *)gtt->page_table;
+    struct scatterlist *sg;
+    dma_addr_t addr;
+    u32 i, n, num_large = 0;
+    
+    if (WARN_ON(index + num_pages > gtt->num_entries))
+        return 0;
+    
+    for_each_sgtable_dma_sg(sgt, sg, i) {
+        addr = sg_dma_address(sg);
+        n = sg_dma_len(sg) >> PAGE_SHIFT;
+        
+        while (n) {
+            if (large_ok && n >= FDCA_GTT_PTES_PER_LARGE &&
+                IS_ALIGNED(index, FDCA_GTT_PTES_PER_LARGE) &&
+                IS_ALIGNED(addr, FDCA_LARGE_PAGE_SIZE)) {
+                pte[index] = (addr & FDCA_GTT_PTE_ADDR_MASK) | pte_flags |
+                             FDCA_GTT_PTE_LARGE;
+                index += FDCA_GTT_PTES_PER_LARGE;
+                addr += FDCA_LARGE_PAGE_SIZE;
+                n -= FDCA_GTT_PTES_PER_LARGE;
+                num_large++;
+                continue;
+            }
+            
+            pte[index++] = (addr & FDCA_GTT_PTE_ADDR_MASK) | pte_flags;
+            addr += PAGE_SIZE;
+            n--;
+        }
     }
     
-    /* 写入页表项 */
-    ((u64 *)gtt->page_table)[index] = pte_value;
-    
-    /* 确保写入完成 */
+    /* 设备遍历页表前所有页表项必须可见 */
     wmb();
     
-    fdca_dbg(fdev, "设置 PTE[%u] = 0x%llx (DMA=0x%llx)\n",
-             index, pte_value, dma_addr);
+    return num_large;
 }
 
 /**
- * fdca_gtt_clear_pte() - 清除页表项
- * @fdev: FDCA 设备
- * @index: 页表项索引
+ * fdca_gtt_clear_ptes() - 批量清除连续的页表项
+ * @gtt: GTT 管理器
+ * @index: 首个页表项索引
+ * @count: 页表项数量
  */
-static void fdca_gtt_clear_pte(struct fdca_device *fdev, u32 index)
+static void fdca_gtt_clear_ptes(struct fdca_gtt_manager *gtt, u32 index, u32 count)
 {
-    struct fdca_gtt_manager *gtt = &fdev->mem_mgr->gtt;
-    
-    if (index >= gtt->num_entries) {
-        fdca_err(fdev, "页表项索引越界: %u >= %u\n", index, gtt->num_entries);
+    if (WARN_ON(index + count > gtt->num_entries))
         return;
-    }
     
-    /* 清除页表项 */
-    ((u64 *)gtt->page_table)[index] = 0;
-    
-    /* 确保写入完成 */
+    memset((u64 *)gtt->page_table + index, 0, count * sizeof(u64));
     wmb();
+}
+
+/**
+ * fdca_gtt_invalidate_range() - 失效一段 GTT 地址的 TLB
+ * @fdev: FDCA 设备
+ * @gpu_addr: 起始 GPU 地址
+ * @num_pages: 页数
+ */
+static void fdca_gtt_invalidate_range(struct fdca_device *fdev, u64 gpu_addr,
+                                      u32 num_pages)
+{
+    iowrite32(lower_32_bits(gpu_addr), fdev->mmio_base + FDCA_GTT_REG_TLB_INV_ADDR_LO);
+    iowrite32(upper_32_bits(gpu_addr), fdev->mmio_base + FDCA_GTT_REG_TLB_INV_ADDR_HI);
+    iowrite32(num_pages, fdev->mmio_base + FDCA_GTT_REG_TLB_INV_PAGES);
+    
+    /* 读回保证失效请求在返回前已到达设备 */
+    ioread32(fdev->mmio_base + FDCA_GTT_REG_TLB_INV_PAGES);
+}
+
+/**
+ * fdca_gtt_perf_add() - 按映射大小记录一次映射或解映射的耗时
+ * @perf: map_perf 或 unmap_perf
+ * @num_pages: 页数
+ * @ns: 耗时
+ */
+static void fdca_gtt_perf_add(struct fdca_gtt_perf *perf, u32 num_pages, u64 ns)
+{
+    u32 bucket = min_t(u32, ilog2(num_pages), FDCA_GTT_PERF_BUCKETS - 1);
     
-    fdca_dbg(fdev, "清除 PTE[%u]\n", index);
+    atomic64_inc(&perf[bucket].calls);
+    atomic64_add(num_pages, &perf[bucket].pages);
+    atomic64_add(ns, &perf[bucket].ns);
 }
 
 /*
@@ -437,15 +490,23 @@ struct fdca_gtt_entry *fdca_gtt_map_pages(struct fdca_device *fdev,
 {
     struct fdca_gtt_manager *gtt = &fdev->mem_mgr->gtt;
     struct fdca_gtt_entry *entry;
-    u64 size = num_pages * PAGE_SIZE;
-    u32 i, pte_index;
+    u64 size = (u64)num_pages << PAGE_SHIFT;
+    u64 start_ns = ktime_get_ns();
+    u64 alignment = PAGE_SIZE;
     int ret;
     
     fdca_dbg(fdev, "GTT 映射: %u 页, 方向=%d, 名称=%s\n",
              num_pages, direction, debug_name ?: "匿名");
     
+    if (!num_pages)
+        return ERR_PTR(-EINVAL);
+    
+    /* 至少 2MB 的映射按 2MB 对齐分配地址，才有机会使用大页项 */
+    if (IS_ENABLED(CONFIG_DRM_FDCA_LARGE_PAGE_SUPPORT) && size >= FDCA_LARGE_PAGE_SIZE)
+        alignment = FDCA_LARGE_PAGE_SIZE;
+    
     /* 分配地址空间 */
-    entry = fdca_gtt_alloc_space(fdev, size, PAGE_SIZE);
+    entry = fdca_gtt_alloc_space(fdev, size, alignment);
     if (IS_ERR(entry)) {
         return entry;
     }
@@ -455,54 +516,40 @@ struct fdca_gtt_entry *fdca_gtt_map_pages(struct fdca_device *fdev,
     entry->num_pages = num_pages;
     entry->debug_name = debug_name;
     
-    /* 分配 DMA 地址数组 */
-    entry->dma_addrs = kcalloc(num_pages, sizeof(dma_addr_t), GFP_KERNEL);
-    if (!entry->dma_addrs) {
-        ret = -ENOMEM;
+    /* 物理连续的页合并为一段，整表一次 DMA 映射，IOMMU 再合并连续的 IOVA */
+    entry->sgt = drm_prime_pages_to_sg(&fdev->drm, pages, num_pages);
+    if (IS_ERR(entry->sgt)) {
+        ret = PTR_ERR(entry->sgt);
         goto err_free_space;
     }
     
-    /* 分配页表项索引数组 */
-    entry->pte_indices = kcalloc(num_pages, sizeof(u32), GFP_KERNEL);
-    if (!entry->pte_indices) {
-        ret = -ENOMEM;
-        goto err_free_dma_addrs;
+    ret = dma_map_sgtable(fdev->dev, entry->sgt, direction, 0);
+    if (ret) {
+        fdca_err(fdev, "DMA 映射失败: %d\n", ret);
+        goto err_free_sgt;
     }
     
-    /* 映射每个页面 */
-    for (i = 0; i < num_pages; i++) {
-        /* 创建 DMA 映射 */
-        entry->dma_addrs[i] = dma_map_page(fdev->dev, pages[i], 0, PAGE_SIZE,
-                                          direction);
-        if (dma_mapping_error(fdev->dev, entry->dma_addrs[i])) {
-            fdca_err(fdev, "DMA 映射失败: 页 %u\n", i);
-            ret = -ENOMEM;
-            goto err_unmap_pages;
-        }
-        
-        /* 设置页表项 */
-        pte_index = fdca_gtt_get_pte_index(gtt, entry->gpu_addr + i * PAGE_SIZE);
-        entry->pte_indices[i] = pte_index;
-        fdca_gtt_set_pte(fdev, pte_index, entry->dma_addrs[i], direction);
-    }
+    /* 节点在 GTT 中连续，页表项索引也连续 */
+    entry->num_large = fdca_gtt_write_ptes(gtt, fdca_gtt_get_pte_index(gtt, entry->gpu_addr),
+                                           entry->sgt, num_pages,
+                                           fdca_gtt_pte_flags(direction));
+    entry->large_pages = entry->num_large > 0;
+    fdca_gtt_invalidate_range(fdev, entry->gpu_addr, num_pages);
     
     /* 更新统计信息 */
     atomic64_inc(&gtt->map_count);
+    atomic64_add(entry->num_large, &gtt->large_ptes);
+    atomic64_add(num_pages - entry->num_large * FDCA_GTT_PTES_PER_LARGE, &gtt->small_ptes);
+    fdca_gtt_perf_add(gtt->map_perf, num_pages, ktime_get_ns() - start_ns);
     
-    fdca_dbg(fdev, "GTT 映射完成: GPU=0x%llx, 页数=%u\n",
-             entry->gpu_addr, num_pages);
+    fdca_dbg(fdev, "GTT 映射完成: GPU=0x%llx, 页数=%u, DMA 段=%u, 大页项=%u\n",
+             entry->gpu_addr, num_pages, entry->sgt->nents, entry->num_large);
     
     return entry;
     
-err_unmap_pages:
-    /* 解映射已经映射的页面 */
-    while (i-- > 0) {
-        dma_unmap_page(fdev->dev, entry->dma_addrs[i], PAGE_SIZE, direction);
-        fdca_gtt_clear_pte(fdev, entry->pte_indices[i]);
-    }
-    kfree(entry->pte_indices);
-err_free_dma_addrs:
-    kfree(entry->dma_addrs);
+err_free_sgt:
+    sg_free_table(entry->sgt);
+    kfree(entry->sgt);
 err_free_space:
     fdca_gtt_free_space(fdev, entry);
     return ERR_PTR(ret);
@@ -513,12 +560,15 @@ err_free_space:
  * @fdev: FDCA 设备
  * @entry: GTT 映射条目
  * @direction: DMA 方向
+ * 
+ * 先清除页表项并失效 TLB，设备不再访问之后才解除 DMA 映射
  */
 void fdca_gtt_unmap_pages(struct fdca_device *fdev, struct fdca_gtt_entry *entry,
                          enum dma_data_direction direction)
 {
     struct fdca_gtt_manager *gtt = &fdev->mem_mgr->gtt;
-    u32 i;
+    u64 start_ns = ktime_get_ns();
+    u32 num_pages;
     
     if (!entry) {
         fdca_warn(fdev, "尝试解映射空的 GTT 条目\n");
@@ -529,24 +579,32 @@ void fdca_gtt_unmap_pages(struct fdca_device *fdev, struct fdca_gtt_entry *entry
              entry->gpu_addr, entry->num_pages, 
              entry->debug_name ?: "匿名");
     
-    /* 解映射所有页面 */
-    for (i = 0; i < entry->num_pages; i++) {
-        /* 清除页表项 */
-        fdca_gtt_clear_pte(fdev, entry->pte_indices[i]);
-        
-        /* 解映射 DMA */
-        dma_unmap_page(fdev->dev, entry->dma_addrs[i], PAGE_SIZE, direction);
-    }
+    num_pages = entry->num_pages;
+    fdca_gtt_clear_ptes(gtt, fdca_gtt_get_pte_index(gtt, entry->gpu_addr), num_pages);
+    fdca_gtt_invalidate_range(fdev, entry->gpu_addr, num_pages);
+    
+    dma_unmap_sgtable(fdev->dev, entry->sgt, direction, 0);
+    sg_free_table(entry->sgt);
+    kfree(entry->sgt);
     
-    /* 释放数组 */
-    kfree(entry->pte_indices);
-    kfree(entry->dma_addrs);
+    /* 更新统计信息 */
+    atomic64_inc(&gtt->unmap_count);
+    atomic64_sub(entry->num_large, &gtt->large_ptes);
+    atomic64_sub(num_pages - entry->num_large * FDCA_GTT_PTES_PER_LARGE, &gtt->small_ptes);
     
     /* 释放地址空间 */
     fdca_gtt_free_space(fdev, entry);
     
-    /* 更新统计信息 */
-    atomic64_inc(&gtt->unmap_count);
+    fdca_gtt_perf_add(gtt->unmap_perf, num_pages, ktime_get_ns() - start_ns);
+}
+
+/**
+ * fdca_gtt_entry_gpu_addr() - 获取映射条目的 GPU 地址
+ * @entry: GTT 映射条目
+ */
+u64 fdca_gtt_entry_gpu_addr(const struct fdca_gtt_entry *entry)
+{
+    return entry->gpu_addr;
 }
 
 /*
@@ -607,5 +665,6 @@ EXPORT_SYMBOL_GPL(fdca_gtt_manager_init);
 EXPORT_SYMBOL_GPL(fdca_gtt_manager_fini);
 EXPORT_SYMBOL_GPL(fdca_gtt_map_pages);
 EXPORT_SYMBOL_GPL(fdca_gtt_unmap_pages);
+EXPORT_SYMBOL_GPL(fdca_gtt_entry_gpu_addr);
 EXPORT_SYMBOL_GPL(fdca_gtt_get_stats);
 EXPORT_SYMBOL_GPL(fdca_gtt_print_stats);
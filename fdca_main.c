@@ -24,6 +24,7 @@
 #include <linux/slab.h>
 
 #include "fdca_drv.h"
+#include "fdca_queue.h"
 
 /*
  * ============================================================================
@@ -35,6 +36,7 @@ MODULE_AUTHOR("FDCA Kernel Team");
 MODULE_DESCRIPTION(FDCA_DRIVER_DESC);
 MODULE_VERSION(FDCA_DRIVER_VERSION);
 MODULE_LICENSE("GPL v2");
+MODULE_IMPORT_NS("DMA_BUF");
 
 /* 模块参数 */
 static unsigned int debug_level = 0;
@@ -245,10 +247,18 @@ static int __init fdca_driver_init(void)
         return -EINVAL;
     }
     
+    /* 命令描述符缓存必须先于设备探测创建 */
+    ret = fdca_command_cache_init();
+    if (ret) {
+        pr_err("命令描述符缓存创建失败: %d\n", ret);
+        return ret;
+    }
+    
     /* 初始化 PCI 驱动 */
     ret = fdca_pci_init();
     if (ret) {
         pr_err("PCI 驱动初始化失败: %d\n", ret);
+        fdca_command_cache_fini();
         return ret;
     }
     
@@ -278,6 +288,11 @@ static void __exit fdca_driver_exit(void)
     /* 清理 PCI 驱动 */
     fdca_pci_exit();
     
+    /* 移除 debugfs 根目录 */
+    fdca_debugfs_fini();
+    
+    fdca_command_cache_fini();
+    
     /* 验证所有设备已清理 */
     if (atomic_read(&fdca_device_count) > 0) {
         pr_warn("驱动卸载时仍有 %d 个设备未清理\n",
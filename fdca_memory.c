@@ -13,20 +13,32 @@
  * 4. 内存池管理和优化
  * 5. 缓存对象管理
  * 6. 内存使用监控和统计
+ * 7. 以用户态内存为后备的用户指针对象
+ * 8. dma-buf 导出和导入
  *
  * Author: FDCA Kernel Team
  * Date: 2024
  */
 
+#include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/genalloc.h>
 #include <linux/workqueue.h>
 #include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-resv.h>
+#include <linux/pfn_t.h>
+#include <linux/shmem_fs.h>
+#include <linux/sched/mm.h>
+#include <linux/mmu_notifier.h>
 
+#include <drm/drm_exec.h>
 #include <drm/drm_gem.h>
 #include <drm/drm_prime.h>
 
 #include "fdca_drv.h"
+#include "fdca_uapi.h"
 
 /*
  * ============================================================================
@@ -45,12 +57,56 @@
 #define FDCA_CACHE_CLEANUP_INTERVAL (10 * HZ)   /* 10秒清理间隔 */
 #define FDCA_CACHE_EXPIRE_TIME  (60 * HZ)       /* 60秒过期时间 */
 
+/* 运行时反复创建释放同尺寸的缓冲区，缓存释放的对象可以省掉 GEM 初始化和 VRAM 分配 */
+static unsigned int bo_cache_mb = 256;
+module_param(bo_cache_mb, uint, 0644);
+MODULE_PARM_DESC(bo_cache_mb, "VRAM held by freed GEM objects kept for reuse, in MB (0=disable)");
+
+/* CPU 映射配置 */
+#define FDCA_GEM_FAULT_AROUND   16              /* 每次缺页映射的页窗口，2 的幂 */
+
 /*
  * ============================================================================
  * GEM 对象结构
  * ============================================================================
  */
 
+/**
+ * struct fdca_cached_object - 缓存的 VRAM 后备
+ * 
+ * GEM 对象引用计数归零后照常销毁，只把 VRAM 后备摘下保留，
+ * 同时挂入 cached_objects (按释放先后) 和对应的大小桶，等待新对象复用
+ */
+struct fdca_cached_object {
+    struct list_head list;              /* cached_objects 节点 */
+    struct list_head bucket;            /* cache_buckets 节点 */
+    struct fdca_vram_object *vram_obj;  /* VRAM 后备 */
+    size_t size;                        /* 对象大小 */
+    u32 flags;                          /* 创建标志 */
+    pid_t owner_tgid;                   /* 释放对象的进程，跨进程复用前需清零 */
+    u64 expire_time;                    /* 过期时间 (jiffies) */
+};
+
+/**
+ * struct fdca_gem_userptr - 用户指针对象的后备信息
+ * 
+ * 固定模式在创建时长期固定全部用户页面。通知模式只在使用前短期固定，
+ * CPU 页表变化时由 mmu_interval_notifier 撤销 GPU 映射，失效的页面
+ * 留在对象中，下次使用时重新获取后 (或对象释放时) 解除固定。
+ *
+ * 失效通知可能由内存回收发出，只获取通知锁，不获取持有期间可能分配
+ * 内存的对象锁。通知锁持有期间同样不分配内存：GPU 映射 (sg 表、GTT
+ * 条目) 在锁外建立，持有通知锁确认页面仍有效后才发布
+ */
+struct fdca_gem_userptr {
+    struct fdca_gem_object *obj;        /* 所属对象 */
+    unsigned long addr;                 /* 用户虚拟地址 */
+    u32 flags;                          /* FDCA_USERPTR_* */
+    bool valid;                         /* 页面和 GPU 映射有效，受 lock 保护 */
+    struct mutex lock;                  /* 通知锁 */
+    struct mmu_interval_notifier notifier; /* 通知模式的地址区间 */
+};
+
 /**
  * struct fdca_gem_object - FDCA GEM 对象
  * 
@@ -72,9 +128,16 @@ struct fdca_gem_object {
     /* GTT 映射 */
     struct fdca_gtt_entry *gtt_entry;   /* GTT 映射条目 */
     
+    /* VRAM 驱逐 */
+    struct list_head lru;               /* vram_lru 节点，仅驻留 VRAM 时在表中 */
+    bool evicted;                       /* 已驱逐到 GTT，下次固定时迁回 VRAM */
+    struct drm_exec move_exec;          /* 碎片整理搬移期间持有的地址空间预留锁 */
+    
     /* 系统内存 */
     struct page **pages;                /* 页面数组 */
-    struct sg_table *sg_table;         /* scatter-gather 表 */
+    struct sg_table *sg_table;         /* scatter-gather 表，发布和撤销持有 VA 锁 */
+    struct fdca_gem_userptr *userptr;   /* 用户指针对象，普通对象为 NULL */
+    u32 export_pins;                    /* dma-buf 附着数，非 0 时留在系统内存 */
     
     /* 属性 */
     u32 flags;                          /* 创建标志 */
@@ -83,8 +146,12 @@ struct fdca_gem_object {
     
     /* 同步 */
     struct mutex lock;                  /* 对象锁 */
+    struct mutex va_lock;               /* VA 锁，drm_gpuvm 的 gpuva 锁 */
     atomic_t pin_count;                 /* 固定计数 */
     
+    /* 对象缓存 */
+    pid_t owner_tgid;                   /* 创建者进程，VRAM 后备跨进程复用前需清零 */
+    
     /* 统计信息 */
     u64 create_time;                    /* 创建时间 */
     u64 last_access;                    /* 最后访问时间 */
@@ -94,18 +161,12 @@ struct fdca_gem_object {
     const char *debug_name;             /* 调试名称 */
 };
 
-/**
- * struct fdca_cached_object - 缓存对象
- * 
- * 用于内存池的缓存管理
- */
-struct fdca_cached_object {
-    struct list_head list;              /* 链表节点 */
-    void *ptr;                          /* 内存指针 */
-    size_t size;                        /* 对象大小 */
-    u64 expire_time;                    /* 过期时间 */
-    atomic_t ref_count;                 /* 引用计数 */
-};
+#define to_fdca_gem(gem) container_of(gem, struct fdca_gem_object, base)
+
+static const struct drm_gem_object_funcs fdca_gem_object_funcs;
+
+static u64 fdca_gem_cache_trim(struct fdca_memory_manager *mem_mgr,
+                               u64 max_bytes, bool expired_only);
 
 /*
  * ============================================================================
@@ -174,23 +235,12 @@ static void fdca_cache_cleanup_work(struct work_struct *work)
     struct fdca_memory_manager *mem_mgr = 
         container_of(work, struct fdca_memory_manager, cache_cleanup.work);
     struct fdca_device *fdev = mem_mgr->fdev;
-    struct fdca_cached_object *obj, *tmp;
-    u64 current_time = jiffies;
-    int cleaned = 0;
+    u64 cleaned;
     
     /* 清理过期的缓存对象 */
-    list_for_each_entry_safe(obj, tmp, &mem_mgr->cached_objects, list) {
-        if (time_after64(current_time, obj->expire_time) &&
-            atomic_read(&obj->ref_count) == 0) {
-            list_del(&obj->list);
-            kfree(obj->ptr);
-            kfree(obj);
-            cleaned++;
-        }
-    }
-    
+    cleaned = fdca_gem_cache_trim(mem_mgr, 0, true);
     if (cleaned > 0) {
-        fdca_dbg(fdev, "缓存清理: 清理了 %d 个对象\n", cleaned);
+        fdca_dbg(fdev, "缓存清理: 释放了 %llu 字节\n", cleaned);
     }
     
     /* 重新安排下次清理 */
@@ -206,7 +256,7 @@ static void fdca_cache_cleanup_work(struct work_struct *work)
 int fdca_memory_manager_init(struct fdca_device *fdev)
 {
     struct fdca_memory_manager *mem_mgr;
-    int ret;
+    int i, ret;
     
     fdca_info(fdev, "初始化内存管理器\n");
     
@@ -222,9 +272,23 @@ int fdca_memory_manager_init(struct fdca_device *fdev)
     
     /* 初始化缓存对象列表 */
     INIT_LIST_HEAD(&mem_mgr->cached_objects);
+    for (i = 0; i < FDCA_GEM_CACHE_BUCKETS; i++)
+        INIT_LIST_HEAD(&mem_mgr->cache_buckets[i]);
+    spin_lock_init(&mem_mgr->cache_lock);
     INIT_DELAYED_WORK(&mem_mgr->cache_cleanup, fdca_cache_cleanup_work);
     
+    /* 初始化 VRAM LRU */
+    INIT_LIST_HEAD(&mem_mgr->vram_lru);
+    spin_lock_init(&mem_mgr->lru_lock);
+    
     /* 初始化统计信息 */
+    atomic64_set(&mem_mgr->userptr_pins, 0);
+    atomic64_set(&mem_mgr->userptr_pin_pages, 0);
+    atomic64_set(&mem_mgr->userptr_pin_ns, 0);
+    atomic64_set(&mem_mgr->userptr_invalidations, 0);
+    atomic64_set(&mem_mgr->prime_exports, 0);
+    atomic64_set(&mem_mgr->prime_imports, 0);
+    atomic64_set(&mem_mgr->prime_move_notifies, 0);
     atomic64_set(&mem_mgr->total_allocated, 0);
     atomic64_set(&mem_mgr->peak_usage, 0);
     
@@ -273,7 +337,6 @@ err_free_mem_mgr:
 void fdca_memory_manager_fini(struct fdca_device *fdev)
 {
     struct fdca_memory_manager *mem_mgr = fdev->mem_mgr;
-    struct fdca_cached_object *obj, *tmp;
     
     if (!mem_mgr) {
         return;
@@ -284,12 +347,8 @@ void fdca_memory_manager_fini(struct fdca_device *fdev)
     /* 停止缓存清理工作 */
     cancel_delayed_work_sync(&mem_mgr->cache_cleanup);
     
-    /* 清理所有缓存对象 */
-    list_for_each_entry_safe(obj, tmp, &mem_mgr->cached_objects, list) {
-        list_del(&obj->list);
-        kfree(obj->ptr);
-        kfree(obj);
-    }
+    /* 清理所有缓存对象，必须在 VRAM 管理器之前 */
+    fdca_gem_cache_trim(mem_mgr, 0, false);
     
     /* 销毁内存池 */
     fdca_memory_destroy_pools(fdev);
@@ -318,6 +377,53 @@ void fdca_memory_manager_fini(struct fdca_device *fdev)
  * ============================================================================
  */
 
+static struct fdca_vram_object *fdca_gem_vram_alloc(struct fdca_device *fdev,
+                                                    size_t size, u32 flags);
+static void fdca_gem_lru_add(struct fdca_gem_object *obj);
+static void fdca_gem_lru_del(struct fdca_gem_object *obj);
+static void fdca_gem_release_pages(struct fdca_gem_object *obj);
+static void fdca_gem_userptr_put_pages(struct fdca_gem_object *obj, struct page **pages);
+static bool fdca_gem_userptr_lock_valid(struct fdca_gem_object *obj);
+static void fdca_gem_userptr_unlock(struct fdca_gem_object *obj);
+static int fdca_gem_prime_map(struct fdca_gem_object *obj);
+static const struct fdca_vram_owner_ops fdca_gem_vram_owner_ops;
+static struct fdca_vram_object *fdca_gem_cache_get(struct fdca_device *fdev,
+                                                   size_t size, u32 flags);
+static void fdca_gem_cache_put(struct fdca_gem_object *obj);
+
+/* 只读用户指针对象只允许设备读 */
+static enum dma_data_direction fdca_gem_dma_dir(const struct fdca_gem_object *obj)
+{
+    if (obj->userptr && (obj->userptr->flags & FDCA_USERPTR_READONLY))
+        return DMA_TO_DEVICE;
+    
+    return DMA_BIDIRECTIONAL;
+}
+
+/**
+ * fdca_gem_object_init_fields() - 初始化基础 GEM 对象之外的字段
+ * @obj: GEM 对象 (基础对象已初始化)
+ * @flags: 创建标志
+ */
+static void fdca_gem_object_init_fields(struct fdca_gem_object *obj, u32 flags)
+{
+    obj->base.funcs = &fdca_gem_object_funcs;
+    
+    obj->flags = flags;
+    obj->coherent = !!(flags & FDCA_GEM_CREATE_COHERENT);
+    obj->pinned = false;
+    
+    mutex_init(&obj->lock);
+    mutex_init(&obj->va_lock);
+    drm_gem_gpuva_set_lock(&obj->base, &obj->va_lock);
+    INIT_LIST_HEAD(&obj->lru);
+    obj->owner_tgid = current->tgid;
+    atomic_set(&obj->pin_count, 0);
+    atomic64_set(&obj->access_count, 0);
+    obj->create_time = ktime_get_boottime_seconds();
+    obj->last_access = obj->create_time;
+}
+
 /**
  * fdca_gem_object_create() - 创建 GEM 对象
  * @fdev: FDCA 设备
@@ -346,27 +452,45 @@ struct fdca_gem_object *fdca_gem_object_create(struct fdca_device *fdev,
         return ERR_PTR(ret);
     }
     
-    /* 初始化 FDCA 特定字段 */
-    obj->flags = flags;
+    fdca_gem_object_init_fields(obj, flags);
     obj->mem_type = FDCA_MEM_TYPE_VRAM;  /* 默认使用 VRAM */
-    obj->coherent = !!(flags & FDCA_VRAM_ALLOC_CACHED);
-    obj->pinned = false;
-    
-    mutex_init(&obj->lock);
-    atomic_set(&obj->pin_count, 0);
-    atomic64_set(&obj->access_count, 0);
-    obj->create_time = ktime_get_boottime_seconds();
-    obj->last_access = obj->create_time;
     
-    /* 分配 VRAM */
-    obj->vram_obj = fdca_vram_alloc(fdev, size, flags, "GEM对象");
-    if (IS_ERR(obj->vram_obj)) {
-        fdca_err(fdev, "VRAM 分配失败\n");
+    /* 优先复用缓存中同尺寸、同标志的 VRAM，否则分配，空间不足时先驱逐冷对象 */
+    if (!(flags & FDCA_GEM_CREATE_GTT)) {
+        obj->vram_obj = fdca_gem_cache_get(fdev, size, flags);
+        if (!obj->vram_obj)
+            obj->vram_obj = fdca_gem_vram_alloc(fdev, size, flags);
+        if (!IS_ERR(obj->vram_obj)) {
+            fdca_vram_set_owner(fdev, obj->vram_obj, &fdca_gem_vram_owner_ops, obj);
+            fdca_gem_lru_add(obj);
+            goto out;
+        }
+        
         ret = PTR_ERR(obj->vram_obj);
+        obj->vram_obj = NULL;
+        if (ret != -ENOSPC && ret != -ENOMEM) {
+            fdca_err(fdev, "VRAM 分配失败: %d\n", ret);
+            goto err_gem_free;
+        }
+        
+        /* 无可驱逐对象时退回 GTT */
+        fdca_dbg(fdev, "VRAM 不足, 大小=%zu 的对象改放 GTT\n", size);
+    }
+    
+    /*
+     * GTT 放置: 页面在首次 CPU 缺页或 GPU 绑定时才从 shmem 分配，
+     * 这里只分配页指针数组
+     */
+    obj->mem_type = FDCA_MEM_TYPE_SYSTEM;
+    obj->pages = kvcalloc(size >> PAGE_SHIFT, sizeof(*obj->pages), GFP_KERNEL);
+    if (!obj->pages) {
+        ret = -ENOMEM;
         goto err_gem_free;
     }
     
-    fdca_dbg(fdev, "GEM 对象创建: 大小=%zu, 标志=0x%x\n", size, flags);
+out:
+    fdca_dbg(fdev, "GEM 对象创建: 大小=%zu, 标志=0x%x, 位置=%s\n", size, flags,
+             obj->vram_obj ? "VRAM" : "GTT");
     
     return obj;
     
@@ -377,19 +501,26 @@ err_gem_free:
 }
 
 /**
- * fdca_gem_object_free() - 释放 GEM 对象
+ * fdca_gem_object_destroy() - 销毁 GEM 对象并释放全部后备存储
  * @obj: GEM 对象
  */
-static void fdca_gem_object_free(struct drm_gem_object *gem_obj)
+static void fdca_gem_object_destroy(struct fdca_gem_object *obj)
 {
-    struct fdca_gem_object *obj = container_of(gem_obj, struct fdca_gem_object, base);
+    struct drm_gem_object *gem_obj = &obj->base;
     struct fdca_device *fdev = drm_to_fdca(gem_obj->dev);
     
     fdca_dbg(fdev, "GEM 对象释放: 大小=%zu\n", gem_obj->size);
     
+    /* 先移出 LRU，驱逐线程不会再拿到本对象 */
+    fdca_gem_lru_del(obj);
+    
+    /* 之后不会再有失效通知访问本对象 */
+    if (obj->userptr && (obj->userptr->flags & FDCA_USERPTR_NOTIFIER))
+        mmu_interval_notifier_remove(&obj->userptr->notifier);
+    
     /* 解除 GTT 映射 */
     if (obj->gtt_entry) {
-        fdca_gtt_unmap_pages(fdev, obj->gtt_entry, DMA_BIDIRECTIONAL);
+        fdca_gtt_unmap_pages(fdev, obj->gtt_entry, fdca_gem_dma_dir(obj));
         obj->gtt_entry = NULL;
     }
     
@@ -399,30 +530,1806 @@ static void fdca_gem_object_free(struct drm_gem_object *gem_obj)
         obj->vram_obj = NULL;
     }
     
-    /* 释放系统内存页面 */
-    if (obj->pages) {
-        u32 num_pages = gem_obj->size >> PAGE_SHIFT;
-        u32 i;
-        
-        for (i = 0; i < num_pages; i++) {
-            if (obj->pages[i]) {
-                put_page(obj->pages[i]);
-            }
-        }
-        kfree(obj->pages);
+    /* 导入对象解除附着，放下 dma-buf 引用 */
+    if (gem_obj->import_attach) {
+        drm_prime_gem_destroy(gem_obj, obj->sg_table);
+        obj->sg_table = NULL;
     }
     
-    /* 释放 scatter-gather 表 */
-    if (obj->sg_table) {
-        sg_free_table(obj->sg_table);
-        kfree(obj->sg_table);
-    }
+    /* 释放系统内存页面和 scatter-gather 表 */
+    fdca_gem_release_pages(obj);
+    kfree(obj->userptr);
     
     /* 释放基础对象 */
     drm_gem_object_release(gem_obj);
     kfree(obj);
 }
 
+/**
+ * fdca_gem_object_free() - 释放 GEM 对象
+ * @gem_obj: GEM 对象
+ * 
+ * 最后一个引用释放时调用；可复用的 VRAM 后备先摘下放入缓存，再销毁对象
+ */
+static void fdca_gem_object_free(struct drm_gem_object *gem_obj)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem_obj);
+    
+    fdca_gem_cache_put(obj);
+    fdca_gem_object_destroy(obj);
+}
+
+/*
+ * ============================================================================
+ * GEM 对象缓存
+ * ============================================================================
+ *
+ * 引用计数归零的 GEM 对象照常经 drm_gem_object_release() 销毁，只有完整
+ * 驻留 VRAM 的对象把 VRAM 后备摘下保留在缓存中，同尺寸、同标志的创建请求
+ * 在新建的 GEM 对象上直接复用。缓存受 bo_cache_mb 和 FDCA_CACHE_MAX_OBJECTS
+ * 限制，超出时从最早释放的后备开始释放；后备在缓存中停留超过
+ * FDCA_CACHE_EXPIRE_TIME 后由 cache_cleanup 工作释放；VRAM 不足时先回收缓存
+ * 再驱逐在用对象。
+ *
+ * 缓存的后备没有所有者，碎片整理不会搬移它们
+ */
+
+/**
+ * fdca_gem_cache_bucket() - 计算对象大小所在的缓存桶
+ * @size: 对象大小
+ */
+static unsigned int fdca_gem_cache_bucket(size_t size)
+{
+    return min_t(unsigned int, ilog2(max_t(size_t, size >> PAGE_SHIFT, 1)),
+                 FDCA_GEM_CACHE_BUCKETS - 1);
+}
+
+/**
+ * fdca_gem_cache_unlink() - 把后备移出缓存 (调用者持有 cache_lock)
+ * @mem_mgr: 内存管理器
+ * @cached: 缓存节点
+ */
+static void fdca_gem_cache_unlink(struct fdca_memory_manager *mem_mgr,
+                                  struct fdca_cached_object *cached)
+{
+    list_del_init(&cached->list);
+    list_del_init(&cached->bucket);
+    mem_mgr->cache_bytes -= cached->size;
+    mem_mgr->cache_count--;
+}
+
+/**
+ * fdca_gem_cache_put() - 把释放的对象的 VRAM 后备放入缓存
+ * @obj: 引用计数已归零的 GEM 对象
+ * 
+ * 只缓存完整驻留 VRAM 且未导出、未导入的对象的后备。放入缓存后
+ * obj->vram_obj 为 NULL，对象随后照常销毁
+ */
+static void fdca_gem_cache_put(struct fdca_gem_object *obj)
+{
+    struct fdca_device *fdev = drm_to_fdca(obj->base.dev);
+    struct fdca_memory_manager *mem_mgr = fdev->mem_mgr;
+    u64 limit = (u64)READ_ONCE(bo_cache_mb) << 20;
+    struct fdca_cached_object *cached;
+    bool over;
+    
+    if (!obj->vram_obj || obj->evicted || obj->pages || obj->gtt_entry ||
+        obj->sg_table || obj->base.import_attach || obj->base.dma_buf ||
+        obj->base.size > limit)
+        return;
+    
+    cached = kmalloc(sizeof(*cached), GFP_KERNEL);
+    if (!cached)
+        return;
+    
+    /* 摘下后备: 不再参与驱逐，碎片整理也不再经本对象搬移它 */
+    fdca_gem_lru_del(obj);
+    fdca_vram_set_owner(fdev, obj->vram_obj, NULL, NULL);
+    
+    cached->vram_obj = obj->vram_obj;
+    cached->size = obj->base.size;
+    cached->flags = obj->flags;
+    cached->owner_tgid = obj->owner_tgid;
+    cached->expire_time = get_jiffies_64() + FDCA_CACHE_EXPIRE_TIME;
+    obj->vram_obj = NULL;
+    
+    spin_lock(&mem_mgr->cache_lock);
+    list_add_tail(&cached->list, &mem_mgr->cached_objects);
+    list_add(&cached->bucket,
+             &mem_mgr->cache_buckets[fdca_gem_cache_bucket(cached->size)]);
+    mem_mgr->cache_bytes += cached->size;
+    mem_mgr->cache_count++;
+    over = mem_mgr->cache_bytes > limit ||
+           mem_mgr->cache_count > FDCA_CACHE_MAX_OBJECTS;
+    spin_unlock(&mem_mgr->cache_lock);
+    
+    if (over)
+        fdca_gem_cache_trim(mem_mgr, limit, false);
+}
+
+/**
+ * fdca_gem_cache_get() - 从缓存取出可复用的 VRAM 后备
+ * @fdev: FDCA 设备
+ * @size: 对象大小
+ * @flags: 创建标志
+ * 
+ * 桶内按释放时间从新到旧查找，优先复用本进程释放的后备；
+ * 复用其它进程释放的后备前清零
+ * 
+ * Return: VRAM 对象，未命中时返回 NULL
+ */
+static struct fdca_vram_object *fdca_gem_cache_get(struct fdca_device *fdev,
+                                                   size_t size, u32 flags)
+{
+    struct fdca_memory_manager *mem_mgr = fdev->mem_mgr;
+    struct list_head *head = &mem_mgr->cache_buckets[fdca_gem_cache_bucket(size)];
+    struct fdca_cached_object *cached, *found = NULL;
+    struct fdca_vram_object *vram_obj;
+    pid_t owner_tgid;
+    
+    spin_lock(&mem_mgr->cache_lock);
+    list_for_each_entry(cached, head, bucket) {
+        if (cached->size != size || cached->flags != flags)
+            continue;
+        if (cached->owner_tgid == current->tgid) {
+            found = cached;
+            break;
+        }
+        if (!found)
+            found = cached;
+    }
+    if (found)
+        fdca_gem_cache_unlink(mem_mgr, found);
+    spin_unlock(&mem_mgr->cache_lock);
+    
+    if (!found) {
+        atomic64_inc(&mem_mgr->cache_misses);
+        return NULL;
+    }
+    
+    vram_obj = found->vram_obj;
+    owner_tgid = found->owner_tgid;
+    kfree(found);
+    
+    if (owner_tgid != current->tgid && fdca_vram_clear(fdev, vram_obj)) {
+        fdca_vram_free(fdev, vram_obj);
+        atomic64_inc(&mem_mgr->cache_misses);
+        return NULL;
+    }
+    
+    atomic64_inc(&mem_mgr->cache_hits);
+    fdca_dbg(fdev, "VRAM 后备复用: 大小=%zu, 标志=0x%x\n", size, flags);
+    
+    return vram_obj;
+}
+
+/**
+ * fdca_gem_cache_trim() - 释放缓存中的后备
+ * @mem_mgr: 内存管理器
+ * @max_bytes: 释放到缓存不超过该字节数且数量不超过上限为止
+ * @expired_only: 只释放已过期的后备，忽略 @max_bytes
+ * 
+ * 从最早放入的后备开始释放，释放在锁外进行
+ * 
+ * Return: 释放的 VRAM 字节数
+ */
+static u64 fdca_gem_cache_trim(struct fdca_memory_manager *mem_mgr,
+                               u64 max_bytes, bool expired_only)
+{
+    struct fdca_cached_object *cached, *tmp;
+    u64 now = get_jiffies_64();
+    LIST_HEAD(victims);
+    u64 freed = 0;
+    
+    spin_lock(&mem_mgr->cache_lock);
+    list_for_each_entry_safe(cached, tmp, &mem_mgr->cached_objects, list) {
+        if (expired_only) {
+            if (time_before64(now, cached->expire_time))
+                break;
+        } else if (mem_mgr->cache_bytes <= max_bytes &&
+                   mem_mgr->cache_count <= FDCA_CACHE_MAX_OBJECTS) {
+            break;
+        }
+        fdca_gem_cache_unlink(mem_mgr, cached);
+        list_add_tail(&cached->list, &victims);
+        freed += cached->size;
+    }
+    spin_unlock(&mem_mgr->cache_lock);
+    
+    list_for_each_entry_safe(cached, tmp, &victims, list) {
+        list_del(&cached->list);
+        atomic64_inc(&mem_mgr->cache_expired);
+        fdca_vram_free(mem_mgr->fdev, cached->vram_obj);
+        kfree(cached);
+    }
+    
+    return freed;
+}
+
+/**
+ * fdca_gem_cache_reclaim() - VRAM 不足时回收缓存
+ * @fdev: FDCA 设备
+ * @size: 需要的字节数
+ * 
+ * Return: true 表示释放了缓存对象，值得重试分配
+ */
+static bool fdca_gem_cache_reclaim(struct fdca_device *fdev, size_t size)
+{
+    struct fdca_memory_manager *mem_mgr = fdev->mem_mgr;
+    u64 cached = READ_ONCE(mem_mgr->cache_bytes);
+    
+    if (!cached)
+        return false;
+    
+    return fdca_gem_cache_trim(mem_mgr, cached > size ? cached - size : 0, false) > 0;
+}
+
+/*
+ * ============================================================================
+ * GTT 对象页面管理
+ * ============================================================================
+ *
+ * GTT 对象的页面来自 drm_gem_object_init() 建立的 shmem 文件，按需分配:
+ * CPU 缺页只分配故障页，GPU 绑定时补齐全部页面。从未访问过的页不占用内存
+ */
+
+/**
+ * fdca_gem_get_page() - 获取 GTT 对象的一页，必要时从 shmem 分配
+ * @obj: GEM 对象
+ * @pgoff: 对象内页偏移
+ * 
+ * 调用者持有 obj->lock
+ * 
+ * Return: 页面指针或 ERR_PTR
+ */
+static struct page *fdca_gem_get_page(struct fdca_gem_object *obj, pgoff_t pgoff)
+{
+    struct address_space *mapping = obj->base.filp->f_mapping;
+    struct page *page;
+    
+    lockdep_assert_held(&obj->lock);
+    
+    if (obj->pages[pgoff])
+        return obj->pages[pgoff];
+    
+    page = shmem_read_mapping_page(mapping, pgoff);
+    if (IS_ERR(page))
+        return page;
+    
+    obj->pages[pgoff] = page;
+    fdca_stats_inc(drm_to_fdca(obj->base.dev), gem_gtt_pages);
+    
+    return page;
+}
+
+/**
+ * fdca_gem_populate() - 分配 GTT 对象的全部页面
+ * @obj: GEM 对象
+ * 
+ * 调用者持有 obj->lock。失败时已分配的页面保留在对象中，随对象释放
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_gem_populate(struct fdca_gem_object *obj)
+{
+    pgoff_t i, num_pages = obj->base.size >> PAGE_SHIFT;
+    struct page *page;
+    
+    /*
+     * 用户指针对象的页面整体获取，失效后需先经 fdca_gem_object_validate()。
+     * 这里不持有通知锁，发布映射前还要再次确认
+     */
+    if (obj->userptr)
+        return READ_ONCE(obj->userptr->valid) ? 0 : -EAGAIN;
+    
+    /* 导入对象没有页面，映射由 fdca_gem_object_validate() 建立 */
+    if (obj->base.import_attach)
+        return -EAGAIN;
+    
+    for (i = 0; i < num_pages; i++) {
+        page = fdca_gem_get_page(obj, i);
+        if (IS_ERR(page))
+            return PTR_ERR(page);
+    }
+    
+    return 0;
+}
+
+/*
+ * 撤销 scatter-gather 表的发布。之后开始执行的 VM_BIND 作业不再写入
+ * 它的页面，之前写入的页表项由调用者随后清除
+ */
+static struct sg_table *fdca_gem_detach_sg(struct fdca_gem_object *obj)
+{
+    struct sg_table *sgt;
+    
+    mutex_lock(&obj->va_lock);
+    sgt = obj->sg_table;
+    obj->sg_table = NULL;
+    mutex_unlock(&obj->va_lock);
+    
+    return sgt;
+}
+
+static void fdca_gem_free_sg(struct fdca_gem_object *obj, struct sg_table *sgt)
+{
+    if (!sgt)
+        return;
+    
+    dma_unmap_sgtable(obj->base.dev->dev, sgt, fdca_gem_dma_dir(obj), 0);
+    sg_free_table(sgt);
+    kfree(sgt);
+}
+
+/* 释放 fdca_gem_object_get_backing() 建立的 scatter-gather 表 */
+static void fdca_gem_release_sg(struct fdca_gem_object *obj)
+{
+    fdca_gem_free_sg(obj, fdca_gem_detach_sg(obj));
+}
+
+/**
+ * fdca_gem_release_pages() - 释放 GTT 对象的全部页面和页指针数组
+ * @obj: GEM 对象
+ * 
+ * 调用者保证页面不再被 GTT 或 CPU 映射引用
+ */
+static void fdca_gem_release_pages(struct fdca_gem_object *obj)
+{
+    pgoff_t i, num_pages = obj->base.size >> PAGE_SHIFT;
+    u32 populated = 0;
+    
+    fdca_gem_release_sg(obj);
+    
+    if (!obj->pages)
+        return;
+    
+    if (obj->userptr) {
+        fdca_gem_userptr_put_pages(obj, obj->pages);
+        obj->pages = NULL;
+        return;
+    }
+    
+    for (i = 0; i < num_pages; i++) {
+        if (obj->pages[i]) {
+            put_page(obj->pages[i]);
+            populated++;
+        }
+    }
+    kvfree(obj->pages);
+    obj->pages = NULL;
+    
+    fdca_stats_add(drm_to_fdca(obj->base.dev), gem_gtt_pages, -(s64)populated);
+}
+
+/**
+ * fdca_gem_object_bind() - 使 GEM 对象可被设备访问
+ * @gem: GEM 对象
+ * @gpu_addr: 输出：设备地址
+ * 
+ * VRAM 对象直接返回 VRAM 偏移；GTT 对象首次绑定时补齐页面并经
+ * fdca_gtt_map_pages() 映射，之后的绑定复用同一映射直到对象释放
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_gem_object_bind(struct drm_gem_object *gem, u64 *gpu_addr)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    struct fdca_device *fdev = drm_to_fdca(gem->dev);
+    struct fdca_gtt_entry *entry = NULL;
+    int ret;
+    
+    /* 导入对象没有页面数组，只能经 VM_BIND 映射 */
+    if (gem->import_attach)
+        return -EINVAL;
+    
+    ret = fdca_gem_object_validate(gem);
+    if (ret)
+        return ret;
+    
+    mutex_lock(&obj->lock);
+    
+    if (obj->vram_obj) {
+        *gpu_addr = fdca_vram_object_offset(obj->vram_obj);
+        goto out_unlock;
+    }
+    
+    if (!obj->gtt_entry) {
+        ret = fdca_gem_populate(obj);
+        if (ret) {
+            fdca_err(fdev, "GTT 对象页面分配失败: %d\n", ret);
+            goto out_unlock;
+        }
+        
+        entry = fdca_gtt_map_pages(fdev, obj->pages, gem->size >> PAGE_SHIFT,
+                                   fdca_gem_dma_dir(obj), "GEM对象");
+        if (IS_ERR(entry)) {
+            ret = PTR_ERR(entry);
+            fdca_err(fdev, "GTT 映射失败: %d\n", ret);
+            goto out_unlock;
+        }
+    }
+    
+    /* 失效通知不获取对象锁，期间可能已撤销页面和原有的映射 */
+    if (!fdca_gem_userptr_lock_valid(obj)) {
+        if (entry)
+            fdca_gtt_unmap_pages(fdev, entry, fdca_gem_dma_dir(obj));
+        ret = -EAGAIN;
+        goto out_unlock;
+    }
+    
+    if (entry)
+        obj->gtt_entry = entry;
+    *gpu_addr = fdca_gtt_entry_gpu_addr(obj->gtt_entry);
+    fdca_gem_userptr_unlock(obj);
+    
+out_unlock:
+    mutex_unlock(&obj->lock);
+    return ret;
+}
+
+/**
+ * fdca_gem_object_lock() - 锁定 GEM 对象
+ * @gem: GEM 对象
+ * 
+ * 对象锁保护后备存储，持有期间可以分配内存。对象的 vm_bo 链表在同时
+ * 持有对象锁和 VA 锁时修改，持有其中任一把锁即可遍历
+ */
+void fdca_gem_object_lock(struct drm_gem_object *gem)
+{
+    mutex_lock(&to_fdca_gem(gem)->lock);
+}
+
+/**
+ * fdca_gem_object_unlock() - 解锁 GEM 对象
+ * @gem: GEM 对象
+ */
+void fdca_gem_object_unlock(struct drm_gem_object *gem)
+{
+    mutex_unlock(&to_fdca_gem(gem)->lock);
+}
+
+/**
+ * fdca_gem_object_va_lock() - 锁定 GEM 对象的 VA 链表
+ * @gem: GEM 对象
+ * 
+ * VA 锁是 drm_gpuvm 的 gpuva 锁，VM_BIND 作业执行时获取。持有期间不
+ * 分配内存，也不获取对象锁
+ */
+void fdca_gem_object_va_lock(struct drm_gem_object *gem)
+{
+    mutex_lock(&to_fdca_gem(gem)->va_lock);
+}
+
+/**
+ * fdca_gem_object_va_unlock() - 解锁 GEM 对象的 VA 链表
+ * @gem: GEM 对象
+ */
+void fdca_gem_object_va_unlock(struct drm_gem_object *gem)
+{
+    mutex_unlock(&to_fdca_gem(gem)->va_lock);
+}
+
+/**
+ * fdca_gem_object_get_backing() - 查询对象当前的后备存储
+ * @gem: GEM 对象 (调用者持有对象锁)
+ * @vram_offset: 输出：驻留 VRAM 时的 VRAM 偏移
+ * @sgt: 输出：位于系统内存时已 DMA 映射的 sg 表，驻留 VRAM 时为 NULL
+ * 
+ * 系统内存对象首次调用时补齐全部页面并建立 sg 表，sg 表随页面一起释放
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_gem_object_get_backing(struct drm_gem_object *gem, u64 *vram_offset,
+                                struct sg_table **sgt)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    struct sg_table *table;
+    int ret;
+    
+    lockdep_assert_held(&obj->lock);
+    
+    if (obj->vram_obj) {
+        *vram_offset = fdca_vram_object_offset(obj->vram_obj);
+        *sgt = NULL;
+        return 0;
+    }
+    
+    if (!obj->sg_table) {
+        ret = fdca_gem_populate(obj);
+        if (ret)
+            return ret;
+        
+        table = drm_prime_pages_to_sg(gem->dev, obj->pages, gem->size >> PAGE_SHIFT);
+        if (IS_ERR(table))
+            return PTR_ERR(table);
+        
+        ret = dma_map_sgtable(gem->dev->dev, table, fdca_gem_dma_dir(obj), 0);
+        if (ret) {
+            sg_free_table(table);
+            kfree(table);
+            return ret;
+        }
+        
+        /* 建表期间失效的用户页面不能发布给 VM_BIND 作业 */
+        if (!fdca_gem_userptr_lock_valid(obj)) {
+            fdca_gem_free_sg(obj, table);
+            return -EAGAIN;
+        }
+        
+        mutex_lock(&obj->va_lock);
+        obj->sg_table = table;
+        mutex_unlock(&obj->va_lock);
+        
+        fdca_gem_userptr_unlock(obj);
+    }
+    
+    *sgt = obj->sg_table;
+    return 0;
+}
+
+/**
+ * fdca_gem_object_peek_backing() - 不分配内存地查询对象当前的后备存储
+ * @gem: GEM 对象 (调用者持有 VA 锁)
+ * @vram_offset: 输出：驻留 VRAM 时的 VRAM 偏移
+ * @sgt: 输出：位于系统内存时已 DMA 映射的 sg 表，驻留 VRAM 时为 NULL
+ * 
+ * VM_BIND 作业执行时调用。地址空间预留对象中的作业 fence 使迁移路径
+ * 跳过该对象，VRAM 后备在作业执行期间不变；sg 表只在持有 VA 锁时
+ * 发布和撤销
+ * 
+ * Return: 0 表示成功，-EAGAIN 表示系统内存后备尚未建立或已被撤销
+ */
+int fdca_gem_object_peek_backing(struct drm_gem_object *gem, u64 *vram_offset,
+                                 struct sg_table **sgt)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    
+    lockdep_assert_held(&obj->va_lock);
+    
+    if (obj->vram_obj) {
+        *vram_offset = fdca_vram_object_offset(obj->vram_obj);
+        *sgt = NULL;
+        return 0;
+    }
+    
+    if (!obj->sg_table)
+        return -EAGAIN;
+    
+    *sgt = obj->sg_table;
+    return 0;
+}
+
+/**
+ * fdca_gem_object_get_pages() - 查询对象当前的 CPU 可访问后备
+ * @gem: GEM 对象 (已固定，调用者不持有对象锁)
+ * @vram_offset: 输出：驻留 VRAM 时的 VRAM 偏移
+ * @pages: 输出：位于系统内存时的页面数组，驻留 VRAM 时为 NULL
+ * 
+ * 系统内存对象补齐全部页面。固定期间对象不会迁移，返回的后备在解除
+ * 固定前保持有效
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_gem_object_get_pages(struct drm_gem_object *gem, u64 *vram_offset,
+                              struct page ***pages)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    int ret = 0;
+    
+    mutex_lock(&obj->lock);
+    
+    if (obj->vram_obj) {
+        *vram_offset = fdca_vram_object_offset(obj->vram_obj);
+        *pages = NULL;
+    } else {
+        ret = fdca_gem_populate(obj);
+        *pages = obj->pages;
+    }
+    
+    mutex_unlock(&obj->lock);
+    return ret;
+}
+
+/**
+ * fdca_gem_object_revocable() - 对象后备是否可能被外部撤销
+ * @gem: GEM 对象
+ * 
+ * 通知模式的用户指针对象和导入对象的后备随时可能失效，固定不能阻止
+ */
+bool fdca_gem_object_revocable(struct drm_gem_object *gem)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    
+    return gem->import_attach ||
+           (obj->userptr && (obj->userptr->flags & FDCA_USERPTR_NOTIFIER));
+}
+
+/*
+ * ============================================================================
+ * VRAM 驱逐和迁移
+ * ============================================================================
+ *
+ * 驻留 VRAM 的对象按最近访问时间排在 vram_lru 中，CPU 缺页和固定时移到表尾。
+ * VRAM 分配失败时从表头开始把未固定的对象迁移到 shmem 页 (之后按 GTT 对象
+ * 处理)，直到释放出足够空间；被驱逐的对象在下一次引用它的提交固定时迁回。
+ * 迁移由 fdca_vram_copy_pages() 经 BAR 拷贝完成，期间持有对象锁和映射它的
+ * 各地址空间的预留锁，并已撤销 CPU 映射，用户态重新缺页时映射到新位置。
+ * 提交中引用的对象在作业完成前保持固定，不会被驱逐
+ */
+
+/**
+ * fdca_gem_vram_flags() - GEM 创建标志转换为 VRAM 分配标志
+ */
+static u32 fdca_gem_vram_flags(u32 flags)
+{
+    u32 vram_flags = 0;
+    
+    if (flags & FDCA_GEM_CREATE_LARGE_PAGE)
+        vram_flags |= FDCA_VRAM_ALLOC_LARGE_PAGE;
+    if (flags & FDCA_GEM_CREATE_CACHED)
+        vram_flags |= FDCA_VRAM_ALLOC_CACHED;
+    
+    return vram_flags;
+}
+
+static void fdca_gem_lru_add(struct fdca_gem_object *obj)
+{
+    struct fdca_memory_manager *mem_mgr = drm_to_fdca(obj->base.dev)->mem_mgr;
+    
+    spin_lock(&mem_mgr->lru_lock);
+    list_add_tail(&obj->lru, &mem_mgr->vram_lru);
+    spin_unlock(&mem_mgr->lru_lock);
+}
+
+static void fdca_gem_lru_del(struct fdca_gem_object *obj)
+{
+    struct fdca_memory_manager *mem_mgr = drm_to_fdca(obj->base.dev)->mem_mgr;
+    
+    spin_lock(&mem_mgr->lru_lock);
+    list_del_init(&obj->lru);
+    spin_unlock(&mem_mgr->lru_lock);
+}
+
+/**
+ * fdca_gem_lru_touch() - 记录一次访问，驻留 VRAM 的对象移到 LRU 表尾
+ * @obj: GEM 对象
+ */
+static void fdca_gem_lru_touch(struct fdca_gem_object *obj)
+{
+    struct fdca_memory_manager *mem_mgr = drm_to_fdca(obj->base.dev)->mem_mgr;
+    
+    obj->last_access = ktime_get_boottime_seconds();
+    atomic64_inc(&obj->access_count);
+    
+    spin_lock(&mem_mgr->lru_lock);
+    if (!list_empty(&obj->lru))
+        list_move_tail(&obj->lru, &mem_mgr->vram_lru);
+    spin_unlock(&mem_mgr->lru_lock);
+}
+
+/**
+ * fdca_gem_unmap_cpu() - 撤销对象的全部用户态 CPU 映射
+ * @obj: GEM 对象
+ * 
+ * 之后的访问重新缺页，映射到对象当前所在的位置
+ */
+static void fdca_gem_unmap_cpu(struct fdca_gem_object *obj)
+{
+    drm_vma_node_unmap(&obj->base.vma_node,
+                       obj->base.dev->anon_inode->i_mapping);
+}
+
+/*
+ * VRAM 碎片整理通过以下回调搬移 GEM 对象: 搬移期间持有对象锁和各地址
+ * 空间的预留锁，CPU 映射已撤销，重新缺页时映射到新偏移；固定中或仍被
+ * GPU 使用的对象不搬移
+ */
+
+static bool fdca_gem_vram_get(void *priv)
+{
+    struct fdca_gem_object *obj = priv;
+    
+    return kref_get_unless_zero(&obj->base.refcount);
+}
+
+static void fdca_gem_vram_put(void *priv)
+{
+    struct fdca_gem_object *obj = priv;
+    
+    drm_gem_object_put(&obj->base);
+}
+
+static int fdca_gem_vram_begin_move(void *priv, struct fdca_vram_object *vram_obj)
+{
+    struct fdca_gem_object *obj = priv;
+    
+    mutex_lock(&obj->lock);
+    
+    /* 对象可能已被驱逐，vram_obj 只做比较不解引用 */
+    if (obj->vram_obj != vram_obj || atomic_read(&obj->pin_count) ||
+        fdca_vm_bo_lock_idle(&obj->base, &obj->move_exec)) {
+        mutex_unlock(&obj->lock);
+        return -EBUSY;
+    }
+    
+    fdca_gem_unmap_cpu(obj);
+    
+    return 0;
+}
+
+static void fdca_gem_vram_end_move(void *priv, struct fdca_vram_object *vram_obj)
+{
+    struct fdca_gem_object *obj = priv;
+    
+    /* 偏移已变化，更新各地址空间中的映射 */
+    if (fdca_vm_bo_update(&obj->base))
+        fdca_err(drm_to_fdca(obj->base.dev), "搬移后更新 GPU 映射失败\n");
+    
+    fdca_vm_bo_unlock(&obj->move_exec);
+    mutex_unlock(&obj->lock);
+}
+
+static const struct fdca_vram_owner_ops fdca_gem_vram_owner_ops = {
+    .get = fdca_gem_vram_get,
+    .put = fdca_gem_vram_put,
+    .begin_move = fdca_gem_vram_begin_move,
+    .end_move = fdca_gem_vram_end_move,
+};
+
+/**
+ * fdca_gem_move_to_gtt() - 把 VRAM 对象迁移到系统内存
+ * @obj: GEM 对象 (已移出 LRU)
+ * 
+ * Return: 0 表示成功，-EBUSY 表示对象已被固定或仍在使用，其它负数表示错误
+ */
+static int fdca_gem_move_to_gtt(struct fdca_gem_object *obj)
+{
+    struct fdca_device *fdev = drm_to_fdca(obj->base.dev);
+    struct fdca_memory_manager *mem_mgr = fdev->mem_mgr;
+    struct fdca_vram_object *vram_obj;
+    u32 num_pages = obj->base.size >> PAGE_SHIFT;
+    struct drm_exec exec;
+    int ret;
+    
+    mutex_lock(&obj->lock);
+    
+    if (atomic_read(&obj->pin_count) || !obj->vram_obj) {
+        ret = -EBUSY;
+        goto out_unlock;
+    }
+    
+    /*
+     * 映射到地址空间的对象在该地址空间空闲前可能正被 GPU 访问。
+     * 预留锁持有到迁移结束，期间新作业无法入队
+     */
+    ret = fdca_vm_bo_lock_idle(&obj->base, &exec);
+    if (ret)
+        goto out_unlock;
+    
+    obj->pages = kvcalloc(num_pages, sizeof(*obj->pages), GFP_KERNEL);
+    if (!obj->pages) {
+        ret = -ENOMEM;
+        goto out_unlock_resv;
+    }
+    
+    ret = fdca_gem_populate(obj);
+    if (ret)
+        goto err_release;
+    
+    /* 对象锁阻止重新缺页，拷贝期间用户态不会再写入 VRAM */
+    fdca_gem_unmap_cpu(obj);
+    
+    ret = fdca_vram_copy_pages(fdev, obj->vram_obj, obj->pages, num_pages, false);
+    if (ret)
+        goto err_release;
+    
+    /* 先把各地址空间的映射切换到系统内存页，再释放 VRAM */
+    vram_obj = obj->vram_obj;
+    obj->vram_obj = NULL;
+    ret = fdca_vm_bo_update(&obj->base);
+    if (ret) {
+        obj->vram_obj = vram_obj;
+        fdca_vm_bo_update(&obj->base);
+        goto err_release;
+    }
+    
+    fdca_vram_free(fdev, vram_obj);
+    obj->mem_type = FDCA_MEM_TYPE_SYSTEM;
+    obj->evicted = true;
+    
+    atomic64_inc(&mem_mgr->evictions);
+    atomic64_add(obj->base.size, &mem_mgr->evicted_bytes);
+    
+    fdca_dbg(fdev, "GEM 对象驱逐到 GTT: 大小=%zu\n", obj->base.size);
+    
+    fdca_vm_bo_unlock(&exec);
+    mutex_unlock(&obj->lock);
+    return 0;
+    
+err_release:
+    fdca_gem_release_pages(obj);
+out_unlock_resv:
+    fdca_vm_bo_unlock(&exec);
+out_unlock:
+    mutex_unlock(&obj->lock);
+    return ret;
+}
+
+/**
+ * fdca_gem_evict() - 驱逐冷对象直到释放出 @size 字节
+ * @fdev: FDCA 设备
+ * @size: 需要的字节数
+ * 
+ * Return: 0 表示已驱逐至少 @size 字节，-ENOSPC 表示没有更多可驱逐对象
+ */
+static int fdca_gem_evict(struct fdca_device *fdev, size_t size)
+{
+    struct fdca_memory_manager *mem_mgr = fdev->mem_mgr;
+    struct fdca_gem_object *obj, *victim, *first_busy = NULL, *stale;
+    size_t freed = 0;
+    int ret = 0;
+    
+    /*
+     * first_busy 持有引用直到不再使用，按指针比较不会碰上重用的内存。
+     * 它被别的路径移出 LRU 后不会再轮转回来，重新开始计一圈
+     */
+    while (freed < size) {
+        victim = NULL;
+        stale = NULL;
+        
+        spin_lock(&mem_mgr->lru_lock);
+        if (first_busy && list_empty(&first_busy->lru)) {
+            stale = first_busy;
+            first_busy = NULL;
+        }
+        list_for_each_entry(obj, &mem_mgr->vram_lru, lru) {
+            if (atomic_read(&obj->pin_count))
+                continue;
+            /* 正在释放的对象由释放路径自行移出 */
+            if (!kref_get_unless_zero(&obj->base.refcount))
+                continue;
+            list_del_init(&obj->lru);
+            victim = obj;
+            break;
+        }
+        spin_unlock(&mem_mgr->lru_lock);
+        
+        if (stale)
+            drm_gem_object_put(&stale->base);
+        
+        if (!victim) {
+            ret = -ENOSPC;
+            break;
+        }
+        
+        /* 剩下的都是正在使用的对象，已经轮转一圈 */
+        if (victim == first_busy) {
+            fdca_gem_lru_add(victim);
+            drm_gem_object_put(&victim->base);
+            ret = -ENOSPC;
+            break;
+        }
+        
+        ret = fdca_gem_move_to_gtt(victim);
+        if (ret) {
+            /* 驱逐期间被固定、仍在使用或迁移失败，放回表尾继续下一个 */
+            if (victim->vram_obj)
+                fdca_gem_lru_add(victim);
+            if (!first_busy) {
+                first_busy = victim;
+                continue;
+            }
+        } else {
+            freed += victim->base.size;
+        }
+        
+        drm_gem_object_put(&victim->base);
+    }
+    
+    if (first_busy)
+        drm_gem_object_put(&first_busy->base);
+    
+    return ret;
+}
+
+/**
+ * fdca_gem_vram_alloc() - 为 GEM 对象分配 VRAM，必要时驱逐
+ * @fdev: FDCA 设备
+ * @size: 对象大小
+ * @flags: GEM 创建标志
+ * 
+ * 先回收对象缓存，再每轮驱逐至少 @size 字节后重试；碎片导致重试仍失败时继续驱逐，
+ * LRU 耗尽后返回分配错误
+ * 
+ * Return: VRAM 对象或 ERR_PTR
+ */
+static struct fdca_vram_object *fdca_gem_vram_alloc(struct fdca_device *fdev,
+                                                    size_t size, u32 flags)
+{
+    struct fdca_vram_object *vram_obj;
+    
+    for (;;) {
+        vram_obj = fdca_vram_alloc(fdev, size, fdca_gem_vram_flags(flags), "GEM对象");
+        if (!IS_ERR(vram_obj))
+            return vram_obj;
+        if (PTR_ERR(vram_obj) != -ENOSPC && PTR_ERR(vram_obj) != -ENOMEM)
+            return vram_obj;
+        /* 先回收缓存中的空闲对象，再驱逐在用对象 */
+        if (fdca_gem_cache_reclaim(fdev, size))
+            continue;
+        if (fdca_gem_evict(fdev, size))
+            return vram_obj;
+    }
+}
+
+/**
+ * fdca_gem_move_to_vram() - 把被驱逐的对象迁回 VRAM
+ * @obj: GEM 对象 (调用者持有 obj->lock)
+ * 
+ * 迁回时不驱逐其它对象；VRAM 仍然不足或对象仍被 GPU 使用时留在 GTT，
+ * 功能不受影响
+ */
+static void fdca_gem_move_to_vram(struct fdca_gem_object *obj)
+{
+    struct fdca_device *fdev = drm_to_fdca(obj->base.dev);
+    struct fdca_memory_manager *mem_mgr = fdev->mem_mgr;
+    struct fdca_vram_object *vram_obj;
+    u32 num_pages = obj->base.size >> PAGE_SHIFT;
+    struct drm_exec exec;
+    
+    lockdep_assert_held(&obj->lock);
+    
+    /* 与驱逐相同，迁回期间持有各地址空间的预留锁 */
+    if (fdca_vm_bo_lock_idle(&obj->base, &exec))
+        return;
+    
+    vram_obj = fdca_vram_alloc(fdev, obj->base.size, fdca_gem_vram_flags(obj->flags),
+                               "GEM对象");
+    if (IS_ERR(vram_obj))
+        goto out_unlock_resv;
+    
+    /* 驱逐时已补齐全部页面 */
+    fdca_gem_unmap_cpu(obj);
+    if (fdca_vram_copy_pages(fdev, vram_obj, obj->pages, num_pages, true)) {
+        fdca_vram_free(fdev, vram_obj);
+        goto out_unlock_resv;
+    }
+    
+    obj->vram_obj = vram_obj;
+    if (fdca_vm_bo_update(&obj->base)) {
+        obj->vram_obj = NULL;
+        fdca_vm_bo_update(&obj->base);
+        fdca_vram_free(fdev, vram_obj);
+        goto out_unlock_resv;
+    }
+    
+    if (obj->gtt_entry) {
+        fdca_gtt_unmap_pages(fdev, obj->gtt_entry, fdca_gem_dma_dir(obj));
+        obj->gtt_entry = NULL;
+    }
+    fdca_gem_release_pages(obj);
+    
+    obj->mem_type = FDCA_MEM_TYPE_VRAM;
+    obj->evicted = false;
+    fdca_vram_set_owner(fdev, vram_obj, &fdca_gem_vram_owner_ops, obj);
+    fdca_gem_lru_add(obj);
+    
+    atomic64_inc(&mem_mgr->restores);
+    atomic64_add(obj->base.size, &mem_mgr->restored_bytes);
+    
+    fdca_dbg(fdev, "GEM 对象迁回 VRAM: 大小=%zu\n", obj->base.size);
+    
+out_unlock_resv:
+    fdca_vm_bo_unlock(&exec);
+}
+
+/**
+ * fdca_gem_object_pin() - 固定 GEM 对象，作业完成前不会被驱逐
+ * @gem: GEM 对象
+ * 
+ * 被驱逐的对象先尝试迁回 VRAM，失效的用户指针对象先重新获取页面
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_gem_object_pin(struct drm_gem_object *gem)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    int ret;
+    
+    ret = fdca_gem_object_validate(gem);
+    if (ret)
+        return ret;
+    
+    mutex_lock(&obj->lock);
+    
+    /*
+     * 导出中的对象可能正被其它设备访问，已被固定的对象可能正被拷贝引擎
+     * 按页访问，都留在系统内存
+     */
+    if (obj->evicted && !obj->export_pins && !atomic_read(&obj->pin_count))
+        fdca_gem_move_to_vram(obj);
+    
+    atomic_inc(&obj->pin_count);
+    obj->pinned = true;
+    fdca_gem_lru_touch(obj);
+    
+    mutex_unlock(&obj->lock);
+    
+    return 0;
+}
+
+/**
+ * fdca_gem_object_unpin() - 解除 fdca_gem_object_pin() 的固定
+ * @gem: GEM 对象
+ */
+void fdca_gem_object_unpin(struct drm_gem_object *gem)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    
+    if (atomic_dec_and_test(&obj->pin_count))
+        obj->pinned = false;
+}
+
+/*
+ * ============================================================================
+ * 用户指针对象
+ * ============================================================================
+ *
+ * 用户指针对象直接以用户态已有的匿名内存为后备，不拷贝数据:
+ * 1. 固定模式在创建时以 FOLL_LONGTERM 固定全部页面，直到对象释放
+ * 2. 通知模式在首次使用时才固定页面。CPU 页表变化 (munmap、迁移、回收)
+ *    时等待使用它的地址空间空闲，撤销 GPU 映射并释放页面；之后的提交
+ *    固定、GTT 绑定或 VM_BIND 映射重新获取页面并重写映射
+ * 对象不会被放入 VRAM，也不能经设备文件 mmap
+ */
+
+/**
+ * fdca_gem_userptr_pin() - 固定用户页面
+ * @obj: 用户指针对象
+ * @mm: 页面所属地址空间
+ * @pages: 输出：页面数组
+ * 
+ * 调用者不能持有对象锁，缺页可能触发同一区间的失效通知
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_gem_userptr_pin(struct fdca_gem_object *obj, struct mm_struct *mm,
+                                struct page **pages)
+{
+    struct fdca_gem_userptr *up = obj->userptr;
+    struct fdca_memory_manager *mem_mgr = drm_to_fdca(obj->base.dev)->mem_mgr;
+    unsigned long num_pages = obj->base.size >> PAGE_SHIFT;
+    unsigned int gup_flags = 0;
+    u64 start_ns = ktime_get_ns();
+    unsigned long pinned = 0;
+    long ret = 0;
+    
+    if (!(up->flags & FDCA_USERPTR_READONLY))
+        gup_flags |= FOLL_WRITE;
+    
+    if (!(up->flags & FDCA_USERPTR_NOTIFIER)) {
+        /* 固定模式只在创建 ioctl 中调用，地址空间就是当前进程 */
+        gup_flags |= FOLL_LONGTERM;
+        while (pinned < num_pages) {
+            ret = pin_user_pages_fast(up->addr + (pinned << PAGE_SHIFT),
+                                      num_pages - pinned, gup_flags, pages + pinned);
+            if (ret <= 0)
+                break;
+            pinned += ret;
+        }
+    } else {
+        /* 可能在调度器工作线程中调用，显式使用对象所属的地址空间 */
+        if (!mmget_not_zero(mm))
+            return -EFAULT;
+        
+        mmap_read_lock(mm);
+        while (pinned < num_pages) {
+            ret = pin_user_pages_remote(mm, up->addr + (pinned << PAGE_SHIFT),
+                                        num_pages - pinned, gup_flags,
+                                        pages + pinned, NULL);
+            if (ret <= 0)
+                break;
+            pinned += ret;
+        }
+        mmap_read_unlock(mm);
+        mmput(mm);
+    }
+    
+    if (pinned < num_pages) {
+        unpin_user_pages(pages, pinned);
+        return ret < 0 ? ret : -EFAULT;
+    }
+    
+    atomic64_inc(&mem_mgr->userptr_pins);
+    atomic64_add(num_pages, &mem_mgr->userptr_pin_pages);
+    atomic64_add(ktime_get_ns() - start_ns, &mem_mgr->userptr_pin_ns);
+    
+    return 0;
+}
+
+/**
+ * fdca_gem_userptr_put_pages() - 解除用户页面的固定
+ * @obj: 用户指针对象
+ * @pages: 页面数组，随之释放
+ * 
+ * 设备可能写过的页面标记为脏。只在进程上下文中调用，不在失效通知中
+ */
+static void fdca_gem_userptr_put_pages(struct fdca_gem_object *obj, struct page **pages)
+{
+    unsigned long num_pages = obj->base.size >> PAGE_SHIFT;
+    bool dirty = !(obj->userptr->flags & FDCA_USERPTR_READONLY);
+    
+    if (!pages)
+        return;
+    
+    unpin_user_pages_dirty_lock(pages, num_pages, dirty);
+    kvfree(pages);
+}
+
+/*
+ * 持有通知锁并确认页面有效，成功时返回 true 且不释放通知锁。
+ * 固定模式对象的页面始终有效，不获取锁
+ */
+static bool fdca_gem_userptr_lock_valid(struct fdca_gem_object *obj)
+{
+    struct fdca_gem_userptr *up = obj->userptr;
+    
+    if (!up || !(up->flags & FDCA_USERPTR_NOTIFIER))
+        return true;
+    
+    mutex_lock(&up->lock);
+    if (up->valid)
+        return true;
+    
+    mutex_unlock(&up->lock);
+    return false;
+}
+
+static void fdca_gem_userptr_unlock(struct fdca_gem_object *obj)
+{
+    struct fdca_gem_userptr *up = obj->userptr;
+    
+    if (up && (up->flags & FDCA_USERPTR_NOTIFIER))
+        mutex_unlock(&up->lock);
+}
+
+/**
+ * fdca_gem_userptr_invalidate() - CPU 页表变化时撤销通知模式对象的 GPU 映射
+ * 
+ * 只持有通知锁：等待映射了该对象的地址空间空闲，再撤销 sg 表、页表项
+ * 和 GTT 条目。页面仍处于固定状态，由下次 fdca_gem_object_validate()
+ * 或对象释放解除固定，通知中不释放页面数组，也不分配内存
+ */
+static bool fdca_gem_userptr_invalidate(struct mmu_interval_notifier *mni,
+                                        const struct mmu_notifier_range *range,
+                                        unsigned long cur_seq)
+{
+    struct fdca_gem_userptr *up = container_of(mni, struct fdca_gem_userptr, notifier);
+    struct fdca_gem_object *obj = up->obj;
+    struct fdca_device *fdev = drm_to_fdca(obj->base.dev);
+    struct sg_table *sgt;
+    
+    if (!mmu_notifier_range_blockable(range))
+        return false;
+    
+    mutex_lock(&up->lock);
+    mmu_interval_set_seq(mni, cur_seq);
+    
+    if (up->valid) {
+        /* 之后建立的映射不会再发布 */
+        WRITE_ONCE(up->valid, false);
+        
+        fdca_vm_bo_wait_idle(&obj->base);
+        
+        /* 先撤销 sg 表，之后执行的 VM_BIND 作业不会再写入旧页面 */
+        sgt = fdca_gem_detach_sg(obj);
+        fdca_vm_bo_invalidate(&obj->base);
+        
+        if (obj->gtt_entry) {
+            fdca_gtt_unmap_pages(fdev, obj->gtt_entry, fdca_gem_dma_dir(obj));
+            obj->gtt_entry = NULL;
+        }
+        fdca_gem_free_sg(obj, sgt);
+        
+        atomic64_inc(&fdev->mem_mgr->userptr_invalidations);
+    }
+    
+    mutex_unlock(&up->lock);
+    
+    return true;
+}
+
+static const struct mmu_interval_notifier_ops fdca_gem_userptr_notifier_ops = {
+    .invalidate = fdca_gem_userptr_invalidate,
+};
+
+/**
+ * fdca_gem_object_validate() - 使用前确保用户指针对象的页面有效
+ * @gem: GEM 对象 (调用者不持有对象锁)
+ * 
+ * 已失效的通知模式对象在锁外重新固定页面，再持有对象锁和通知锁确认
+ * 期间没有新的失效、也没有其它线程抢先装入后替换页面，最后解除旧页面
+ * 的固定并重写各地址空间中的映射。导入对象重新映射附着。其它对象
+ * 直接返回
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_gem_object_validate(struct drm_gem_object *gem)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    struct fdca_gem_userptr *up = obj->userptr;
+    unsigned long num_pages = gem->size >> PAGE_SHIFT;
+    struct page **pages = NULL, **stale;
+    unsigned long seq;
+    bool valid;
+    int ret = 0;
+    
+    if (gem->import_attach)
+        return fdca_gem_prime_map(obj);
+    
+    if (!up || !(up->flags & FDCA_USERPTR_NOTIFIER))
+        return 0;
+    
+    for (;;) {
+        mutex_lock(&up->lock);
+        valid = up->valid;
+        mutex_unlock(&up->lock);
+        if (valid)
+            break;
+        
+        if (!pages) {
+            pages = kvmalloc_array(num_pages, sizeof(*pages), GFP_KERNEL);
+            if (!pages)
+                return -ENOMEM;
+        }
+        
+        seq = mmu_interval_read_begin(&up->notifier);
+        ret = fdca_gem_userptr_pin(obj, up->notifier.mm, pages);
+        if (ret)
+            break;
+        
+        mutex_lock(&obj->lock);
+        mutex_lock(&up->lock);
+        
+        /* 固定期间可能有新的失效，或其它线程已装入页面 */
+        valid = up->valid;
+        if (valid || mmu_interval_read_retry(&up->notifier, seq)) {
+            mutex_unlock(&up->lock);
+            mutex_unlock(&obj->lock);
+            unpin_user_pages(pages, num_pages);
+            if (valid)
+                break;
+            continue;
+        }
+        
+        /* 旧页面的 GPU 映射已由失效通知撤销 */
+        stale = obj->pages;
+        obj->pages = pages;
+        pages = NULL;
+        WRITE_ONCE(up->valid, true);
+        mutex_unlock(&up->lock);
+        
+        fdca_gem_userptr_put_pages(obj, stale);
+        ret = fdca_vm_bo_update(gem);
+        mutex_unlock(&obj->lock);
+        break;
+    }
+    
+    kvfree(pages);
+    return ret;
+}
+
+/**
+ * fdca_gem_object_readonly() - 对象是否只允许设备读
+ * @gem: GEM 对象
+ */
+bool fdca_gem_object_readonly(struct drm_gem_object *gem)
+{
+    return fdca_gem_dma_dir(to_fdca_gem(gem)) == DMA_TO_DEVICE;
+}
+
+/**
+ * fdca_gem_userptr_create() - 以用户态内存为后备创建 GEM 对象
+ * @fdev: FDCA 设备
+ * @addr: 用户虚拟地址 (页对齐)
+ * @size: 字节数 (页对齐)
+ * @flags: FDCA_USERPTR_*
+ * 
+ * Return: GEM 对象指针或 ERR_PTR
+ */
+struct fdca_gem_object *fdca_gem_userptr_create(struct fdca_device *fdev,
+                                                u64 addr, u64 size, u32 flags)
+{
+    struct fdca_gem_object *obj;
+    struct fdca_gem_userptr *up;
+    int ret;
+    
+    obj = kzalloc(sizeof(*obj), GFP_KERNEL);
+    if (!obj)
+        return ERR_PTR(-ENOMEM);
+    
+    up = kzalloc(sizeof(*up), GFP_KERNEL);
+    if (!up) {
+        kfree(obj);
+        return ERR_PTR(-ENOMEM);
+    }
+    
+    /* 没有 shmem 后备 */
+    drm_gem_private_object_init(&fdev->drm, &obj->base, size);
+    fdca_gem_object_init_fields(obj, FDCA_GEM_CREATE_GTT);
+    obj->mem_type = FDCA_MEM_TYPE_SYSTEM;
+    obj->debug_name = "用户指针";
+    
+    up->obj = obj;
+    up->addr = addr;
+    up->flags = flags;
+    mutex_init(&up->lock);
+    obj->userptr = up;
+    
+    if (flags & FDCA_USERPTR_NOTIFIER) {
+        ret = mmu_interval_notifier_insert(&up->notifier, current->mm, addr, size,
+                                           &fdca_gem_userptr_notifier_ops);
+        if (ret)
+            goto err_free;
+    } else {
+        obj->pages = kvmalloc_array(size >> PAGE_SHIFT, sizeof(*obj->pages), GFP_KERNEL);
+        if (!obj->pages) {
+            ret = -ENOMEM;
+            goto err_free;
+        }
+        
+        ret = fdca_gem_userptr_pin(obj, current->mm, obj->pages);
+        if (ret) {
+            kvfree(obj->pages);
+            goto err_free;
+        }
+        up->valid = true;
+    }
+    
+    fdca_dbg(fdev, "用户指针对象创建: 地址=0x%llx, 大小=%llu, 标志=0x%x\n",
+             addr, size, flags);
+    
+    return obj;
+    
+err_free:
+    drm_gem_object_release(&obj->base);
+    kfree(up);
+    kfree(obj);
+    return ERR_PTR(ret);
+}
+
+/*
+ * ============================================================================
+ * dma-buf 导出和导入
+ * ============================================================================
+ *
+ * 导出: 其它设备不能直接访问 VRAM，首个附着把对象迁到系统内存并留在那里，
+ * 直到最后一个附着解除。drm_gem_map_dma_buf() 以 get_sg_table 返回的
+ * 页面表为每个附着单独做 DMA 映射。
+ *
+ * 导入: 以动态附着接入其它设备导出的 dma-buf，附着映射在首次使用时由
+ * fdca_gem_object_validate() 建立。导出者搬移后备前调用 move_notify，
+ * 此时等待映射了对象的地址空间空闲，撤销页表项并解除附着映射，下次使用
+ * 时重新映射。导入对象的 sg_table 由 dma-buf 预留锁保护。
+ */
+
+static struct dma_buf *fdca_gem_prime_export(struct drm_gem_object *gem, int flags)
+{
+    /* 用户指针对象的页面属于用户态进程 */
+    if (to_fdca_gem(gem)->userptr)
+        return ERR_PTR(-EPERM);
+    
+    return drm_gem_prime_export(gem, flags);
+}
+
+/*
+ * 每个附着调用一次，调用者持有 dma-buf 预留锁。对象仍有作业在途或被
+ * 提交固定时无法迁移，返回 -EBUSY
+ */
+static int fdca_gem_prime_pin(struct drm_gem_object *gem)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    int ret;
+    
+    mutex_lock(&obj->lock);
+    if (obj->vram_obj) {
+        fdca_vm_bo_wait_idle(gem);
+        mutex_unlock(&obj->lock);
+        
+        fdca_gem_lru_del(obj);
+        ret = fdca_gem_move_to_gtt(obj);
+        if (ret) {
+            if (obj->vram_obj)
+                fdca_gem_lru_add(obj);
+            return ret;
+        }
+        
+        atomic64_inc(&drm_to_fdca(gem->dev)->mem_mgr->prime_exports);
+        mutex_lock(&obj->lock);
+    }
+    
+    /* 迁移后到这里之间可能已被提交迁回 */
+    if (obj->vram_obj) {
+        ret = -EBUSY;
+        goto out_unlock;
+    }
+    
+    ret = fdca_gem_populate(obj);
+    if (!ret)
+        obj->export_pins++;
+    
+out_unlock:
+    mutex_unlock(&obj->lock);
+    return ret;
+}
+
+static void fdca_gem_prime_unpin(struct drm_gem_object *gem)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    
+    mutex_lock(&obj->lock);
+    obj->export_pins--;
+    mutex_unlock(&obj->lock);
+}
+
+/* 附着已固定对象，页面齐全；返回的表由 drm_gem_map_dma_buf() 映射和释放 */
+static struct sg_table *fdca_gem_prime_get_sg_table(struct drm_gem_object *gem)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    struct sg_table *sgt;
+    
+    mutex_lock(&obj->lock);
+    sgt = drm_prime_pages_to_sg(gem->dev, obj->pages, gem->size >> PAGE_SHIFT);
+    mutex_unlock(&obj->lock);
+    
+    return sgt;
+}
+
+/**
+ * fdca_gem_prime_map() - 建立导入对象的附着映射
+ * @obj: 导入对象 (调用者不持有对象锁)
+ * 
+ * 导出者的 map 回调可能搬移后备并回调 move_notify，不能在对象锁内调用
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_gem_prime_map(struct fdca_gem_object *obj)
+{
+    struct dma_buf_attachment *attach = obj->base.import_attach;
+    struct dma_resv *resv = attach->dmabuf->resv;
+    struct sg_table *sgt;
+    long timeout;
+    int ret;
+    
+    ret = dma_resv_lock_interruptible(resv, NULL);
+    if (ret)
+        return ret;
+    
+    if (obj->sg_table)
+        goto out_unlock;
+    
+    sgt = dma_buf_map_attachment(attach, fdca_gem_dma_dir(obj));
+    if (IS_ERR(sgt)) {
+        ret = PTR_ERR(sgt);
+        goto out_unlock;
+    }
+    
+    /* 导出者搬移后备的拷贝完成后映射才有效 */
+    timeout = dma_resv_wait_timeout(resv, DMA_RESV_USAGE_KERNEL, true,
+                                    MAX_SCHEDULE_TIMEOUT);
+    if (timeout < 0) {
+        dma_buf_unmap_attachment(attach, sgt, fdca_gem_dma_dir(obj));
+        ret = timeout;
+        goto out_unlock;
+    }
+    
+    mutex_lock(&obj->lock);
+    mutex_lock(&obj->va_lock);
+    obj->sg_table = sgt;
+    mutex_unlock(&obj->va_lock);
+    ret = fdca_vm_bo_update(&obj->base);
+    mutex_unlock(&obj->lock);
+    
+out_unlock:
+    dma_resv_unlock(resv);
+    return ret;
+}
+
+/* 导出者持有预留锁调用，返回后不能再访问原有的后备 */
+static void fdca_gem_prime_move_notify(struct dma_buf_attachment *attach)
+{
+    struct fdca_gem_object *obj = attach->importer_priv;
+    struct sg_table *sgt;
+    
+    dma_resv_assert_held(attach->dmabuf->resv);
+    
+    mutex_lock(&obj->lock);
+    if (obj->sg_table) {
+        fdca_vm_bo_wait_idle(&obj->base);
+        
+        /* 先撤销 sg 表，之后执行的 VM_BIND 作业不会再写入旧后备 */
+        sgt = fdca_gem_detach_sg(obj);
+        fdca_vm_bo_invalidate(&obj->base);
+        
+        dma_buf_unmap_attachment(attach, sgt, fdca_gem_dma_dir(obj));
+        
+        atomic64_inc(&drm_to_fdca(obj->base.dev)->mem_mgr->prime_move_notifies);
+    }
+    mutex_unlock(&obj->lock);
+}
+
+static const struct dma_buf_attach_ops fdca_gem_prime_attach_ops = {
+    .allow_peer2peer = false,
+    .move_notify = fdca_gem_prime_move_notify,
+};
+
+/**
+ * fdca_gem_prime_import() - 导入 dma-buf
+ * @drm: DRM 设备
+ * @dma_buf: 要导入的 dma-buf
+ * 
+ * 本设备导出的对象直接返回原对象
+ * 
+ * Return: GEM 对象指针或 ERR_PTR
+ */
+struct drm_gem_object *fdca_gem_prime_import(struct drm_device *drm,
+                                             struct dma_buf *dma_buf)
+{
+    struct fdca_device *fdev = drm_to_fdca(drm);
+    struct dma_buf_attachment *attach;
+    struct fdca_gem_object *obj;
+    struct drm_gem_object *gem;
+    
+    if (dma_buf->ops == &drm_gem_prime_dmabuf_ops) {
+        gem = dma_buf->priv;
+        if (gem->dev == drm) {
+            drm_gem_object_get(gem);
+            return gem;
+        }
+    }
+    
+    if (!PAGE_ALIGNED(dma_buf->size))
+        return ERR_PTR(-EINVAL);
+    
+    obj = kzalloc(sizeof(*obj), GFP_KERNEL);
+    if (!obj)
+        return ERR_PTR(-ENOMEM);
+    
+    /* 与导出者共用预留对象，须在初始化基础对象之前设置 */
+    obj->base.resv = dma_buf->resv;
+    drm_gem_private_object_init(drm, &obj->base, dma_buf->size);
+    fdca_gem_object_init_fields(obj, FDCA_GEM_CREATE_GTT);
+    obj->mem_type = FDCA_MEM_TYPE_SYSTEM;
+    obj->debug_name = "dma-buf导入";
+    
+    attach = dma_buf_dynamic_attach(dma_buf, drm->dev, &fdca_gem_prime_attach_ops, obj);
+    if (IS_ERR(attach)) {
+        fdca_dbg(fdev, "dma-buf 附着失败: %ld\n", PTR_ERR(attach));
+        drm_gem_object_release(&obj->base);
+        kfree(obj);
+        return ERR_CAST(attach);
+    }
+    
+    get_dma_buf(dma_buf);
+    obj->base.import_attach = attach;
+    
+    atomic64_inc(&fdev->mem_mgr->prime_imports);
+    fdca_dbg(fdev, "dma-buf 导入: 大小=%zu, 导出者=%s\n", dma_buf->size,
+             dma_buf->exp_name);
+    
+    return &obj->base;
+}
+
+/*
+ * ============================================================================
+ * CPU 映射
+ * ============================================================================
+ *
+ * 用户态经 DRM_IOCTL_FDCA_GEM_MMAP 取得伪偏移后 mmap 设备文件，页表在缺页时建立:
+ * 1. VRAM 对象经 BAR 以写合并方式映射
+ * 2. GTT 对象直接映射 shmem 页，缺页时按需分配
+ * 3. 4KB 路径一次映射故障页所在的 FDCA_GEM_FAULT_AROUND 页窗口，
+ *    顺序访问时缺页次数降为原来的 1/16。GTT 对象只预映射已分配的页
+ * 4. 以 FDCA_VRAM_LARGE_BLOCK_SIZE 分配的 VRAM 对象在 VMA 与物理地址均
+ *    2MB 对齐时以 PMD 映射，一次缺页覆盖 2MB
+ */
+
+/**
+ * fdca_gem_object_mmap() - 建立 GEM 对象的 VMA
+ * @gem: GEM 对象
+ * @vma: 虚拟内存区域
+ * 
+ * 只设置 VMA 属性，不预先建立页表
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_gem_object_mmap(struct drm_gem_object *gem,
+                                struct vm_area_struct *vma)
+{
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    
+    /* 用户指针对象在用户态已有映射 */
+    if (obj->userptr)
+        return -EINVAL;
+    
+    /* 导入对象由导出者映射，drm_gem_mmap_obj() 取得的引用由 VMA 文件接替 */
+    if (gem->import_attach) {
+        int ret;
+        
+        vma->vm_private_data = NULL;
+        ret = dma_buf_mmap(gem->import_attach->dmabuf, vma, 0);
+        if (!ret)
+            drm_gem_object_put(gem);
+        return ret;
+    }
+    
+    /* drm_gem_mmap 传入的是伪偏移，之后 vm_pgoff 为对象内页偏移 */
+    vma->vm_pgoff -= drm_vma_node_start(&gem->vma_node);
+    
+    /* 对象可能在 VRAM 与系统内存之间迁移，统一按 PFN 映射 */
+    vm_flags_set(vma, VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP);
+    vma->vm_page_prot = vm_get_page_prot(vma->vm_flags);
+    
+    /* 可能位于 VRAM 的对象始终写合并，迁移后不必改变页属性 */
+    mutex_lock(&obj->lock);
+    if (obj->vram_obj || obj->evicted || (obj->flags & FDCA_GEM_CREATE_UNCACHED))
+        vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+    mutex_unlock(&obj->lock);
+    
+    return 0;
+}
+
+/**
+ * fdca_gem_insert_page() - 映射对象的一页
+ * @vma: 虚拟内存区域
+ * @obj: GEM 对象
+ * @pgoff: 对象内页偏移
+ * @populate: GTT 对象的页尚未分配时是否分配
+ * 
+ * 调用者持有 obj->lock。预映射不分配新页，未分配的页留给它自己的缺页
+ */
+static vm_fault_t fdca_gem_insert_page(struct vm_area_struct *vma,
+                                       struct fdca_gem_object *obj,
+                                       pgoff_t pgoff, bool populate)
+{
+    struct fdca_device *fdev = drm_to_fdca(obj->base.dev);
+    unsigned long addr = vma->vm_start + ((pgoff - vma->vm_pgoff) << PAGE_SHIFT);
+    resource_size_t phys;
+    struct page *page;
+    
+    if (obj->vram_obj) {
+        phys = fdev->vram_base + fdca_vram_object_offset(obj->vram_obj);
+        return vmf_insert_pfn(vma, addr, (phys >> PAGE_SHIFT) + pgoff);
+    }
+    
+    if (!obj->pages)
+        return VM_FAULT_SIGBUS;
+    
+    if (populate) {
+        page = fdca_gem_get_page(obj, pgoff);
+        if (IS_ERR(page))
+            return PTR_ERR(page) == -ENOMEM ? VM_FAULT_OOM : VM_FAULT_SIGBUS;
+    } else {
+        page = obj->pages[pgoff];
+        if (!page)
+            return VM_FAULT_NOPAGE;
+    }
+    
+    return vmf_insert_pfn(vma, addr, page_to_pfn(page));
+}
+
+/**
+ * fdca_gem_fault() - 4KB 缺页处理
+ * @vmf: 缺页信息
+ * 
+ * 先映射故障页，再尽力映射同一窗口内的其余页，窗口按 FDCA_GEM_FAULT_AROUND
+ * 对齐并限制在 VMA 和对象范围内。预映射失败不影响本次缺页结果
+ */
+static vm_fault_t fdca_gem_fault(struct vm_fault *vmf)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    struct drm_gem_object *gem = vma->vm_private_data;
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    struct fdca_device *fdev = drm_to_fdca(gem->dev);
+    pgoff_t num_pages = gem->size >> PAGE_SHIFT;
+    pgoff_t first, last, pgoff;
+    u32 mapped = 1;
+    vm_fault_t ret;
+    
+    if (vmf->pgoff >= num_pages)
+        return VM_FAULT_SIGBUS;
+    
+    first = ALIGN_DOWN(vmf->pgoff, FDCA_GEM_FAULT_AROUND);
+    last = first + FDCA_GEM_FAULT_AROUND;
+    first = max(first, vma->vm_pgoff);
+    last = min3(last, num_pages, vma->vm_pgoff + vma_pages(vma));
+    
+    mutex_lock(&obj->lock);
+    
+    ret = fdca_gem_insert_page(vma, obj, vmf->pgoff, true);
+    if (ret & VM_FAULT_ERROR)
+        goto out_unlock;
+    
+    for (pgoff = first; pgoff < last; pgoff++) {
+        if (pgoff == vmf->pgoff)
+            continue;
+        if (!obj->vram_obj && !obj->pages[pgoff])
+            continue;
+        if (fdca_gem_insert_page(vma, obj, pgoff, false) & VM_FAULT_ERROR)
+            break;
+        mapped++;
+    }
+    
+    fdca_gem_lru_touch(obj);
+    fdca_stats_inc(fdev, gem_faults);
+    fdca_stats_add(fdev, gem_fault_pages, mapped);
+    
+out_unlock:
+    mutex_unlock(&obj->lock);
+    return ret;
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/**
+ * fdca_gem_huge_fault() - 2MB PMD 缺页处理
+ * @vmf: 缺页信息
+ * @order: 请求的映射阶数
+ * 
+ * 仅处理大页 VRAM 对象，且要求 PMD 覆盖的用户地址范围完全落在 VMA 与对象内、
+ * 对应的 BAR 物理地址 2MB 对齐，否则回退到 fdca_gem_fault()
+ */
+static vm_fault_t fdca_gem_huge_fault(struct vm_fault *vmf, unsigned int order)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    struct drm_gem_object *gem = vma->vm_private_data;
+    struct fdca_gem_object *obj = to_fdca_gem(gem);
+    struct fdca_device *fdev = drm_to_fdca(gem->dev);
+    unsigned long haddr = vmf->address & PMD_MASK;
+    pgoff_t pgoff;
+    resource_size_t phys;
+    vm_fault_t ret = VM_FAULT_FALLBACK;
+    
+    if (order != PMD_ORDER)
+        return VM_FAULT_FALLBACK;
+    if (haddr < vma->vm_start || haddr + PMD_SIZE > vma->vm_end)
+        return VM_FAULT_FALLBACK;
+    
+    /* PMD 起始地址对应的对象内页偏移 */
+    pgoff = vma->vm_pgoff + ((haddr - vma->vm_start) >> PAGE_SHIFT);
+    if (pgoff + (PMD_SIZE >> PAGE_SHIFT) > (gem->size >> PAGE_SHIFT))
+        return VM_FAULT_FALLBACK;
+    
+    mutex_lock(&obj->lock);
+    
+    if (obj->mem_type != FDCA_MEM_TYPE_VRAM || !obj->vram_obj ||
+        !fdca_vram_object_is_large(obj->vram_obj))
+        goto out_unlock;
+    
+    phys = fdev->vram_base + fdca_vram_object_offset(obj->vram_obj) +
+           ((resource_size_t)pgoff << PAGE_SHIFT);
+    if (!IS_ALIGNED(phys, PMD_SIZE))
+        goto out_unlock;
+    
+    ret = vmf_insert_pfn_pmd(vmf, pfn_to_pfn_t(phys >> PAGE_SHIFT),
+                             vmf->flags & FAULT_FLAG_WRITE);
+    if (ret == VM_FAULT_NOPAGE)
+        fdca_stats_inc(fdev, gem_huge_faults);
+    
+out_unlock:
+    mutex_unlock(&obj->lock);
+    return ret;
+}
+#endif
+
+static const struct vm_operations_struct fdca_gem_vm_ops = {
+    .fault = fdca_gem_fault,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+    .huge_fault = fdca_gem_huge_fault,
+#endif
+    .open = drm_gem_vm_open,
+    .close = drm_gem_vm_close,
+};
+
 /*
  * ============================================================================
  * 内存统计和监控
@@ -451,6 +2358,7 @@ void fdca_memory_get_total_stats(struct fdca_device *fdev,
     stats->vram_used = vram_stats.used_size;
     stats->vram_available = vram_stats.available_size;
     stats->vram_fragmentation = vram_stats.fragmentation;
+    stats->vram_largest_free = vram_stats.largest_free;
     
     stats->gtt_total = gtt_stats.total_size;
     stats->gtt_used = gtt_stats.used_size;
@@ -491,6 +2399,12 @@ void fdca_memory_print_total_stats(struct fdca_device *fdev)
 static const struct drm_gem_object_funcs fdca_gem_object_funcs = {
     .free = fdca_gem_object_free,
     .print_info = drm_gem_print_info,
+    .export = fdca_gem_prime_export,
+    .pin = fdca_gem_prime_pin,
+    .unpin = fdca_gem_prime_unpin,
+    .get_sg_table = fdca_gem_prime_get_sg_table,
+    .mmap = fdca_gem_object_mmap,
+    .vm_ops = &fdca_gem_vm_ops,
 };
 
 /*
@@ -502,5 +2416,20 @@ static const struct drm_gem_object_funcs fdca_gem_object_funcs = {
 EXPORT_SYMBOL_GPL(fdca_memory_manager_init);
 EXPORT_SYMBOL_GPL(fdca_memory_manager_fini);
 EXPORT_SYMBOL_GPL(fdca_gem_object_create);
+EXPORT_SYMBOL_GPL(fdca_gem_object_bind);
+EXPORT_SYMBOL_GPL(fdca_gem_object_pin);
+EXPORT_SYMBOL_GPL(fdca_gem_object_unpin);
+EXPORT_SYMBOL_GPL(fdca_gem_object_lock);
+EXPORT_SYMBOL_GPL(fdca_gem_object_unlock);
+EXPORT_SYMBOL_GPL(fdca_gem_object_va_lock);
+EXPORT_SYMBOL_GPL(fdca_gem_object_va_unlock);
+EXPORT_SYMBOL_GPL(fdca_gem_object_get_backing);
+EXPORT_SYMBOL_GPL(fdca_gem_object_peek_backing);
+EXPORT_SYMBOL_GPL(fdca_gem_object_get_pages);
+EXPORT_SYMBOL_GPL(fdca_gem_object_revocable);
+EXPORT_SYMBOL_GPL(fdca_gem_object_validate);
+EXPORT_SYMBOL_GPL(fdca_gem_object_readonly);
+EXPORT_SYMBOL_GPL(fdca_gem_userptr_create);
+EXPORT_SYMBOL_GPL(fdca_gem_prime_import);
 EXPORT_SYMBOL_GPL(fdca_memory_get_total_stats);
 EXPORT_SYMBOL_GPL(fdca_memory_print_total_stats);
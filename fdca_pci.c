@@ -427,6 +427,9 @@ static int fdca_pci_probe(struct pci_dev *pdev, const struct pci_device_id *id)
     
     /* 初始化 IDR */
     idr_init(&fdev->ctx_idr);
+    ida_init(&fdev->vm_ida);
+    for (int i = 0; i < FDCA_UNIT_MAX; i++)
+        ida_init(&fdev->units[i].queue_ida);
     
     /* 初始化统计信息 */
     atomic_set(&fdev->ctx_count, 0);
@@ -541,6 +544,7 @@ err_unmap_mmio:
     iounmap(fdev->mmio_base);
 err_free_device:
     idr_destroy(&fdev->ctx_idr);
+    ida_destroy(&fdev->vm_ida);
 err_disable_device:
     pci_disable_device(pdev);
     return ret;
@@ -591,6 +595,9 @@ static void fdca_pci_remove(struct pci_dev *pdev)
     
     /* 清理 IDR */
     idr_destroy(&fdev->ctx_idr);
+    ida_destroy(&fdev->vm_ida);
+    for (int i = 0; i < FDCA_UNIT_MAX; i++)
+        ida_destroy(&fdev->units[i].queue_ida);
     
     /* 禁用 PCI 设备 */
     pci_disable_device(pdev);
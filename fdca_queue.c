@@ -6,164 +6,1215 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/atomic.h>
+#include <linux/module.h>
+#include <linux/interrupt.h>
+#include <linux/uaccess.h>
+#include <linux/dma-mapping.h>
+#include <linux/dma-fence.h>
+#include <linux/mempool.h>
 #include "fdca_drv.h"
 #include "fdca_queue.h"
 
-static struct fdca_queue_manager *cau_queue_mgr = NULL;
-static struct fdca_queue_manager *cfu_queue_mgr = NULL;
+/*
+ * ============================================================================
+ * 硬件环形缓冲区
+ * ============================================================================
+ *
+ * 环形缓冲区操作不持有任何锁:
+ * 1. 生产者通过 cmpxchg 推进 reserve 预留一段连续空间
+ * 2. 各自把命令包直接拷贝到 cmd_buffer 中的预留区域
+ * 3. 按预留顺序依次发布: 等待 tail 到达自己的起点后写门铃并推进 tail
+ *
+ * 经调度器提交时负载在提交 ioctl 中拷贝到提交内存块，1~3 都在依赖满足后
+ * 由 run_job 完成。prepare_job 在环空间不足时让作业等待最早的在途批次，
+ * 因此 run_job 预留时不会等待，已预留的空间也总是属于即将发布的批次
+ *
+ * 每个批次只写一次门铃，head 由完成回收路径根据 fence 页中的完成序号更新，
+ * 回收直接在中断上下文中触发批次 fence
+ */
+
+static bool sim_queue;
+module_param(sim_queue, bool, 0444);
+MODULE_PARM_DESC(sim_queue, "Use software-simulated queue MMIO backend (no hardware required)");
+
+/* 等待发布顺序时的自旋次数上限，超过后睡眠 */
+#define FDCA_RING_COMMIT_SPIN   1024
+
+static inline u32 fdca_ring_mask(struct fdca_queue *queue)
+{
+    return queue->cmd_buffer_size - 1;
+}
+
+static inline u32 fdca_ring_space(struct fdca_queue *queue, u32 reserve)
+{
+    return queue->cmd_buffer_size - (reserve - READ_ONCE(queue->head));
+}
 
-/* CAU 队列操作 */
-static int fdca_cau_submit_cmd(struct fdca_queue_manager *mgr, struct fdca_command *cmd)
+/**
+ * fdca_ring_write() - 向环形缓冲区写入数据 (处理回绕)
+ */
+static void fdca_ring_write(struct fdca_queue *queue, u32 pos,
+                            const void *src, u32 len)
 {
-    /* CAU 队列优化低延迟提交 */
-    cmd->start_time = ktime_get_ns();
-    cmd->status = FDCA_CMD_RUNNING;
+    u32 off = pos & fdca_ring_mask(queue);
+    u32 first = min_t(u32, len, queue->cmd_buffer_size - off);
     
-    /* 移动到运行队列 */
-    list_move_tail(&cmd->list, &mgr->running_cmds);
+    memcpy(queue->cmd_buffer + off, src, first);
+    if (len > first)
+        memcpy(queue->cmd_buffer, src + first, len - first);
+}
+
+/**
+ * fdca_ring_read() - 从环形缓冲区读取数据 (处理回绕)
+ */
+static void fdca_ring_read(struct fdca_queue *queue, u32 pos, void *dst, u32 len)
+{
+    u32 off = pos & fdca_ring_mask(queue);
+    u32 first = min_t(u32, len, queue->cmd_buffer_size - off);
+    
+    memcpy(dst, queue->cmd_buffer + off, first);
+    if (len > first)
+        memcpy(dst + first, queue->cmd_buffer, len - first);
+}
+
+/**
+ * fdca_ring_try_reserve() - 无锁预留环形缓冲区空间，空间不足时不等待
+ * @queue: 硬件队列
+ * @len: 需要的字节数
+ * @start: 输出：预留区域起点
+ *
+ * Return: 0 表示成功，-ENOSPC 表示空间不足
+ */
+static int fdca_ring_try_reserve(struct fdca_queue *queue, u32 len, u32 *start)
+{
+    u32 old;
     
-    /* 立即提交到硬件 */
-    /* TODO: 实际的硬件提交逻辑 */
+    do {
+        old = READ_ONCE(queue->reserve);
+        if (fdca_ring_space(queue, old) < len)
+            return -ENOSPC;
+    } while (cmpxchg(&queue->reserve, old, old + len) != old);
     
+    *start = old;
     return 0;
 }
 
-/* CFU 队列操作 */
-static int fdca_cfu_submit_cmd(struct fdca_queue_manager *mgr, struct fdca_command *cmd)
+/**
+ * fdca_ring_reserve() - 无锁预留环形缓冲区空间
+ * @queue: 硬件队列
+ * @len: 需要的字节数
+ * @start: 输出：预留区域起点
+ *
+ * 空间不足时先尝试回收已完成的批次，仍不足则睡眠等待
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_ring_reserve(struct fdca_queue *queue, u32 len, u32 *start)
 {
-    /* CFU 队列优化高吞吐量 */
-    cmd->start_time = ktime_get_ns();
-    cmd->status = FDCA_CMD_RUNNING;
+    int ret;
+    
+    for (;;) {
+        ret = fdca_ring_try_reserve(queue, len, start);
+        if (ret != -ENOSPC)
+            return ret;
+        
+        fdca_queue_retire(queue);
+        ret = wait_event_interruptible(queue->wait_queue,
+                !READ_ONCE(queue->active) ||
+                fdca_ring_space(queue, READ_ONCE(queue->reserve)) >= len);
+        if (ret)
+            return ret;
+        if (!READ_ONCE(queue->active))
+            return -ENODEV;
+    }
+}
+
+/**
+ * fdca_ring_commit() - 按预留顺序发布批次并写门铃
+ * @queue: 硬件队列
+ * @start: 批次起点
+ * @end: 批次结束位置 (含末尾 FENCE 包)
+ * @fence: 批次完成时触发的 fence，可为 NULL
+ *
+ * 发布顺序串行化后分配批次序号并填写末尾的 FENCE 包
+ *
+ * Return: 批次序号
+ */
+static u32 fdca_ring_commit(struct fdca_queue *queue, u32 start, u32 end,
+                            struct dma_fence *fence)
+{
+    struct fdca_ring_packet pkt;
+    struct fdca_ring_fence *rec;
+    u32 spin = 0, seqno;
+    
+    /* 等待前序生产者发布，tail 必须按预留顺序推进 */
+    while (smp_load_acquire(&queue->tail) != start) {
+        if (++spin < FDCA_RING_COMMIT_SPIN) {
+            cpu_relax();
+            continue;
+        }
+        wait_event(queue->wait_queue, smp_load_acquire(&queue->tail) == start);
+    }
+    
+    /* 发布顺序已串行化，此处对序号和在途数组是单生产者 */
+    seqno = ++queue->seqno;
+    pkt.type = 0;
+    pkt.size = 0;
+    pkt.flags = FDCA_RING_PKT_FENCE | FDCA_RING_PKT_LAST;
+    pkt.seqno = seqno;
+    fdca_ring_write(queue, end - FDCA_RING_FENCE_LEN, &pkt, sizeof(pkt));
+    
+    rec = &queue->inflight[queue->inflight_tail & (queue->inflight_size - 1)];
+    rec->wptr = end;
+    rec->seqno = seqno;
+    rec->fence = fence ? dma_fence_get(fence) : NULL;
+    smp_store_release(&queue->inflight_tail, queue->inflight_tail + 1);
+    
+    /* 命令数据对设备可见后再写门铃，一次门铃覆盖整个批次 */
+    dma_wmb();
+    queue->ops->ring_doorbell(queue, end);
+    atomic64_inc(&queue->doorbell_count);
+    
+    /* 门铃写入后再交出发布权，保证硬件看到的写指针单调递增 */
+    smp_store_release(&queue->tail, end);
     
-    /* 批量处理优化 */
-    list_move_tail(&cmd->list, &mgr->running_cmds);
+    if (wq_has_sleeper(&queue->wait_queue))
+        wake_up_all(&queue->wait_queue);
+    
+    return seqno;
+}
+
+/**
+ * fdca_queue_prepare_batch() - 在提交内存块中生成一批命令包
+ * @queue: 硬件队列
+ * @block: 本次提交的内存块
+ * @cmds: 命令描述符数组 (已拷贝到内核)
+ * @num_cmds: 命令数量
+ * @batch: 输出：待写入环形缓冲区的批次
+ *
+ * 命令负载从用户空间拷贝到内存块中，按环中的格式排列 (不含末尾的
+ * FENCE 包)。此时不占用环形缓冲区，批次由调度器在依赖满足后调用
+ * fdca_queue_write_batch() 写入并发布，提交路径不会等待环空间
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_queue_prepare_batch(struct fdca_queue *queue, struct fdca_arena_block *block,
+                             const struct drm_fdca_command *cmds, u32 num_cmds,
+                             struct fdca_ring_batch *batch)
+{
+    struct fdca_ring_packet pkt;
+    u64 start_ns = ktime_get_ns();
+    u32 total, pos, i;
+    u8 *data;
+    
+    if (!num_cmds || num_cmds > FDCA_SUBMIT_MAX_CMDS)
+        return -EINVAL;
+    
+    /* 计算批次总长度，末尾预留 FENCE 包 */
+    total = FDCA_RING_FENCE_LEN;
+    for (i = 0; i < num_cmds; i++) {
+        if (cmds[i].size > FDCA_SUBMIT_MAX_BYTES)
+            return -EINVAL;
+        total += fdca_ring_packet_len(cmds[i].size);
+        if (total > FDCA_SUBMIT_MAX_BYTES)
+            return -E2BIG;
+    }
+    
+    data = fdca_arena_alloc(block, total - FDCA_RING_FENCE_LEN);
+    if (!data)
+        return -ENOMEM;
+    
+    /* 写入命令包，对齐填充清零 */
+    pos = 0;
+    for (i = 0; i < num_cmds; i++) {
+        pkt.type = cmds[i].type;
+        pkt.size = cmds[i].size;
+        pkt.flags = 0;
+        pkt.seqno = 0;
+        memcpy(data + pos, &pkt, sizeof(pkt));
+        
+        if (copy_from_user(data + pos + sizeof(pkt), u64_to_user_ptr(cmds[i].data_ptr),
+                           cmds[i].size))
+            return -EFAULT;
+        
+        memset(data + pos + sizeof(pkt) + cmds[i].size, 0,
+               fdca_ring_packet_len(cmds[i].size) - sizeof(pkt) - cmds[i].size);
+        pos += fdca_ring_packet_len(cmds[i].size);
+    }
+    
+    batch->data = data;
+    batch->len = total;
+    batch->error = 0;
+    
+    atomic64_add(ktime_get_ns() - start_ns, &queue->submit_ns);
     
     return 0;
 }
 
-/* 通用等待函数 */
-static int fdca_queue_wait_cmd(struct fdca_queue_manager *mgr, u32 cmd_id)
+/**
+ * fdca_queue_space_fence() - 检查环形缓冲区能否容纳批次
+ * @queue: 硬件队列
+ * @len: 批次长度
+ *
+ * 供调度器的 prepare_job 使用。空间不足时返回最早的在途批次 fence，
+ * 它触发时回收路径已推进 head，调度器随后再次检查
+ *
+ * Return: 空间足够时返回 NULL，否则返回带引用的 fence
+ */
+struct dma_fence *fdca_queue_space_fence(struct fdca_queue *queue, u32 len)
 {
-    struct fdca_command *cmd;
+    struct dma_fence *fence = NULL;
+    unsigned long flags;
+    u32 mask = queue->inflight_size - 1;
+    
+    fdca_queue_retire(queue);
+    if (fdca_ring_space(queue, READ_ONCE(queue->reserve)) >= len)
+        return NULL;
+    
+    spin_lock_irqsave(&queue->lock, flags);
+    if (queue->inflight_head != smp_load_acquire(&queue->inflight_tail)) {
+        fence = queue->inflight[queue->inflight_head & mask].fence;
+        if (fence)
+            dma_fence_get(fence);
+    }
+    spin_unlock_irqrestore(&queue->lock, flags);
+    
+    return fence;
+}
+
+/**
+ * fdca_queue_write_batch() - 预留环形缓冲区并写入批次
+ * @queue: 硬件队列
+ * @batch: fdca_queue_prepare_batch() 生成的批次
+ *
+ * 只在调度器的 run_job 中调用，prepare_job 已保证空间足够，不会等待。
+ * batch->error 非 0 时 (依赖失败或提交时出错) 整个区域写为一个 SKIP 包，
+ * 末尾的 FENCE 包照常发布，批次 fence 仍按顺序触发
+ *
+ * Return: 0 表示成功，-ENOSPC 表示空间不足
+ */
+int fdca_queue_write_batch(struct fdca_queue *queue, struct fdca_ring_batch *batch)
+{
+    struct fdca_ring_packet pkt;
+    int ret;
+    
+    ret = fdca_ring_try_reserve(queue, batch->len, &batch->start);
+    if (ret)
+        return ret;
+    
+    batch->end = batch->start + batch->len;
+    
+    if (batch->error) {
+        pkt.type = 0;
+        pkt.size = batch->len - FDCA_RING_FENCE_LEN - sizeof(pkt);
+        pkt.flags = FDCA_RING_PKT_SKIP;
+        pkt.seqno = 0;
+        fdca_ring_write(queue, batch->start, &pkt, sizeof(pkt));
+    } else {
+        fdca_ring_write(queue, batch->start, batch->data,
+                        batch->len - FDCA_RING_FENCE_LEN);
+    }
+    
+    return 0;
+}
+
+/**
+ * fdca_queue_commit_batch() - 发布已写入的批次并写门铃
+ * @queue: 硬件队列
+ * @batch: 批次
+ * @fence: 批次完成时触发的 fence
+ */
+void fdca_queue_commit_batch(struct fdca_queue *queue,
+                             const struct fdca_ring_batch *batch,
+                             struct dma_fence *fence)
+{
+    if (batch->error)
+        dma_fence_set_error(fence, batch->error);
+    
+    fdca_ring_commit(queue, batch->start, batch->end, fence);
+    
+    atomic64_inc(&queue->submit_count);
+    queue->last_activity = ktime_get_boottime_seconds();
+}
+
+/**
+ * fdca_queue_retire() - 回收硬件已完成的批次
+ * @queue: 硬件队列
+ *
+ * 根据 fence 页中的完成序号推进 head，并触发所有已完成批次的 fence。
+ * 只读一致性内存，不访问 MMIO，可在中断上下文和轮询路径中调用
+ */
+void fdca_queue_retire(struct fdca_queue *queue)
+{
+    struct fdca_ring_fence rec;
+    unsigned long flags;
+    u32 seqno, mask = queue->inflight_size - 1;
+    
+    seqno = fdca_queue_completed_seqno(queue);
+    if (seqno == READ_ONCE(queue->retired_seqno))
+        return;
+    
+    /* 用户态提交队列没有内核批次，只记录进度 */
+    if (unlikely(queue->user_mode)) {
+        WRITE_ONCE(queue->retired_seqno, seqno);
+        goto out_wake;
+    }
+    
+    for (;;) {
+        spin_lock_irqsave(&queue->lock, flags);
+        if (queue->inflight_head == smp_load_acquire(&queue->inflight_tail) ||
+            (s32)(queue->inflight[queue->inflight_head & mask].seqno - seqno) > 0) {
+            spin_unlock_irqrestore(&queue->lock, flags);
+            break;
+        }
+        rec = queue->inflight[queue->inflight_head & mask];
+        queue->inflight_head++;
+        WRITE_ONCE(queue->head, rec.wptr);
+        WRITE_ONCE(queue->retired_seqno, rec.seqno);
+        spin_unlock_irqrestore(&queue->lock, flags);
+        
+        if (rec.fence) {
+            dma_fence_signal(rec.fence);
+            dma_fence_put(rec.fence);
+        }
+        atomic64_inc(&queue->complete_count);
+    }
+    
+out_wake:
+    if (wq_has_sleeper(&queue->wait_queue))
+        wake_up_all(&queue->wait_queue);
+}
+
+/*
+ * 硬件后端
+ */
+
+static irqreturn_t fdca_queue_irq_handler(int irq, void *data)
+{
+    struct fdca_queue *queue = data;
+    
+    /* 单元中断在该单元所有队列间共享 */
+    if (fdca_queue_completed_seqno(queue) == READ_ONCE(queue->retired_seqno))
+        return IRQ_NONE;
+    
+    fdca_stats_inc(queue->fdev, total_interrupts);
+    fdca_queue_retire(queue);
+    
+    return IRQ_HANDLED;
+}
+
+static int fdca_hw_queue_init(struct fdca_queue *queue)
+{
+    struct fdca_device *fdev = queue->fdev;
+    
+    queue->mmio_base = fdev->units[queue->unit].mmio_base +
+                       FDCA_QUEUE_MMIO_OFFSET + queue->id * FDCA_QUEUE_MMIO_STRIDE;
+    queue->mmio_size = FDCA_QUEUE_MMIO_STRIDE;
+    queue->irq = fdev->units[queue->unit].irq;
+    
+    writel(lower_32_bits(queue->cmd_buffer_dma), queue->mmio_base + FDCA_QUEUE_REG_BASE_LO);
+    writel(upper_32_bits(queue->cmd_buffer_dma), queue->mmio_base + FDCA_QUEUE_REG_BASE_HI);
+    writel(queue->cmd_buffer_size, queue->mmio_base + FDCA_QUEUE_REG_SIZE);
+    writel(lower_32_bits(queue->fence_dma), queue->mmio_base + FDCA_QUEUE_REG_FENCE_LO);
+    writel(upper_32_bits(queue->fence_dma), queue->mmio_base + FDCA_QUEUE_REG_FENCE_HI);
+    writel(0, queue->mmio_base + FDCA_QUEUE_REG_DOORBELL);
+    writel(FDCA_QUEUE_CTRL_ENABLE, queue->mmio_base + FDCA_QUEUE_REG_CTRL);
+    
+    return request_irq(queue->irq, fdca_queue_irq_handler, IRQF_SHARED,
+                       "fdca-queue", queue);
+}
+
+static void fdca_hw_queue_fini(struct fdca_queue *queue)
+{
+    writel(0, queue->mmio_base + FDCA_QUEUE_REG_CTRL);
+    free_irq(queue->irq, queue);
+}
+
+static void fdca_hw_ring_doorbell(struct fdca_queue *queue, u32 wptr)
+{
+    writel(wptr, queue->mmio_base + FDCA_QUEUE_REG_DOORBELL);
+}
+
+static u32 fdca_hw_get_rptr(struct fdca_queue *queue)
+{
+    return readl(queue->mmio_base + FDCA_QUEUE_REG_RPTR);
+}
+
+static void fdca_hw_queue_reset(struct fdca_queue *queue)
+{
+    writel(0, queue->mmio_base + FDCA_QUEUE_REG_CTRL);
+}
+
+static const struct fdca_queue_ops fdca_hw_queue_ops = {
+    .init = fdca_hw_queue_init,
+    .fini = fdca_hw_queue_fini,
+    .reset = fdca_hw_queue_reset,
+    .ring_doorbell = fdca_hw_ring_doorbell,
+    .get_rptr = fdca_hw_get_rptr,
+};
+
+/*
+ * 软件模拟后端 - 用工作队列模拟设备消费环形缓冲区，
+ * 便于在没有硬件的环境下验证提交路径和测量提交开销
+ */
+
+/**
+ * fdca_queue_sim_consume() - 模拟设备消费 [sim_rptr, wptr) 内的命令包
+ * @queue: 模拟队列
+ * @wptr: 写指针
+ *
+ * 用户态提交队列的写指针来自用户态，需要完整校验
+ *
+ * Return: 0 表示成功，-EINVAL 表示写指针或命令包非法 (读指针停在非法包处)
+ */
+int fdca_queue_sim_consume(struct fdca_queue *queue, u32 wptr)
+{
+    struct fdca_ring_packet pkt;
+    u32 rptr = queue->sim_rptr;
+    u32 len;
     int ret = 0;
     
-    /* 查找命令 */
-    mutex_lock(&mgr->queue_lock);
-    list_for_each_entry(cmd, &mgr->running_cmds, list) {
-        if (cmd->cmd_id == cmd_id) {
-            while (cmd->status == FDCA_CMD_RUNNING) {
-                mutex_unlock(&mgr->queue_lock);
-                wait_event_interruptible(mgr->wait_queue, 
-                                        cmd->status != FDCA_CMD_RUNNING);
-                mutex_lock(&mgr->queue_lock);
-            }
-            ret = (cmd->status == FDCA_CMD_COMPLETED) ? 0 : -EIO;
+    if (wptr - rptr > queue->cmd_buffer_size ||
+        !IS_ALIGNED(wptr, FDCA_QUEUE_PKT_ALIGN))
+        return -EINVAL;
+    
+    while (rptr != wptr) {
+        fdca_ring_read(queue, rptr, &pkt, sizeof(pkt));
+        if (pkt.size > FDCA_SUBMIT_MAX_BYTES ||
+            fdca_ring_packet_len(pkt.size) > wptr - rptr) {
+            ret = -EINVAL;
             break;
         }
+        len = fdca_ring_packet_len(pkt.size);
+        rptr += len;
+        
+        /* 与硬件一致: 前序包全部完成后写 fence 页 */
+        if (pkt.flags & FDCA_RING_PKT_FENCE) {
+            dma_wmb();
+            WRITE_ONCE(*queue->fence_cpu, pkt.seqno);
+        }
     }
-    mutex_unlock(&mgr->queue_lock);
     
+    smp_store_release(&queue->sim_rptr, rptr);
     return ret;
 }
 
+static void fdca_sim_queue_work(struct work_struct *work)
+{
+    struct fdca_queue *queue = container_of(work, struct fdca_queue, sim_work);
+    u32 wptr = READ_ONCE(queue->sim_wptr);
+    
+    if (fdca_queue_sim_consume(queue, wptr)) {
+        fdca_err(queue->fdev, "模拟队列 %u: 非法命令包 (读指针=%u)\n",
+                 queue->id, queue->sim_rptr);
+        smp_store_release(&queue->sim_rptr, wptr);
+    }
+    
+    fdca_queue_retire(queue);
+}
+
+static int fdca_sim_queue_init(struct fdca_queue *queue)
+{
+    INIT_WORK(&queue->sim_work, fdca_sim_queue_work);
+    return 0;
+}
+
+static void fdca_sim_queue_fini(struct fdca_queue *queue)
+{
+    cancel_work_sync(&queue->sim_work);
+}
+
+static void fdca_sim_ring_doorbell(struct fdca_queue *queue, u32 wptr)
+{
+    WRITE_ONCE(queue->sim_wptr, wptr);
+    queue_work(system_highpri_wq, &queue->sim_work);
+}
+
+static u32 fdca_sim_get_rptr(struct fdca_queue *queue)
+{
+    return smp_load_acquire(&queue->sim_rptr);
+}
+
+static const struct fdca_queue_ops fdca_sim_queue_ops = {
+    .init = fdca_sim_queue_init,
+    .fini = fdca_sim_queue_fini,
+    .ring_doorbell = fdca_sim_ring_doorbell,
+    .get_rptr = fdca_sim_get_rptr,
+};
+
+/**
+ * fdca_queue_ban() - 停用挂死的队列并以错误触发所有在途批次
+ * @queue: 硬件队列
+ * @error: 写入在途 fence 的错误码
+ *
+ * 由调度器超时处理调用，之后该队列上的提交返回 -ENODEV
+ */
+void fdca_queue_ban(struct fdca_queue *queue, int error)
+{
+    struct dma_fence *fence;
+    unsigned long flags;
+    u32 mask = queue->inflight_size - 1;
+    
+    WRITE_ONCE(queue->active, false);
+    if (queue->ops->reset)
+        queue->ops->reset(queue);
+    
+    for (;;) {
+        spin_lock_irqsave(&queue->lock, flags);
+        if (queue->inflight_head == smp_load_acquire(&queue->inflight_tail)) {
+            spin_unlock_irqrestore(&queue->lock, flags);
+            break;
+        }
+        fence = queue->inflight[queue->inflight_head & mask].fence;
+        queue->inflight_head++;
+        spin_unlock_irqrestore(&queue->lock, flags);
+        
+        if (fence) {
+            dma_fence_set_error(fence, error);
+            dma_fence_signal(fence);
+            dma_fence_put(fence);
+        }
+    }
+    
+    wake_up_all(&queue->wait_queue);
+}
+
+/**
+ * fdca_queue_set_time_slice() - 设置硬件在单元内各队列间轮转的时间片
+ * @queue: 硬件队列
+ * @time_slice_us: 时间片(微秒)
+ */
+void fdca_queue_set_time_slice(struct fdca_queue *queue, u32 time_slice_us)
+{
+    queue->time_slice_us = time_slice_us;
+    if (!queue->simulated)
+        writel(time_slice_us, queue->mmio_base + FDCA_QUEUE_REG_TSLICE);
+}
+
+/**
+ * fdca_queue_set_user_mode() - 把队列切换为用户态提交
+ * @queue: 新创建、尚未提交过批次的队列
+ * @wptr_dma: 门铃页 DMA 地址
+ *
+ * 硬件从门铃页轮询写指针，不再需要 MMIO 门铃；模拟后端由调用者
+ * 负责轮询并调用 fdca_queue_sim_consume()
+ */
+void fdca_queue_set_user_mode(struct fdca_queue *queue, dma_addr_t wptr_dma)
+{
+    queue->user_mode = true;
+    if (queue->simulated)
+        return;
+    
+    writel(lower_32_bits(wptr_dma), queue->mmio_base + FDCA_QUEUE_REG_WPTR_LO);
+    writel(upper_32_bits(wptr_dma), queue->mmio_base + FDCA_QUEUE_REG_WPTR_HI);
+    writel(FDCA_QUEUE_CTRL_ENABLE | FDCA_QUEUE_CTRL_WPTR_POLL,
+           queue->mmio_base + FDCA_QUEUE_REG_CTRL);
+}
+
+/**
+ * fdca_queue_set_vm() - 把队列绑定到上下文的 GPU 地址空间
+ * @queue: 新创建、尚未提交过批次的队列
+ * @vm: 地址空间，生命周期不短于队列的运行期
+ */
+void fdca_queue_set_vm(struct fdca_queue *queue, struct fdca_vm *vm)
+{
+    dma_addr_t pt_base = fdca_vm_pt_base(vm);
+    
+    if (queue->simulated)
+        return;
+    
+    writel(lower_32_bits(pt_base), queue->mmio_base + FDCA_QUEUE_REG_VM_BASE_LO);
+    writel(upper_32_bits(pt_base), queue->mmio_base + FDCA_QUEUE_REG_VM_BASE_HI);
+    writel(vm->asid, queue->mmio_base + FDCA_QUEUE_REG_VM_ASID);
+}
+
+/**
+ * fdca_queue_create() - 创建硬件队列
+ * @fdev: FDCA 设备
+ * @type: 队列类型
+ *
+ * Return: 队列指针或 ERR_PTR
+ */
+struct fdca_queue *fdca_queue_create(struct fdca_device *fdev, enum fdca_queue_type type)
+{
+    enum fdca_unit_type unit = fdca_queue_type_to_unit(type);
+    struct fdca_queue *queue;
+    u32 max_queues;
+    int ret;
+    
+    if (!sim_queue && !fdev->units[unit].present)
+        return ERR_PTR(-ENODEV);
+    
+    queue = kzalloc(sizeof(*queue), GFP_KERNEL);
+    if (!queue)
+        return ERR_PTR(-ENOMEM);
+    
+    queue->fdev = fdev;
+    queue->type = type;
+    queue->unit = unit;
+    queue->simulated = sim_queue;
+    queue->ops = sim_queue ? &fdca_sim_queue_ops : &fdca_hw_queue_ops;
+    
+    /* 分配硬件队列 ID */
+    max_queues = sim_queue ? FDCA_MAX_QUEUES : fdev->units[unit].num_queues;
+    ret = ida_alloc_max(&fdev->units[unit].queue_ida, max_queues - 1, GFP_KERNEL);
+    if (ret < 0) {
+        fdca_err(fdev, "硬件队列已耗尽: 单元=%d\n", unit);
+        goto err_free_queue;
+    }
+    queue->id = ret;
+    
+    /* 分配环形缓冲区 */
+    queue->cmd_buffer_size = FDCA_QUEUE_RING_SIZE;
+    queue->cmd_buffer = dma_alloc_coherent(fdev->dev, queue->cmd_buffer_size,
+                                           &queue->cmd_buffer_dma, GFP_KERNEL);
+    if (!queue->cmd_buffer) {
+        ret = -ENOMEM;
+        goto err_free_id;
+    }
+    
+    /* 完成序号页 */
+    queue->fence_cpu = dma_alloc_coherent(fdev->dev, PAGE_SIZE,
+                                          &queue->fence_dma, GFP_KERNEL);
+    if (!queue->fence_cpu) {
+        ret = -ENOMEM;
+        goto err_free_ring;
+    }
+    
+    /* 每个批次至少占用一个 FENCE 包，据此确定在途数组容量 */
+    queue->inflight_size = queue->cmd_buffer_size / FDCA_RING_FENCE_LEN;
+    queue->inflight = kvcalloc(queue->inflight_size, sizeof(*queue->inflight),
+                               GFP_KERNEL);
+    if (!queue->inflight) {
+        ret = -ENOMEM;
+        goto err_free_fence;
+    }
+    
+    spin_lock_init(&queue->lock);
+    mutex_init(&queue->submit_lock);
+    init_waitqueue_head(&queue->wait_queue);
+    atomic64_set(&queue->submit_count, 0);
+    atomic64_set(&queue->complete_count, 0);
+    atomic64_set(&queue->doorbell_count, 0);
+    atomic64_set(&queue->submit_ns, 0);
+    queue->create_time_ns = ktime_get_ns();
+    queue->last_activity = ktime_get_boottime_seconds();
+    
+    ret = queue->ops->init(queue);
+    if (ret) {
+        fdca_err(fdev, "队列 %u 初始化失败: %d\n", queue->id, ret);
+        goto err_free_inflight;
+    }
+    
+    queue->active = true;
+    
+    fdca_dbg(fdev, "队列创建: 类型=%d, ID=%u, 环大小=%zu%s\n",
+             type, queue->id, queue->cmd_buffer_size,
+             queue->simulated ? " (模拟)" : "");
+    
+    return queue;
+    
+err_free_inflight:
+    kvfree(queue->inflight);
+err_free_fence:
+    dma_free_coherent(fdev->dev, PAGE_SIZE, queue->fence_cpu, queue->fence_dma);
+err_free_ring:
+    dma_free_coherent(fdev->dev, queue->cmd_buffer_size,
+                      queue->cmd_buffer, queue->cmd_buffer_dma);
+err_free_id:
+    ida_free(&fdev->units[unit].queue_ida, queue->id);
+err_free_queue:
+    kfree(queue);
+    return ERR_PTR(ret);
+}
+
+/**
+ * fdca_queue_destroy() - 销毁硬件队列
+ * @queue: 硬件队列
+ *
+ * 未完成批次的 fence 会被直接触发，避免等待者永久阻塞
+ */
+void fdca_queue_destroy(struct fdca_queue *queue)
+{
+    struct fdca_device *fdev;
+    u32 mask;
+    
+    if (!queue)
+        return;
+    
+    fdev = queue->fdev;
+    mask = queue->inflight_size - 1;
+    
+    WRITE_ONCE(queue->active, false);
+    wake_up_all(&queue->wait_queue);
+    
+    queue->ops->fini(queue);
+    
+    while (queue->inflight_head != queue->inflight_tail) {
+        struct dma_fence *fence = queue->inflight[queue->inflight_head & mask].fence;
+        
+        if (fence) {
+            dma_fence_set_error(fence, -ECANCELED);
+            dma_fence_signal(fence);
+            dma_fence_put(fence);
+        }
+        queue->inflight_head++;
+    }
+    
+    fdca_dbg(fdev, "队列销毁: ID=%u, 提交 %lld, 完成 %lld, 门铃 %lld\n",
+             queue->id, atomic64_read(&queue->submit_count),
+             atomic64_read(&queue->complete_count),
+             atomic64_read(&queue->doorbell_count));
+    
+    kvfree(queue->inflight);
+    dma_free_coherent(fdev->dev, PAGE_SIZE, queue->fence_cpu, queue->fence_dma);
+    dma_free_coherent(fdev->dev, queue->cmd_buffer_size,
+                      queue->cmd_buffer, queue->cmd_buffer_dma);
+    ida_free(&fdev->units[queue->unit].queue_ida, queue->id);
+    kfree(queue);
+}
+
+/*
+ * ============================================================================
+ * 内核命令描述符
+ * ============================================================================
+ *
+ * 描述符来自专用 slab，并以 mempool 保留少量对象，内存紧张时内核命令
+ * (迁移、回收) 仍能下发。不超过 FDCA_CMD_INLINE_BYTES 的负载内联在
+ * 描述符中，常见的短命令一次分配都不需要
+ */
+
+static struct kmem_cache *fdca_cmd_cache;
+static mempool_t *fdca_cmd_pool;
+
+/**
+ * fdca_command_cache_init() - 创建命令描述符 slab 和 mempool
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_command_cache_init(void)
+{
+    fdca_cmd_cache = KMEM_CACHE(fdca_command, SLAB_HWCACHE_ALIGN);
+    if (!fdca_cmd_cache)
+        return -ENOMEM;
+    
+    fdca_cmd_pool = mempool_create_slab_pool(FDCA_CMD_POOL_MIN, fdca_cmd_cache);
+    if (!fdca_cmd_pool) {
+        kmem_cache_destroy(fdca_cmd_cache);
+        fdca_cmd_cache = NULL;
+        return -ENOMEM;
+    }
+    
+    return 0;
+}
+
+/**
+ * fdca_command_cache_fini() - 销毁命令描述符 slab 和 mempool
+ */
+void fdca_command_cache_fini(void)
+{
+    mempool_destroy(fdca_cmd_pool);
+    kmem_cache_destroy(fdca_cmd_cache);
+    fdca_cmd_pool = NULL;
+    fdca_cmd_cache = NULL;
+}
+
+/**
+ * fdca_command_alloc() - 分配内核命令并拷贝负载
+ * @type: 命令类型
+ * @data: 负载，可为 NULL (调用者之后自行填写 cmd->data)
+ * @size: 负载字节数
+ * @gfp: 分配标志
+ *
+ * 可睡眠的 @gfp 下描述符分配不会失败 (mempool)，只有超出内联长度的
+ * 负载可能失败
+ *
+ * Return: 命令指针，失败返回 NULL
+ */
+struct fdca_command *fdca_command_alloc(u32 type, const void *data, size_t size,
+                                        gfp_t gfp)
+{
+    struct fdca_command *cmd;
+    
+    if (size > FDCA_SUBMIT_MAX_BYTES - sizeof(struct fdca_ring_packet))
+        return NULL;
+    
+    cmd = mempool_alloc(fdca_cmd_pool, gfp);
+    if (!cmd)
+        return NULL;
+    
+    memset(cmd, 0, offsetof(struct fdca_command, inline_data));
+    cmd->type = type;
+    cmd->data_size = size;
+    
+    if (size <= FDCA_CMD_INLINE_BYTES) {
+        cmd->data = cmd->inline_data;
+    } else {
+        cmd->data = kvmalloc(size, gfp);
+        if (!cmd->data) {
+            mempool_free(cmd, fdca_cmd_pool);
+            return NULL;
+        }
+    }
+    
+    if (data)
+        memcpy(cmd->data, data, size);
+    
+    return cmd;
+}
+
+/**
+ * fdca_command_free() - 释放内核命令
+ * @cmd: 命令 (必须已完成或从未提交)
+ */
+void fdca_command_free(struct fdca_command *cmd)
+{
+    if (!cmd)
+        return;
+    
+    if (cmd->data != cmd->inline_data)
+        kvfree(cmd->data);
+    mempool_free(cmd, fdca_cmd_pool);
+}
+
+/*
+ * ============================================================================
+ * 内核命令队列管理器
+ * ============================================================================
+ *
+ * 每个设备、每个计算单元一个管理器，独占一个硬件队列:
+ * 1. 任意数量的提交者通过 llist 无锁入队，不持有任何锁
+ * 2. 单个消费者 (工作项，不会并发执行) 一次取走全部待提交命令，
+ *    按提交顺序打包为批次写入环形缓冲区，每批只写一次门铃
+ * 3. 每批末尾的 FENCE 包携带队列序号，硬件完成后写入 fence 页；
+ *    等待者只需比较命令的批次序号与 fence 页即可判断完成 (O(1))，
+ *    已完成的命令在运行链表头部按序号批量回收，不为每批创建 fence
+ *
+ * CAU 管理器在高优先级工作队列上消费以降低延迟，CFU 管理器在
+ * unbound 工作队列上消费，积累更大的批次
+ */
+
+static inline bool fdca_cmd_done(struct fdca_command *cmd)
+{
+    return smp_load_acquire(&cmd->status) >= FDCA_CMD_COMPLETED;
+}
+
+/**
+ * fdca_cmd_complete() - 完成一条命令
+ *
+ * 状态写入之后提交者可能立即释放命令，之后不能再访问 cmd
+ */
+static void fdca_cmd_complete(struct fdca_queue_manager *mgr,
+                              struct fdca_command *cmd, int error)
+{
+    cmd->end_time = ktime_get_ns();
+    if (error)
+        atomic64_inc(&mgr->failed_cmds);
+    else
+        atomic64_inc(&mgr->completed_cmds);
+    smp_store_release(&cmd->status, error ? FDCA_CMD_ERROR : FDCA_CMD_COMPLETED);
+}
+
+/**
+ * fdca_queue_mgr_retire() - 批量回收已完成的命令
+ * @mgr: 队列管理器
+ *
+ * 运行链表按序号递增，从头部摘下序号不超过 fence 页完成序号的全部命令。
+ * 队列被禁用 (超时复位、销毁) 时剩余命令全部以错误结束
+ */
+static void fdca_queue_mgr_retire(struct fdca_queue_manager *mgr)
+{
+    struct fdca_queue *queue = mgr->queue;
+    struct fdca_command *cmd, *tmp;
+    bool active = READ_ONCE(queue->active);
+    u32 done = fdca_queue_completed_seqno(queue);
+    unsigned long flags;
+    LIST_HEAD(list);
+    
+    spin_lock_irqsave(&mgr->running_lock, flags);
+    list_for_each_entry_safe(cmd, tmp, &mgr->running_cmds, list) {
+        if (active && (s32)(cmd->seqno - done) > 0)
+            break;
+        list_move_tail(&cmd->list, &list);
+    }
+    spin_unlock_irqrestore(&mgr->running_lock, flags);
+    
+    list_for_each_entry_safe(cmd, tmp, &list, list) {
+        bool passed = (s32)(cmd->seqno - done) <= 0;
+        
+        fdca_cmd_complete(mgr, cmd, passed ? 0 : -ENODEV);
+    }
+}
+
+/**
+ * fdca_cmd_poll() - 等待条件: 回收已完成命令后检查 @cmd 状态
+ */
+static bool fdca_cmd_poll(struct fdca_queue_manager *mgr, struct fdca_command *cmd)
+{
+    enum fdca_cmd_status status = smp_load_acquire(&cmd->status);
+    
+    if (status >= FDCA_CMD_COMPLETED)
+        return true;
+    
+    /* 尚未下发或批次未完成时只比较序号，不获取锁 */
+    if (READ_ONCE(mgr->queue->active) &&
+        (status == FDCA_CMD_PENDING || !fdca_queue_seqno_passed(mgr->queue, cmd->seqno)))
+        return false;
+    
+    fdca_queue_mgr_retire(mgr);
+    return fdca_cmd_done(cmd);
+}
+
+/**
+ * fdca_queue_mgr_flush() - 把一段命令链写成一个批次并发布
+ * @mgr: 队列管理器
+ * @node: 按提交顺序排列的命令链起点
+ *
+ * Return: 未写入本批次的剩余命令链
+ */
+static struct llist_node *fdca_queue_mgr_flush(struct fdca_queue_manager *mgr,
+                                               struct llist_node *node)
+{
+    struct fdca_queue *queue = mgr->queue;
+    struct fdca_command *cmd, *tmp;
+    struct fdca_ring_packet pkt;
+    struct llist_node *rest = node;
+    u32 total = FDCA_RING_FENCE_LEN, count = 0, len, start, pos, seqno;
+    unsigned long flags;
+    LIST_HEAD(cmds);
+    int ret;
+    
+    /* 按批次上限切分 */
+    while (rest && count < FDCA_SUBMIT_MAX_CMDS) {
+        cmd = llist_entry(rest, struct fdca_command, node);
+        len = fdca_ring_packet_len(cmd->data_size);
+        if (count && total + len > FDCA_SUBMIT_MAX_BYTES)
+            break;
+        total += len;
+        count++;
+        rest = rest->next;
+        list_add_tail(&cmd->list, &cmds);
+    }
+    
+    ret = fdca_ring_reserve(queue, total, &start);
+    if (ret)
+        goto err_fail;
+    
+    /* 管理器独占该队列，下一次发布的序号可以预知 */
+    seqno = READ_ONCE(queue->seqno) + 1;
+    
+    /* 单消费者，命令 ID 即下发顺序 */
+    pos = start;
+    list_for_each_entry(cmd, &cmds, list) {
+        cmd->cmd_id = ++mgr->last_id;
+        cmd->seqno = seqno;
+        cmd->start_time = ktime_get_ns();
+        smp_store_release(&cmd->status, FDCA_CMD_RUNNING);
+        
+        pkt.type = cmd->type;
+        pkt.size = cmd->data_size;
+        pkt.flags = 0;
+        pkt.seqno = 0;
+        fdca_ring_write(queue, pos, &pkt, sizeof(pkt));
+        fdca_ring_write(queue, pos + sizeof(pkt), cmd->data, cmd->data_size);
+        pos += fdca_ring_packet_len(cmd->data_size);
+    }
+    
+    /* 先入运行链表再发布，发布后批次随时可能完成 */
+    spin_lock_irqsave(&mgr->running_lock, flags);
+    list_splice_tail(&cmds, &mgr->running_cmds);
+    spin_unlock_irqrestore(&mgr->running_lock, flags);
+    
+    WARN_ON_ONCE(fdca_ring_commit(queue, start, start + total, NULL) != seqno);
+    atomic64_inc(&queue->submit_count);
+    atomic64_inc(&mgr->drained_batches);
+    
+    return rest;
+    
+err_fail:
+    list_for_each_entry_safe(cmd, tmp, &cmds, list) {
+        list_del(&cmd->list);
+        fdca_cmd_complete(mgr, cmd, ret);
+    }
+    wake_up_all(&queue->wait_queue);
+    return rest;
+}
+
+/**
+ * fdca_queue_mgr_submit_work() - 单消费者: 取走全部待提交命令并下发
+ */
+static void fdca_queue_mgr_submit_work(struct work_struct *work)
+{
+    struct fdca_queue_manager *mgr =
+        container_of(work, struct fdca_queue_manager, submit_work);
+    struct llist_node *node;
+    
+    /* 顺带回收无人等待的已完成命令 */
+    fdca_queue_mgr_retire(mgr);
+    
+    /* llist 为后进先出，反转后恢复提交顺序 */
+    node = llist_reverse_order(llist_del_all(&mgr->pending));
+    while (node)
+        node = fdca_queue_mgr_flush(mgr, node);
+}
+
 /**
  * fdca_queue_manager_init() - 初始化队列管理器
+ * @fdev: FDCA 设备
+ * @type: 计算单元
+ *
+ * Return: 0 表示成功，负数表示错误
  */
-int fdca_queue_manager_init(struct fdca_device *fdev, enum fdca_queue_type type)
+int fdca_queue_manager_init(struct fdca_device *fdev, enum fdca_unit_type type)
 {
     struct fdca_queue_manager *mgr;
+    struct fdca_queue *queue;
+    
+    if (type != FDCA_UNIT_CAU && type != FDCA_UNIT_CFU)
+        return -EINVAL;
     
     mgr = kzalloc(sizeof(*mgr), GFP_KERNEL);
     if (!mgr)
         return -ENOMEM;
     
+    queue = fdca_queue_create(fdev, type == FDCA_UNIT_CAU ?
+                              FDCA_QUEUE_CAU_COMPUTE : FDCA_QUEUE_CFU_VECTOR);
+    if (IS_ERR(queue)) {
+        kfree(mgr);
+        return PTR_ERR(queue);
+    }
+    
     mgr->fdev = fdev;
     mgr->type = type;
+    mgr->queue = queue;
+    mgr->wq = (type == FDCA_UNIT_CAU) ? system_highpri_wq : system_unbound_wq;
     
-    INIT_LIST_HEAD(&mgr->pending_cmds);
+    init_llist_head(&mgr->pending);
+    INIT_WORK(&mgr->submit_work, fdca_queue_mgr_submit_work);
     INIT_LIST_HEAD(&mgr->running_cmds);
-    mutex_init(&mgr->queue_lock);
-    init_waitqueue_head(&mgr->wait_queue);
+    spin_lock_init(&mgr->running_lock);
     
     atomic64_set(&mgr->submitted_cmds, 0);
     atomic64_set(&mgr->completed_cmds, 0);
     atomic64_set(&mgr->failed_cmds, 0);
+    atomic64_set(&mgr->drained_batches, 0);
     
-    /* 设置类型特定的操作 */
-    switch (type) {
-    case FDCA_QUEUE_CAU:
-        mgr->submit_cmd = fdca_cau_submit_cmd;
-        cau_queue_mgr = mgr;
-        break;
-    case FDCA_QUEUE_CFU:
-        mgr->submit_cmd = fdca_cfu_submit_cmd;
-        cfu_queue_mgr = mgr;
-        break;
-    default:
-        kfree(mgr);
-        return -EINVAL;
-    }
-    
-    mgr->wait_cmd = fdca_queue_wait_cmd;
+    fdev->queue_mgrs[type] = mgr;
     
-    fdca_info(fdev, "%s 队列管理器初始化完成\n", 
-              (type == FDCA_QUEUE_CAU) ? "CAU" : "CFU");
+    fdca_info(fdev, "%s 队列管理器初始化完成: 硬件队列 %u\n",
+              (type == FDCA_UNIT_CAU) ? "CAU" : "CFU", queue->id);
     
     return 0;
 }
 
 /**
  * fdca_queue_manager_fini() - 清理队列管理器
+ *
+ * 未完成的命令以错误结束
  */
-void fdca_queue_manager_fini(struct fdca_device *fdev, enum fdca_queue_type type)
+void fdca_queue_manager_fini(struct fdca_device *fdev, enum fdca_unit_type type)
 {
-    struct fdca_queue_manager *mgr = (type == FDCA_QUEUE_CAU) ? cau_queue_mgr : cfu_queue_mgr;
+    struct fdca_queue_manager *mgr = fdev->queue_mgrs[type];
     
     if (!mgr)
         return;
     
-    fdca_info(fdev, "%s 队列统计: 提交 %lld, 完成 %lld, 失败 %lld\n",
-              (type == FDCA_QUEUE_CAU) ? "CAU" : "CFU",
+    fdev->queue_mgrs[type] = NULL;
+    flush_work(&mgr->submit_work);
+    
+    /* 队列禁用后剩余命令全部以错误结束 */
+    WRITE_ONCE(mgr->queue->active, false);
+    fdca_queue_mgr_retire(mgr);
+    fdca_queue_destroy(mgr->queue);
+    
+    fdca_info(fdev, "%s 队列统计: 提交 %lld, 完成 %lld, 失败 %lld, 批次 %lld\n",
+              (type == FDCA_UNIT_CAU) ? "CAU" : "CFU",
               atomic64_read(&mgr->submitted_cmds),
               atomic64_read(&mgr->completed_cmds),
-              atomic64_read(&mgr->failed_cmds));
+              atomic64_read(&mgr->failed_cmds),
+              atomic64_read(&mgr->drained_batches));
     
     kfree(mgr);
-    
-    if (type == FDCA_QUEUE_CAU)
-        cau_queue_mgr = NULL;
-    else
-        cfu_queue_mgr = NULL;
 }
 
 /**
- * fdca_queue_submit_command() - 提交命令到队列
+ * fdca_queue_submit_command() - 提交内核命令
+ * @fdev: FDCA 设备
+ * @type: 计算单元
+ * @cmd: 命令 (完成前由调用者保持有效)
+ *
+ * 只做一次无锁入队，由消费者批量下发
+ *
+ * Return: 0 表示成功，负数表示错误
  */
-int fdca_queue_submit_command(struct fdca_device *fdev, enum fdca_queue_type type,
+int fdca_queue_submit_command(struct fdca_device *fdev, enum fdca_unit_type type,
                              struct fdca_command *cmd)
 {
-    struct fdca_queue_manager *mgr = (type == FDCA_QUEUE_CAU) ? cau_queue_mgr : cfu_queue_mgr;
-    int ret;
+    struct fdca_queue_manager *mgr;
     
-    if (!mgr || !cmd)
+    if (type >= FDCA_UNIT_MAX || !cmd)
         return -EINVAL;
     
+    mgr = fdev->queue_mgrs[type];
+    if (!mgr)
+        return -ENODEV;
+    
+    if (cmd->data_size > FDCA_SUBMIT_MAX_BYTES - sizeof(struct fdca_ring_packet))
+        return -E2BIG;
+    
     cmd->submit_time = ktime_get_ns();
     cmd->status = FDCA_CMD_PENDING;
-    
-    mutex_lock(&mgr->queue_lock);
-    list_add_tail(&cmd->list, &mgr->pending_cmds);
     atomic64_inc(&mgr->submitted_cmds);
     
-    /* 立即尝试提交 */
-    ret = mgr->submit_cmd(mgr, cmd);
+    /* 链表由空变为非空时才需要唤醒消费者 */
+    if (llist_add(&cmd->node, &mgr->pending))
+        queue_work(mgr->wq, &mgr->submit_work);
+    
+    return 0;
+}
+
+/**
+ * fdca_queue_wait_command() - 等待内核命令完成
+ * @fdev: FDCA 设备
+ * @type: 计算单元
+ * @cmd: 已提交的命令
+ *
+ * Return: 0 表示成功完成，-EIO 表示执行失败，其他负数表示错误
+ */
+int fdca_queue_wait_command(struct fdca_device *fdev, enum fdca_unit_type type,
+                            struct fdca_command *cmd)
+{
+    struct fdca_queue_manager *mgr;
+    int ret;
+    
+    if (type >= FDCA_UNIT_MAX || !cmd)
+        return -EINVAL;
     
-    mutex_unlock(&mgr->queue_lock);
+    mgr = fdev->queue_mgrs[type];
+    if (!mgr)
+        return -ENODEV;
     
-    return ret;
+    ret = wait_event_interruptible(mgr->queue->wait_queue, fdca_cmd_poll(mgr, cmd));
+    if (ret)
+        return ret;
+    
+    return (cmd->status == FDCA_CMD_COMPLETED) ? 0 : -EIO;
 }
 
 EXPORT_SYMBOL_GPL(fdca_queue_manager_init);
 EXPORT_SYMBOL_GPL(fdca_queue_manager_fini);
+EXPORT_SYMBOL_GPL(fdca_command_alloc);
+EXPORT_SYMBOL_GPL(fdca_command_free);
 EXPORT_SYMBOL_GPL(fdca_queue_submit_command);
 EXPORT_SYMBOL_GPL(fdca_queue_wait_command);
+EXPORT_SYMBOL_GPL(fdca_queue_create);
+EXPORT_SYMBOL_GPL(fdca_queue_destroy);
+EXPORT_SYMBOL_GPL(fdca_queue_prepare_batch);
+EXPORT_SYMBOL_GPL(fdca_queue_space_fence);
+EXPORT_SYMBOL_GPL(fdca_queue_write_batch);
+EXPORT_SYMBOL_GPL(fdca_queue_commit_batch);
+EXPORT_SYMBOL_GPL(fdca_queue_retire);
+EXPORT_SYMBOL_GPL(fdca_queue_ban);
+EXPORT_SYMBOL_GPL(fdca_queue_set_time_slice);
+EXPORT_SYMBOL_GPL(fdca_queue_set_user_mode);
+EXPORT_SYMBOL_GPL(fdca_queue_sim_consume);
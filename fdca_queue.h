@@ -9,12 +9,20 @@
 #include <linux/types.h>
 #include <linux/mutex.h>
 #include <linux/wait.h>
+#include <linux/llist.h>
+#include <linux/kref.h>
+#include <linux/refcount.h>
+#include <linux/sizes.h>
 
-/* 队列类型 */
-enum fdca_queue_type {
-    FDCA_QUEUE_CAU,     /* 上下文相关队列 (访存优化) */
-    FDCA_QUEUE_CFU,     /* 上下文无关队列 (计算优化) */
-};
+#include <drm/gpu_scheduler.h>
+
+#include "fdca_drv.h"
+#include "fdca_uapi.h"
+
+/*
+ * 队列管理器按计算单元区分 (enum fdca_unit_type):
+ * CAU 队列针对低延迟访存，CFU 队列针对高吞吐计算
+ */
 
 /* 命令状态 */
 enum fdca_cmd_status {
@@ -24,45 +32,314 @@ enum fdca_cmd_status {
     FDCA_CMD_ERROR,
 };
 
-/* 命令描述符 */
+/* 不超过该长度的负载内联在描述符中，避免单独分配 */
+#define FDCA_CMD_INLINE_BYTES       64
+
+/* 描述符 mempool 最少保留数，保证内存回收路径上的命令能够下发 */
+#define FDCA_CMD_POOL_MIN           16
+
+/**
+ * struct fdca_command - 内核命令描述符
+ *
+ * 由 fdca_command_alloc() 从专用 slab 分配，释放使用 fdca_command_free()
+ */
 struct fdca_command {
-    struct list_head list;
-    u32 cmd_id;
+    struct llist_node node;         /* 待提交链表节点 (无锁入队) */
+    struct list_head list;          /* 运行链表节点 */
+    u32 cmd_id;                     /* 下发顺序 ID，由消费者分配 */
+    u32 seqno;                      /* 所在批次的队列序号，下发后有效 */
+    u32 type;                       /* 命令类型 (写入包头) */
     enum fdca_cmd_status status;
     void *data;
     size_t data_size;
     u64 submit_time;
     u64 start_time;
     u64 end_time;
+    u8 inline_data[FDCA_CMD_INLINE_BYTES] __aligned(8);
 };
 
-/* 队列管理器 */
+/**
+ * struct fdca_queue_manager - 内核命令队列管理器
+ * 
+ * 每设备每计算单元一个，多生产者无锁入队，单消费者下发到独占的硬件队列
+ */
 struct fdca_queue_manager {
     struct fdca_device *fdev;
-    enum fdca_queue_type type;
+    enum fdca_unit_type type;
+    struct fdca_queue *queue;       /* 独占的硬件队列 */
     
-    /* 队列状态 */
-    struct list_head pending_cmds;
-    struct list_head running_cmds;
-    struct mutex queue_lock;
-    wait_queue_head_t wait_queue;
+    /* 提交: MPSC */
+    struct llist_head pending;      /* 待提交命令 (后进先出) */
+    struct work_struct submit_work; /* 单消费者 */
+    struct workqueue_struct *wq;    /* 消费者所在工作队列 */
+    u32 last_id;                    /* 最后下发的命令 ID (仅消费者访问) */
+    
+    /* 完成 - 按队列序号批量回收 */
+    struct list_head running_cmds;  /* 已下发未完成的命令，按序号递增 */
+    spinlock_t running_lock;        /* 保护 running_cmds */
     
     /* 统计信息 */
     atomic64_t submitted_cmds;
     atomic64_t completed_cmds;
     atomic64_t failed_cmds;
+    atomic64_t drained_batches;     /* 下发批次数 */
+};
+
+/*
+ * ============================================================================
+ * 硬件环形缓冲区
+ * ============================================================================
+ */
+
+/* 队列 MMIO 布局: 每个硬件队列在所属单元 BAR 中占用一个寄存器窗口 */
+#define FDCA_QUEUE_MMIO_OFFSET      0x1000  /* 队列寄存器窗口起始偏移 */
+#define FDCA_QUEUE_MMIO_STRIDE      0x100   /* 每个队列窗口大小 */
+#define FDCA_QUEUE_REG_BASE_LO      0x00    /* 环形缓冲区基址低 32 位 */
+#define FDCA_QUEUE_REG_BASE_HI      0x04    /* 环形缓冲区基址高 32 位 */
+#define FDCA_QUEUE_REG_SIZE         0x08    /* 环形缓冲区大小 */
+#define FDCA_QUEUE_REG_RPTR         0x0C    /* 硬件读指针 */
+#define FDCA_QUEUE_REG_DOORBELL     0x10    /* 门铃: 写入新的写指针 */
+#define FDCA_QUEUE_REG_CTRL         0x14    /* 队列控制 */
+#define FDCA_QUEUE_REG_TSLICE       0x18    /* 单元内队列轮转时间片(微秒) */
+#define FDCA_QUEUE_REG_FENCE_LO     0x1C    /* fence 页地址低 32 位 */
+#define FDCA_QUEUE_REG_FENCE_HI     0x20    /* fence 页地址高 32 位 */
+#define FDCA_QUEUE_REG_WPTR_LO      0x24    /* 门铃页地址低 32 位 (轮询写指针) */
+#define FDCA_QUEUE_REG_WPTR_HI      0x28    /* 门铃页地址高 32 位 */
+#define FDCA_QUEUE_REG_VM_BASE_LO   0x2C    /* 上下文 L0 页表地址低 32 位 */
+#define FDCA_QUEUE_REG_VM_BASE_HI   0x30    /* 上下文 L0 页表地址高 32 位 */
+#define FDCA_QUEUE_REG_VM_ASID      0x34    /* 上下文地址空间 ID */
+
+#define FDCA_QUEUE_CTRL_ENABLE      BIT(0)  /* 启用队列 */
+#define FDCA_QUEUE_CTRL_WPTR_POLL   BIT(1)  /* 从门铃页轮询写指针，代替 MMIO 门铃 */
+
+/* 环形缓冲区配置 */
+#define FDCA_QUEUE_RING_SIZE        (64 << 10)  /* 64KB，必须为 2 的幂 */
+#define FDCA_QUEUE_PKT_ALIGN        8           /* 命令包对齐 */
+#define FDCA_SUBMIT_MAX_CMDS        256         /* 单次提交最大命令数 */
+#define FDCA_SUBMIT_MAX_BYTES       (FDCA_QUEUE_RING_SIZE / 2) /* 单批次上限 */
+
+/* 命令包标志 */
+#define FDCA_RING_PKT_SKIP          BIT(0)  /* 硬件跳过该包 (填充/拷贝失败) */
+#define FDCA_RING_PKT_LAST          BIT(1)  /* 批次最后一个包，完成后触发中断 */
+#define FDCA_RING_PKT_FENCE         BIT(2)  /* 前序包完成后把 seqno 写入 fence 页 */
+
+/**
+ * struct fdca_ring_packet - 环形缓冲区命令包头
+ *
+ * 每条 drm_fdca_command 在环中编码为包头 + 负载，整体按 8 字节对齐
+ */
+struct fdca_ring_packet {
+    u32 type;                       /* 命令类型 (drm_fdca_command.type) */
+    u32 size;                       /* 负载字节数 */
+    u32 flags;                      /* 包标志 */
+    u32 seqno;                      /* FENCE 包: 写入 fence 页的序号，其他包为 0 */
+};
+
+/* 每个批次以一个 FENCE 包结尾，由发布路径填写序号 */
+#define FDCA_RING_FENCE_LEN         sizeof(struct fdca_ring_packet)
+
+/**
+ * struct fdca_ring_fence - 在途批次记录
+ */
+struct fdca_ring_fence {
+    u32 wptr;                       /* 批次结束位置 */
+    u32 seqno;                      /* 批次序号 */
+    struct dma_fence *fence;        /* 批次完成 fence (队列持有引用)，可为 NULL */
+};
+
+/**
+ * struct fdca_ring_batch - 等待写入环形缓冲区并发布的批次
+ */
+struct fdca_ring_batch {
+    void *data;                     /* 命令包 (位于提交内存块，不含 FENCE 包) */
+    u32 len;                        /* 环中占用的长度 (含 FENCE 包) */
+    u32 start;                      /* 批次起点，写入后有效 */
+    u32 end;                        /* 批次结束位置，写入后有效 */
+    int error;                      /* 非 0 时以 SKIP 包发布 */
+};
+
+/**
+ * struct fdca_job - 调度器作业
+ * 
+ * 批次在提交 ioctl 中生成，依赖满足且环空间足够后由 run_job 写入并发布
+ */
+struct fdca_job {
+    struct drm_sched_job base;      /* 调度器作业 */
+    struct fdca_arena_block *block; /* 作业所在的提交内存块 */
+    struct fdca_context *ctx;       /* 所属上下文 (持有引用，队列随之有效) */
+    struct fdca_queue *queue;       /* 目标硬件队列 */
+    struct fdca_ring_batch batch;   /* 环中位置 */
+    struct dma_fence *fence;        /* 硬件完成 fence */
+    u64 queued_ns;                  /* 入队时间 */
     
-    /* 队列特定操作 */
-    int (*submit_cmd)(struct fdca_queue_manager *mgr, struct fdca_command *cmd);
-    int (*wait_cmd)(struct fdca_queue_manager *mgr, u32 cmd_id);
-    void (*cleanup)(struct fdca_queue_manager *mgr);
+    /* 引用的 GEM 对象，作业释放时解除固定 */
+    struct drm_gem_object **bos;    /* 位于提交内存块 */
+    u32 num_bos;                    /* 已固定的对象数 */
 };
 
+/*
+ * 提交内存池
+ *
+ * 每个上下文缓存若干固定大小的内存块，一次提交的作业、命令描述符、
+ * 依赖数组和 syncobj 数组都从同一块中顺序切分，作业释放时整块归还
+ */
+#define FDCA_ARENA_BLOCK_SIZE       SZ_16K
+#define FDCA_ARENA_MAX_CACHED       8       /* 每上下文缓存的空闲块上限 */
+
+/**
+ * struct fdca_submit_arena - 上下文提交内存池
+ *
+ * 独立引用计数: 上下文和每个借出的块各持有一个引用，上下文释放后
+ * 仍在调度器中的作业归还块时才真正释放
+ */
+struct fdca_submit_arena {
+    struct kref ref;
+    spinlock_t lock;                /* 保护 free_blocks */
+    struct list_head free_blocks;   /* 空闲块 */
+    u32 num_free;
+    
+    /* 统计信息 */
+    atomic64_t block_allocs;        /* 新分配的块 */
+    atomic64_t block_reuses;        /* 复用的块 */
+    atomic64_t overflows;           /* 超出块容量的单独分配 */
+};
+
+/**
+ * struct fdca_arena_block - 提交内存块
+ *
+ * 提交 ioctl 和作业各持有一个引用，作业可能在 ioctl 返回前完成
+ */
+struct fdca_arena_block {
+    struct list_head node;          /* 空闲链表节点 */
+    struct fdca_submit_arena *arena;
+    refcount_t users;
+    struct list_head overflow;      /* 超出容量的单独分配，归还时释放 */
+    u32 used;                       /* 已切分字节数 */
+    u32 allocs;                     /* 本次提交发生的分配次数 */
+    u8 data[] __aligned(8);
+};
+
+#define FDCA_ARENA_BLOCK_DATA \
+    (FDCA_ARENA_BLOCK_SIZE - sizeof(struct fdca_arena_block))
+
+/*
+ * 用户态提交队列
+ *
+ * 上下文独占一个硬件队列，环、门铃页和完成页经 GEM mmap 路径映射给
+ * 用户态。内核只负责创建时的校验和生命周期，映射存在期间内存保持有效
+ */
+#define FDCA_UMQ_MAX_PER_CTX        8
+#define FDCA_UMQ_SPIN_POLLS         256     /* 模拟消费者空闲时的自旋轮询次数 */
+#define FDCA_UMQ_POLL_MIN_US        20      /* 之后的睡眠轮询间隔 */
+#define FDCA_UMQ_POLL_MAX_US        50
+
+enum fdca_umq_bo_type {
+    FDCA_UMQ_BO_RING,
+    FDCA_UMQ_BO_DOORBELL,
+    FDCA_UMQ_BO_FENCE,
+    FDCA_UMQ_BO_MAX,
+};
+
+/**
+ * struct fdca_umq - 用户态提交队列
+ *
+ * 上下文和每个映射对象各持有一个引用，最后一个引用释放时才销毁队列内存
+ */
+struct fdca_umq {
+    struct kref ref;
+    struct fdca_device *fdev;
+    struct fdca_queue *queue;       /* 独占的硬件队列 */
+    u32 id;
+    
+    struct drm_fdca_umq_doorbell *doorbell; /* 门铃页 */
+    dma_addr_t doorbell_dma;
+    struct drm_gem_object *bos[FDCA_UMQ_BO_MAX]; /* 映射对象，销毁时释放 */
+    
+    struct task_struct *consumer;   /* 模拟后端的消费线程 */
+    atomic64_t doorbells;           /* 消费者观察到的写指针更新次数 */
+};
+
+static inline struct fdca_job *to_fdca_job(struct drm_sched_job *sched_job)
+{
+    return container_of(sched_job, struct fdca_job, base);
+}
+
+static inline u32 fdca_ring_packet_len(u32 payload)
+{
+    return ALIGN(sizeof(struct fdca_ring_packet) + payload, FDCA_QUEUE_PKT_ALIGN);
+}
+
+/**
+ * fdca_queue_completed_seqno() - 读取硬件写入 fence 页的完成序号
+ */
+static inline u32 fdca_queue_completed_seqno(struct fdca_queue *queue)
+{
+    u32 seqno = READ_ONCE(*queue->fence_cpu);
+    
+    /* 序号之后再读取依赖它的数据 */
+    dma_rmb();
+    return seqno;
+}
+
+static inline bool fdca_queue_seqno_passed(struct fdca_queue *queue, u32 seqno)
+{
+    return (s32)(fdca_queue_completed_seqno(queue) - seqno) >= 0;
+}
+
+static inline enum fdca_unit_type fdca_queue_type_to_unit(enum fdca_queue_type type)
+{
+    return (type <= FDCA_QUEUE_CAU_COMPUTE) ? FDCA_UNIT_CAU : FDCA_UNIT_CFU;
+}
+
 /* 函数声明 */
-int fdca_queue_manager_init(struct fdca_device *fdev, enum fdca_queue_type type);
-void fdca_queue_manager_fini(struct fdca_device *fdev, enum fdca_queue_type type);
-int fdca_queue_submit_command(struct fdca_device *fdev, enum fdca_queue_type type,
+int fdca_command_cache_init(void);
+void fdca_command_cache_fini(void);
+struct fdca_command *fdca_command_alloc(u32 type, const void *data, size_t size,
+                                        gfp_t gfp);
+void fdca_command_free(struct fdca_command *cmd);
+
+int fdca_queue_manager_init(struct fdca_device *fdev, enum fdca_unit_type type);
+void fdca_queue_manager_fini(struct fdca_device *fdev, enum fdca_unit_type type);
+int fdca_queue_submit_command(struct fdca_device *fdev, enum fdca_unit_type type,
                              struct fdca_command *cmd);
-int fdca_queue_wait_command(struct fdca_device *fdev, enum fdca_queue_type type, u32 cmd_id);
+int fdca_queue_wait_command(struct fdca_device *fdev, enum fdca_unit_type type,
+                            struct fdca_command *cmd);
+
+struct fdca_queue *fdca_queue_create(struct fdca_device *fdev, enum fdca_queue_type type);
+void fdca_queue_destroy(struct fdca_queue *queue);
+int fdca_queue_prepare_batch(struct fdca_queue *queue, struct fdca_arena_block *block,
+                             const struct drm_fdca_command *cmds, u32 num_cmds,
+                             struct fdca_ring_batch *batch);
+struct dma_fence *fdca_queue_space_fence(struct fdca_queue *queue, u32 len);
+int fdca_queue_write_batch(struct fdca_queue *queue, struct fdca_ring_batch *batch);
+void fdca_queue_commit_batch(struct fdca_queue *queue,
+                             const struct fdca_ring_batch *batch,
+                             struct dma_fence *fence);
+void fdca_queue_retire(struct fdca_queue *queue);
+void fdca_queue_ban(struct fdca_queue *queue, int error);
+void fdca_queue_set_time_slice(struct fdca_queue *queue, u32 time_slice_us);
+void fdca_queue_set_user_mode(struct fdca_queue *queue, dma_addr_t wptr_dma);
+void fdca_queue_set_vm(struct fdca_queue *queue, struct fdca_vm *vm);
+int fdca_queue_sim_consume(struct fdca_queue *queue, u32 wptr);
+
+/* 提交内存池 */
+struct fdca_submit_arena *fdca_submit_arena_create(void);
+void fdca_submit_arena_put(struct fdca_submit_arena *arena);
+struct fdca_arena_block *fdca_arena_block_get(struct fdca_submit_arena *arena);
+void fdca_arena_block_put(struct fdca_arena_block *block);
+void *fdca_arena_alloc(struct fdca_arena_block *block, size_t size);
+
+/* 用户态提交队列 */
+int fdca_umq_create(struct fdca_context *ctx, struct drm_file *file,
+                    enum fdca_queue_type type, struct drm_fdca_umq_create *args);
+int fdca_umq_destroy(struct fdca_context *ctx, struct drm_file *file, u32 id);
+void fdca_umq_ctx_fini(struct fdca_context *ctx, struct drm_file *file);
+
+/* 调度器作业 */
+struct fdca_job *fdca_job_create(struct fdca_context *ctx, enum fdca_queue_type type,
+                                 struct fdca_arena_block *block);
+void fdca_job_free(struct fdca_job *job);
+int fdca_job_push(struct fdca_job *job, const struct drm_fdca_command *cmds,
+                  u32 num_cmds, struct dma_fence **fence, u32 *fence_id);
 
 #endif /* __FDCA_QUEUE_H__ */
@@ -0,0 +1,599 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * FDCA Job Scheduler
+ *
+ * 基于 drm_gpu_scheduler 的作业调度:
+ * 1. 每个计算单元 (CAU/CFU) 一个调度器，限制单元上的在途作业数
+ * 2. 每个上下文在每种队列上一个调度实体，进程间按优先级公平轮转
+ * 3. 输入依赖以 fence 形式交给调度器解析，提交 ioctl 不再阻塞
+ * 4. 作业超时后停用对应上下文的硬件队列，调度器只短暂停止，其余上下文
+ *    的作业在恢复后继续执行
+ *
+ * 命令负载在提交 ioctl 中拷贝到上下文的提交内存块，环形缓冲区空间
+ * 在 run_job 中预留: prepare_job 在空间不足时让作业等待最早的在途批次，
+ * 提交路径和 run_job 都不会等待环空间。作业及提交期间的临时数组来自
+ * 上下文的提交内存池，作业释放时整块归还
+ */
+
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/dma-fence.h>
+#include <drm/drm_gem.h>
+#include <drm/gpu_scheduler.h>
+#include "fdca_drv.h"
+#include "fdca_queue.h"
+
+static unsigned int sched_hw_submission = 128;
+module_param(sched_hw_submission, uint, 0444);
+MODULE_PARM_DESC(sched_hw_submission, "Maximum in-flight jobs per compute unit");
+
+static unsigned int job_timeout_ms = 2000;
+module_param(job_timeout_ms, uint, 0444);
+MODULE_PARM_DESC(job_timeout_ms, "Job timeout in milliseconds before the queue is banned");
+
+/* 普通优先级的硬件时间片，高优先级加倍，低优先级减半 */
+#define FDCA_SCHED_TIME_SLICE_US    1000
+
+static const char * const fdca_sched_names[FDCA_UNIT_MAX] = {
+    [FDCA_UNIT_CAU] = "fdca-cau",
+    [FDCA_UNIT_CFU] = "fdca-cfu",
+};
+
+static inline struct fdca_scheduler *to_fdca_sched(struct drm_gpu_scheduler *sched)
+{
+    return container_of(sched, struct fdca_scheduler, base);
+}
+
+/* === 调度器后端操作 === */
+
+/**
+ * fdca_sched_prepare_job() - 依赖满足后检查环形缓冲区空间
+ *
+ * 空间不足时返回最早的在途批次 fence，调度器等它触发后再次调用。
+ * 在途批次的依赖都已满足，等待总能结束
+ */
+static struct dma_fence *fdca_sched_prepare_job(struct drm_sched_job *sched_job,
+                                                struct drm_sched_entity *entity)
+{
+    struct fdca_job *job = to_fdca_job(sched_job);
+
+    /* 队列停用后 run_job 直接取消作业，不需要环空间 */
+    if (!READ_ONCE(job->queue->active))
+        return NULL;
+
+    return fdca_queue_space_fence(job->queue, job->batch.len);
+}
+
+/**
+ * fdca_sched_run_job() - 写入并发布批次
+ *
+ * 同一 fence 时间线必须按顺序触发，失败的作业以 SKIP 包经环发布而不是
+ * 直接触发
+ */
+static struct dma_fence *fdca_sched_run_job(struct drm_sched_job *sched_job)
+{
+    struct fdca_job *job = to_fdca_job(sched_job);
+    struct fdca_scheduler *fsched = to_fdca_sched(sched_job->sched);
+    struct fdca_queue *queue = job->queue;
+    int error = sched_job->s_fence->finished.error;
+    int ret;
+
+    atomic64_add(ktime_get_ns() - job->queued_ns, &fsched->total_schedule_time);
+
+    /* 队列已被停用，在途批次已全部触发，批次不再发布 */
+    if (!READ_ONCE(queue->active)) {
+        dma_fence_set_error(job->fence, -ECANCELED);
+        dma_fence_signal(job->fence);
+        return dma_fence_get(job->fence);
+    }
+
+    if (error)
+        job->batch.error = error;
+
+    /* 单实体单生产者，prepare_job 之后空间不会被他人占用 */
+    ret = fdca_queue_write_batch(queue, &job->batch);
+    if (WARN_ON_ONCE(ret)) {
+        dma_fence_set_error(job->fence, ret);
+        dma_fence_signal(job->fence);
+        return dma_fence_get(job->fence);
+    }
+
+    fdca_queue_commit_batch(queue, &job->batch, job->fence);
+    atomic64_inc(&fsched->schedule_count);
+
+    return dma_fence_get(job->fence);
+}
+
+/**
+ * fdca_sched_timedout_job() - 作业超时处理
+ *
+ * 各上下文使用独立的硬件环，只停用超时作业所在的队列: 其在途批次以
+ * -ETIMEDOUT 触发，实体中尚未执行的作业在 run_job 中以 -ECANCELED
+ * 触发，之后的提交被拒绝。按调度器的恢复流程先停止再重启，
+ * drm_sched_stop() 把超时作业放回 pending 链表，drm_sched_start()
+ * 为其余上下文仍在途的作业重新挂接完成回调
+ */
+static enum drm_gpu_sched_stat fdca_sched_timedout_job(struct drm_sched_job *sched_job)
+{
+    struct fdca_job *job = to_fdca_job(sched_job);
+    struct drm_gpu_scheduler *sched = sched_job->sched;
+    struct fdca_scheduler *fsched = to_fdca_sched(sched);
+
+    drm_sched_stop(sched, sched_job);
+
+    /* 作业可能在超时处理开始前刚好完成 */
+    if (!dma_fence_is_signaled(job->fence)) {
+        atomic64_inc(&fsched->timeout_count);
+        fdca_err(fsched->fdev, "作业超时: 上下文=%u, 队列=%u, 停用队列\n",
+                 job->ctx->ctx_id, job->queue->id);
+        fdca_queue_ban(job->queue, -ETIMEDOUT);
+    }
+
+    drm_sched_start(sched, 0);
+
+    return DRM_GPU_SCHED_STAT_NOMINAL;
+}
+
+/**
+ * fdca_job_put_bos() - 解除作业对 GEM 对象的固定并释放引用
+ */
+static void fdca_job_put_bos(struct fdca_job *job)
+{
+    u32 i;
+
+    for (i = 0; i < job->num_bos; i++) {
+        fdca_gem_object_unpin(job->bos[i]);
+        drm_gem_object_put(job->bos[i]);
+    }
+    job->num_bos = 0;
+}
+
+static void fdca_sched_free_job(struct drm_sched_job *sched_job)
+{
+    struct fdca_job *job = to_fdca_job(sched_job);
+
+    drm_sched_job_cleanup(sched_job);
+
+    /* 实体销毁时未执行的作业也要触发 fence，避免等待者永久阻塞 */
+    if (!dma_fence_is_signaled(job->fence)) {
+        dma_fence_set_error(job->fence, -ECANCELED);
+        dma_fence_signal(job->fence);
+    }
+
+    dma_fence_put(job->fence);
+    fdca_job_put_bos(job);
+    fdca_context_put_async(job->ctx);
+
+    /* 作业本身位于内存块中，归还后不能再访问 */
+    fdca_arena_block_put(job->block);
+}
+
+static const struct drm_sched_backend_ops fdca_sched_ops = {
+    .prepare_job = fdca_sched_prepare_job,
+    .run_job = fdca_sched_run_job,
+    .timedout_job = fdca_sched_timedout_job,
+    .free_job = fdca_sched_free_job,
+};
+
+/* === 优先级 === */
+
+static enum drm_sched_priority fdca_sched_ctx_priority(struct fdca_scheduler *fsched,
+                                                       struct fdca_context *ctx)
+{
+    if (ctx->nice < 0)
+        return DRM_SCHED_PRIORITY_HIGH;
+    if (ctx->nice > 0)
+        return DRM_SCHED_PRIORITY_LOW;
+
+    return fsched->default_priority;
+}
+
+static u32 fdca_sched_time_slice(struct fdca_scheduler *fsched,
+                                 enum drm_sched_priority prio)
+{
+    switch (prio) {
+    case DRM_SCHED_PRIORITY_KERNEL:
+    case DRM_SCHED_PRIORITY_HIGH:
+        return fsched->time_slice_us * 2;
+    case DRM_SCHED_PRIORITY_LOW:
+        return fsched->time_slice_us / 2;
+    default:
+        return fsched->time_slice_us;
+    }
+}
+
+/* === 调度实体 === */
+
+/**
+ * fdca_sched_entity_init() - 为上下文的队列创建调度实体
+ * @ctx: 上下文
+ * @queue: 新创建的硬件队列
+ *
+ * 同时按实体优先级设置硬件队列的时间片
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_sched_entity_init(struct fdca_context *ctx, struct fdca_queue *queue)
+{
+    struct fdca_scheduler *fsched = ctx->fdev->schedulers[queue->unit];
+    struct drm_gpu_scheduler *sched;
+    enum drm_sched_priority prio;
+    int ret;
+
+    if (!fsched)
+        return -ENODEV;
+
+    sched = &fsched->base;
+    prio = fdca_sched_ctx_priority(fsched, ctx);
+
+    ret = drm_sched_entity_init(&ctx->entities[queue->type], prio, &sched, 1, NULL);
+    if (ret)
+        return ret;
+
+    fdca_queue_set_time_slice(queue, fdca_sched_time_slice(fsched, prio));
+
+    return 0;
+}
+
+/**
+ * fdca_sched_entity_fini() - 销毁调度实体
+ * @ctx: 上下文
+ * @type: 队列类型
+ *
+ * 等待已入队作业下发，剩余作业被取消。必须在销毁硬件队列之前调用
+ */
+void fdca_sched_entity_fini(struct fdca_context *ctx, enum fdca_queue_type type)
+{
+    drm_sched_entity_destroy(&ctx->entities[type]);
+}
+
+/* === 提交内存池 === */
+
+/* 超出内存块容量的单独分配 */
+struct fdca_arena_chunk {
+    struct list_head node;
+    u8 data[] __aligned(8);
+};
+
+static void fdca_submit_arena_release(struct kref *ref)
+{
+    struct fdca_submit_arena *arena = container_of(ref, struct fdca_submit_arena, ref);
+    struct fdca_arena_block *block, *tmp;
+
+    list_for_each_entry_safe(block, tmp, &arena->free_blocks, node)
+        kvfree(block);
+    kfree(arena);
+}
+
+/**
+ * fdca_submit_arena_create() - 创建上下文提交内存池
+ *
+ * Return: 内存池指针，失败返回 NULL
+ */
+struct fdca_submit_arena *fdca_submit_arena_create(void)
+{
+    struct fdca_submit_arena *arena;
+
+    arena = kzalloc(sizeof(*arena), GFP_KERNEL);
+    if (!arena)
+        return NULL;
+
+    kref_init(&arena->ref);
+    spin_lock_init(&arena->lock);
+    INIT_LIST_HEAD(&arena->free_blocks);
+    atomic64_set(&arena->block_allocs, 0);
+    atomic64_set(&arena->block_reuses, 0);
+    atomic64_set(&arena->overflows, 0);
+
+    return arena;
+}
+
+/**
+ * fdca_submit_arena_put() - 释放上下文对内存池的引用
+ */
+void fdca_submit_arena_put(struct fdca_submit_arena *arena)
+{
+    if (arena)
+        kref_put(&arena->ref, fdca_submit_arena_release);
+}
+
+/**
+ * fdca_arena_block_get() - 为一次提交取出内存块
+ * @arena: 上下文提交内存池
+ *
+ * 优先复用空闲块，稳态下不发生分配
+ *
+ * Return: 内存块 (引用计数为 1)，失败返回 NULL
+ */
+struct fdca_arena_block *fdca_arena_block_get(struct fdca_submit_arena *arena)
+{
+    struct fdca_arena_block *block = NULL;
+
+    spin_lock(&arena->lock);
+    if (arena->num_free) {
+        block = list_first_entry(&arena->free_blocks, struct fdca_arena_block, node);
+        list_del(&block->node);
+        arena->num_free--;
+    }
+    spin_unlock(&arena->lock);
+
+    if (block) {
+        block->allocs = 0;
+        atomic64_inc(&arena->block_reuses);
+    } else {
+        block = kvmalloc(FDCA_ARENA_BLOCK_SIZE, GFP_KERNEL);
+        if (!block)
+            return NULL;
+        block->arena = arena;
+        block->allocs = 1;
+        atomic64_inc(&arena->block_allocs);
+    }
+
+    INIT_LIST_HEAD(&block->overflow);
+    refcount_set(&block->users, 1);
+    block->used = 0;
+    kref_get(&arena->ref);
+
+    return block;
+}
+
+/**
+ * fdca_arena_block_put() - 释放内存块引用，最后一个引用整块归还内存池
+ */
+void fdca_arena_block_put(struct fdca_arena_block *block)
+{
+    struct fdca_submit_arena *arena = block->arena;
+    struct fdca_arena_chunk *chunk, *tmp;
+
+    if (!refcount_dec_and_test(&block->users))
+        return;
+
+    list_for_each_entry_safe(chunk, tmp, &block->overflow, node)
+        kvfree(chunk);
+
+    spin_lock(&arena->lock);
+    if (arena->num_free < FDCA_ARENA_MAX_CACHED) {
+        list_add(&block->node, &arena->free_blocks);
+        arena->num_free++;
+        block = NULL;
+    }
+    spin_unlock(&arena->lock);
+
+    kvfree(block);
+    fdca_submit_arena_put(arena);
+}
+
+/**
+ * fdca_arena_alloc() - 从内存块中顺序切分
+ * @block: 内存块
+ * @size: 字节数
+ *
+ * 只在提交 ioctl 中调用。超出块容量时单独分配，归还时一并释放
+ *
+ * Return: 未清零的内存，失败返回 NULL
+ */
+void *fdca_arena_alloc(struct fdca_arena_block *block, size_t size)
+{
+    struct fdca_arena_chunk *chunk;
+    void *ptr;
+
+    size = ALIGN(size, 8);
+    if (size <= FDCA_ARENA_BLOCK_DATA - block->used) {
+        ptr = block->data + block->used;
+        block->used += size;
+        return ptr;
+    }
+
+    chunk = kvmalloc(struct_size(chunk, data, size), GFP_KERNEL);
+    if (!chunk)
+        return NULL;
+
+    list_add(&chunk->node, &block->overflow);
+    block->allocs++;
+    atomic64_inc(&block->arena->overflows);
+
+    return chunk->data;
+}
+
+/* === 作业 === */
+
+/**
+ * fdca_job_create() - 创建调度器作业
+ * @ctx: 上下文
+ * @type: 队列类型 (队列和实体必须已创建)
+ * @block: 本次提交的内存块，作业持有一个引用直到被释放
+ *
+ * Return: 作业指针或 ERR_PTR
+ */
+struct fdca_job *fdca_job_create(struct fdca_context *ctx, enum fdca_queue_type type,
+                                 struct fdca_arena_block *block)
+{
+    struct fdca_job *job;
+    int ret;
+
+    job = fdca_arena_alloc(block, sizeof(*job));
+    if (!job)
+        return ERR_PTR(-ENOMEM);
+
+    memset(job, 0, sizeof(*job));
+    job->ctx = ctx;
+    job->queue = ctx->queues[type];
+    job->block = block;
+
+    ret = drm_sched_job_init(&job->base, &ctx->entities[type], 1, ctx);
+    if (ret)
+        return ERR_PTR(ret);
+
+    /* 作业可能晚于文件关闭完成，上下文和队列须保持有效 */
+    kref_get(&ctx->ref);
+    refcount_inc(&block->users);
+
+    return job;
+}
+
+/**
+ * fdca_job_free() - 释放尚未入队的作业
+ */
+void fdca_job_free(struct fdca_job *job)
+{
+    drm_sched_job_cleanup(&job->base);
+    fdca_job_put_bos(job);
+    fdca_context_put_async(job->ctx);
+    fdca_arena_block_put(job->block);
+}
+
+/**
+ * fdca_job_push() - 写入批次并把作业交给调度器
+ * @job: 作业 (无论成功与否都会被消耗)
+ * @cmds: 命令描述符数组
+ * @num_cmds: 命令数量
+ * @fence: 输出：硬件完成 fence (带引用)
+ * @fence_id: 输出：上下文内 fence ID
+ *
+ * fence 序号分配和实体入队在同一把锁下完成，保证两者顺序一致；
+ * 环形缓冲区空间到 run_job 才预留，锁内不会等待环空间。作业的完成
+ * fence 同时记入上下文地址空间的预留对象，VM_BIND 解映射和对象驱逐
+ * 据此等待。负载拷贝可能缺页并进入 GEM 缺页和驱逐路径，它们会获取
+ * 同一预留锁，因此拷贝在获取预留锁之前完成，预留锁只覆盖 fence 槽位
+ * 预留和添加。负载拷贝失败时不分配 fence；槽位预留失败时作业仍然
+ * 入队 (以 SKIP 包发布)，但返回错误且不输出 fence
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_job_push(struct fdca_job *job, const struct drm_fdca_command *cmds,
+                  u32 num_cmds, struct dma_fence **fence, u32 *fence_id)
+{
+    struct fdca_queue *queue = job->queue;
+    enum fdca_queue_type type = queue->type;
+    struct dma_resv *resv = drm_gpuvm_resv(&job->ctx->vm->base);
+    int ret;
+
+    /*
+     * 可能失败的准备工作在分配 fence 序号之前完成: 序号分配之后作业
+     * 必须入队并经环形缓冲区按顺序触发，否则会先于同一时间线上仍在
+     * 途的 fence 触发
+     */
+    ret = fdca_queue_prepare_batch(queue, job->block, cmds, num_cmds, &job->batch);
+    if (ret)
+        goto err_free;
+
+    mutex_lock(&queue->submit_lock);
+
+    job->fence = fdca_fence_create(&job->ctx->fences, type, fence_id);
+    if (IS_ERR(job->fence)) {
+        ret = PTR_ERR(job->fence);
+        goto err_unlock;
+    }
+
+    /* fence 序号已分配，槽位预留失败时批次改为 SKIP 包按顺序发布 */
+    dma_resv_lock(resv, NULL);
+    ret = dma_resv_reserve_fences(resv, 1);
+    if (ret)
+        job->batch.error = ret;
+
+    drm_sched_job_arm(&job->base);
+    if (!ret)
+        dma_resv_add_fence(resv, &job->base.s_fence->finished,
+                           DMA_RESV_USAGE_BOOKKEEP);
+    dma_resv_unlock(resv);
+
+    job->queued_ns = ktime_get_ns();
+    ret = job->batch.error;
+    if (!ret)
+        *fence = dma_fence_get(job->fence);
+    drm_sched_entity_push_job(&job->base);
+
+    mutex_unlock(&queue->submit_lock);
+    return ret;
+
+err_unlock:
+    mutex_unlock(&queue->submit_lock);
+err_free:
+    fdca_job_free(job);
+    return ret;
+}
+
+/* === 调度器初始化 === */
+
+/**
+ * fdca_scheduler_init() - 为每个计算单元创建调度器
+ */
+int fdca_scheduler_init(struct fdca_device *fdev)
+{
+    struct fdca_scheduler *fsched;
+    int unit, ret;
+
+    for (unit = FDCA_UNIT_CAU; unit <= FDCA_UNIT_CFU; unit++) {
+        const struct drm_sched_init_args args = {
+            .ops = &fdca_sched_ops,
+            .num_rqs = DRM_SCHED_PRIORITY_COUNT,
+            .credit_limit = sched_hw_submission,
+            .timeout = msecs_to_jiffies(job_timeout_ms),
+            .name = fdca_sched_names[unit],
+            .dev = fdev->dev,
+        };
+
+        fsched = kzalloc(sizeof(*fsched), GFP_KERNEL);
+        if (!fsched) {
+            ret = -ENOMEM;
+            goto err_fini;
+        }
+
+        fsched->fdev = fdev;
+        fsched->unit = unit;
+        fsched->default_priority = DRM_SCHED_PRIORITY_NORMAL;
+        fsched->time_slice_us = FDCA_SCHED_TIME_SLICE_US;
+        atomic64_set(&fsched->schedule_count, 0);
+        atomic64_set(&fsched->timeout_count, 0);
+        atomic64_set(&fsched->total_schedule_time, 0);
+
+        ret = drm_sched_init(&fsched->base, &args);
+        if (ret) {
+            fdca_err(fdev, "调度器 %s 初始化失败: %d\n", args.name, ret);
+            kfree(fsched);
+            goto err_fini;
+        }
+
+        fdev->schedulers[unit] = fsched;
+    }
+
+    fdca_info(fdev, "调度器初始化完成: 在途上限=%u, 超时=%u ms\n",
+              sched_hw_submission, job_timeout_ms);
+    return 0;
+
+err_fini:
+    fdca_scheduler_fini(fdev);
+    return ret;
+}
+
+/**
+ * fdca_scheduler_fini() - 销毁调度器
+ *
+ * 调用前所有上下文的实体必须已销毁
+ */
+void fdca_scheduler_fini(struct fdca_device *fdev)
+{
+    int unit;
+
+    for (unit = 0; unit < FDCA_UNIT_MAX; unit++) {
+        if (!fdev->schedulers[unit])
+            continue;
+
+        drm_sched_fini(&fdev->schedulers[unit]->base);
+        kfree(fdev->schedulers[unit]);
+        fdev->schedulers[unit] = NULL;
+    }
+}
+
+EXPORT_SYMBOL_GPL(fdca_scheduler_init);
+EXPORT_SYMBOL_GPL(fdca_scheduler_fini);
+EXPORT_SYMBOL_GPL(fdca_sched_entity_init);
+EXPORT_SYMBOL_GPL(fdca_sched_entity_fini);
+EXPORT_SYMBOL_GPL(fdca_submit_arena_create);
+EXPORT_SYMBOL_GPL(fdca_submit_arena_put);
+EXPORT_SYMBOL_GPL(fdca_arena_block_get);
+EXPORT_SYMBOL_GPL(fdca_arena_block_put);
+EXPORT_SYMBOL_GPL(fdca_arena_alloc);
+EXPORT_SYMBOL_GPL(fdca_job_create);
+EXPORT_SYMBOL_GPL(fdca_job_free);
+EXPORT_SYMBOL_GPL(fdca_job_push);
@@ -1,101 +1,590 @@
 // SPDX-License-Identifier: GPL-2.0-only
 /*
  * FDCA Synchronization Object Management
+ *
+ * 基于 dma_fence 的每上下文 fence 表:
+ * 1. fence ID 在上下文内单调递增，通过 xarray 索引
+ * 2. 查找走 RCU，不持有任何表锁
+ * 3. 每个 fence 使用独立的自旋锁，中断上下文触发不会互相争用
+ * 4. 已触发的 fence 通过无锁链表交给工作队列从表中回收
+ *
+ * 另外把批次 fence 挂接到 drm_syncobj 时间线上，用户态可以用时间线点
+ * 串联跨 CAU/CFU 的依赖，并用 DRM 核心的 DRM_IOCTL_SYNCOBJ_TIMELINE_WAIT
+ * 一次等待多个时间点
  */
 
 #include <linux/slab.h>
-#include <linux/completion.h>
+#include <linux/xarray.h>
+#include <linux/llist.h>
+#include <linux/uaccess.h>
+#include <linux/sched/signal.h>
+#include <linux/hrtimer.h>
+#include <linux/dma-fence.h>
+#include <linux/dma-fence-chain.h>
+#include <drm/drm_syncobj.h>
 #include "fdca_drv.h"
+#include "fdca_uapi.h"
+#include "fdca_queue.h"
+
+/* 推理类作业只有几十微秒，先轮询完成序号可以省掉一次睡眠/唤醒 */
+static unsigned int wait_spin_us = 20;
+module_param(wait_spin_us, uint, 0644);
+MODULE_PARM_DESC(wait_spin_us, "Busy-poll window in microseconds before a fence wait sleeps (0=never spin)");
 
 /* 同步对象 */
-struct fdca_sync_obj {
-    u32 fence_id;
-    struct completion completion;
-    struct list_head list;
-    atomic_t ref_count;
-    bool signaled;
+struct fdca_fence {
+    struct dma_fence base;          /* 必须是第一个成员，释放走 kfree_rcu */
+    spinlock_t lock;                /* fence 独立锁 */
+    struct fdca_fence_table *table; /* 所属 fence 表 */
+    u32 id;                         /* 上下文内 fence ID */
+    struct dma_fence_cb cb;         /* 触发回调 */
+    struct llist_node gc_node;      /* 回收链表节点 */
+};
+
+static inline struct fdca_fence *to_fdca_fence(struct dma_fence *fence)
+{
+    return container_of(fence, struct fdca_fence, base);
+}
+
+static const char *fdca_fence_get_driver_name(struct dma_fence *fence)
+{
+    return FDCA_DRIVER_NAME;
+}
+
+static const char *fdca_fence_get_timeline_name(struct dma_fence *fence)
+{
+    return "fdca-queue";
+}
+
+static const struct dma_fence_ops fdca_fence_ops = {
+    .get_driver_name = fdca_fence_get_driver_name,
+    .get_timeline_name = fdca_fence_get_timeline_name,
 };
 
-static struct list_head sync_objects = LIST_HEAD_INIT(sync_objects);
-static DEFINE_MUTEX(sync_lock);
-static atomic_t fence_counter = ATOMIC_INIT(0);
+/**
+ * fdca_fence_signaled_cb() - fence 触发回调
+ *
+ * 可能在中断上下文中执行，只做无锁入队
+ */
+static void fdca_fence_signaled_cb(struct dma_fence *fence, struct dma_fence_cb *cb)
+{
+    struct fdca_fence *f = container_of(cb, struct fdca_fence, cb);
+    struct fdca_fence_table *table = f->table;
+
+    atomic64_inc(&table->fdev->stats.fences_signaled);
+
+    if (llist_add(&f->gc_node, &table->gc_list))
+        schedule_work(&table->gc_work);
+}
+
+/**
+ * fdca_fence_gc_work() - 从表中移除已触发的 fence 并释放表引用
+ */
+static void fdca_fence_gc_work(struct work_struct *work)
+{
+    struct fdca_fence_table *table =
+        container_of(work, struct fdca_fence_table, gc_work);
+    struct fdca_fence *f, *tmp;
+
+    llist_for_each_entry_safe(f, tmp, llist_del_all(&table->gc_list), gc_node) {
+        xa_erase(&table->xa, f->id);
+        dma_fence_put(&f->base);
+    }
+}
+
+/**
+ * fdca_fence_table_init() - 初始化上下文 fence 表
+ * @table: fence 表
+ * @fdev: FDCA 设备
+ */
+void fdca_fence_table_init(struct fdca_fence_table *table, struct fdca_device *fdev)
+{
+    int i;
+
+    table->fdev = fdev;
+    xa_init(&table->xa);
+    atomic_set(&table->next_id, 0);
+    init_llist_head(&table->gc_list);
+    INIT_WORK(&table->gc_work, fdca_fence_gc_work);
+
+    /* 每种队列一条时间线，同一时间线内的 fence 按提交顺序触发 */
+    table->context = dma_fence_context_alloc(FDCA_QUEUE_MAX);
+    for (i = 0; i < FDCA_QUEUE_MAX; i++)
+        atomic64_set(&table->seqno[i], 0);
+}
+
+/**
+ * fdca_fence_table_fini() - 清理上下文 fence 表
+ * @table: fence 表
+ *
+ * 调用前队列必须已销毁；残留的未触发 fence 以 -ECANCELED 触发
+ */
+void fdca_fence_table_fini(struct fdca_fence_table *table)
+{
+    struct fdca_fence *f;
+    unsigned long id;
+
+    flush_work(&table->gc_work);
+
+    xa_for_each(&table->xa, id, f) {
+        if (!dma_fence_is_signaled(&f->base)) {
+            dma_fence_set_error(&f->base, -ECANCELED);
+            dma_fence_signal(&f->base);
+        }
+    }
+
+    flush_work(&table->gc_work);
+    WARN_ON(!xa_empty(&table->xa));
+    xa_destroy(&table->xa);
+}
+
+/**
+ * fdca_fence_create() - 创建同步栅栏
+ * @table: fence 表
+ * @type: 队列类型 (决定 fence 所在时间线)
+ * @id: 输出：上下文内 fence ID
+ *
+ * 表持有一个引用直到 fence 触发，调用者获得另一个引用
+ *
+ * Return: fence 指针或 ERR_PTR
+ */
+struct dma_fence *fdca_fence_create(struct fdca_fence_table *table,
+                                    enum fdca_queue_type type, u32 *id)
+{
+    struct fdca_fence *f;
+    int ret;
+
+    f = kzalloc(sizeof(*f), GFP_KERNEL);
+    if (!f)
+        return ERR_PTR(-ENOMEM);
+
+    spin_lock_init(&f->lock);
+    f->table = table;
+    dma_fence_init(&f->base, &fdca_fence_ops, &f->lock,
+                   table->context + type,
+                   atomic64_inc_return(&table->seqno[type]));
+
+    /* ID 单调递增，已分配但不在表中的 ID 即为已触发 */
+    f->id = atomic_inc_return(&table->next_id);
+    if (unlikely(!f->id))
+        f->id = atomic_inc_return(&table->next_id);
+
+    ret = xa_err(xa_store(&table->xa, f->id, f, GFP_KERNEL));
+    if (ret) {
+        dma_fence_put(&f->base);
+        return ERR_PTR(ret);
+    }
+
+    /* 表引用 + 调用者引用 */
+    dma_fence_get(&f->base);
+    dma_fence_add_callback(&f->base, &f->cb, fdca_fence_signaled_cb);
+    atomic64_inc(&table->fdev->stats.fences_created);
+
+    *id = f->id;
+    return &f->base;
+}
+
+/**
+ * fdca_fence_lookup() - 按 ID 查找 fence
+ * @table: fence 表
+ * @id: fence ID
+ *
+ * Return: 带引用的 fence；已回收返回 NULL；ID 从未分配返回 ERR_PTR(-ENOENT)
+ */
+struct dma_fence *fdca_fence_lookup(struct fdca_fence_table *table, u32 id)
+{
+    struct fdca_fence *f;
+    struct dma_fence *fence = NULL;
+
+    rcu_read_lock();
+    f = xa_load(&table->xa, id);
+    if (f)
+        fence = dma_fence_get_rcu(&f->base);
+    rcu_read_unlock();
+
+    if (fence)
+        return fence;
+
+    if (!id || (s32)(id - (u32)atomic_read(&table->next_id)) > 0)
+        return ERR_PTR(-ENOENT);
+
+    return NULL;
+}
+
+/**
+ * fdca_fence_wait() - 等待同步栅栏
+ * @table: fence 表
+ * @id: fence ID
+ * @timeout: 超时 (jiffies)，MAX_SCHEDULE_TIMEOUT 表示无限等待
+ *
+ * Return: 0 表示已触发，-ETIME 表示超时，其他负数表示错误
+ */
+int fdca_fence_wait(struct fdca_fence_table *table, u32 id, long timeout)
+{
+    struct dma_fence *fence;
+    long ret;
+
+    fence = fdca_fence_lookup(table, id);
+    if (IS_ERR(fence))
+        return PTR_ERR(fence);
+    if (!fence)
+        return 0;
+
+    ret = fdca_fence_wait_timeout(table->fdev, fence, timeout);
+    dma_fence_put(fence);
+
+    return ret;
+}
+
+/**
+ * fdca_fence_wait_timeout() - 等待 fence 并记录触发到唤醒的延迟
+ * @fdev: FDCA 设备
+ * @fence: fence
+ * @timeout: 超时 (jiffies)
+ *
+ * Return: 0 表示已触发，-ETIME 表示超时，其他负数表示错误
+ */
+int fdca_fence_wait_timeout(struct fdca_device *fdev, struct dma_fence *fence,
+                            long timeout)
+{
+    long ret;
+    s64 latency;
+
+    if (dma_fence_is_signaled(fence))
+        return fence->error;
+
+    ret = dma_fence_wait_timeout(fence, true, timeout);
+    if (ret < 0)
+        return ret;
+    if (!ret)
+        return -ETIME;
+
+    if (test_bit(DMA_FENCE_FLAG_TIMESTAMP_BIT, &fence->flags)) {
+        latency = ktime_to_ns(ktime_sub(ktime_get(), fence->timestamp));
+        atomic64_inc(&fdev->stats.fence_waits);
+        atomic64_add(latency, &fdev->stats.fence_wakeup_ns);
+        if (latency > READ_ONCE(fdev->stats.fence_wakeup_max_ns))
+            WRITE_ONCE(fdev->stats.fence_wakeup_max_ns, latency);
+    }
+
+    return fence->error;
+}
+
+/* === 轮询+睡眠混合等待 === */
+
+struct fdca_wait_cb {
+    struct dma_fence_cb base;
+    struct task_struct *task;
+};
+
+static void fdca_wait_wake(struct dma_fence *fence, struct dma_fence_cb *cb)
+{
+    wake_up_process(container_of(cb, struct fdca_wait_cb, base)->task);
+}
+
+/* 耗时按 2 的幂微秒分桶: 0 号桶 <1us，k 号桶 [2^(k-1), 2^k) us */
+static void fdca_wait_hist_add(atomic64_t *hist, s64 ns)
+{
+    u64 us = ns > 0 ? div_u64(ns, NSEC_PER_USEC) : 0;
+    u32 bucket = us ? min_t(u32, ilog2(us) + 1, FDCA_WAIT_HIST_BUCKETS - 1) : 0;
+
+    atomic64_inc(&hist[bucket]);
+}
+
+/**
+ * fdca_fence_spin() - 在轮询窗口内主动回收队列并检查 fence
+ *
+ * Return: true 表示 fence 已触发
+ */
+static bool fdca_fence_spin(struct fdca_queue *queue, struct dma_fence *fence,
+                            ktime_t end)
+{
+    do {
+        fdca_queue_retire(queue);
+        if (dma_fence_is_signaled(fence))
+            return true;
+        if (need_resched())
+            break;
+        cpu_relax();
+    } while (ktime_before(ktime_get(), end));
+
+    return false;
+}
 
 /**
- * fdca_sync_create_fence() - 创建同步栅栏
+ * fdca_fence_sleep() - 可中断睡眠直到 fence 触发或绝对截止时间
+ *
+ * Return: 0 表示已触发，-ETIME 表示超时，-ERESTARTSYS 表示被信号打断
  */
-u32 fdca_sync_create_fence(void)
+static int fdca_fence_sleep(struct dma_fence *fence, ktime_t deadline)
 {
-    struct fdca_sync_obj *obj;
-    u32 fence_id;
-    
-    obj = kzalloc(sizeof(*obj), GFP_KERNEL);
-    if (!obj)
+    struct fdca_wait_cb cb = { .task = current };
+    int ret = 0;
+
+    if (dma_fence_add_callback(fence, &cb.base, fdca_wait_wake))
         return 0;
-    
-    fence_id = atomic_inc_return(&fence_counter);
-    obj->fence_id = fence_id;
-    init_completion(&obj->completion);
-    INIT_LIST_HEAD(&obj->list);
-    atomic_set(&obj->ref_count, 1);
-    obj->signaled = false;
-    
-    mutex_lock(&sync_lock);
-    list_add_tail(&obj->list, &sync_objects);
-    mutex_unlock(&sync_lock);
-    
-    return fence_id;
-}
-
-/**
- * fdca_sync_signal_fence() - 触发同步栅栏
- */
-int fdca_sync_signal_fence(u32 fence_id)
-{
-    struct fdca_sync_obj *obj;
-    int ret = -ENOENT;
-    
-    mutex_lock(&sync_lock);
-    list_for_each_entry(obj, &sync_objects, list) {
-        if (obj->fence_id == fence_id) {
-            obj->signaled = true;
-            complete(&obj->completion);
-            ret = 0;
+
+    for (;;) {
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (dma_fence_is_signaled(fence))
+            break;
+        if (signal_pending(current)) {
+            ret = -ERESTARTSYS;
+            break;
+        }
+        if (deadline != KTIME_MAX && !ktime_before(ktime_get(), deadline)) {
+            ret = -ETIME;
             break;
         }
+        schedule_hrtimeout(&deadline, HRTIMER_MODE_ABS);
     }
-    mutex_unlock(&sync_lock);
-    
+    __set_current_state(TASK_RUNNING);
+
+    dma_fence_remove_callback(fence, &cb.base);
     return ret;
 }
 
 /**
- * fdca_sync_wait_fence() - 等待同步栅栏
+ * fdca_fence_wait_deadline() - 轮询后睡眠的 fence 等待
+ * @ctx: 上下文
+ * @id: fence ID
+ * @deadline: CLOCK_MONOTONIC 绝对截止时间，KTIME_MAX 表示无限等待
+ * @flags: FDCA_WAIT_* 标志
+ * @result: 输出：FDCA_WAIT_RESULT_*
+ *
+ * 先在 wait_spin_us 窗口内轮询 fence 所在队列的读指针，未完成再
+ * 挂中断回调睡眠。两种路径的耗时分别计入 debugfs 直方图
+ *
+ * Return: 0 表示已触发，-ETIME 表示超时，其他负数表示错误
  */
-int fdca_sync_wait_fence(u32 fence_id, unsigned long timeout_ms)
+int fdca_fence_wait_deadline(struct fdca_context *ctx, u32 id, ktime_t deadline,
+                             u32 flags, u32 *result)
 {
-    struct fdca_sync_obj *obj;
-    int ret = -ENOENT;
-    
-    mutex_lock(&sync_lock);
-    list_for_each_entry(obj, &sync_objects, list) {
-        if (obj->fence_id == fence_id) {
-            mutex_unlock(&sync_lock);
-            if (timeout_ms) {
-                ret = wait_for_completion_timeout(&obj->completion, 
-                                                 msecs_to_jiffies(timeout_ms));
-                ret = ret ? 0 : -ETIMEDOUT;
-            } else {
-                wait_for_completion(&obj->completion);
-                ret = 0;
-            }
+    struct fdca_device *fdev = ctx->fdev;
+    struct dma_fence *fence;
+    struct fdca_queue *queue = NULL;
+    ktime_t start, spin_end;
+    u64 type;
+    int ret;
+
+    *result = FDCA_WAIT_RESULT_IDLE;
+
+    fence = fdca_fence_lookup(&ctx->fences, id);
+    if (IS_ERR(fence))
+        return PTR_ERR(fence);
+    if (!fence)
+        return 0;
+
+    if (dma_fence_is_signaled(fence)) {
+        ret = fence->error;
+        goto out_put;
+    }
+
+    /* fence 时间线与队列类型一一对应 */
+    type = fence->context - ctx->fences.context;
+    if (type < FDCA_QUEUE_MAX)
+        queue = smp_load_acquire(&ctx->queues[type]);
+
+    start = ktime_get();
+    spin_end = ktime_add_us(start, READ_ONCE(wait_spin_us));
+    if (ktime_after(spin_end, deadline))
+        spin_end = deadline;
+
+    if (queue && !(flags & FDCA_WAIT_NO_SPIN) && ktime_after(spin_end, start) &&
+        fdca_fence_spin(queue, fence, spin_end)) {
+        *result = FDCA_WAIT_RESULT_SPIN;
+        fdca_wait_hist_add(fdev->stats.wait_spin_hist,
+                           ktime_to_ns(ktime_sub(ktime_get(), start)));
+        ret = fence->error;
+        goto out_put;
+    }
+
+    ret = fdca_fence_sleep(fence, deadline);
+    if (ret == -ETIME)
+        atomic64_inc(&fdev->stats.wait_timeouts);
+    if (ret)
+        goto out_put;
+
+    *result = FDCA_WAIT_RESULT_SLEEP;
+    fdca_wait_hist_add(fdev->stats.wait_sleep_hist,
+                       ktime_to_ns(ktime_sub(ktime_get(), start)));
+    ret = fence->error;
+
+out_put:
+    dma_fence_put(fence);
+    return ret;
+}
+
+/* === drm_syncobj 时间线 === */
+
+static inline enum fdca_sync_type fdca_syncobj_type(const struct drm_fdca_syncobj *s)
+{
+    return (s->flags & FDCA_SYNCOBJ_TIMELINE) ? FDCA_SYNC_TIMELINE : FDCA_SYNC_FENCE;
+}
+
+/**
+ * fdca_syncobj_check() - 校验时间点描述符
+ *
+ * Return: 二值 syncobj 返回 0 点，时间线返回 point；非法返回负数
+ */
+static int fdca_syncobj_check(const struct drm_fdca_syncobj *s, u64 *point)
+{
+    if (s->flags & ~FDCA_SYNCOBJ_TIMELINE)
+        return -EINVAL;
+
+    *point = 0;
+    if (fdca_syncobj_type(s) == FDCA_SYNC_TIMELINE) {
+        if (!s->point)
+            return -EINVAL;
+        *point = s->point;
+    }
+
+    return 0;
+}
+
+/**
+ * fdca_syncobj_copy() - 从用户态拷贝时间点数组
+ *
+ * Return: kvmalloc 分配的数组或 ERR_PTR
+ */
+struct drm_fdca_syncobj *fdca_syncobj_copy(u64 syncs_ptr, u32 count)
+{
+    struct drm_fdca_syncobj *syncs;
+
+    if (!syncs_ptr || count > FDCA_SYNCOBJ_MAX)
+        return ERR_PTR(-EINVAL);
+
+    syncs = kvmalloc_array(count, sizeof(*syncs), GFP_KERNEL);
+    if (!syncs)
+        return ERR_PTR(-ENOMEM);
+
+    if (copy_from_user(syncs, u64_to_user_ptr(syncs_ptr),
+                       count * sizeof(*syncs))) {
+        kvfree(syncs);
+        return ERR_PTR(-EFAULT);
+    }
+
+    return syncs;
+}
+
+/**
+ * fdca_syncobj_add_deps() - 把输入 syncobj 时间点加入作业依赖
+ * @file: DRM 文件
+ * @job: 调度器作业
+ * @syncs: 已拷贝到内核的 drm_fdca_syncobj 数组
+ * @count: 数量
+ *
+ * 依赖由调度器解析，提交 ioctl 不阻塞
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_syncobj_add_deps(struct drm_file *file, struct drm_sched_job *job,
+                          const struct drm_fdca_syncobj *syncs, u32 count)
+{
+    u64 point;
+    u32 i;
+    int ret;
+
+    for (i = 0; i < count; i++) {
+        ret = fdca_syncobj_check(&syncs[i], &point);
+        if (ret)
+            return ret;
+
+        ret = drm_sched_job_add_syncobj_dependency(job, file, syncs[i].handle, point);
+        if (ret)
+            return ret;
+    }
+
+    return 0;
+}
+
+/**
+ * fdca_syncobj_out_prepare() - 查找输出 syncobj 并预分配时间线链节点
+ * @file: DRM 文件
+ * @syncs: 已拷贝到内核的 drm_fdca_syncobj 数组
+ * @count: 数量
+ * @out: 输出数组 (调用者提供，容量为 @count)
+ *
+ * 失败时 @out 中已获取的资源需由 fdca_syncobj_out_free() 释放
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_syncobj_out_prepare(struct drm_file *file,
+                             const struct drm_fdca_syncobj *syncs, u32 count,
+                             struct fdca_syncobj_out *out)
+{
+    u32 i;
+    int ret;
+
+    memset(out, 0, count * sizeof(*out));
+
+    for (i = 0; i < count; i++) {
+        ret = fdca_syncobj_check(&syncs[i], &out[i].point);
+        if (ret)
             return ret;
+
+        out[i].syncobj = drm_syncobj_find(file, syncs[i].handle);
+        if (!out[i].syncobj)
+            return -ENOENT;
+
+        if (fdca_syncobj_type(&syncs[i]) == FDCA_SYNC_TIMELINE) {
+            out[i].chain = dma_fence_chain_alloc();
+            if (!out[i].chain)
+                return -ENOMEM;
         }
     }
-    mutex_unlock(&sync_lock);
-    
-    return ret;
+
+    return 0;
+}
+
+/**
+ * fdca_syncobj_out_signal() - 把批次 fence 挂接到输出 syncobj
+ * @out: 输出数组
+ * @count: 数量
+ * @fence: 批次 fence
+ *
+ * 时间线 syncobj 追加 point，二值 syncobj 替换 fence
+ */
+void fdca_syncobj_out_signal(struct fdca_syncobj_out *out, u32 count,
+                             struct dma_fence *fence)
+{
+    u32 i;
+
+    for (i = 0; i < count; i++) {
+        if (out[i].chain) {
+            drm_syncobj_add_point(out[i].syncobj, out[i].chain, fence, out[i].point);
+            out[i].chain = NULL;
+        } else {
+            drm_syncobj_replace_fence(out[i].syncobj, fence);
+        }
+    }
+}
+
+/**
+ * fdca_syncobj_out_free() - 释放未使用的链节点和 syncobj 引用
+ *
+ * 数组本身由调用者管理
+ */
+void fdca_syncobj_out_free(struct fdca_syncobj_out *out, u32 count)
+{
+    u32 i;
+
+    for (i = 0; i < count; i++) {
+        dma_fence_chain_free(out[i].chain);
+        if (out[i].syncobj)
+            drm_syncobj_put(out[i].syncobj);
+    }
 }
 
-EXPORT_SYMBOL_GPL(fdca_sync_create_fence);
-EXPORT_SYMBOL_GPL(fdca_sync_signal_fence);
-EXPORT_SYMBOL_GPL(fdca_sync_wait_fence);
+EXPORT_SYMBOL_GPL(fdca_fence_table_init);
+EXPORT_SYMBOL_GPL(fdca_fence_table_fini);
+EXPORT_SYMBOL_GPL(fdca_fence_create);
+EXPORT_SYMBOL_GPL(fdca_fence_lookup);
+EXPORT_SYMBOL_GPL(fdca_fence_wait);
+EXPORT_SYMBOL_GPL(fdca_fence_wait_timeout);
+EXPORT_SYMBOL_GPL(fdca_fence_wait_deadline);
+EXPORT_SYMBOL_GPL(fdca_syncobj_copy);
+EXPORT_SYMBOL_GPL(fdca_syncobj_add_deps);
+EXPORT_SYMBOL_GPL(fdca_syncobj_out_prepare);
+EXPORT_SYMBOL_GPL(fdca_syncobj_out_signal);
+EXPORT_SYMBOL_GPL(fdca_syncobj_out_free);
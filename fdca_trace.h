@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * FDCA Tracepoints
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM fdca
+
+#if !defined(_FDCA_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _FDCA_TRACE_H_
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+/**
+ * fdca_submit_alloc - 一次提交在提交路径上发生的内存分配
+ *
+ * allocs 统计新分配的内存块、超出块容量的单独分配、时间线链节点，
+ * 以及每次提交固定发生的两次分配 (作业 fence 和调度器的 s_fence)，
+ * 内存池预热后最小为 2。依赖由 drm_sched_job_add_dependency() 存入
+ * 调度器作业的 xarray，其内部节点分配不计入
+ */
+TRACE_EVENT(fdca_submit_alloc,
+    TP_PROTO(u32 ctx_id, u32 num_cmds, u32 num_deps, u32 allocs, u32 arena_bytes),
+    TP_ARGS(ctx_id, num_cmds, num_deps, allocs, arena_bytes),
+
+    TP_STRUCT__entry(
+        __field(u32, ctx_id)
+        __field(u32, num_cmds)
+        __field(u32, num_deps)
+        __field(u32, allocs)
+        __field(u32, arena_bytes)
+    ),
+
+    TP_fast_assign(
+        __entry->ctx_id = ctx_id;
+        __entry->num_cmds = num_cmds;
+        __entry->num_deps = num_deps;
+        __entry->allocs = allocs;
+        __entry->arena_bytes = arena_bytes;
+    ),
+
+    TP_printk("ctx=%u cmds=%u deps=%u allocs=%u arena_bytes=%u",
+              __entry->ctx_id, __entry->num_cmds, __entry->num_deps,
+              __entry->allocs, __entry->arena_bytes)
+);
+
+#endif /* _FDCA_TRACE_H_ */
+
+/* 必须位于保护宏之外 */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE fdca_trace
+#include <trace/define_trace.h>
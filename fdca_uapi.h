@@ -10,6 +10,7 @@
 #define __FDCA_UAPI_H__
 
 #include <linux/types.h>
+#include <drm/drm.h>
 
 /* FDCA 设备参数 */
 #define FDCA_PARAM_DEVICE_ID        0
@@ -29,12 +30,56 @@
 #define FDCA_GEM_CREATE_UNCACHED    BIT(1)
 #define FDCA_GEM_CREATE_COHERENT    BIT(2)
 #define FDCA_GEM_CREATE_LARGE_PAGE  BIT(3)
+#define FDCA_GEM_CREATE_GTT         BIT(4)   /* 放置在 GTT (shmem 系统内存，按需分配) */
+
+/* 用户指针对象标志 */
+#define FDCA_USERPTR_READONLY       BIT(0)   /* 设备只读，允许只读映射的内存 */
+#define FDCA_USERPTR_NOTIFIER       BIT(1)   /* 不长期固定，CPU 页表变化时撤销并按需重新获取 */
 
 /* 任务提交标志 */
 #define FDCA_SUBMIT_CAU             BIT(0)   /* 提交到 CAU */
 #define FDCA_SUBMIT_CFU             BIT(1)   /* 提交到 CFU */
-#define FDCA_SUBMIT_SYNC            BIT(2)   /* 同步提交 */
+#define FDCA_SUBMIT_SYNC            BIT(2)   /* 同步提交，被信号打断时返回 -EINTR，fence_out 仍有效 */
 #define FDCA_SUBMIT_ASYNC           BIT(3)   /* 异步提交 */
+#define FDCA_SUBMIT_FLAGS           (FDCA_SUBMIT_CAU | FDCA_SUBMIT_CFU | \
+                                     FDCA_SUBMIT_SYNC | FDCA_SUBMIT_ASYNC)
+
+/* syncobj 标志 */
+#define FDCA_SYNCOBJ_TIMELINE       BIT(0)   /* 时间线 syncobj，使用 point */
+
+/* fence 等待标志 */
+#define FDCA_WAIT_ABSOLUTE          BIT(0)   /* timeout_ns 为绝对截止时间 */
+#define FDCA_WAIT_NO_SPIN           BIT(1)   /* 跳过轮询直接睡眠 */
+
+/* fence 等待结果 */
+#define FDCA_WAIT_RESULT_IDLE       0        /* 进入时已完成 */
+#define FDCA_WAIT_RESULT_SPIN       1        /* 轮询阶段完成 */
+#define FDCA_WAIT_RESULT_SLEEP      2        /* 睡眠后被唤醒 */
+
+/* 单次提交/等待的 syncobj 数量上限 */
+#define FDCA_SYNCOBJ_MAX            1024
+
+/* 单次提交全部命令的 fence 依赖总数上限 */
+#define FDCA_SUBMIT_MAX_DEPS        256
+
+/* 单次提交引用的 GEM 对象数上限 */
+#define FDCA_SUBMIT_MAX_BOS         1024
+
+/* VM_BIND 操作类型 */
+#define FDCA_VM_BIND_OP_MAP         0        /* 映射对象的一段 */
+#define FDCA_VM_BIND_OP_UNMAP       1        /* 解除一段虚拟地址的映射 */
+
+/* VM_BIND 映射标志 */
+#define FDCA_VM_BIND_READONLY       BIT(0)   /* GPU 只读映射 */
+
+/* 单次 VM_BIND 的操作数上限 */
+#define FDCA_VM_BIND_MAX_OPS        512
+
+/* 用户态提交队列命令包标志 (与内核环形缓冲区编码一致) */
+#define FDCA_UMQ_PKT_SKIP           (1u << 0) /* 设备跳过该包 */
+#define FDCA_UMQ_PKT_LAST           (1u << 1) /* 批次最后一个包 */
+#define FDCA_UMQ_PKT_FENCE          (1u << 2) /* 前序包完成后把 seqno 写入完成页 */
+#define FDCA_UMQ_PKT_ALIGN          8         /* 命令包对齐 */
 
 /*
  * ============================================================================
@@ -60,6 +105,18 @@ struct drm_fdca_gem_create {
     __u32 handle;       /* 返回句柄 */
 };
 
+/**
+ * struct drm_fdca_gem_userptr - 以用户态内存创建 GEM 对象
+ * 
+ * addr 和 size 须页对齐。对象不能再经 GEM_MMAP 映射
+ */
+struct drm_fdca_gem_userptr {
+    __u64 addr;         /* 用户虚拟地址 */
+    __u64 size;         /* 字节数 */
+    __u32 flags;        /* FDCA_USERPTR_* */
+    __u32 handle;       /* 返回句柄 */
+};
+
 /**
  * struct drm_fdca_gem_mmap - 映射 GEM 对象
  */
@@ -108,7 +165,20 @@ struct drm_fdca_command {
     __u64 data_ptr;     /* 命令数据指针 */
     __u32 num_deps;     /* 依赖数量 */
     __u32 pad;
-    __u64 deps_ptr;     /* 依赖数组指针 */
+    __u64 deps_ptr;     /* 依赖数组指针 (同一上下文的 __u32 fence ID) */
+};
+
+/**
+ * struct drm_fdca_syncobj - syncobj 时间点
+ * 
+ * 二值 syncobj 忽略 point；时间线 syncobj 的 point 不能为 0。
+ * 等待多个时间点使用 DRM 核心的 DRM_IOCTL_SYNCOBJ_TIMELINE_WAIT，
+ * 它支持全部/任一、等待提交和可重启的绝对超时
+ */
+struct drm_fdca_syncobj {
+    __u32 handle;       /* drm_syncobj 句柄 */
+    __u32 flags;        /* FDCA_SYNCOBJ_* */
+    __u64 point;        /* 时间线点 */
 };
 
 /**
@@ -120,32 +190,190 @@ struct drm_fdca_submit {
     __u32 num_cmds;     /* 命令数量 */
     __u32 fence_out;    /* 输出栅栏 ID */
     __u64 cmds_ptr;     /* 命令数组指针 */
-    __u64 fence_in;     /* 输入栅栏 ID */
+    __u64 fence_in;     /* 输入栅栏 ID，须不超过 32 位 */
+    __u32 num_in_syncs; /* 输入 syncobj 数量 */
+    __u32 num_out_syncs; /* 输出 syncobj 数量 */
+    __u64 in_syncs_ptr; /* 输入 drm_fdca_syncobj 数组指针 */
+    __u64 out_syncs_ptr; /* 输出 drm_fdca_syncobj 数组指针 */
+    __u32 num_bos;      /* 引用的 GEM 对象数量 */
+    __u32 pad;
+    __u64 bos_ptr;      /* GEM 句柄数组指针 (__u32)，作业完成前这些对象不会被驱逐 */
+};
+
+/**
+ * struct drm_fdca_vm_bind_op - 一个地址空间操作
+ * 
+ * 地址、长度和对象内偏移必须页对齐。UNMAP 忽略 handle 和 bo_offset，
+ * 可以只覆盖已有映射的一部分
+ */
+struct drm_fdca_vm_bind_op {
+    __u32 op;           /* FDCA_VM_BIND_OP_* */
+    __u32 handle;       /* GEM 句柄 (MAP) */
+    __u64 bo_offset;    /* 对象内偏移 (MAP) */
+    __u64 va;           /* GPU 虚拟地址 */
+    __u64 range;        /* 字节数 */
+    __u32 flags;        /* FDCA_VM_BIND_* (MAP) */
+    __u32 pad;
+};
+
+/**
+ * struct drm_fdca_vm_bind - 异步更新上下文地址空间
+ * 
+ * 操作按数组顺序执行，同一上下文的多次 VM_BIND 按提交顺序执行。
+ * 输入 syncobj 全部触发后才修改页表；解除映射还会等待已提交、
+ * 仍在使用该地址空间的作业完成。全部操作完成后输出 syncobj 触发，
+ * 后续提交以它作为输入即可使用新映射
+ */
+struct drm_fdca_vm_bind {
+    __u32 num_ops;      /* 操作数量 */
+    __u32 flags;        /* 保留，必须为 0 */
+    __u64 ops_ptr;      /* drm_fdca_vm_bind_op 数组指针 */
+    __u32 num_in_syncs; /* 输入 syncobj 数量 */
+    __u32 num_out_syncs; /* 输出 syncobj 数量 */
+    __u64 in_syncs_ptr; /* 输入 drm_fdca_syncobj 数组指针 */
+    __u64 out_syncs_ptr; /* 输出 drm_fdca_syncobj 数组指针 */
+};
+
+/* 单次拷贝提交的区域数上限 */
+#define FDCA_COPY_MAX_REGIONS       256
+
+/**
+ * struct drm_fdca_copy_region - 一段对象间拷贝
+ * 
+ * 同一对象内源与目的区间不能重叠
+ */
+struct drm_fdca_copy_region {
+    __u32 src_handle;   /* 源对象句柄 */
+    __u32 dst_handle;   /* 目的对象句柄 */
+    __u64 src_offset;   /* 源对象内偏移 */
+    __u64 dst_offset;   /* 目的对象内偏移 */
+    __u64 size;         /* 字节数 */
+};
+
+/**
+ * struct drm_fdca_copy - 异步拷贝
+ * 
+ * 输入 syncobj 全部触发后执行，完成时触发输出 syncobj
+ */
+struct drm_fdca_copy {
+    __u64 regions_ptr;  /* drm_fdca_copy_region 数组指针 */
+    __u32 num_regions;  /* 区域数 */
+    __u32 flags;        /* 保留，须为 0 */
+    __u32 num_in_syncs; /* 输入 syncobj 数量 */
+    __u32 num_out_syncs; /* 输出 syncobj 数量 */
+    __u64 in_syncs_ptr; /* 输入 drm_fdca_syncobj 数组指针 */
+    __u64 out_syncs_ptr; /* 输出 drm_fdca_syncobj 数组指针 */
+};
+
+/**
+ * struct drm_fdca_gem_pwrite - 把用户数据写入对象
+ * 
+ * 经驱动的暂存缓冲中转，返回时数据已写入对象
+ */
+struct drm_fdca_gem_pwrite {
+    __u32 handle;       /* 对象句柄 */
+    __u32 pad;
+    __u64 offset;       /* 对象内偏移 */
+    __u64 size;         /* 字节数 */
+    __u64 data_ptr;     /* 用户数据指针 */
+};
+
+/**
+ * struct drm_fdca_gem_pread - 把对象内容读到用户内存
+ */
+struct drm_fdca_gem_pread {
+    __u32 handle;       /* 对象句柄 */
+    __u32 pad;
+    __u64 offset;       /* 对象内偏移 */
+    __u64 size;         /* 字节数 */
+    __u64 data_ptr;     /* 用户缓冲指针 */
+};
+
+/**
+ * struct drm_fdca_umq_create - 创建用户态提交队列
+ * 
+ * 环、门铃页和完成页通过返回的偏移在 DRM 设备文件上 mmap。
+ * 用户态把命令包写入环后更新门铃页中的写指针即完成提交，不再经过 ioctl
+ */
+struct drm_fdca_umq_create {
+    __u32 flags;            /* FDCA_SUBMIT_CAU 或 FDCA_SUBMIT_CFU */
+    __u32 umq_id;           /* 返回队列 ID */
+    __u32 ring_size;        /* 返回环大小 (字节，2 的幂) */
+    __u32 pad;
+    __u64 ring_offset;      /* 返回环的 mmap 偏移 (读写) */
+    __u64 doorbell_offset;  /* 返回门铃页的 mmap 偏移 (读写，struct drm_fdca_umq_doorbell) */
+    __u64 fence_offset;     /* 返回完成页的 mmap 偏移 (只读，struct drm_fdca_umq_fence) */
+};
+
+/**
+ * struct drm_fdca_umq_destroy - 销毁用户态提交队列
+ * 
+ * 队列立即停止消费，已建立的映射在 munmap 之前保持有效
+ */
+struct drm_fdca_umq_destroy {
+    __u32 umq_id;           /* 队列 ID */
+    __u32 pad;
+};
+
+/**
+ * struct drm_fdca_umq_doorbell - 门铃页布局
+ * 
+ * wptr 为单调递增的字节偏移 (对环大小取模得到环内位置)，
+ * 必须在命令包写入完成之后以 release 语义更新
+ */
+struct drm_fdca_umq_doorbell {
+    __u32 wptr;             /* 写指针 */
+    __u32 pad;
+};
+
+/**
+ * struct drm_fdca_umq_fence - 完成页布局
+ * 
+ * 命令包头为 {__u32 type, size, flags, seqno}，包头加负载按
+ * FDCA_UMQ_PKT_ALIGN 对齐。带 FDCA_UMQ_PKT_FENCE 的包完成后设备把其
+ * seqno 写入本页；环中非法数据使队列停止并在 error 中给出错误码
+ */
+struct drm_fdca_umq_fence {
+    __u32 seqno;            /* 最后完成的 seqno */
+    __u32 error;            /* 非 0 表示队列因错误停止 */
 };
 
 /**
  * struct drm_fdca_wait - 等待操作
+ * 
+ * 默认先在有界窗口内轮询完成序号，再转入中断驱动的睡眠。
+ * 带 FDCA_WAIT_ABSOLUTE 时 timeout_ns 为 CLOCK_MONOTONIC 绝对截止时间；
+ * 被信号打断时内核把截止时间写回为绝对时间，重启的调用不会延长等待
  */
 struct drm_fdca_wait {
     __u32 ctx_id;       /* 上下文 ID */
     __u32 fence_id;     /* 栅栏 ID */
     __u64 timeout_ns;   /* 超时时间（纳秒） */
-    __u32 result;       /* 等待结果 */
-    __u32 pad;
+    __u32 result;       /* 等待结果 FDCA_WAIT_RESULT_* */
+    __u32 flags;        /* 等待标志 FDCA_WAIT_* */
 };
 
+/* 空闲块直方图的阶数上限 */
+#define FDCA_MEMORY_STATS_ORDERS    32
+
 /**
  * struct drm_fdca_memory_stats - 内存统计信息
+ * 
+ * 碎片率 = 100 - 最大空闲块 * 100 / 可用总量。
+ * vram_free_blocks[i] 为大小 vram_min_block << i 的空闲块数量
  */
 struct drm_fdca_memory_stats {
     __u64 vram_total;       /* VRAM 总大小 */
     __u64 vram_used;        /* VRAM 已使用 */
     __u64 vram_available;   /* VRAM 可用 */
     __u32 vram_fragmentation; /* VRAM 碎片率 */
-    __u32 pad;
+    __u32 vram_num_orders;  /* vram_free_blocks 的有效项数 */
     __u64 gtt_total;        /* GTT 总大小 */
     __u64 gtt_used;         /* GTT 已使用 */
     __u64 gtt_available;    /* GTT 可用 */
+    __u64 vram_largest_free; /* 最大空闲块 */
+    __u64 vram_min_block;   /* 最小块大小 (0 阶) */
+    __u32 vram_free_blocks[FDCA_MEMORY_STATS_ORDERS]; /* 每阶空闲块数 */
 };
 
 /**
@@ -176,6 +404,14 @@ struct drm_fdca_performance_info {
 #define DRM_FDCA_WAIT               0x07
 #define DRM_FDCA_GET_MEMORY_STATS   0x08
 #define DRM_FDCA_GET_PERF_INFO      0x09
+/* 0x0a 保留 (原 SYNCOBJ_WAIT，由 DRM_IOCTL_SYNCOBJ_TIMELINE_WAIT 取代) */
+#define DRM_FDCA_UMQ_CREATE         0x0b
+#define DRM_FDCA_UMQ_DESTROY        0x0c
+#define DRM_FDCA_VM_BIND            0x0d
+#define DRM_FDCA_GEM_USERPTR        0x0e
+#define DRM_FDCA_COPY               0x0f
+#define DRM_FDCA_GEM_PWRITE         0x10
+#define DRM_FDCA_GEM_PREAD          0x11
 
 #define DRM_IOCTL_FDCA_GET_PARAM    DRM_IOWR(DRM_COMMAND_BASE + DRM_FDCA_GET_PARAM, struct drm_fdca_get_param)
 #define DRM_IOCTL_FDCA_GEM_CREATE   DRM_IOWR(DRM_COMMAND_BASE + DRM_FDCA_GEM_CREATE, struct drm_fdca_gem_create)
@@ -187,5 +423,12 @@ struct drm_fdca_performance_info {
 #define DRM_IOCTL_FDCA_WAIT         DRM_IOWR(DRM_COMMAND_BASE + DRM_FDCA_WAIT, struct drm_fdca_wait)
 #define DRM_IOCTL_FDCA_GET_MEMORY_STATS DRM_IOR(DRM_COMMAND_BASE + DRM_FDCA_GET_MEMORY_STATS, struct drm_fdca_memory_stats)
 #define DRM_IOCTL_FDCA_GET_PERF_INFO DRM_IOR(DRM_COMMAND_BASE + DRM_FDCA_GET_PERF_INFO, struct drm_fdca_performance_info)
+#define DRM_IOCTL_FDCA_UMQ_CREATE   DRM_IOWR(DRM_COMMAND_BASE + DRM_FDCA_UMQ_CREATE, struct drm_fdca_umq_create)
+#define DRM_IOCTL_FDCA_UMQ_DESTROY  DRM_IOW(DRM_COMMAND_BASE + DRM_FDCA_UMQ_DESTROY, struct drm_fdca_umq_destroy)
+#define DRM_IOCTL_FDCA_VM_BIND      DRM_IOW(DRM_COMMAND_BASE + DRM_FDCA_VM_BIND, struct drm_fdca_vm_bind)
+#define DRM_IOCTL_FDCA_GEM_USERPTR  DRM_IOWR(DRM_COMMAND_BASE + DRM_FDCA_GEM_USERPTR, struct drm_fdca_gem_userptr)
+#define DRM_IOCTL_FDCA_COPY         DRM_IOW(DRM_COMMAND_BASE + DRM_FDCA_COPY, struct drm_fdca_copy)
+#define DRM_IOCTL_FDCA_GEM_PWRITE   DRM_IOW(DRM_COMMAND_BASE + DRM_FDCA_GEM_PWRITE, struct drm_fdca_gem_pwrite)
+#define DRM_IOCTL_FDCA_GEM_PREAD    DRM_IOW(DRM_COMMAND_BASE + DRM_FDCA_GEM_PREAD, struct drm_fdca_gem_pread)
 
 #endif /* __FDCA_UAPI_H__ */
@@ -0,0 +1,391 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * FDCA User-Mode Submission Queues
+ *
+ * 用户态提交队列:
+ * 1. 上下文独占一个硬件队列，环形缓冲区、门铃页和完成页各包装为一个
+ *    GEM 对象，经 drm_gem_mmap 映射给用户态
+ * 2. 用户态写入命令包后更新门铃页中的写指针，硬件轮询门铃页消费，
+ *    完成后把 FENCE 包的 seqno 写入完成页，整个提交路径不进入内核
+ * 3. 模拟后端由每个队列一个内核线程轮询门铃页，模拟设备消费并校验
+ *    用户态写入的数据
+ *
+ * 内核只在创建时校验参数并管理生命周期: 销毁后队列立即停止，
+ * 映射仍然有效的内存在 munmap 之后才释放
+ */
+
+#include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/delay.h>
+#include <linux/mm.h>
+#include <linux/dma-mapping.h>
+#include <drm/drm_gem.h>
+#include <drm/drm_vma_manager.h>
+#include "fdca_drv.h"
+#include "fdca_queue.h"
+
+/**
+ * struct fdca_umq_bo - 用户态队列映射对象
+ *
+ * 不占用 VRAM，只把已有的一致性 DMA 内存暴露给 mmap
+ */
+struct fdca_umq_bo {
+    struct drm_gem_object base;
+    struct fdca_umq *umq;           /* 持有队列引用 */
+    void *cpu;
+    dma_addr_t dma;
+    bool readonly;
+};
+
+static inline struct fdca_umq_bo *to_fdca_umq_bo(struct drm_gem_object *gem)
+{
+    return container_of(gem, struct fdca_umq_bo, base);
+}
+
+/* === 生命周期 === */
+
+static void fdca_umq_release(struct kref *ref)
+{
+    struct fdca_umq *umq = container_of(ref, struct fdca_umq, ref);
+
+    fdca_dbg(umq->fdev, "用户态队列 %u 释放: 门铃 %lld\n",
+             umq->id, atomic64_read(&umq->doorbells));
+
+    fdca_queue_destroy(umq->queue);
+    dma_free_coherent(umq->fdev->dev, PAGE_SIZE, umq->doorbell, umq->doorbell_dma);
+    kfree(umq);
+}
+
+static inline void fdca_umq_put(struct fdca_umq *umq)
+{
+    kref_put(&umq->ref, fdca_umq_release);
+}
+
+/* === 映射对象 === */
+
+static void fdca_umq_bo_free(struct drm_gem_object *gem)
+{
+    struct fdca_umq_bo *bo = to_fdca_umq_bo(gem);
+
+    drm_gem_object_release(gem);
+    fdca_umq_put(bo->umq);
+    kfree(bo);
+}
+
+static int fdca_umq_bo_mmap(struct drm_gem_object *gem, struct vm_area_struct *vma)
+{
+    struct fdca_umq_bo *bo = to_fdca_umq_bo(gem);
+
+    if (bo->readonly) {
+        if (vma->vm_flags & VM_WRITE)
+            return -EPERM;
+        vm_flags_clear(vma, VM_MAYWRITE);
+    }
+
+    /* drm_gem_mmap 传入的是伪偏移 */
+    vma->vm_pgoff -= drm_vma_node_start(&gem->vma_node);
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+
+    return dma_mmap_coherent(gem->dev->dev, vma, bo->cpu, bo->dma, gem->size);
+}
+
+static const struct vm_operations_struct fdca_umq_vm_ops = {
+    .open = drm_gem_vm_open,
+    .close = drm_gem_vm_close,
+};
+
+static const struct drm_gem_object_funcs fdca_umq_bo_funcs = {
+    .free = fdca_umq_bo_free,
+    .mmap = fdca_umq_bo_mmap,
+    .vm_ops = &fdca_umq_vm_ops,
+};
+
+/**
+ * fdca_umq_bo_create() - 为一段一致性内存创建映射对象
+ * @offset: 输出：mmap 偏移
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_umq_bo_create(struct fdca_umq *umq, struct drm_file *file,
+                              enum fdca_umq_bo_type type, void *cpu, dma_addr_t dma,
+                              size_t size, bool readonly, u64 *offset)
+{
+    struct fdca_umq_bo *bo;
+    int ret;
+
+    bo = kzalloc(sizeof(*bo), GFP_KERNEL);
+    if (!bo)
+        return -ENOMEM;
+
+    drm_gem_private_object_init(&umq->fdev->drm, &bo->base, size);
+    bo->base.funcs = &fdca_umq_bo_funcs;
+    bo->cpu = cpu;
+    bo->dma = dma;
+    bo->readonly = readonly;
+    bo->umq = umq;
+    kref_get(&umq->ref);
+
+    /* 之后的失败路径由 put 释放，包括队列引用 */
+    ret = drm_gem_create_mmap_offset(&bo->base);
+    if (ret)
+        goto err_put;
+
+    /* 没有句柄，直接授权本文件访问映射偏移 */
+    ret = drm_vma_node_allow(&bo->base.vma_node, file);
+    if (ret)
+        goto err_put;
+
+    *offset = drm_vma_node_offset_addr(&bo->base.vma_node);
+    umq->bos[type] = &bo->base;
+
+    return 0;
+
+err_put:
+    drm_gem_object_put(&bo->base);
+    return ret;
+}
+
+/* === 模拟消费者 === */
+
+/**
+ * fdca_umq_consumer() - 模拟设备轮询门铃页
+ *
+ * 空闲时先自旋再退避睡眠；环中出现非法数据时把错误写入完成页并停止，
+ * 与硬件遇到非法包时停止队列的行为一致
+ */
+static int fdca_umq_consumer(void *data)
+{
+    struct fdca_umq *umq = data;
+    struct fdca_queue *queue = umq->queue;
+    struct drm_fdca_umq_fence *status = (void *)queue->fence_cpu;
+    u32 wptr, idle = 0;
+    int ret;
+
+    while (!kthread_should_stop()) {
+        wptr = smp_load_acquire(&umq->doorbell->wptr);
+        if (wptr == queue->sim_rptr) {
+            if (++idle < FDCA_UMQ_SPIN_POLLS) {
+                cond_resched();
+                continue;
+            }
+            usleep_range(FDCA_UMQ_POLL_MIN_US, FDCA_UMQ_POLL_MAX_US);
+            continue;
+        }
+
+        idle = 0;
+        atomic64_inc(&umq->doorbells);
+
+        ret = fdca_queue_sim_consume(queue, wptr);
+        fdca_queue_retire(queue);
+        if (ret) {
+            fdca_err(umq->fdev, "用户态队列 %u: 非法数据 (读指针=%u, 写指针=%u)，停止\n",
+                     umq->id, queue->sim_rptr, wptr);
+            WRITE_ONCE(status->error, -ret);
+            break;
+        }
+    }
+
+    /* 出错停止后等待销毁 */
+    set_current_state(TASK_INTERRUPTIBLE);
+    while (!kthread_should_stop()) {
+        schedule();
+        set_current_state(TASK_INTERRUPTIBLE);
+    }
+    __set_current_state(TASK_RUNNING);
+
+    return 0;
+}
+
+/* === 创建和销毁 === */
+
+/**
+ * fdca_umq_create() - 创建用户态提交队列
+ * @ctx: 上下文
+ * @file: DRM 文件 (映射偏移只对该文件开放)
+ * @type: 队列类型
+ * @args: 输出队列 ID、环大小和三个 mmap 偏移
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_umq_create(struct fdca_context *ctx, struct drm_file *file,
+                    enum fdca_queue_type type, struct drm_fdca_umq_create *args)
+{
+    struct fdca_device *fdev = ctx->fdev;
+    struct fdca_queue *queue;
+    struct fdca_umq *umq;
+    u32 id;
+    int ret, i;
+
+    BUILD_BUG_ON(FDCA_UMQ_PKT_SKIP != FDCA_RING_PKT_SKIP);
+    BUILD_BUG_ON(FDCA_UMQ_PKT_LAST != FDCA_RING_PKT_LAST);
+    BUILD_BUG_ON(FDCA_UMQ_PKT_FENCE != FDCA_RING_PKT_FENCE);
+    BUILD_BUG_ON(FDCA_UMQ_PKT_ALIGN != FDCA_QUEUE_PKT_ALIGN);
+    BUILD_BUG_ON(sizeof(struct drm_fdca_umq_fence) > PAGE_SIZE);
+
+    umq = kzalloc(sizeof(*umq), GFP_KERNEL);
+    if (!umq)
+        return -ENOMEM;
+
+    kref_init(&umq->ref);
+    umq->fdev = fdev;
+    atomic64_set(&umq->doorbells, 0);
+
+    umq->doorbell = dma_alloc_coherent(fdev->dev, PAGE_SIZE, &umq->doorbell_dma,
+                                       GFP_KERNEL);
+    if (!umq->doorbell) {
+        ret = -ENOMEM;
+        goto err_free_umq;
+    }
+
+    queue = fdca_queue_create(fdev, type);
+    if (IS_ERR(queue)) {
+        ret = PTR_ERR(queue);
+        goto err_free_doorbell;
+    }
+    umq->queue = queue;
+    fdca_queue_set_vm(queue, ctx->vm);
+
+    /*
+     * 从此由引用计数负责释放队列和门铃页。先只预留 ID，完全初始化后
+     * 再发布，并发的销毁在此之前找不到该队列
+     */
+    ret = xa_alloc(&ctx->umqs, &id, NULL, XA_LIMIT(1, FDCA_UMQ_MAX_PER_CTX),
+                   GFP_KERNEL);
+    if (ret) {
+        ret = (ret == -EBUSY) ? -ENOSPC : ret;
+        goto err_put;
+    }
+    umq->id = id;
+
+    ret = fdca_umq_bo_create(umq, file, FDCA_UMQ_BO_RING, queue->cmd_buffer,
+                             queue->cmd_buffer_dma, queue->cmd_buffer_size,
+                             false, &args->ring_offset);
+    if (ret)
+        goto err_erase;
+
+    ret = fdca_umq_bo_create(umq, file, FDCA_UMQ_BO_DOORBELL, umq->doorbell,
+                             umq->doorbell_dma, PAGE_SIZE, false,
+                             &args->doorbell_offset);
+    if (ret)
+        goto err_erase;
+
+    ret = fdca_umq_bo_create(umq, file, FDCA_UMQ_BO_FENCE, queue->fence_cpu,
+                             queue->fence_dma, PAGE_SIZE, true,
+                             &args->fence_offset);
+    if (ret)
+        goto err_erase;
+
+    fdca_queue_set_user_mode(queue, umq->doorbell_dma);
+
+    if (queue->simulated) {
+        umq->consumer = kthread_run(fdca_umq_consumer, umq, "fdca-umq/%u:%u",
+                                    ctx->ctx_id, id);
+        if (IS_ERR(umq->consumer)) {
+            ret = PTR_ERR(umq->consumer);
+            umq->consumer = NULL;
+            goto err_erase;
+        }
+    }
+
+    ret = xa_err(xa_store(&ctx->umqs, id, umq, GFP_KERNEL));
+    if (ret)
+        goto err_stop;
+
+    args->umq_id = id;
+    args->ring_size = queue->cmd_buffer_size;
+
+    fdca_dbg(fdev, "用户态队列创建: 上下文=%u, ID=%u, 硬件队列=%u%s\n",
+             ctx->ctx_id, id, queue->id, queue->simulated ? " (模拟)" : "");
+
+    return 0;
+
+err_stop:
+    if (umq->consumer)
+        kthread_stop(umq->consumer);
+err_erase:
+    xa_erase(&ctx->umqs, id);
+    for (i = 0; i < FDCA_UMQ_BO_MAX; i++) {
+        if (!umq->bos[i])
+            continue;
+        drm_vma_node_revoke(&umq->bos[i]->vma_node, file);
+        drm_gem_object_put(umq->bos[i]);
+    }
+err_put:
+    fdca_queue_ban(queue, -ECANCELED);
+    fdca_umq_put(umq);
+    return ret;
+
+err_free_doorbell:
+    dma_free_coherent(fdev->dev, PAGE_SIZE, umq->doorbell, umq->doorbell_dma);
+err_free_umq:
+    kfree(umq);
+    return ret;
+}
+
+/**
+ * fdca_umq_teardown() - 停止队列并释放上下文持有的引用
+ */
+static void fdca_umq_teardown(struct fdca_umq *umq, struct drm_file *file)
+{
+    int i;
+
+    if (umq->consumer)
+        kthread_stop(umq->consumer);
+
+    /* 停止硬件消费，用户态之后写入的数据不再被执行 */
+    fdca_queue_ban(umq->queue, -ECANCELED);
+
+    for (i = 0; i < FDCA_UMQ_BO_MAX; i++) {
+        if (!umq->bos[i])
+            continue;
+        drm_vma_node_revoke(&umq->bos[i]->vma_node, file);
+        drm_gem_object_put(umq->bos[i]);
+        umq->bos[i] = NULL;
+    }
+
+    fdca_umq_put(umq);
+}
+
+/**
+ * fdca_umq_destroy() - 销毁用户态提交队列
+ * @ctx: 上下文
+ * @file: DRM 文件
+ * @id: 队列 ID
+ *
+ * Return: 0 表示成功，-ENOENT 表示队列不存在
+ */
+int fdca_umq_destroy(struct fdca_context *ctx, struct drm_file *file, u32 id)
+{
+    struct fdca_umq *umq;
+
+    /* 创建中的队列只预留了 ID，读到 NULL，不能把预留删掉 */
+    xa_lock(&ctx->umqs);
+    umq = xa_load(&ctx->umqs, id);
+    if (umq)
+        __xa_erase(&ctx->umqs, id);
+    xa_unlock(&ctx->umqs);
+    if (!umq)
+        return -ENOENT;
+
+    fdca_umq_teardown(umq, file);
+    return 0;
+}
+
+/**
+ * fdca_umq_ctx_fini() - 销毁上下文的全部用户态提交队列
+ */
+void fdca_umq_ctx_fini(struct fdca_context *ctx, struct drm_file *file)
+{
+    struct fdca_umq *umq;
+    unsigned long id;
+
+    xa_for_each(&ctx->umqs, id, umq) {
+        xa_erase(&ctx->umqs, id);
+        fdca_umq_teardown(umq, file);
+    }
+    xa_destroy(&ctx->umqs);
+}
+
+EXPORT_SYMBOL_GPL(fdca_umq_create);
+EXPORT_SYMBOL_GPL(fdca_umq_destroy);
+EXPORT_SYMBOL_GPL(fdca_umq_ctx_fini);
@@ -4,13 +4,24 @@
  * 
  * 支持 unit-strided, strided, indexed 和 segment 内存操作
  * 实现高效的向量数据传输
+ * 
+ * 索引数组和数据暂存从设备的分档 DMA 缓冲池分配
  */
 
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
+#include <linux/dmapool.h>
 #include "fdca_drv.h"
 #include "fdca_rvv_instr.h"
 
+/* DMA 缓冲 */
+struct fdca_vmem_buf {
+    void *cpu_addr;
+    dma_addr_t dma_addr;
+    size_t size;
+    int pool_idx;                 /* 所属尺寸档，-1 表示直接一致性分配 */
+};
+
 /* 向量内存操作描述符 */
 struct fdca_vector_mem_op {
     enum fdca_vmem_type type;
@@ -22,10 +33,139 @@ struct fdca_vector_mem_op {
     bool is_load;                 /* 是否为加载操作 */
     
     /* DMA 相关 */
+    struct fdca_vmem_buf data;    /* 数据暂存 */
+    struct fdca_vmem_buf index;   /* 索引数组 (indexed 模式) */
+};
+
+/*
+ * ============================================================================
+ * DMA 缓冲池
+ * ============================================================================
+ *
+ * 一致性分配代价很高，每次操作分配会占满 indexed 访问的热路径。
+ * 缓冲按大小分档从 dma_pool 分配，释放的块留在池内复用；初始化时每档
+ * 预热一块。超过最大档的请求仍直接做一致性分配并计数
+ */
+
+static const size_t fdca_vmem_pool_sizes[FDCA_VMEM_POOL_CLASSES] = {
+    SZ_256, SZ_4K, SZ_64K,
+};
+
+static const char * const fdca_vmem_pool_names[FDCA_VMEM_POOL_CLASSES] = {
+    "fdca-vmem-256", "fdca-vmem-4k", "fdca-vmem-64k",
+};
+
+/**
+ * fdca_vmem_buf_alloc() - 分配 DMA 缓冲
+ * @fdev: FDCA 设备
+ * @buf: 输出
+ * @size: 字节数
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vmem_buf_alloc(struct fdca_device *fdev, struct fdca_vmem_buf *buf,
+                               size_t size)
+{
+    struct fdca_vmem_pools *vp = &fdev->vmem_pools;
+    int i;
+    
+    buf->size = size;
+    
+    for (i = 0; i < FDCA_VMEM_POOL_CLASSES; i++) {
+        if (size > fdca_vmem_pool_sizes[i])
+            continue;
+        
+        buf->cpu_addr = dma_pool_alloc(vp->pools[i], GFP_KERNEL, &buf->dma_addr);
+        if (!buf->cpu_addr)
+            return -ENOMEM;
+        
+        buf->pool_idx = i;
+        atomic64_inc(&vp->allocs[i]);
+        return 0;
+    }
+    
+    buf->cpu_addr = dma_alloc_coherent(fdev->dev, size, &buf->dma_addr, GFP_KERNEL);
+    if (!buf->cpu_addr)
+        return -ENOMEM;
+    
+    buf->pool_idx = -1;
+    atomic64_inc(&vp->fallbacks);
+    return 0;
+}
+
+/**
+ * fdca_vmem_buf_free() - 释放 DMA 缓冲
+ * @fdev: FDCA 设备
+ * @buf: 缓冲，未分配时忽略
+ */
+static void fdca_vmem_buf_free(struct fdca_device *fdev, struct fdca_vmem_buf *buf)
+{
+    if (!buf->cpu_addr)
+        return;
+    
+    if (buf->pool_idx >= 0)
+        dma_pool_free(fdev->vmem_pools.pools[buf->pool_idx], buf->cpu_addr,
+                      buf->dma_addr);
+    else
+        dma_free_coherent(fdev->dev, buf->size, buf->cpu_addr, buf->dma_addr);
+    
+    buf->cpu_addr = NULL;
+}
+
+/**
+ * fdca_vector_mem_fini() - 销毁 DMA 缓冲池
+ * @fdev: FDCA 设备
+ * 
+ * 调用前所有向量内存操作必须已完成
+ */
+void fdca_vector_mem_fini(struct fdca_device *fdev)
+{
+    struct fdca_vmem_pools *vp = &fdev->vmem_pools;
+    int i;
+    
+    for (i = 0; i < FDCA_VMEM_POOL_CLASSES; i++) {
+        dma_pool_destroy(vp->pools[i]);
+        vp->pools[i] = NULL;
+    }
+}
+
+/**
+ * fdca_vector_mem_init() - 创建并预热 DMA 缓冲池
+ * @fdev: FDCA 设备
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_vector_mem_init(struct fdca_device *fdev)
+{
+    struct fdca_vmem_pools *vp = &fdev->vmem_pools;
     dma_addr_t dma_addr;
     void *cpu_addr;
-    size_t total_size;
-};
+    int i;
+    
+    for (i = 0; i < FDCA_VMEM_POOL_CLASSES; i++) {
+        atomic64_set(&vp->allocs[i], 0);
+        
+        vp->pools[i] = dma_pool_create(fdca_vmem_pool_names[i], fdev->dev,
+                                       fdca_vmem_pool_sizes[i], 64, 0);
+        if (!vp->pools[i])
+            goto err_destroy;
+        
+        /* 预热: 块释放后留在池内，首次操作不再触发一致性分配 */
+        cpu_addr = dma_pool_alloc(vp->pools[i], GFP_KERNEL, &dma_addr);
+        if (!cpu_addr)
+            goto err_destroy;
+        dma_pool_free(vp->pools[i], cpu_addr, dma_addr);
+    }
+    
+    atomic64_set(&vp->fallbacks, 0);
+    
+    return 0;
+    
+err_destroy:
+    fdca_err(fdev, "向量内存缓冲池创建失败: %zu 字节档\n", fdca_vmem_pool_sizes[i]);
+    fdca_vector_mem_fini(fdev);
+    return -ENOMEM;
+}
 
 /**
  * fdca_vector_mem_prepare_dma() - 准备 DMA 传输
@@ -33,36 +173,48 @@ struct fdca_vector_mem_op {
 static int fdca_vector_mem_prepare_dma(struct fdca_device *fdev,
                                       struct fdca_vector_mem_op *op)
 {
+    size_t total_size;
+    int ret;
+    
     /* 计算总传输大小 */
     switch (op->type) {
     case FDCA_VMEM_UNIT_STRIDE:
-        op->total_size = op->num_elements * op->element_size;
+        total_size = (size_t)op->num_elements * op->element_size;
         break;
         
     case FDCA_VMEM_STRIDED:
-        op->total_size = op->num_elements * op->stride;
+        total_size = (size_t)op->num_elements * op->stride;
         break;
         
     case FDCA_VMEM_INDEXED:
         /* 最大可能的大小 */
-        op->total_size = op->num_elements * op->element_size;
+        total_size = (size_t)op->num_elements * op->element_size;
         break;
         
     case FDCA_VMEM_SEGMENT:
         /* 分段操作的总大小 */
-        op->total_size = op->num_elements * op->element_size;
+        total_size = (size_t)op->num_elements * op->element_size;
         break;
         
     default:
         return -EINVAL;
     }
     
-    /* 分配 DMA 一致性内存 */
-    op->cpu_addr = dma_alloc_coherent(fdev->dev, op->total_size,
-                                     &op->dma_addr, GFP_KERNEL);
-    if (!op->cpu_addr) {
-        fdca_err(fdev, "DMA 内存分配失败: %zu 字节\n", op->total_size);
-        return -ENOMEM;
+    ret = fdca_vmem_buf_alloc(fdev, &op->data, total_size);
+    if (ret) {
+        fdca_err(fdev, "DMA 内存分配失败: %zu 字节\n", total_size);
+        return ret;
+    }
+    
+    /* 索引数组与数据同时准备，硬件完成前不能释放 */
+    if (op->type == FDCA_VMEM_INDEXED) {
+        ret = fdca_vmem_buf_alloc(fdev, &op->index,
+                                  (size_t)op->num_elements * sizeof(u32));
+        if (ret) {
+            fdca_err(fdev, "索引数组 DMA 分配失败\n");
+            fdca_vmem_buf_free(fdev, &op->data);
+            return ret;
+        }
     }
     
     return 0;
@@ -74,11 +226,8 @@ static int fdca_vector_mem_prepare_dma(struct fdca_device *fdev,
 static void fdca_vector_mem_cleanup_dma(struct fdca_device *fdev,
                                        struct fdca_vector_mem_op *op)
 {
-    if (op->cpu_addr) {
-        dma_free_coherent(fdev->dev, op->total_size,
-                         op->cpu_addr, op->dma_addr);
-        op->cpu_addr = NULL;
-    }
+    fdca_vmem_buf_free(fdev, &op->index);
+    fdca_vmem_buf_free(fdev, &op->data);
 }
 
 /**
@@ -94,7 +243,7 @@ static int fdca_vector_mem_unit_stride(struct fdca_device *fdev,
     iowrite64(op->base_addr, reg_base + 0x100);          /* 基地址 */
     iowrite32(op->num_elements, reg_base + 0x108);       /* 元素数量 */
     iowrite32(op->element_size, reg_base + 0x10C);       /* 元素大小 */
-    iowrite64(op->dma_addr, reg_base + 0x110);           /* DMA 地址 */
+    iowrite64(op->data.dma_addr, reg_base + 0x110);      /* DMA 地址 */
     
     /* 设置控制寄存器 */
     ctrl_reg = (op->is_load ? BIT(0) : 0) |               /* 加载/存储 */
@@ -124,7 +273,7 @@ static int fdca_vector_mem_strided(struct fdca_device *fdev,
     iowrite32(op->stride, reg_base + 0x128);             /* 步长 */
     iowrite32(op->num_elements, reg_base + 0x12C);       /* 元素数量 */
     iowrite32(op->element_size, reg_base + 0x130);       /* 元素大小 */
-    iowrite64(op->dma_addr, reg_base + 0x134);           /* DMA 地址 */
+    iowrite64(op->data.dma_addr, reg_base + 0x134);      /* DMA 地址 */
     
     /* 设置控制寄存器 */
     ctrl_reg = (op->is_load ? BIT(0) : 0) |               /* 加载/存储 */
@@ -147,30 +296,20 @@ static int fdca_vector_mem_indexed(struct fdca_device *fdev,
                                   struct fdca_vector_mem_op *op)
 {
     void __iomem *reg_base = fdev->units[FDCA_UNIT_VPU].mmio_base;
-    dma_addr_t indices_dma;
-    void *indices_cpu;
-    size_t indices_size;
     u32 ctrl_reg;
-    int ret = 0;
-    
-    /* 准备索引数组的 DMA 传输 */
-    indices_size = op->num_elements * sizeof(u32);
-    indices_cpu = dma_alloc_coherent(fdev->dev, indices_size,
-                                    &indices_dma, GFP_KERNEL);
-    if (!indices_cpu) {
-        fdca_err(fdev, "索引数组 DMA 分配失败\n");
-        return -ENOMEM;
-    }
     
-    /* 复制索引数据 */
-    memcpy(indices_cpu, op->indices, indices_size);
+    if (!op->indices)
+        return -EINVAL;
+    
+    /* 复制索引数据，缓冲已在 prepare_dma 中分配 */
+    memcpy(op->index.cpu_addr, op->indices, op->index.size);
     
     /* 配置 indexed 操作 */
     iowrite64(op->base_addr, reg_base + 0x140);          /* 基地址 */
-    iowrite64(indices_dma, reg_base + 0x148);            /* 索引数组地址 */
+    iowrite64(op->index.dma_addr, reg_base + 0x148);     /* 索引数组地址 */
     iowrite32(op->num_elements, reg_base + 0x150);       /* 元素数量 */
     iowrite32(op->element_size, reg_base + 0x154);       /* 元素大小 */
-    iowrite64(op->dma_addr, reg_base + 0x158);           /* DMA 地址 */
+    iowrite64(op->data.dma_addr, reg_base + 0x158);      /* DMA 地址 */
     
     /* 设置控制寄存器 */
     ctrl_reg = (op->is_load ? BIT(0) : 0) |               /* 加载/存储 */
@@ -183,10 +322,7 @@ static int fdca_vector_mem_indexed(struct fdca_device *fdev,
     fdca_dbg(fdev, "Indexed 操作: 基地址=0x%llx, 元素=%u\n",
              op->base_addr, op->num_elements);
     
-    /* 清理索引数组 */
-    dma_free_coherent(fdev->dev, indices_size, indices_cpu, indices_dma);
-    
-    return ret;
+    return 0;
 }
 
 /**
@@ -204,7 +340,7 @@ static int fdca_vector_mem_segment(struct fdca_device *fdev,
     iowrite32(num_fields, reg_base + 0x188);             /* 字段数量 */
     iowrite32(op->num_elements, reg_base + 0x18C);       /* 元素数量 */
     iowrite32(op->element_size, reg_base + 0x190);       /* 元素大小 */
-    iowrite64(op->dma_addr, reg_base + 0x194);           /* DMA 地址 */
+    iowrite64(op->data.dma_addr, reg_base + 0x194);      /* DMA 地址 */
     
     /* 设置控制寄存器 */
     ctrl_reg = (op->is_load ? BIT(0) : 0) |               /* 加载/存储 */
@@ -386,6 +522,8 @@ int fdca_vector_mem_set_indices(struct fdca_vector_mem_op *op,
     return 0;
 }
 
+EXPORT_SYMBOL_GPL(fdca_vector_mem_init);
+EXPORT_SYMBOL_GPL(fdca_vector_mem_fini);
 EXPORT_SYMBOL_GPL(fdca_vector_mem_execute);
 EXPORT_SYMBOL_GPL(fdca_vector_mem_create_op);
 EXPORT_SYMBOL_GPL(fdca_vector_mem_destroy_op);
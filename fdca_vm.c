@@ -0,0 +1,1770 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * FDCA (Fangzheng Distributed Computing Architecture) GPU Virtual Memory
+ *
+ * Copyright (C) 2024 Fangzheng Technology Co., Ltd.
+ *
+ * 上下文 GPU 虚拟地址空间
+ *
+ * 本模块负责：
+ * 1. 使用 drm_gpuvm 管理每个上下文独立的虚拟地址区间
+ * 2. 三级页表 (1GB/2MB/4KB) 的按需分配和回收
+ * 3. VRAM 和系统内存对象到虚拟地址的映射
+ * 4. 对象迁移后更新所有地址空间中的页表项
+ * 5. 地址空间 ID 分配和 TLB 失效
+ * 6. VM_BIND 异步映射/解映射作业
+ * 7. 用户指针对象失效时撤销页表项
+ *
+ * 每个上下文的硬件队列在创建时绑定到该上下文的 L0 页表，不同上下文
+ * 互不可见。全局 GTT 窗口在每个地址空间中保留，内核映射 (以及
+ * fdca_gem_object_bind() 返回的地址) 继续经全局 GTT 翻译。
+ *
+ * Author: FDCA Kernel Team
+ * Date: 2024
+ */
+
+#include <linux/slab.h>
+#include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
+
+#include <drm/drm_exec.h>
+#include <drm/drm_gem.h>
+#include <drm/drm_gpuvm.h>
+#include <drm/drm_syncobj.h>
+#include <drm/gpu_scheduler.h>
+
+#include "fdca_drv.h"
+#include "fdca_uapi.h"
+
+/*
+ * ============================================================================
+ * 地址空间配置
+ * ============================================================================
+ */
+
+/* 每级页表 512 项，恰好占一页 */
+#define FDCA_VM_PT_ENTRIES      512
+#define FDCA_VM_PT_SIZE         (FDCA_VM_PT_ENTRIES * sizeof(u64))
+
+/* 三级页表覆盖 39 位虚拟地址 (512GB) */
+#define FDCA_VM_VA_BITS         39
+#define FDCA_VM_VA_SIZE         (1ULL << FDCA_VM_VA_BITS)
+
+/* 全局 GTT 窗口在每个地址空间中保留 */
+#define FDCA_VM_RESERVED_START  FDCA_GTT_START_ADDR
+#define FDCA_VM_RESERVED_SIZE   FDCA_GTT_SIZE_MAX
+
+/* 硬件支持的地址空间 ID，0 保留给全局 GTT */
+#define FDCA_VM_MAX_ASID        4095
+
+/* 写入 ASID 失效该地址空间在所有单元中的 TLB */
+#define FDCA_VM_REG_TLB_INV     0x110
+
+/* 各级页表项映射的地址位移 */
+static const u8 fdca_vm_level_shift[FDCA_GTT_MAX_LEVELS] = {
+    [FDCA_GTT_LEVEL_0] = 30,
+    [FDCA_GTT_LEVEL_1] = 21,
+    [FDCA_GTT_LEVEL_2] = 12,
+};
+
+/**
+ * struct fdca_vm_pt - 一级页表
+ *
+ * 页表本身位于一致性 DMA 内存，硬件直接遍历；children 只在 L0/L1 存在
+ */
+struct fdca_vm_pt {
+    u64 *entries;                       /* 页表项 */
+    dma_addr_t dma;                     /* 页表 DMA 地址 */
+    u32 level;                          /* 所在级别 */
+    u32 used;                           /* 有效项数，降为 0 时回收 */
+    struct list_head free_link;         /* pt_free 链表节点 */
+    struct fdca_vm_pt *children[];      /* 下级页表 */
+};
+
+/**
+ * struct fdca_vm_pt_cache - 预先分配的页表
+ *
+ * 持有 pt_lock 时不分配内存，需要的页表在锁外按上界分配好，
+ * 用剩的在锁外释放
+ */
+struct fdca_vm_pt_cache {
+    struct list_head pts[FDCA_GTT_MAX_LEVELS]; /* 按级别的空闲页表 */
+    u32 count[FDCA_GTT_MAX_LEVELS];     /* 各级空闲页表数 */
+};
+
+/**
+ * struct fdca_vm_va - 一段虚拟地址映射
+ *
+ * 移出区间树的映射先标记为 dead 挂入回收链表，之后在可以获取对象锁的
+ * 上下文中解除与对象的链接并释放
+ */
+struct fdca_vm_va {
+    struct drm_gpuva base;              /* drm_gpuvm 映射节点 */
+    u64 pte_flags;                      /* 页表项权限位 */
+    bool dead;                          /* 已移出区间树，页表项已清除 */
+    struct list_head link;              /* 预分配或回收链表节点 */
+};
+
+/**
+ * struct fdca_vm_op_ctx - drm_gpuvm 拆分步骤的参数
+ *
+ * 步骤中用到的内存全部预先分配，VM_BIND 作业执行时不分配内存
+ */
+struct fdca_vm_op_ctx {
+    struct fdca_vm *vm;
+    u64 pte_flags;                      /* 新映射的权限位 */
+    struct drm_gpuvm_bo *vm_bo;         /* 新映射的 vm_bo */
+    struct fdca_vm_pt_cache *pt_cache;  /* 预分配的页表，可为 NULL */
+    struct list_head *va_cache;         /* 预分配的映射节点 */
+    struct list_head *reap;             /* 移出区间树的映射节点 */
+};
+
+static inline struct fdca_vm *to_fdca_vm(struct drm_gpuvm *gpuvm)
+{
+    return container_of(gpuvm, struct fdca_vm, base);
+}
+
+static inline struct fdca_vm_va *to_fdca_vm_va(struct drm_gpuva *va)
+{
+    return container_of(va, struct fdca_vm_va, base);
+}
+
+/*
+ * ============================================================================
+ * 页表管理
+ * ============================================================================
+ *
+ * 页表随映射按需分配：只映射 4KB 时每个 1GB 区间最多多出一张 L1 和一张 L2，
+ * 1GB/2MB 对齐的连续后备直接以 L0/L1 叶子项 (FDCA_GTT_PTE_LARGE) 映射，
+ * 不再分配下级页表。解映射后有效项为 0 的页表挂入 pt_free，TLB 失效后释放。
+ * 所有页表操作都在 pt_lock 下进行。VM_BIND 作业执行时同样获取 pt_lock，
+ * 而作业完成 fence 可能被内存回收路径等待，因此持有 pt_lock 时不分配
+ * 内存：新页表取自调用者在锁外预先填充的 fdca_vm_pt_cache
+ */
+
+/**
+ * fdca_vm_pt_alloc() - 分配一张页表
+ * @vm: 地址空间
+ * @level: 页表级别
+ *
+ * 可能睡眠并进入内存回收，不能在 pt_lock 下或作业执行中调用
+ *
+ * Return: 页表或 NULL
+ */
+static struct fdca_vm_pt *fdca_vm_pt_alloc(struct fdca_vm *vm, u32 level)
+{
+    u32 num_children = level < FDCA_GTT_LEVEL_2 ? FDCA_VM_PT_ENTRIES : 0;
+    struct fdca_vm_pt *pt;
+
+    pt = kzalloc(struct_size(pt, children, num_children), GFP_KERNEL);
+    if (!pt)
+        return NULL;
+
+    /* dma_alloc_coherent 返回的内存已清零 */
+    pt->entries = dma_alloc_coherent(vm->fdev->dev, FDCA_VM_PT_SIZE, &pt->dma,
+                                     GFP_KERNEL);
+    if (!pt->entries) {
+        kfree(pt);
+        return NULL;
+    }
+
+    pt->level = level;
+    INIT_LIST_HEAD(&pt->free_link);
+    atomic64_add(FDCA_VM_PT_SIZE, &vm->pt_bytes);
+
+    return pt;
+}
+
+/**
+ * fdca_vm_pt_free() - 释放页表及其全部下级页表
+ * @vm: 地址空间
+ * @pt: 页表
+ */
+static void fdca_vm_pt_free(struct fdca_vm *vm, struct fdca_vm_pt *pt)
+{
+    u32 i;
+
+    if (pt->level < FDCA_GTT_LEVEL_2) {
+        for (i = 0; i < FDCA_VM_PT_ENTRIES; i++) {
+            if (pt->children[i])
+                fdca_vm_pt_free(vm, pt->children[i]);
+        }
+    }
+
+    dma_free_coherent(vm->fdev->dev, FDCA_VM_PT_SIZE, pt->entries, pt->dma);
+    atomic64_sub(FDCA_VM_PT_SIZE, &vm->pt_bytes);
+    kfree(pt);
+}
+
+static void fdca_vm_pt_cache_init(struct fdca_vm_pt_cache *cache)
+{
+    u32 level;
+
+    for (level = 0; level < FDCA_GTT_MAX_LEVELS; level++) {
+        INIT_LIST_HEAD(&cache->pts[level]);
+        cache->count[level] = 0;
+    }
+}
+
+/**
+ * fdca_vm_pt_cache_count() - 累加映射或解映射一段区间最多需要的页表数
+ * @need: 各级页表数，累加到其中
+ * @va: 起始虚拟地址
+ * @range: 字节数
+ * @map: 是否写入新映射
+ * @contig: 新映射的后备连续，且与 @va 按 2MB 同余
+ *
+ * 区间两端部分覆盖的大页拆分时每级各需一张。写入新映射时，区间覆盖的
+ * 每个上级页表项下最多再需一张下级页表；连续后备的中间部分以 2MB
+ * 叶子项映射，只有两端需要 L2 页表
+ */
+static void fdca_vm_pt_cache_count(u32 *need, u64 va, u64 range, bool map, bool contig)
+{
+    u32 level, shift, num;
+
+    for (level = FDCA_GTT_LEVEL_1; level < FDCA_GTT_MAX_LEVELS; level++) {
+        need[level] += 2;
+        if (!map)
+            continue;
+
+        shift = fdca_vm_level_shift[level - 1];
+        num = ((va + range - 1) >> shift) - (va >> shift) + 1;
+        if (contig && level == FDCA_GTT_LEVEL_2)
+            num = min(num, 2U);
+        need[level] += num;
+    }
+}
+
+/* 连续后备能否以 2MB 叶子项映射，决定 fdca_vm_pt_cache_count() 的 @contig */
+static bool fdca_vm_backing_contig(const struct sg_table *sgt, u64 addr, u64 va)
+{
+    return IS_ENABLED(CONFIG_DRM_FDCA_LARGE_PAGE_SUPPORT) && !sgt &&
+           IS_ALIGNED(addr - va, 1ULL << fdca_vm_level_shift[FDCA_GTT_LEVEL_1]);
+}
+
+/**
+ * fdca_vm_pt_cache_fill() - 补足预分配页表
+ * @vm: 地址空间
+ * @cache: 页表缓存
+ * @need: 各级需要的页表数
+ *
+ * 调用者不持有 pt_lock
+ *
+ * Return: 0 表示成功，-ENOMEM 表示分配失败 (已分配的留在缓存中)
+ */
+static int fdca_vm_pt_cache_fill(struct fdca_vm *vm, struct fdca_vm_pt_cache *cache,
+                                 const u32 *need)
+{
+    struct fdca_vm_pt *pt;
+    u32 level;
+
+    for (level = FDCA_GTT_LEVEL_1; level < FDCA_GTT_MAX_LEVELS; level++) {
+        while (cache->count[level] < need[level]) {
+            pt = fdca_vm_pt_alloc(vm, level);
+            if (!pt)
+                return -ENOMEM;
+            list_add(&pt->free_link, &cache->pts[level]);
+            cache->count[level]++;
+        }
+    }
+
+    return 0;
+}
+
+static bool fdca_vm_pt_cache_enough(const struct fdca_vm_pt_cache *cache, const u32 *need)
+{
+    u32 level;
+
+    for (level = FDCA_GTT_LEVEL_1; level < FDCA_GTT_MAX_LEVELS; level++) {
+        if (cache->count[level] < need[level])
+            return false;
+    }
+
+    return true;
+}
+
+/* 取出一张预分配页表，缓存为空时返回 NULL */
+static struct fdca_vm_pt *fdca_vm_pt_cache_take(struct fdca_vm_pt_cache *cache, u32 level)
+{
+    struct fdca_vm_pt *pt;
+
+    if (!cache || !cache->count[level])
+        return NULL;
+
+    pt = list_first_entry(&cache->pts[level], struct fdca_vm_pt, free_link);
+    list_del_init(&pt->free_link);
+    cache->count[level]--;
+
+    return pt;
+}
+
+/* 释放用剩的预分配页表，调用者不持有 pt_lock */
+static void fdca_vm_pt_cache_fini(struct fdca_vm *vm, struct fdca_vm_pt_cache *cache)
+{
+    struct fdca_vm_pt *pt, *tmp;
+    u32 level;
+
+    for (level = 0; level < FDCA_GTT_MAX_LEVELS; level++) {
+        list_for_each_entry_safe(pt, tmp, &cache->pts[level], free_link)
+            fdca_vm_pt_free(vm, pt);
+        INIT_LIST_HEAD(&cache->pts[level]);
+        cache->count[level] = 0;
+    }
+}
+
+static inline u64 fdca_vm_pde(const struct fdca_vm_pt *child)
+{
+    return (child->dma & FDCA_GTT_PTE_ADDR_MASK) | FDCA_GTT_PTE_VALID;
+}
+
+static inline bool fdca_vm_pte_is_leaf(u64 pte, u32 level)
+{
+    return level == FDCA_GTT_LEVEL_2 || (pte & FDCA_GTT_PTE_LARGE);
+}
+
+/**
+ * fdca_vm_pt_map() - 把一段连续后备映射到页表
+ * @vm: 地址空间
+ * @cache: 预分配的页表
+ * @pt: 当前级页表
+ * @va: 起始虚拟地址
+ * @addr: 起始设备地址 (VRAM 偏移或 DMA 地址)
+ * @size: 字节数，不超出 @pt 覆盖的范围
+ * @flags: 页表项权限位
+ *
+ * 能用大页时优先用大页。失败时已写入的部分由调用者清除
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vm_pt_map(struct fdca_vm *vm, struct fdca_vm_pt_cache *cache,
+                          struct fdca_vm_pt *pt, u64 va, u64 addr, u64 size, u64 flags)
+{
+    u32 level = pt->level;
+    u64 entry_size = 1ULL << fdca_vm_level_shift[level];
+    struct fdca_vm_pt *child;
+    u64 len;
+    u32 idx;
+    int ret;
+
+    while (size) {
+        idx = (va >> fdca_vm_level_shift[level]) & (FDCA_VM_PT_ENTRIES - 1);
+        len = min(size, entry_size - (va & (entry_size - 1)));
+
+        /* 覆盖整项且后备地址按本级对齐时直接写叶子项 */
+        if (level == FDCA_GTT_LEVEL_2 ||
+            (IS_ENABLED(CONFIG_DRM_FDCA_LARGE_PAGE_SUPPORT) &&
+             len == entry_size && IS_ALIGNED(addr, entry_size) &&
+             !pt->children[idx])) {
+            if (!(pt->entries[idx] & FDCA_GTT_PTE_VALID))
+                pt->used++;
+            WRITE_ONCE(pt->entries[idx], (addr & FDCA_GTT_PTE_ADDR_MASK) | flags |
+                       FDCA_GTT_PTE_VALID |
+                       (level < FDCA_GTT_LEVEL_2 ? FDCA_GTT_PTE_LARGE : 0));
+        } else {
+            child = pt->children[idx];
+            if (!child) {
+                /* drm_gpuvm 保证区间未映射，不会遇到大页叶子项 */
+                if (WARN_ON(pt->entries[idx] & FDCA_GTT_PTE_VALID))
+                    return -EEXIST;
+
+                child = fdca_vm_pt_cache_take(cache, level + 1);
+                if (!child)
+                    return -ENOMEM;
+
+                pt->children[idx] = child;
+                WRITE_ONCE(pt->entries[idx], fdca_vm_pde(child));
+                pt->used++;
+            }
+
+            ret = fdca_vm_pt_map(vm, cache, child, va, addr, len, flags);
+            if (ret)
+                return ret;
+        }
+
+        va += len;
+        addr += len;
+        size -= len;
+    }
+
+    return 0;
+}
+
+/**
+ * fdca_vm_pt_split() - 把大页叶子项拆成一张下级页表
+ * @vm: 地址空间
+ * @cache: 预分配的页表
+ * @pt: 大页叶子项所在页表
+ * @idx: 页表项索引
+ *
+ * 只解映射大页的一部分时使用，拆分前后映射内容不变
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vm_pt_split(struct fdca_vm *vm, struct fdca_vm_pt_cache *cache,
+                            struct fdca_vm_pt *pt, u32 idx)
+{
+    u64 pte = pt->entries[idx];
+    u64 addr = pte & FDCA_GTT_PTE_ADDR_MASK;
+    u64 flags = pte & ~(FDCA_GTT_PTE_ADDR_MASK | FDCA_GTT_PTE_LARGE);
+    u32 child_level = pt->level + 1;
+    u64 child_size = 1ULL << fdca_vm_level_shift[child_level];
+    struct fdca_vm_pt *child;
+    u32 i;
+
+    child = fdca_vm_pt_cache_take(cache, child_level);
+    if (!child)
+        return -ENOMEM;
+
+    if (child_level < FDCA_GTT_LEVEL_2)
+        flags |= FDCA_GTT_PTE_LARGE;
+
+    for (i = 0; i < FDCA_VM_PT_ENTRIES; i++)
+        child->entries[i] = ((addr + i * child_size) & FDCA_GTT_PTE_ADDR_MASK) | flags;
+    child->used = FDCA_VM_PT_ENTRIES;
+
+    pt->children[idx] = child;
+    WRITE_ONCE(pt->entries[idx], fdca_vm_pde(child));
+
+    return 0;
+}
+
+/**
+ * fdca_vm_pt_clear() - 清除一段虚拟地址的页表项
+ * @vm: 地址空间
+ * @cache: 预分配的页表，整段清除映射时可为 NULL
+ * @pt: 当前级页表
+ * @va: 起始虚拟地址
+ * @size: 字节数，不超出 @pt 覆盖的范围
+ *
+ * 清空的下级页表挂入 pt_free，TLB 失效后由 fdca_vm_flush() 释放。
+ * 只有部分解映射大页时需要新页表
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vm_pt_clear(struct fdca_vm *vm, struct fdca_vm_pt_cache *cache,
+                            struct fdca_vm_pt *pt, u64 va, u64 size)
+{
+    u32 level = pt->level;
+    u64 entry_size = 1ULL << fdca_vm_level_shift[level];
+    struct fdca_vm_pt *child;
+    u64 pte, len;
+    u32 idx;
+    int ret;
+
+    while (size) {
+        idx = (va >> fdca_vm_level_shift[level]) & (FDCA_VM_PT_ENTRIES - 1);
+        len = min(size, entry_size - (va & (entry_size - 1)));
+        pte = pt->entries[idx];
+
+        if (!(pte & FDCA_GTT_PTE_VALID))
+            goto next;
+
+        if (fdca_vm_pte_is_leaf(pte, level) && len == entry_size) {
+            WRITE_ONCE(pt->entries[idx], 0);
+            pt->used--;
+            goto next;
+        }
+
+        if (fdca_vm_pte_is_leaf(pte, level)) {
+            ret = fdca_vm_pt_split(vm, cache, pt, idx);
+            if (ret)
+                return ret;
+        }
+
+        child = pt->children[idx];
+        ret = fdca_vm_pt_clear(vm, cache, child, va, len);
+        if (ret)
+            return ret;
+
+        if (!child->used) {
+            WRITE_ONCE(pt->entries[idx], 0);
+            pt->children[idx] = NULL;
+            pt->used--;
+            list_add_tail(&child->free_link, &vm->pt_free);
+        }
+next:
+        va += len;
+        size -= len;
+    }
+
+    return 0;
+}
+
+/**
+ * fdca_vm_flush() - 使页表修改对硬件生效
+ * @vm: 地址空间
+ *
+ * 失效 TLB 后释放已摘下的页表，硬件不会再遍历它们
+ */
+static void fdca_vm_flush(struct fdca_vm *vm)
+{
+    struct fdca_vm_pt *pt, *tmp;
+    LIST_HEAD(free_list);
+
+    mutex_lock(&vm->pt_lock);
+    list_splice_init(&vm->pt_free, &free_list);
+
+    /* 页表写入先于失效请求到达设备 */
+    wmb();
+    iowrite32(vm->asid, vm->fdev->mmio_base + FDCA_VM_REG_TLB_INV);
+    ioread32(vm->fdev->mmio_base + FDCA_VM_REG_TLB_INV);
+    mutex_unlock(&vm->pt_lock);
+
+    list_for_each_entry_safe(pt, tmp, &free_list, free_link)
+        fdca_vm_pt_free(vm, pt);
+}
+
+/**
+ * fdca_vm_write_va() - 按对象当前后备写入一段映射的页表项
+ * @vm: 地址空间
+ * @cache: 预分配的页表
+ * @gem: GEM 对象 (调用者持有对象的 VA 锁)
+ * @bo_offset: 对象内偏移
+ * @va: 起始虚拟地址
+ * @range: 字节数
+ * @pte_flags: 权限位
+ *
+ * 调用者持有 pt_lock
+ *
+ * Return: 0 表示成功，-EAGAIN 表示系统内存后备尚未建立或已被撤销，
+ * 其它负数表示错误
+ */
+static int fdca_vm_write_va(struct fdca_vm *vm, struct fdca_vm_pt_cache *cache,
+                            struct drm_gem_object *gem, u64 bo_offset, u64 va,
+                            u64 range, u64 pte_flags)
+{
+    struct scatterlist *sg;
+    struct sg_table *sgt;
+    u64 vram_offset, addr, len;
+    unsigned int i;
+    int ret;
+
+    ret = fdca_gem_object_peek_backing(gem, &vram_offset, &sgt);
+    if (ret)
+        return ret;
+
+    /* VRAM 对象物理连续 */
+    if (!sgt)
+        return fdca_vm_pt_map(vm, cache, vm->root, va, vram_offset + bo_offset, range,
+                              pte_flags | FDCA_GTT_PTE_VRAM);
+
+    for_each_sgtable_dma_sg(sgt, sg, i) {
+        addr = sg_dma_address(sg);
+        len = sg_dma_len(sg);
+
+        if (bo_offset >= len) {
+            bo_offset -= len;
+            continue;
+        }
+
+        addr += bo_offset;
+        len = min(len - bo_offset, range);
+        bo_offset = 0;
+
+        ret = fdca_vm_pt_map(vm, cache, vm->root, va, addr, len, pte_flags);
+        if (ret)
+            return ret;
+
+        va += len;
+        range -= len;
+        if (!range)
+            break;
+    }
+
+    return 0;
+}
+
+/*
+ * ============================================================================
+ * drm_gpuvm 拆分步骤
+ * ============================================================================
+ *
+ * drm_gpuvm_sm_map()/drm_gpuvm_sm_unmap() 把一次请求拆成 map/remap/unmap
+ * 步骤，每一步同时更新区间树、对象的 VA 链表和页表。步骤在 VM_BIND 作业
+ * 中执行，只获取 lock、对象的 VA 锁和 pt_lock，不获取可能在分配内存时
+ * 持有的对象锁；映射节点、vm_bo 和页表都在 ioctl 中预先分配。
+ * 移出区间树的映射标记为 dead 并挂入回收链表，它与对象的链接 (以及可能
+ * 随之释放的 vm_bo 和对象引用) 留给 fdca_vm_va_reap() 在作业释放时解除
+ */
+
+/* 从预分配链表取出一个映射节点 */
+static struct fdca_vm_va *fdca_vm_va_take(struct fdca_vm_op_ctx *octx, u64 pte_flags)
+{
+    struct fdca_vm_va *va;
+
+    va = list_first_entry_or_null(octx->va_cache, struct fdca_vm_va, link);
+    if (!va)
+        return NULL;
+
+    list_del_init(&va->link);
+    va->pte_flags = pte_flags;
+
+    return va;
+}
+
+/* 映射已移出区间树且页表项已清除，调用者持有对象的 VA 锁 */
+static void fdca_vm_va_retire(struct fdca_vm_op_ctx *octx, struct drm_gpuva *gpuva)
+{
+    struct fdca_vm_va *va = to_fdca_vm_va(gpuva);
+
+    va->dead = true;
+    list_add_tail(&va->link, octx->reap);
+}
+
+/**
+ * fdca_vm_va_reap() - 解除已移出区间树的映射与对象的链接并释放
+ * @reap: fdca_vm_va_retire() 挂入的映射
+ *
+ * 获取对象锁，不能在作业执行中调用
+ */
+static void fdca_vm_va_reap(struct list_head *reap)
+{
+    struct fdca_vm_va *va, *tmp;
+    struct drm_gem_object *gem;
+
+    list_for_each_entry_safe(va, tmp, reap, link) {
+        gem = va->base.gem.obj;
+
+        /* 对象可能只剩 vm_bo 持有的引用 */
+        drm_gem_object_get(gem);
+        fdca_gem_object_lock(gem);
+        fdca_gem_object_va_lock(gem);
+        drm_gpuva_unlink(&va->base);
+        fdca_gem_object_va_unlock(gem);
+        fdca_gem_object_unlock(gem);
+        drm_gem_object_put(gem);
+
+        list_del(&va->link);
+        kfree(va);
+    }
+}
+
+static int fdca_vm_step_map(struct drm_gpuva_op *op, void *priv)
+{
+    struct fdca_vm_op_ctx *octx = priv;
+    struct fdca_vm *vm = octx->vm;
+    struct drm_gem_object *gem = op->map.gem.obj;
+    struct fdca_vm_va *va;
+    int ret;
+
+    va = fdca_vm_va_take(octx, octx->pte_flags);
+    if (WARN_ON(!va))
+        return -ENOMEM;
+
+    fdca_gem_object_va_lock(gem);
+
+    mutex_lock(&vm->pt_lock);
+    ret = fdca_vm_write_va(vm, octx->pt_cache, gem, op->map.gem.offset,
+                           op->map.va.addr, op->map.va.range, va->pte_flags);
+    /* 后备已被撤销时页表项留空，重新获取后由 fdca_vm_bo_update() 写入 */
+    if (ret == -EAGAIN)
+        ret = 0;
+    /* 新写入的叶子项都在区间内，清除时不需要拆分 */
+    if (ret)
+        fdca_vm_pt_clear(vm, NULL, vm->root, op->map.va.addr, op->map.va.range);
+    mutex_unlock(&vm->pt_lock);
+
+    if (ret) {
+        fdca_gem_object_va_unlock(gem);
+        list_add(&va->link, octx->va_cache);
+        return ret;
+    }
+
+    drm_gpuva_map(&vm->base, &va->base, &op->map);
+    drm_gpuva_link(&va->base, octx->vm_bo);
+
+    fdca_gem_object_va_unlock(gem);
+
+    atomic64_add(op->map.va.range, &vm->mapped_bytes);
+    return 0;
+}
+
+static int fdca_vm_step_remap(struct drm_gpuva_op *op, void *priv)
+{
+    struct fdca_vm_op_ctx *octx = priv;
+    struct fdca_vm *vm = octx->vm;
+    struct drm_gpuva *old = op->remap.unmap->va;
+    struct drm_gem_object *gem = old->gem.obj;
+    struct drm_gpuvm_bo *vm_bo = old->vm_bo;
+    u64 pte_flags = to_fdca_vm_va(old)->pte_flags;
+    struct fdca_vm_va *prev = NULL, *next = NULL;
+    u64 start, range;
+    int ret = -ENOMEM;
+
+    if (op->remap.prev) {
+        prev = fdca_vm_va_take(octx, pte_flags);
+        if (WARN_ON(!prev))
+            goto err_put_back;
+    }
+
+    if (op->remap.next) {
+        next = fdca_vm_va_take(octx, pte_flags);
+        if (WARN_ON(!next))
+            goto err_put_back;
+    }
+
+    drm_gpuva_op_remap_to_unmap_range(&op->remap, &start, &range);
+
+    fdca_gem_object_va_lock(gem);
+
+    mutex_lock(&vm->pt_lock);
+    ret = fdca_vm_pt_clear(vm, octx->pt_cache, vm->root, start, range);
+    mutex_unlock(&vm->pt_lock);
+    if (ret) {
+        fdca_gem_object_va_unlock(gem);
+        goto err_put_back;
+    }
+
+    /* 保留部分的页表项不变，由新节点接管 */
+    drm_gpuva_remap(prev ? &prev->base : NULL, next ? &next->base : NULL, &op->remap);
+    if (prev)
+        drm_gpuva_link(&prev->base, vm_bo);
+    if (next)
+        drm_gpuva_link(&next->base, vm_bo);
+    fdca_vm_va_retire(octx, old);
+
+    fdca_gem_object_va_unlock(gem);
+
+    atomic64_sub(range, &vm->mapped_bytes);
+
+    return 0;
+
+err_put_back:
+    if (prev)
+        list_add(&prev->link, octx->va_cache);
+    if (next)
+        list_add(&next->link, octx->va_cache);
+    return ret;
+}
+
+static int fdca_vm_step_unmap(struct drm_gpuva_op *op, void *priv)
+{
+    struct fdca_vm_op_ctx *octx = priv;
+    struct fdca_vm *vm = octx->vm;
+    struct drm_gpuva *va = op->unmap.va;
+    struct drm_gem_object *gem = va->gem.obj;
+    u64 range = va->va.range;
+    int ret;
+
+    fdca_gem_object_va_lock(gem);
+
+    /* 整段映射的叶子项都在区间内，不需要拆分大页，不会失败 */
+    mutex_lock(&vm->pt_lock);
+    ret = fdca_vm_pt_clear(vm, NULL, vm->root, va->va.addr, range);
+    mutex_unlock(&vm->pt_lock);
+    WARN_ON(ret);
+
+    drm_gpuva_unmap(&op->unmap);
+    fdca_vm_va_retire(octx, va);
+
+    fdca_gem_object_va_unlock(gem);
+
+    atomic64_sub(range, &vm->mapped_bytes);
+
+    return 0;
+}
+
+static void fdca_vm_free(struct drm_gpuvm *gpuvm)
+{
+    struct fdca_vm *vm = to_fdca_vm(gpuvm);
+    struct fdca_device *fdev = vm->fdev;
+
+    fdca_vm_pt_free(vm, vm->root);
+    ida_free(&fdev->vm_ida, vm->asid);
+    mutex_destroy(&vm->bind_lock);
+    mutex_destroy(&vm->pt_lock);
+    mutex_destroy(&vm->lock);
+    kfree(vm);
+}
+
+static const struct drm_gpuvm_ops fdca_vm_ops = {
+    .vm_free = fdca_vm_free,
+    .sm_step_map = fdca_vm_step_map,
+    .sm_step_remap = fdca_vm_step_remap,
+    .sm_step_unmap = fdca_vm_step_unmap,
+};
+
+/*
+ * ============================================================================
+ * 地址空间接口
+ * ============================================================================
+ */
+
+/**
+ * fdca_vm_create() - 创建 GPU 虚拟地址空间
+ * @fdev: FDCA 设备
+ *
+ * Return: 地址空间指针或 ERR_PTR
+ */
+struct fdca_vm *fdca_vm_create(struct fdca_device *fdev)
+{
+    struct drm_gpu_scheduler *sched = &fdev->vm_bind_sched;
+    struct drm_gem_object *r_obj;
+    struct fdca_vm *vm;
+    int ret;
+
+    vm = kzalloc(sizeof(*vm), GFP_KERNEL);
+    if (!vm)
+        return ERR_PTR(-ENOMEM);
+
+    vm->fdev = fdev;
+    mutex_init(&vm->lock);
+    mutex_init(&vm->pt_lock);
+    mutex_init(&vm->bind_lock);
+    spin_lock_init(&vm->bind_pending_lock);
+    INIT_LIST_HEAD(&vm->bind_pending);
+    INIT_LIST_HEAD(&vm->pt_free);
+    atomic64_set(&vm->pt_bytes, 0);
+    atomic64_set(&vm->mapped_bytes, 0);
+    atomic64_set(&vm->bind_jobs, 0);
+    atomic64_set(&vm->bind_ops, 0);
+    atomic64_set(&vm->bind_waits, 0);
+
+    ret = ida_alloc_range(&fdev->vm_ida, 1, FDCA_VM_MAX_ASID, GFP_KERNEL);
+    if (ret < 0) {
+        fdca_err(fdev, "无法分配地址空间 ID: %d\n", ret);
+        goto err_free_vm;
+    }
+    vm->asid = ret;
+
+    vm->root = fdca_vm_pt_alloc(vm, FDCA_GTT_LEVEL_0);
+    if (!vm->root) {
+        ret = -ENOMEM;
+        goto err_free_asid;
+    }
+
+    ret = drm_sched_entity_init(&vm->bind_entity, DRM_SCHED_PRIORITY_NORMAL,
+                                &sched, 1, NULL);
+    if (ret)
+        goto err_free_root;
+
+    r_obj = drm_gpuvm_resv_object_alloc(&fdev->drm);
+    if (!r_obj) {
+        ret = -ENOMEM;
+        goto err_fini_entity;
+    }
+
+    drm_gpuvm_init(&vm->base, "fdca-vm", 0, &fdev->drm, r_obj,
+                   0, FDCA_VM_VA_SIZE,
+                   FDCA_VM_RESERVED_START, FDCA_VM_RESERVED_SIZE,
+                   &fdca_vm_ops);
+    drm_gem_object_put(r_obj);
+
+    fdca_dbg(fdev, "GPU 地址空间创建: ASID=%u\n", vm->asid);
+
+    return vm;
+
+err_fini_entity:
+    drm_sched_entity_destroy(&vm->bind_entity);
+err_free_root:
+    fdca_vm_pt_free(vm, vm->root);
+err_free_asid:
+    ida_free(&fdev->vm_ida, vm->asid);
+err_free_vm:
+    kfree(vm);
+    return ERR_PTR(ret);
+}
+
+/**
+ * fdca_vm_destroy() - 解除全部映射并释放地址空间
+ * @vm: 地址空间 (使用它的队列已停止)
+ */
+void fdca_vm_destroy(struct fdca_vm *vm)
+{
+    LIST_HEAD(reap);
+    struct fdca_vm_op_ctx octx = { .vm = vm, .reap = &reap };
+    u64 reserved_end = FDCA_VM_RESERVED_START + FDCA_VM_RESERVED_SIZE;
+
+    if (!vm)
+        return;
+
+    /*
+     * 先停止绑定实体：返回后不会再有 VM_BIND 作业执行，未执行的作业
+     * 以错误触发并在释放时放下各自持有的地址空间引用
+     */
+    drm_sched_entity_destroy(&vm->bind_entity);
+
+    /* 保留区间由 drm_gpuvm 自己的节点占用，分两段整段解映射，不需要页表 */
+    mutex_lock(&vm->lock);
+    drm_gpuvm_sm_unmap(&vm->base, &octx, 0, FDCA_VM_RESERVED_START);
+    drm_gpuvm_sm_unmap(&vm->base, &octx, reserved_end, FDCA_VM_VA_SIZE - reserved_end);
+    mutex_unlock(&vm->lock);
+
+    fdca_vm_flush(vm);
+    fdca_vm_va_reap(&reap);
+
+    drm_gpuvm_put(&vm->base);
+}
+
+/**
+ * fdca_vm_bo_rewrite() - 按对象当前后备重写它在一个地址空间中的映射
+ * @gem: GEM 对象 (调用者持有对象锁，后备已建立)
+ * @vm_bo: 对象在该地址空间中的 vm_bo
+ * @vram_offset: 驻留 VRAM 时的 VRAM 偏移
+ * @sgt: 位于系统内存时的 sg 表
+ *
+ * 持有 VA 锁和 pt_lock 时不分配内存，预分配的页表不够时解锁补足后
+ * 重新统计，期间 VM_BIND 作业可能增减映射
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vm_bo_rewrite(struct drm_gem_object *gem, struct drm_gpuvm_bo *vm_bo,
+                              u64 vram_offset, const struct sg_table *sgt)
+{
+    struct fdca_vm *vm = to_fdca_vm(vm_bo->vm);
+    u32 need[FDCA_GTT_MAX_LEVELS];
+    struct fdca_vm_pt_cache cache;
+    struct drm_gpuva *va;
+    int ret = 0;
+
+    fdca_vm_pt_cache_init(&cache);
+
+    for (;;) {
+        memset(need, 0, sizeof(need));
+
+        fdca_gem_object_va_lock(gem);
+        drm_gpuvm_bo_for_each_va(va, vm_bo) {
+            if (!to_fdca_vm_va(va)->dead)
+                fdca_vm_pt_cache_count(need, va->va.addr, va->va.range, true,
+                                       fdca_vm_backing_contig(sgt,
+                                                              vram_offset + va->gem.offset,
+                                                              va->va.addr));
+        }
+        if (fdca_vm_pt_cache_enough(&cache, need))
+            break;
+        fdca_gem_object_va_unlock(gem);
+
+        ret = fdca_vm_pt_cache_fill(vm, &cache, need);
+        if (ret)
+            goto out_fini;
+    }
+
+    mutex_lock(&vm->pt_lock);
+    drm_gpuvm_bo_for_each_va(va, vm_bo) {
+        if (to_fdca_vm_va(va)->dead)
+            continue;
+
+        fdca_vm_pt_clear(vm, NULL, vm->root, va->va.addr, va->va.range);
+        ret = fdca_vm_write_va(vm, &cache, gem, va->gem.offset, va->va.addr,
+                               va->va.range, to_fdca_vm_va(va)->pte_flags);
+        if (ret)
+            break;
+    }
+    mutex_unlock(&vm->pt_lock);
+    fdca_gem_object_va_unlock(gem);
+
+    fdca_vm_flush(vm);
+
+out_fini:
+    fdca_vm_pt_cache_fini(vm, &cache);
+    return ret;
+}
+
+/**
+ * fdca_vm_bo_update() - 对象后备变化后重写所有地址空间中的映射
+ * @gem: GEM 对象 (调用者持有对象锁)
+ *
+ * 驱逐、迁回和碎片整理搬移后调用。VRAM 与系统内存的连续性不同，
+ * 整段清除后按新后备重新选择页大小。系统内存对象的 sg 表在这里建立，
+ * 尚未执行的 VM_BIND 作业之后只需查询
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_vm_bo_update(struct drm_gem_object *gem)
+{
+    struct drm_gpuvm_bo *vm_bo;
+    struct sg_table *sgt;
+    u64 vram_offset;
+    int ret;
+
+    /* vm_bo 的增删同时持有对象锁和 VA 锁，这里只需对象锁 */
+    if (list_empty(&gem->gpuva.list))
+        return 0;
+
+    ret = fdca_gem_object_get_backing(gem, &vram_offset, &sgt);
+    if (ret)
+        return ret;
+
+    drm_gem_for_each_gpuvm_bo(vm_bo, gem) {
+        ret = fdca_vm_bo_rewrite(gem, vm_bo, vram_offset, sgt);
+        if (ret)
+            return ret;
+    }
+
+    return 0;
+}
+
+/**
+ * fdca_vm_bo_lock_idle() - 锁定映射了该对象的地址空间并确认都已空闲
+ * @gem: GEM 对象 (调用者持有对象锁)
+ * @exec: 锁定上下文，成功时由调用者经 fdca_vm_bo_unlock() 释放
+ *
+ * 作业只记录在地址空间的预留对象上，不跟踪具体访问了哪些对象，
+ * 因此只要任一地址空间仍有在途作业，就认为对象可能正被访问。
+ * 新作业入队时要获取同一预留锁添加 fence，驱逐、迁回和碎片整理在
+ * 搬移完成前一直持有这些锁，搬移期间不会有作业开始访问对象
+ *
+ * Return: 0 表示已锁定且空闲，-EBUSY 表示仍有在途作业，其它负数表示错误
+ */
+int fdca_vm_bo_lock_idle(struct drm_gem_object *gem, struct drm_exec *exec)
+{
+    struct drm_gpuvm_bo *vm_bo;
+    int ret = 0;
+
+    drm_exec_init(exec, 0, 0);
+    drm_exec_until_all_locked(exec) {
+        drm_gem_for_each_gpuvm_bo(vm_bo, gem) {
+            ret = drm_exec_lock_obj(exec, vm_bo->vm->r_obj);
+            drm_exec_retry_on_contention(exec);
+            if (ret)
+                break;
+        }
+    }
+
+    if (!ret) {
+        drm_gem_for_each_gpuvm_bo(vm_bo, gem) {
+            if (!dma_resv_test_signaled(drm_gpuvm_resv(vm_bo->vm),
+                                        DMA_RESV_USAGE_BOOKKEEP)) {
+                ret = -EBUSY;
+                break;
+            }
+        }
+    }
+
+    if (ret)
+        drm_exec_fini(exec);
+
+    return ret;
+}
+
+/**
+ * fdca_vm_bo_unlock() - 释放 fdca_vm_bo_lock_idle() 获取的预留锁
+ * @exec: 锁定上下文
+ */
+void fdca_vm_bo_unlock(struct drm_exec *exec)
+{
+    drm_exec_fini(exec);
+}
+
+/**
+ * fdca_vm_bo_wait_idle() - 等待映射了该对象的地址空间空闲
+ * @gem: GEM 对象 (调用者不持有 VA 锁)
+ *
+ * 在 VA 锁下遍历 vm_bo，等待期间释放 VA 锁。不要求对象锁，可在只持有
+ * 通知锁的用户指针失效通知中调用。调用者持有的对象锁或通知锁在等待
+ * 期间不释放，执行中的作业不会获取这两把锁
+ */
+void fdca_vm_bo_wait_idle(struct drm_gem_object *gem)
+{
+    struct drm_gpuvm_bo *vm_bo;
+    struct drm_gpuvm *gpuvm;
+
+retry:
+    fdca_gem_object_va_lock(gem);
+    drm_gem_for_each_gpuvm_bo(vm_bo, gem) {
+        gpuvm = vm_bo->vm;
+        if (dma_resv_test_signaled(drm_gpuvm_resv(gpuvm), DMA_RESV_USAGE_BOOKKEEP))
+            continue;
+
+        /* 释放 VA 锁后 vm_bo 可能被解除，只保留地址空间的引用 */
+        drm_gpuvm_get(gpuvm);
+        fdca_gem_object_va_unlock(gem);
+        dma_resv_wait_timeout(drm_gpuvm_resv(gpuvm), DMA_RESV_USAGE_BOOKKEEP,
+                              false, MAX_SCHEDULE_TIMEOUT);
+        drm_gpuvm_put(gpuvm);
+        goto retry;
+    }
+    fdca_gem_object_va_unlock(gem);
+}
+
+/**
+ * fdca_vm_bo_invalidate() - 清除对象在所有地址空间中的页表项
+ * @gem: GEM 对象 (调用者不持有 VA 锁)
+ *
+ * 映射节点保留，只撤销页表项。对象后备重新有效后由 fdca_vm_bo_update()
+ * 重写。调用者保证地址空间已空闲。只获取 VA 锁和 pt_lock，不分配内存
+ */
+void fdca_vm_bo_invalidate(struct drm_gem_object *gem)
+{
+    struct drm_gpuvm_bo *vm_bo;
+    struct drm_gpuva *va;
+    struct fdca_vm *vm;
+
+    fdca_gem_object_va_lock(gem);
+    drm_gem_for_each_gpuvm_bo(vm_bo, gem) {
+        vm = to_fdca_vm(vm_bo->vm);
+
+        /* 整段映射的叶子项都在区间内，不需要拆分大页，不会失败 */
+        mutex_lock(&vm->pt_lock);
+        drm_gpuvm_bo_for_each_va(va, vm_bo) {
+            if (!to_fdca_vm_va(va)->dead)
+                WARN_ON(fdca_vm_pt_clear(vm, NULL, vm->root, va->va.addr, va->va.range));
+        }
+        mutex_unlock(&vm->pt_lock);
+
+        fdca_vm_flush(vm);
+    }
+    fdca_gem_object_va_unlock(gem);
+}
+
+/**
+ * fdca_vm_pt_base() - 获取 L0 页表的 DMA 地址，写入队列寄存器
+ * @vm: 地址空间
+ */
+dma_addr_t fdca_vm_pt_base(const struct fdca_vm *vm)
+{
+    return vm->root->dma;
+}
+
+/*
+ * ============================================================================
+ * 异步绑定
+ * ============================================================================
+ */
+
+/**
+ * struct fdca_vm_bind_item - 已校验的一个绑定操作
+ */
+struct fdca_vm_bind_item {
+    u32 op;                             /* FDCA_VM_BIND_OP_* */
+    struct drm_gem_object *gem;         /* MAP 的对象 (持有引用) */
+    struct drm_gpuvm_bo *vm_bo;         /* MAP 的 vm_bo (持有引用) */
+    u64 bo_offset;                      /* 对象内偏移 */
+    u64 va;                             /* 虚拟地址 */
+    u64 range;                          /* 字节数 */
+    u64 pte_flags;                      /* 页表项权限位 */
+    bool contig;                        /* 页表按连续后备估计 */
+};
+
+/**
+ * struct fdca_vm_bind_job - 一次 VM_BIND 对应的调度器作业
+ *
+ * 作业持有地址空间和各对象的引用，以及执行时用到的全部内存，
+ * 在 free_job 之后由 free_work 释放
+ */
+struct fdca_vm_bind_job {
+    struct drm_sched_job base;          /* 调度器作业 */
+    struct fdca_vm *vm;                 /* 目标地址空间 */
+    struct list_head pending_link;      /* vm->bind_pending 节点 */
+    struct work_struct free_work;       /* 释放需要对象锁，不在调度器线程中进行 */
+    struct fdca_vm_pt_cache pt_cache;   /* 预分配的页表 */
+    struct list_head va_cache;          /* 预分配的映射节点 */
+    struct list_head reap;              /* 执行时移出区间树的映射节点 */
+    u32 num_ops;                        /* 已校验的操作数 */
+    struct fdca_vm_bind_item ops[];     /* 操作数组 */
+};
+
+static inline struct fdca_vm_bind_job *to_fdca_vm_bind_job(struct drm_sched_job *job)
+{
+    return container_of(job, struct fdca_vm_bind_job, base);
+}
+
+/* 作业的映射已进入区间树，或作业不会再执行 */
+static void fdca_vm_bind_job_retire(struct fdca_vm_bind_job *job)
+{
+    spin_lock(&job->vm->bind_pending_lock);
+    list_del_init(&job->pending_link);
+    spin_unlock(&job->vm->bind_pending_lock);
+}
+
+static void fdca_vm_bind_job_free(struct fdca_vm_bind_job *job)
+{
+    struct fdca_vm_bind_item *item;
+    struct fdca_vm_va *va, *tmp;
+    u32 i;
+
+    fdca_vm_bind_job_retire(job);
+    drm_sched_job_cleanup(&job->base);
+
+    fdca_vm_va_reap(&job->reap);
+
+    list_for_each_entry_safe(va, tmp, &job->va_cache, link)
+        kfree(va);
+    fdca_vm_pt_cache_fini(job->vm, &job->pt_cache);
+
+    for (i = 0; i < job->num_ops; i++) {
+        item = &job->ops[i];
+
+        /* 放下最后一个引用时 vm_bo 移出对象的链表 */
+        if (item->vm_bo) {
+            fdca_gem_object_lock(item->gem);
+            fdca_gem_object_va_lock(item->gem);
+            drm_gpuvm_bo_put(item->vm_bo);
+            fdca_gem_object_va_unlock(item->gem);
+            fdca_gem_object_unlock(item->gem);
+        }
+
+        if (item->gem)
+            drm_gem_object_put(item->gem);
+    }
+
+    drm_gpuvm_put(&job->vm->base);
+    kvfree(job);
+}
+
+static void fdca_vm_bind_job_free_work(struct work_struct *work)
+{
+    fdca_vm_bind_job_free(container_of(work, struct fdca_vm_bind_job, free_work));
+}
+
+/*
+ * 页表更新由 CPU 同步完成，返回 NULL 时调度器立即触发完成 fence，
+ * 返回错误指针时错误码随 fence 传递给等待者。执行期间只获取 lock、
+ * 对象的 VA 锁和 pt_lock，不分配内存：回收路径可能正等待这个 fence
+ */
+static struct dma_fence *fdca_vm_bind_run_job(struct drm_sched_job *sched_job)
+{
+    struct fdca_vm_bind_job *job = to_fdca_vm_bind_job(sched_job);
+    struct fdca_vm *vm = job->vm;
+    struct fdca_vm_op_ctx octx = {
+        .vm = vm,
+        .pt_cache = &job->pt_cache,
+        .va_cache = &job->va_cache,
+        .reap = &job->reap,
+    };
+    struct fdca_vm_bind_item *item;
+    int ret = 0;
+    u32 i;
+
+    /* 实体被销毁时未执行的作业已带错误码 */
+    if (sched_job->s_fence->finished.error) {
+        fdca_vm_bind_job_retire(job);
+        return NULL;
+    }
+
+    mutex_lock(&vm->lock);
+    for (i = 0; i < job->num_ops && !ret; i++) {
+        item = &job->ops[i];
+        if (item->op == FDCA_VM_BIND_OP_MAP) {
+            octx.pte_flags = item->pte_flags;
+            octx.vm_bo = item->vm_bo;
+            ret = drm_gpuvm_sm_map(&vm->base, &octx, item->va, item->range,
+                                   item->gem, item->bo_offset);
+        } else {
+            ret = drm_gpuvm_sm_unmap(&vm->base, &octx, item->va, item->range);
+        }
+    }
+    mutex_unlock(&vm->lock);
+
+    fdca_vm_flush(vm);
+
+    /* 映射已在区间树中，之后的重叠检查改由区间树发现 */
+    fdca_vm_bind_job_retire(job);
+
+    if (ret) {
+        fdca_dbg(vm->fdev, "VM_BIND 第 %u 个操作失败: %d\n", i - 1, ret);
+        return ERR_PTR(ret);
+    }
+
+    return NULL;
+}
+
+static enum drm_gpu_sched_stat fdca_vm_bind_timedout_job(struct drm_sched_job *sched_job)
+{
+    /* run_job 返回时作业已完成，不会超时 */
+    return DRM_GPU_SCHED_STAT_NOMINAL;
+}
+
+static void fdca_vm_bind_free_job(struct drm_sched_job *sched_job)
+{
+    struct fdca_vm_bind_job *job = to_fdca_vm_bind_job(sched_job);
+
+    /* 调度器线程也执行 run_job，不能阻塞在可能正分配内存的对象锁上 */
+    queue_work(system_unbound_wq, &job->free_work);
+}
+
+static const struct drm_sched_backend_ops fdca_vm_bind_sched_ops = {
+    .run_job = fdca_vm_bind_run_job,
+    .timedout_job = fdca_vm_bind_timedout_job,
+    .free_job = fdca_vm_bind_free_job,
+};
+
+/**
+ * fdca_vm_bind_check_op() - 校验用户态操作并查找对象
+ * @file: DRM 文件
+ * @vm: 地址空间
+ * @uop: 用户态操作
+ * @item: 输出：校验后的操作
+ * @wait_idle: 输出：解映射操作置位
+ *
+ * 映射是否与已有映射重叠要到入队时由 fdca_vm_bind_overlaps() 判断
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vm_bind_check_op(struct drm_file *file, struct fdca_vm *vm,
+                                 const struct drm_fdca_vm_bind_op *uop,
+                                 struct fdca_vm_bind_item *item, bool *wait_idle)
+{
+    struct drm_gem_object *gem;
+    int ret;
+
+    if (uop->pad || !uop->range || !IS_ALIGNED(uop->va | uop->range, PAGE_SIZE))
+        return -EINVAL;
+
+    if (!drm_gpuvm_range_valid(&vm->base, uop->va, uop->range))
+        return -EINVAL;
+
+    item->op = uop->op;
+    item->va = uop->va;
+    item->range = uop->range;
+
+    switch (uop->op) {
+    case FDCA_VM_BIND_OP_UNMAP:
+        if (uop->flags)
+            return -EINVAL;
+        *wait_idle = true;
+        return 0;
+
+    case FDCA_VM_BIND_OP_MAP:
+        if (uop->flags & ~FDCA_VM_BIND_READONLY ||
+            !IS_ALIGNED(uop->bo_offset, PAGE_SIZE))
+            return -EINVAL;
+
+        gem = drm_gem_object_lookup(file, uop->handle);
+        if (!gem)
+            return -ENOENT;
+        item->gem = gem;
+
+        if (uop->range > gem->size || uop->bo_offset > gem->size - uop->range)
+            return -EINVAL;
+
+        /* 只读用户指针对象只能只读映射 */
+        if (!(uop->flags & FDCA_VM_BIND_READONLY) && fdca_gem_object_readonly(gem))
+            return -EPERM;
+
+        /*
+         * 用户指针和导入对象在这里获取后备，作业中不阻塞在 mmap 锁或
+         * dma-buf 预留锁上。执行前再次失效的对象只建立映射节点
+         */
+        ret = fdca_gem_object_validate(gem);
+        if (ret)
+            return ret;
+
+        item->bo_offset = uop->bo_offset;
+        item->pte_flags = FDCA_GTT_PTE_READABLE;
+        if (!(uop->flags & FDCA_VM_BIND_READONLY))
+            item->pte_flags |= FDCA_GTT_PTE_WRITABLE;
+        return 0;
+
+    default:
+        return -EINVAL;
+    }
+}
+
+/**
+ * fdca_vm_bind_overlaps() - 检查作业的映射是否会替换已有或即将建立的映射
+ * @vm: 地址空间 (调用者持有 bind_lock)
+ * @job: 尚未入队的作业
+ *
+ * 区间树只反映已执行的作业，排在前面、尚未执行的作业建立的映射要查
+ * bind_pending。作业先插入区间树再移出 bind_pending，这里按相反顺序
+ * 检查，两边总有一处能看到它的映射
+ *
+ * Return: 任一映射与之重叠时返回 true
+ */
+static bool fdca_vm_bind_overlaps(struct fdca_vm *vm, struct fdca_vm_bind_job *job)
+{
+    struct fdca_vm_bind_job *pending;
+    struct fdca_vm_bind_item *item, *other;
+    bool overlap = false;
+    u32 i, j;
+
+    lockdep_assert_held(&vm->bind_lock);
+
+    spin_lock(&vm->bind_pending_lock);
+    list_for_each_entry(pending, &vm->bind_pending, pending_link) {
+        for (i = 0; i < job->num_ops && !overlap; i++) {
+            item = &job->ops[i];
+            if (item->op != FDCA_VM_BIND_OP_MAP)
+                continue;
+
+            for (j = 0; j < pending->num_ops; j++) {
+                other = &pending->ops[j];
+                if (other->op == FDCA_VM_BIND_OP_MAP &&
+                    item->va < other->va + other->range &&
+                    other->va < item->va + item->range) {
+                    overlap = true;
+                    break;
+                }
+            }
+        }
+        if (overlap)
+            break;
+    }
+    spin_unlock(&vm->bind_pending_lock);
+
+    if (overlap)
+        return true;
+
+    mutex_lock(&vm->lock);
+    for (i = 0; i < job->num_ops && !overlap; i++) {
+        item = &job->ops[i];
+        if (item->op == FDCA_VM_BIND_OP_MAP &&
+            drm_gpuva_find_first(&vm->base, item->va, item->range))
+            overlap = true;
+    }
+    mutex_unlock(&vm->lock);
+
+    return overlap;
+}
+
+/**
+ * fdca_vm_bind_prealloc() - 入队前分配作业执行时用到的映射节点和 vm_bo
+ * @vm: 地址空间
+ * @job: 尚未入队的作业
+ *
+ * 映射最多替换一段、拆出前后两段，解映射最多拆出前后两段
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vm_bind_prealloc(struct fdca_vm *vm, struct fdca_vm_bind_job *job)
+{
+    struct fdca_vm_bind_item *item;
+    struct fdca_vm_va *va;
+    u32 i, n;
+
+    for (i = 0; i < job->num_ops; i++) {
+        item = &job->ops[i];
+
+        for (n = item->op == FDCA_VM_BIND_OP_MAP ? 3 : 2; n; n--) {
+            va = kzalloc(sizeof(*va), GFP_KERNEL);
+            if (!va)
+                return -ENOMEM;
+            INIT_LIST_HEAD(&va->link);
+            list_add(&va->link, &job->va_cache);
+        }
+
+        if (item->op != FDCA_VM_BIND_OP_MAP)
+            continue;
+
+        item->vm_bo = drm_gpuvm_bo_create(&vm->base, item->gem);
+        if (!item->vm_bo)
+            return -ENOMEM;
+
+        /* 对象在该地址空间中已有 vm_bo 时放下预分配的 */
+        fdca_gem_object_lock(item->gem);
+        fdca_gem_object_va_lock(item->gem);
+        item->vm_bo = drm_gpuvm_bo_obtain_prealloc(item->vm_bo);
+        fdca_gem_object_va_unlock(item->gem);
+        fdca_gem_object_unlock(item->gem);
+    }
+
+    return 0;
+}
+
+/**
+ * fdca_vm_bind_prepare() - 建立系统内存后备并预分配页表
+ * @vm: 地址空间
+ * @job: 尚未入队的作业
+ *
+ * 按对象当前的后备估计页表数，之后对象仍可能被迁移，入队前由
+ * fdca_vm_bind_backing_stable() 确认。失效的用户指针对象只建立映射
+ * 节点，按系统内存估计。可重复调用，页表缓存只补足差额
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vm_bind_prepare(struct fdca_vm *vm, struct fdca_vm_bind_job *job)
+{
+    u32 need[FDCA_GTT_MAX_LEVELS] = { 0 };
+    struct fdca_vm_bind_item *item;
+    struct sg_table *sgt = NULL;
+    u64 vram_offset = 0;
+    u32 i;
+    int ret;
+
+    for (i = 0; i < job->num_ops; i++) {
+        item = &job->ops[i];
+
+        if (item->op != FDCA_VM_BIND_OP_MAP) {
+            fdca_vm_pt_cache_count(need, item->va, item->range, false, false);
+            continue;
+        }
+
+        fdca_gem_object_lock(item->gem);
+        ret = fdca_gem_object_get_backing(item->gem, &vram_offset, &sgt);
+        fdca_gem_object_unlock(item->gem);
+
+        if (ret && ret != -EAGAIN)
+            return ret;
+
+        item->contig = !ret && fdca_vm_backing_contig(sgt, vram_offset + item->bo_offset,
+                                                      item->va);
+        fdca_vm_pt_cache_count(need, item->va, item->range, true, item->contig);
+    }
+
+    return fdca_vm_pt_cache_fill(vm, &job->pt_cache, need);
+}
+
+/**
+ * fdca_vm_bind_backing_stable() - 确认按连续后备估计的对象未被迁移
+ * @job: 尚未入队的作业
+ *
+ * 调用者持有地址空间预留锁。迁移路径整个搬移期间持有映射了对象的
+ * 地址空间的预留锁，并跳过预留对象中有未完成 fence 的对象，这里看到
+ * 的后备保持到作业执行结束
+ *
+ * Return: 全部未变时返回 true
+ */
+static bool fdca_vm_bind_backing_stable(struct fdca_vm_bind_job *job)
+{
+    struct fdca_vm_bind_item *item;
+    struct sg_table *sgt;
+    u64 vram_offset;
+    bool stable;
+    u32 i;
+    int ret;
+
+    for (i = 0; i < job->num_ops; i++) {
+        item = &job->ops[i];
+        if (item->op != FDCA_VM_BIND_OP_MAP || !item->contig)
+            continue;
+
+        fdca_gem_object_va_lock(item->gem);
+        ret = fdca_gem_object_peek_backing(item->gem, &vram_offset, &sgt);
+        stable = !ret && fdca_vm_backing_contig(sgt, vram_offset + item->bo_offset,
+                                                item->va);
+        fdca_gem_object_va_unlock(item->gem);
+
+        if (!stable)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * fdca_vm_bind() - 异步执行一批映射/解映射操作
+ * @file: DRM 文件
+ * @vm: 上下文地址空间
+ * @args: VM_BIND 参数
+ *
+ * 操作在 ioctl 中完成校验和对象查找，页表修改由地址空间的绑定实体
+ * 在输入 syncobj 触发后执行，ioctl 不阻塞。同一地址空间的作业按提交
+ * 顺序执行；含解映射或会替换已有映射 (包括排在前面、尚未执行的作业
+ * 建立的映射) 的作业还依赖地址空间预留对象上记录的在途计算作业，
+ * 保证 GPU 不会访问已撤销的页。不重叠的映射不等待，可与计算重叠。
+ *
+ * 作业执行时用到的内存都在这里、作业 fence 创建之前分配。作业 fence
+ * 同样加入预留对象，执行前迁移路径不会搬移它映射的对象。fence 创建
+ * 到入队之间不分配内存，也不获取对象锁，等待它的回收路径不会反过来
+ * 阻塞入队
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_vm_bind(struct drm_file *file, struct fdca_vm *vm,
+                 struct drm_fdca_vm_bind *args)
+{
+    struct drm_fdca_vm_bind_op *uops;
+    struct drm_fdca_syncobj *syncs;
+    struct fdca_syncobj_out *out = NULL;
+    struct fdca_vm_bind_job *job;
+    struct dma_resv *resv;
+    struct dma_fence *fence;
+    bool wait_idle = false;
+    bool overlap;
+    u32 i;
+    int ret;
+
+    if (!args->ops_ptr || !args->num_ops ||
+        args->num_ops > FDCA_VM_BIND_MAX_OPS || args->flags)
+        return -EINVAL;
+
+    uops = kvmalloc_array(args->num_ops, sizeof(*uops), GFP_KERNEL);
+    if (!uops)
+        return -ENOMEM;
+
+    if (copy_from_user(uops, u64_to_user_ptr(args->ops_ptr),
+                       args->num_ops * sizeof(*uops))) {
+        ret = -EFAULT;
+        goto out_free_uops;
+    }
+
+    job = kvzalloc(struct_size(job, ops, args->num_ops), GFP_KERNEL);
+    if (!job) {
+        ret = -ENOMEM;
+        goto out_free_uops;
+    }
+
+    ret = drm_sched_job_init(&job->base, &vm->bind_entity, 1, vm);
+    if (ret) {
+        kvfree(job);
+        goto out_free_uops;
+    }
+
+    drm_gpuvm_get(&vm->base);
+    job->vm = vm;
+    INIT_LIST_HEAD(&job->pending_link);
+    INIT_WORK(&job->free_work, fdca_vm_bind_job_free_work);
+    fdca_vm_pt_cache_init(&job->pt_cache);
+    INIT_LIST_HEAD(&job->va_cache);
+    INIT_LIST_HEAD(&job->reap);
+
+    for (i = 0; i < args->num_ops; i++) {
+        /* 先计数，查找失败时对象引用也能被释放 */
+        job->num_ops++;
+        ret = fdca_vm_bind_check_op(file, vm, &uops[i], &job->ops[i], &wait_idle);
+        if (ret)
+            goto err_free_job;
+    }
+
+    if (args->num_in_syncs) {
+        syncs = fdca_syncobj_copy(args->in_syncs_ptr, args->num_in_syncs);
+        if (IS_ERR(syncs)) {
+            ret = PTR_ERR(syncs);
+            goto err_free_job;
+        }
+
+        ret = fdca_syncobj_add_deps(file, &job->base, syncs, args->num_in_syncs);
+        kvfree(syncs);
+        if (ret)
+            goto err_free_job;
+    }
+
+    /* 输出 syncobj 先行查找并预分配，入队之后不再失败 */
+    if (args->num_out_syncs) {
+        syncs = fdca_syncobj_copy(args->out_syncs_ptr, args->num_out_syncs);
+        if (IS_ERR(syncs)) {
+            ret = PTR_ERR(syncs);
+            goto err_free_job;
+        }
+
+        out = kvcalloc(args->num_out_syncs, sizeof(*out), GFP_KERNEL);
+        if (!out) {
+            kvfree(syncs);
+            ret = -ENOMEM;
+            goto err_free_job;
+        }
+
+        ret = fdca_syncobj_out_prepare(file, syncs, args->num_out_syncs, out);
+        kvfree(syncs);
+        if (ret)
+            goto err_free_out;
+    }
+
+    ret = fdca_vm_bind_prealloc(vm, job);
+    if (ret)
+        goto err_free_out;
+
+    resv = drm_gpuvm_resv(&vm->base);
+
+retry:
+    ret = fdca_vm_bind_prepare(vm, job);
+    if (ret)
+        goto err_free_out;
+
+    /* 重叠检查到入队之间不能有新作业插入 */
+    mutex_lock(&vm->bind_lock);
+
+    overlap = wait_idle || fdca_vm_bind_overlaps(vm, job);
+
+    dma_resv_lock(resv, NULL);
+
+    /* 估计页表后对象被迁移，重新估计 */
+    if (!fdca_vm_bind_backing_stable(job)) {
+        dma_resv_unlock(resv);
+        mutex_unlock(&vm->bind_lock);
+        goto retry;
+    }
+
+    if (overlap)
+        ret = drm_sched_job_add_resv_dependencies(&job->base, resv,
+                                                  DMA_RESV_USAGE_BOOKKEEP);
+    if (!ret)
+        ret = dma_resv_reserve_fences(resv, 1);
+    if (ret) {
+        dma_resv_unlock(resv);
+        mutex_unlock(&vm->bind_lock);
+        goto err_free_out;
+    }
+
+    if (overlap)
+        atomic64_inc(&vm->bind_waits);
+
+    spin_lock(&vm->bind_pending_lock);
+    list_add_tail(&job->pending_link, &vm->bind_pending);
+    spin_unlock(&vm->bind_pending_lock);
+
+    /* 作业在此被消耗 */
+    drm_sched_job_arm(&job->base);
+    fence = dma_fence_get(&job->base.s_fence->finished);
+    dma_resv_add_fence(resv, fence, DMA_RESV_USAGE_BOOKKEEP);
+    dma_resv_unlock(resv);
+
+    drm_sched_entity_push_job(&job->base);
+    mutex_unlock(&vm->bind_lock);
+
+    fdca_syncobj_out_signal(out, args->num_out_syncs, fence);
+    dma_fence_put(fence);
+
+    atomic64_inc(&vm->bind_jobs);
+    atomic64_add(args->num_ops, &vm->bind_ops);
+
+    fdca_syncobj_out_free(out, args->num_out_syncs);
+    kvfree(out);
+    kvfree(uops);
+    return 0;
+
+err_free_out:
+    fdca_syncobj_out_free(out, args->num_out_syncs);
+    kvfree(out);
+err_free_job:
+    fdca_vm_bind_job_free(job);
+out_free_uops:
+    kvfree(uops);
+    return ret;
+}
+
+/**
+ * fdca_vm_bind_init() - 创建地址空间更新调度器
+ * @fdev: FDCA 设备
+ *
+ * 所有地址空间共用一个调度器，每个地址空间一个实体
+ *
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_vm_bind_init(struct fdca_device *fdev)
+{
+    const struct drm_sched_init_args args = {
+        .ops = &fdca_vm_bind_sched_ops,
+        .num_rqs = DRM_SCHED_PRIORITY_COUNT,
+        .credit_limit = 1,
+        .timeout = MAX_SCHEDULE_TIMEOUT,
+        .name = "fdca-vm-bind",
+        .dev = fdev->dev,
+    };
+    int ret;
+
+    ret = drm_sched_init(&fdev->vm_bind_sched, &args);
+    if (ret)
+        fdca_err(fdev, "地址空间更新调度器初始化失败: %d\n", ret);
+
+    return ret;
+}
+
+/**
+ * fdca_vm_bind_fini() - 销毁地址空间更新调度器
+ *
+ * 调用前所有地址空间必须已销毁
+ */
+void fdca_vm_bind_fini(struct fdca_device *fdev)
+{
+    drm_sched_fini(&fdev->vm_bind_sched);
+}
+
+/*
+ * ============================================================================
+ * 导出符号
+ * ============================================================================
+ */
+
+EXPORT_SYMBOL_GPL(fdca_vm_create);
+EXPORT_SYMBOL_GPL(fdca_vm_destroy);
+EXPORT_SYMBOL_GPL(fdca_vm_bo_update);
+EXPORT_SYMBOL_GPL(fdca_vm_bo_lock_idle);
+EXPORT_SYMBOL_GPL(fdca_vm_bo_unlock);
+EXPORT_SYMBOL_GPL(fdca_vm_bo_wait_idle);
+EXPORT_SYMBOL_GPL(fdca_vm_bo_invalidate);
+EXPORT_SYMBOL_GPL(fdca_vm_pt_base);
+EXPORT_SYMBOL_GPL(fdca_vm_bind);
+EXPORT_SYMBOL_GPL(fdca_vm_bind_init);
+EXPORT_SYMBOL_GPL(fdca_vm_bind_fini);
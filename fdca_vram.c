@@ -21,8 +21,12 @@
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/workqueue.h>
-#include <linux/delay.h>
 #include <linux/genalloc.h>
+#include <linux/highmem.h>
+#include <linux/io.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
+#include <linux/sizes.h>
 
 #include <drm/drm_buddy.h>
 #include <drm/drm_print.h>
@@ -35,20 +39,11 @@
  * ============================================================================
  */
 
-/* VRAM 块大小定义 */
-#define FDCA_VRAM_MIN_BLOCK_SIZE    PAGE_SIZE           /* 最小块: 4KB */
-#define FDCA_VRAM_LARGE_BLOCK_SIZE  (2 << 20)           /* 大页块: 2MB */
-#define FDCA_VRAM_HUGE_BLOCK_SIZE   (1 << 30)           /* 巨页块: 1GB */
-
-/* 分配标志 */
-#define FDCA_VRAM_ALLOC_CONTIGUOUS  BIT(0)              /* 连续分配 */
-#define FDCA_VRAM_ALLOC_LARGE_PAGE  BIT(1)              /* 大页分配 */
-#define FDCA_VRAM_ALLOC_PINNED      BIT(2)              /* 固定内存 */
-#define FDCA_VRAM_ALLOC_CACHED      BIT(3)              /* 缓存内存 */
-
 /* 碎片整理阈值 */
 #define FDCA_VRAM_FRAG_THRESHOLD    25                  /* 碎片率 25% */
 #define FDCA_VRAM_DEFRAG_INTERVAL   (30 * HZ)           /* 30秒检查间隔 */
+#define FDCA_VRAM_DEFRAG_SLICE_NS   (2 * NSEC_PER_MSEC) /* 每个时间片最长 2ms */
+#define FDCA_VRAM_DEFRAG_MAX_MOVE   (64 << 20)          /* 单次搬移的最大对象 */
 
 /*
  * ============================================================================
@@ -83,8 +78,16 @@ struct fdca_vram_object {
     /* 调试信息 */
     const char *debug_name;             /* 调试名称 */
     struct task_struct *owner;          /* 所有者进程 */
+    
+    /* 碎片整理 */
+    const struct fdca_vram_owner_ops *owner_ops; /* 所有者回调，NULL 表示不可搬移 */
+    void *owner_priv;                   /* 回调参数 */
 };
 
+/* 前向声明 */
+static void fdca_vram_defrag_work(struct work_struct *work);
+static void fdca_vram_check_fragmentation(struct fdca_device *fdev);
+
 /*
  * ============================================================================
  * VRAM 管理器初始化和清理
@@ -138,7 +141,7 @@ int fdca_vram_manager_init(struct fdca_device *fdev)
 {
     struct fdca_vram_manager *vram = &fdev->mem_mgr->vram;
     u64 vram_size;
-    int ret;
+    int cpu, i, ret;
     
     fdca_info(fdev, "初始化 VRAM 管理器\n");
     
@@ -166,9 +169,27 @@ int fdca_vram_manager_init(struct fdca_device *fdev)
     atomic64_set(&vram->free_count, 0);
     atomic64_set(&vram->large_page_count, 0);
     
+    /* 初始化每 CPU 小块缓存 */
+    vram->pcp = alloc_percpu(struct fdca_vram_pcp);
+    if (!vram->pcp) {
+        drm_buddy_fini(&vram->buddy);
+        return -ENOMEM;
+    }
+    for_each_possible_cpu(cpu) {
+        struct fdca_vram_pcp *pcp = per_cpu_ptr(vram->pcp, cpu);
+        
+        for (i = 0; i < FDCA_VRAM_NR_CLASSES; i++)
+            spin_lock_init(&pcp->mags[i].lock);
+    }
+    atomic64_set(&vram->mag_cached, 0);
+    
     /* 初始化碎片整理工作 */
+    INIT_LIST_HEAD(&vram->objects);
+    spin_lock_init(&vram->objects_lock);
     INIT_WORK(&vram->defrag_work, fdca_vram_defrag_work);
     vram->defrag_in_progress = false;
+    atomic64_set(&vram->defrag_moves, 0);
+    atomic64_set(&vram->defrag_bytes, 0);
     
     fdca_info(fdev, "VRAM 管理器初始化完成: %llu MB\n", vram_size >> 20);
     
@@ -185,10 +206,12 @@ void fdca_vram_manager_fini(struct fdca_device *fdev)
     
     fdca_info(fdev, "清理 VRAM 管理器\n");
     
-    /* 等待碎片整理完成 */
-    if (vram->defrag_in_progress) {
-        cancel_work_sync(&vram->defrag_work);
-    }
+    /* 等待碎片整理完成，整理工作可能自行重新排队 */
+    cancel_work_sync(&vram->defrag_work);
+    
+    /* 缓存的块归还 buddy 后再检查泄漏 */
+    fdca_vram_mag_drain(vram);
+    free_percpu(vram->pcp);
     
     /* 清理 buddy 分配器 */
     drm_buddy_fini(&vram->buddy);
@@ -213,6 +236,241 @@ void fdca_vram_manager_fini(struct fdca_device *fdev)
  * ============================================================================
  */
 
+/*
+ * 每 CPU 小块缓存
+ *
+ * 4K、64K 和 2M 三个规格的块在每个 CPU 上各缓存若干个，分配和释放这些规格
+ * 的对象只取本 CPU 缓存的自旋锁，不进入 VRAM 锁和 buddy 分配器。缓存空时
+ * 在 VRAM 锁下一次补充半个缓存，满时一次归还半个缓存。
+ * 缓存中的块在 buddy 看来已分配，计入 vram->used；mag_cached 记录这部分
+ * 字节，统计时扣除。VRAM 分配失败和碎片整理开始时清空全部缓存
+ */
+
+/**
+ * struct fdca_vram_size_class - 缓存规格
+ */
+static const struct fdca_vram_size_class {
+    u64 size;                           /* 块大小 */
+    u32 max;                            /* 每 CPU 缓存块数上限 */
+} fdca_vram_classes[FDCA_VRAM_NR_CLASSES] = {
+    { SZ_4K,  FDCA_VRAM_MAG_MAX },
+    { SZ_64K, 16 },
+    { SZ_2M,  2 },
+};
+
+/**
+ * fdca_vram_size_class() - 查找与块大小完全相同的缓存规格
+ * 
+ * Return: 规格索引，不在缓存规格中时返回 -1
+ */
+static int fdca_vram_size_class(u64 block_size)
+{
+    int i;
+    
+    for (i = 0; i < FDCA_VRAM_NR_CLASSES; i++) {
+        if (fdca_vram_classes[i].size == block_size)
+            return i;
+    }
+    
+    return -1;
+}
+
+/**
+ * fdca_vram_block_size() - 对象占用的块大小
+ * 
+ * 每个对象占用一个 buddy 块，块大小为请求大小向上取 2 的幂
+ */
+static u64 fdca_vram_block_size(size_t size)
+{
+    return max_t(u64, roundup_pow_of_two(size), FDCA_VRAM_MIN_BLOCK_SIZE);
+}
+
+/**
+ * fdca_vram_buddy_free() - 把若干块归还 buddy
+ * @vram: VRAM 管理器 (调用者不持有锁)
+ * @blocks: 块数组
+ * @count: 块数量
+ */
+static void fdca_vram_buddy_free(struct fdca_vram_manager *vram,
+                                 struct drm_buddy_block **blocks, u32 count)
+{
+    u32 i;
+    
+    if (!count)
+        return;
+    
+    mutex_lock(&vram->lock);
+    for (i = 0; i < count; i++) {
+        vram->used -= drm_buddy_block_size(&vram->buddy, blocks[i]);
+        vram->available += drm_buddy_block_size(&vram->buddy, blocks[i]);
+        drm_buddy_free_block(&vram->buddy, blocks[i]);
+    }
+    mutex_unlock(&vram->lock);
+}
+
+/**
+ * fdca_vram_buddy_alloc() - 从 buddy 分配一个块
+ * @vram: VRAM 管理器 (调用者持有锁)
+ * @block_size: 块大小 (2 的幂)
+ * @flags: 分配标志
+ * 
+ * Return: 块指针或 ERR_PTR
+ */
+static struct drm_buddy_block *fdca_vram_buddy_alloc(struct fdca_vram_manager *vram,
+                                                     u64 block_size, u32 flags)
+{
+    struct drm_buddy_block *block;
+    LIST_HEAD(blocks);
+    int ret;
+    
+    lockdep_assert_held(&vram->lock);
+    
+    if (vram->available < block_size)
+        return ERR_PTR(-ENOSPC);
+    
+    ret = drm_buddy_alloc_blocks(&vram->buddy, 0, vram->size,
+                                 block_size, block_size, &blocks,
+                                 (flags & FDCA_VRAM_ALLOC_CONTIGUOUS) ?
+                                 DRM_BUDDY_CONTIGUOUS_ALLOCATION : 0);
+    if (ret)
+        return ERR_PTR(ret);
+    
+    block = list_first_entry(&blocks, struct drm_buddy_block, link);
+    list_del(&block->link);
+    
+    vram->used += block_size;
+    vram->available -= block_size;
+    
+    return block;
+}
+
+/**
+ * fdca_vram_mag_get() - 从本 CPU 缓存取一个块，缓存空时批量补充
+ * @vram: VRAM 管理器
+ * @class: 规格索引
+ * 
+ * Return: 块指针，VRAM 不足时返回 NULL
+ */
+static struct drm_buddy_block *fdca_vram_mag_get(struct fdca_vram_manager *vram,
+                                                 int class)
+{
+    const struct fdca_vram_size_class *sc = &fdca_vram_classes[class];
+    struct drm_buddy_block *blocks[FDCA_VRAM_MAG_MAX];
+    struct drm_buddy_block *block = NULL;
+    struct fdca_vram_mag *mag;
+    u32 n = 0, i;
+    
+    mag = &get_cpu_ptr(vram->pcp)->mags[class];
+    spin_lock(&mag->lock);
+    if (mag->count)
+        block = mag->blocks[--mag->count];
+    spin_unlock(&mag->lock);
+    put_cpu_ptr(vram->pcp);
+    
+    if (block) {
+        atomic64_sub(sc->size, &vram->mag_cached);
+        atomic64_inc(&vram->mag_hits);
+        return block;
+    }
+    
+    /* 补充半个缓存，第一个块直接返回 */
+    mutex_lock(&vram->lock);
+    while (n < max(sc->max / 2, 1u)) {
+        block = fdca_vram_buddy_alloc(vram, sc->size, 0);
+        if (IS_ERR(block))
+            break;
+        blocks[n++] = block;
+    }
+    mutex_unlock(&vram->lock);
+    
+    if (!n)
+        return NULL;
+    
+    atomic64_inc(&vram->mag_refills);
+    
+    /* 可能已迁移到其它 CPU 或被并发补充，放不下的块归还 buddy */
+    mag = &get_cpu_ptr(vram->pcp)->mags[class];
+    spin_lock(&mag->lock);
+    for (i = 1; i < n && mag->count < sc->max; i++)
+        mag->blocks[mag->count++] = blocks[i];
+    spin_unlock(&mag->lock);
+    put_cpu_ptr(vram->pcp);
+    
+    atomic64_add((i - 1) * sc->size, &vram->mag_cached);
+    fdca_vram_buddy_free(vram, &blocks[i], n - i);
+    
+    return blocks[0];
+}
+
+/**
+ * fdca_vram_mag_put() - 把块放回本 CPU 缓存，缓存满时批量归还 buddy
+ * @vram: VRAM 管理器
+ * @class: 规格索引
+ * @block: 块
+ */
+static void fdca_vram_mag_put(struct fdca_vram_manager *vram, int class,
+                              struct drm_buddy_block *block)
+{
+    const struct fdca_vram_size_class *sc = &fdca_vram_classes[class];
+    struct drm_buddy_block *blocks[FDCA_VRAM_MAG_MAX];
+    struct fdca_vram_mag *mag;
+    u32 n = 0;
+    
+    mag = &get_cpu_ptr(vram->pcp)->mags[class];
+    spin_lock(&mag->lock);
+    if (mag->count == sc->max) {
+        /* 归还最早放入的一半 */
+        n = max(sc->max / 2, 1u);
+        memcpy(blocks, mag->blocks, n * sizeof(*blocks));
+        memmove(mag->blocks, mag->blocks + n, (mag->count - n) * sizeof(*blocks));
+        mag->count -= n;
+    }
+    mag->blocks[mag->count++] = block;
+    spin_unlock(&mag->lock);
+    put_cpu_ptr(vram->pcp);
+    
+    atomic64_add(sc->size, &vram->mag_cached);
+    
+    if (n) {
+        atomic64_sub(n * sc->size, &vram->mag_cached);
+        atomic64_inc(&vram->mag_flushes);
+        fdca_vram_buddy_free(vram, blocks, n);
+    }
+}
+
+/**
+ * fdca_vram_mag_drain() - 清空所有 CPU 的缓存
+ * @vram: VRAM 管理器 (调用者不持有锁)
+ * 
+ * Return: 归还 buddy 的字节数
+ */
+static u64 fdca_vram_mag_drain(struct fdca_vram_manager *vram)
+{
+    struct drm_buddy_block *blocks[FDCA_VRAM_MAG_MAX];
+    struct fdca_vram_mag *mag;
+    u64 drained = 0;
+    u32 n;
+    int cpu, class;
+    
+    for_each_possible_cpu(cpu) {
+        for (class = 0; class < FDCA_VRAM_NR_CLASSES; class++) {
+            mag = &per_cpu_ptr(vram->pcp, cpu)->mags[class];
+            
+            spin_lock(&mag->lock);
+            n = mag->count;
+            memcpy(blocks, mag->blocks, n * sizeof(*blocks));
+            mag->count = 0;
+            spin_unlock(&mag->lock);
+            
+            atomic64_sub(n * fdca_vram_classes[class].size, &vram->mag_cached);
+            drained += n * fdca_vram_classes[class].size;
+            fdca_vram_buddy_free(vram, blocks, n);
+        }
+    }
+    
+    return drained;
+}
+
 /**
  * fdca_vram_alloc() - 分配 VRAM 内存
  * @fdev: FDCA 设备
@@ -220,6 +478,8 @@ void fdca_vram_manager_fini(struct fdca_device *fdev)
  * @flags: 分配标志
  * @debug_name: 调试名称
  * 
+ * 对象占用一个大小为 2 的幂的 buddy 块，缓存规格内的块优先从每 CPU 缓存分配
+ * 
  * Return: 内存对象指针或 ERR_PTR
  */
 struct fdca_vram_object *fdca_vram_alloc(struct fdca_device *fdev,
@@ -228,9 +488,9 @@ struct fdca_vram_object *fdca_vram_alloc(struct fdca_device *fdev,
 {
     struct fdca_vram_manager *vram = &fdev->mem_mgr->vram;
     struct fdca_vram_object *obj;
-    struct drm_buddy_block *block;
-    u64 min_block_size = FDCA_VRAM_MIN_BLOCK_SIZE;
-    int ret;
+    struct drm_buddy_block *block = NULL;
+    u64 block_size;
+    int class;
     
     /* 参数验证 */
     if (!size || size > vram->size) {
@@ -240,12 +500,7 @@ struct fdca_vram_object *fdca_vram_alloc(struct fdca_device *fdev,
     
     /* 页对齐 */
     size = PAGE_ALIGN(size);
-    
-    /* 大页优化 */
-    if ((flags & FDCA_VRAM_ALLOC_LARGE_PAGE) && 
-        size >= FDCA_VRAM_LARGE_BLOCK_SIZE) {
-        min_block_size = FDCA_VRAM_LARGE_BLOCK_SIZE;
-    }
+    block_size = fdca_vram_block_size(size);
     
     /* 分配对象结构 */
     obj = kzalloc(sizeof(*obj), GFP_KERNEL);
@@ -254,36 +509,36 @@ struct fdca_vram_object *fdca_vram_alloc(struct fdca_device *fdev,
         return ERR_PTR(-ENOMEM);
     }
     
-    /* 获取锁进行分配 */
-    mutex_lock(&vram->lock);
+    class = fdca_vram_size_class(block_size);
+    if (class >= 0)
+        block = fdca_vram_mag_get(vram, class);
     
-    /* 检查可用空间 */
-    if (vram->available < size) {
+    if (!block) {
+        mutex_lock(&vram->lock);
+        block = fdca_vram_buddy_alloc(vram, block_size, flags);
         mutex_unlock(&vram->lock);
-        fdca_err(fdev, "VRAM 空间不足: 请求 %zu，可用 %llu\n",
-                 size, vram->available);
-        kfree(obj);
-        return ERR_PTR(-ENOMEM);
-    }
-    
-    /* 使用 buddy 分配器分配内存 */
-    ret = drm_buddy_alloc_blocks(&vram->buddy, 0, vram->size,
-                                size, min_block_size, 
-                                &block, 1,
-                                (flags & FDCA_VRAM_ALLOC_CONTIGUOUS) ? 
-                                DRM_BUDDY_CONTIGUOUS_ALLOCATION : 0);
-    if (ret) {
-        mutex_unlock(&vram->lock);
-        fdca_err(fdev, "buddy 分配失败: %d\n", ret);
-        kfree(obj);
-        return ERR_PTR(ret);
+        
+        /* 其它 CPU 缓存的块可能正好够用，清空后重试一次 */
+        if (IS_ERR(block) && fdca_vram_mag_drain(vram)) {
+            mutex_lock(&vram->lock);
+            block = fdca_vram_buddy_alloc(vram, block_size, flags);
+            mutex_unlock(&vram->lock);
+        }
+        
+        if (IS_ERR(block)) {
+            /* 调用者可以驱逐后重试，不视为错误 */
+            fdca_dbg(fdev, "VRAM 空间不足: 请求 %zu, 错误 %ld\n",
+                     size, PTR_ERR(block));
+            kfree(obj);
+            return ERR_CAST(block);
+        }
     }
     
     /* 初始化对象 */
     INIT_LIST_HEAD(&obj->list);
     obj->block = block;
     obj->offset = drm_buddy_block_offset(block);
-    obj->size = drm_buddy_block_size(block);
+    obj->size = block_size;
     obj->flags = flags;
     obj->cpu_addr = NULL;
     obj->dma_addr = 0;
@@ -294,17 +549,17 @@ struct fdca_vram_object *fdca_vram_alloc(struct fdca_device *fdev,
     obj->debug_name = debug_name;
     obj->owner = current;
     
+    spin_lock(&vram->objects_lock);
+    list_add_tail(&obj->list, &vram->objects);
+    spin_unlock(&vram->objects_lock);
+    
     /* 更新统计信息 */
-    vram->used += obj->size;
-    vram->available -= obj->size;
     atomic64_inc(&vram->alloc_count);
     
     if (flags & FDCA_VRAM_ALLOC_LARGE_PAGE) {
         atomic64_inc(&vram->large_page_count);
     }
     
-    mutex_unlock(&vram->lock);
-    
     fdca_dbg(fdev, "VRAM 分配成功: 偏移=0x%llx, 大小=%zu, 标志=0x%x, 名称=%s\n",
              obj->offset, obj->size, flags, debug_name ?: "匿名");
     
@@ -319,6 +574,7 @@ struct fdca_vram_object *fdca_vram_alloc(struct fdca_device *fdev,
 void fdca_vram_free(struct fdca_device *fdev, struct fdca_vram_object *obj)
 {
     struct fdca_vram_manager *vram = &fdev->mem_mgr->vram;
+    int class;
     
     if (!obj) {
         fdca_warn(fdev, "尝试释放空的 VRAM 对象\n");
@@ -339,17 +595,21 @@ void fdca_vram_free(struct fdca_device *fdev, struct fdca_vram_object *obj)
         fdca_vram_unmap(fdev, obj);
     }
     
-    mutex_lock(&vram->lock);
+    spin_lock(&vram->objects_lock);
+    list_del(&obj->list);
+    spin_unlock(&vram->objects_lock);
     
-    /* 释放 buddy 块 */
-    drm_buddy_free_block(&vram->buddy, obj->block);
-    
-    /* 更新统计信息 */
-    vram->used -= obj->size;
-    vram->available += obj->size;
     atomic64_inc(&vram->free_count);
     
-    mutex_unlock(&vram->lock);
+    /* 缓存规格的块放回每 CPU 缓存，不影响 buddy 碎片 */
+    class = fdca_vram_size_class(obj->size);
+    if (class >= 0) {
+        fdca_vram_mag_put(vram, class, obj->block);
+        kfree(obj);
+        return;
+    }
+    
+    fdca_vram_buddy_free(vram, &obj->block, 1);
     
     /* 释放对象结构 */
     kfree(obj);
@@ -358,6 +618,125 @@ void fdca_vram_free(struct fdca_device *fdev, struct fdca_vram_object *obj)
     fdca_vram_check_fragmentation(fdev);
 }
 
+/**
+ * fdca_vram_object_offset() - 获取对象在 VRAM 中的偏移
+ * @obj: 内存对象
+ * 
+ * Return: 相对 VRAM 起始的字节偏移
+ */
+u64 fdca_vram_object_offset(const struct fdca_vram_object *obj)
+{
+    return obj->offset;
+}
+
+/**
+ * fdca_vram_object_is_large() - 对象是否以 2MB 大页块分配
+ * @obj: 内存对象
+ * 
+ * 大页块的起始偏移按 FDCA_VRAM_LARGE_BLOCK_SIZE 对齐，可用 PMD 映射
+ */
+bool fdca_vram_object_is_large(const struct fdca_vram_object *obj)
+{
+    return (obj->flags & FDCA_VRAM_ALLOC_LARGE_PAGE) &&
+           obj->size >= FDCA_VRAM_LARGE_BLOCK_SIZE &&
+           IS_ALIGNED(obj->offset, FDCA_VRAM_LARGE_BLOCK_SIZE);
+}
+
+/**
+ * fdca_vram_set_owner() - 注册对象所有者，使对象可被碎片整理搬移
+ * @fdev: FDCA 设备
+ * @obj: VRAM 对象
+ * @ops: 所有者回调
+ * @priv: 回调参数
+ */
+void fdca_vram_set_owner(struct fdca_device *fdev, struct fdca_vram_object *obj,
+                         const struct fdca_vram_owner_ops *ops, void *priv)
+{
+    struct fdca_vram_manager *vram = &fdev->mem_mgr->vram;
+    
+    spin_lock(&vram->objects_lock);
+    obj->owner_ops = ops;
+    obj->owner_priv = priv;
+    spin_unlock(&vram->objects_lock);
+}
+
+/**
+ * fdca_vram_copy_pages() - 在 VRAM 对象与系统内存页之间拷贝
+ * @fdev: FDCA 设备
+ * @obj: VRAM 对象
+ * @pages: 系统内存页数组
+ * @num_pages: 页数，不超过对象大小
+ * @to_vram: true 表示从系统内存拷入 VRAM，false 表示拷出
+ * 
+ * 迁移引擎的 CPU 实现：临时以写合并方式映射 BAR 逐页拷贝，
+ * 不影响对象自身的 fdca_vram_map() 映射
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_vram_copy_pages(struct fdca_device *fdev, struct fdca_vram_object *obj,
+                         struct page **pages, u32 num_pages, bool to_vram)
+{
+    size_t size = (size_t)num_pages << PAGE_SHIFT;
+    void __iomem *vaddr;
+    void *page_addr;
+    u32 i;
+    
+    if (size > obj->size)
+        return -EINVAL;
+    
+    vaddr = ioremap_wc(fdev->vram_base + obj->offset, size);
+    if (!vaddr) {
+        fdca_err(fdev, "VRAM 拷贝映射失败: 偏移=0x%llx\n", obj->offset);
+        return -ENOMEM;
+    }
+    
+    for (i = 0; i < num_pages; i++) {
+        page_addr = kmap_local_page(pages[i]);
+        if (to_vram)
+            memcpy_toio(vaddr + ((size_t)i << PAGE_SHIFT), page_addr, PAGE_SIZE);
+        else
+            memcpy_fromio(page_addr, vaddr + ((size_t)i << PAGE_SHIFT), PAGE_SIZE);
+        kunmap_local(page_addr);
+        cond_resched();
+    }
+    
+    iounmap(vaddr);
+    
+    return 0;
+}
+
+/**
+ * fdca_vram_clear() - 把 VRAM 对象内容清零
+ * @fdev: FDCA 设备
+ * @obj: VRAM 对象
+ * 
+ * 回收对象交给其它进程前调用，避免泄漏上一个使用者的数据
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+int fdca_vram_clear(struct fdca_device *fdev, struct fdca_vram_object *obj)
+{
+    void __iomem *vaddr;
+    size_t off, len;
+    
+    vaddr = ioremap_wc(fdev->vram_base + obj->offset, obj->size);
+    if (!vaddr) {
+        fdca_err(fdev, "VRAM 清零映射失败: 偏移=0x%llx\n", obj->offset);
+        return -ENOMEM;
+    }
+    
+    /* 按 2MB 分段清零，大对象不长时间占用 CPU */
+    for (off = 0; off < obj->size; off += len) {
+        len = min_t(size_t, obj->size - off, FDCA_VRAM_LARGE_BLOCK_SIZE);
+        memset_io(vaddr + off, 0, len);
+        cond_resched();
+    }
+    
+    iounmap(vaddr);
+    
+    return 0;
+}
+
 /**
  * fdca_vram_map() - 映射 VRAM 到 CPU 地址空间
  * @fdev: FDCA 设备
@@ -418,29 +797,74 @@ void fdca_vram_unmap(struct fdca_device *fdev, struct fdca_vram_object *obj)
  * ============================================================================
  */
 
+/**
+ * fdca_vram_largest_free() - 最大空闲块大小
+ * @vram: VRAM 管理器 (调用者持有锁)
+ * 
+ * buddy 按阶维护空闲链表，从最高阶向下找到第一个非空链表即可
+ * 
+ * Return: 最大空闲块字节数
+ */
+static u64 fdca_vram_largest_free(struct fdca_vram_manager *vram)
+{
+    struct drm_buddy *mm = &vram->buddy;
+    int order;
+    
+    lockdep_assert_held(&vram->lock);
+    
+    for (order = mm->max_order; order >= 0; order--) {
+        if (!list_empty(&mm->free_list[order]))
+            return mm->chunk_size << order;
+    }
+    
+    return 0;
+}
+
+/**
+ * fdca_vram_free_histogram() - 统计每阶空闲块数量
+ * @vram: VRAM 管理器 (调用者持有锁)
+ * @hist: 输出数组，第 i 项为 chunk_size << i 的空闲块数
+ * @num: 数组项数
+ * 
+ * Return: 有效阶数
+ */
+static u32 fdca_vram_free_histogram(struct fdca_vram_manager *vram, u32 *hist, u32 num)
+{
+    struct drm_buddy *mm = &vram->buddy;
+    struct drm_buddy_block *block;
+    u32 order, num_orders = min_t(u32, mm->max_order + 1, num);
+    
+    lockdep_assert_held(&vram->lock);
+    
+    memset(hist, 0, num * sizeof(*hist));
+    for (order = 0; order < num_orders; order++) {
+        list_for_each_entry(block, &mm->free_list[order], link)
+            hist[order]++;
+    }
+    
+    return num_orders;
+}
+
 /**
  * fdca_vram_get_fragmentation() - 计算碎片率
  * @fdev: FDCA 设备
  * 
+ * 最大空闲块占可用总量的比例越低，碎片越严重。调用者持有 VRAM 锁
+ * 
  * Return: 碎片率百分比
  */
 static u32 fdca_vram_get_fragmentation(struct fdca_device *fdev)
 {
     struct fdca_vram_manager *vram = &fdev->mem_mgr->vram;
     u64 largest_free;
-    u32 fragmentation;
     
     if (vram->available == 0) {
         return 0;
     }
     
-    /* 获取最大可用块 */
-    largest_free = drm_buddy_avail_size(&vram->buddy);
+    largest_free = fdca_vram_largest_free(vram);
     
-    /* 计算碎片率 */
-    fragmentation = 100 - (largest_free * 100 / vram->available);
-    
-    return fragmentation;
+    return 100 - div64_u64(largest_free * 100, vram->available);
 }
 
 /**
@@ -452,7 +876,10 @@ static void fdca_vram_check_fragmentation(struct fdca_device *fdev)
     struct fdca_vram_manager *vram = &fdev->mem_mgr->vram;
     u32 fragmentation;
     
+    mutex_lock(&vram->lock);
+    
     if (vram->defrag_in_progress) {
+        mutex_unlock(&vram->lock);
         return;
     }
     
@@ -461,41 +888,237 @@ static void fdca_vram_check_fragmentation(struct fdca_device *fdev)
     if (fragmentation > FDCA_VRAM_FRAG_THRESHOLD) {
         fdca_info(fdev, "检测到高碎片率: %u%%，启动碎片整理\n", fragmentation);
         vram->defrag_in_progress = true;
+        vram->defrag_cursor = vram->size;
         schedule_work(&vram->defrag_work);
     }
+    
+    mutex_unlock(&vram->lock);
 }
 
-/* 前向声明 */
-static void fdca_vram_defrag_work(struct work_struct *work);
-static void fdca_vram_check_fragmentation(struct fdca_device *fdev);
+/*
+ * 碎片整理
+ *
+ * 每轮从高地址向低地址扫描已注册所有者的对象，把对象搬到其当前位置以下的
+ * 空闲块中，高端空间逐渐腾空并由 buddy 合并成大块。
+ * 1. 选对象和预留目标块在 VRAM 锁下完成，随即放锁
+ * 2. 所有者在 begin_move 中锁定对象、撤销 CPU 映射；固定中的对象拒绝搬移
+ * 3. 经 BAR 拷贝数据，期间不持有 VRAM 锁
+ * 4. 重新取 VRAM 锁交换块和偏移，释放旧块
+ * 每个时间片最多运行 FDCA_VRAM_DEFRAG_SLICE_NS，未完成时工作重新排队，
+ * 分配者最多只被一次选块或换块阻塞
+ */
 
 /**
- * fdca_vram_defrag_work() - 碎片整理工作函数
- * @work: 工作结构
+ * struct fdca_vram_move - 一次搬移
  */
-static void fdca_vram_defrag_work(struct work_struct *work)
+struct fdca_vram_move {
+    struct fdca_vram_object *obj;
+    const struct fdca_vram_owner_ops *ops;
+    void *priv;
+    struct drm_buddy_block *block;      /* 预留的目标块 */
+    size_t size;
+};
+
+/**
+ * fdca_vram_defrag_pick() - 选择下一个待搬移对象并预留目标块
+ * @vram: VRAM 管理器 (调用者不持有锁)
+ * @mv: 输出：搬移描述，成功时已取得所有者引用
+ * 
+ * Return: true 表示找到，false 表示本轮没有更多候选
+ */
+static bool fdca_vram_defrag_pick(struct fdca_vram_manager *vram,
+                                  struct fdca_vram_move *mv)
 {
-    struct fdca_vram_manager *vram = container_of(work, struct fdca_vram_manager, defrag_work);
-    struct fdca_device *fdev = container_of(vram, struct fdca_memory_manager, vram)->fdev;
-    u32 frag_before, frag_after;
+    struct fdca_vram_object *obj, *best;
+    LIST_HEAD(blocks);
+    u64 offset;
+    int ret;
     
-    fdca_info(fdev, "开始 VRAM 碎片整理\n");
+    for (;;) {
+        best = NULL;
+        
+        spin_lock(&vram->objects_lock);
+        list_for_each_entry(obj, &vram->objects, list) {
+            /* 内核长期映射的对象地址被直接引用，不能搬移 */
+            if (!obj->owner_ops || obj->mapped ||
+                obj->size > FDCA_VRAM_DEFRAG_MAX_MOVE)
+                continue;
+            if (obj->offset >= vram->defrag_cursor)
+                continue;
+            if (!best || obj->offset > best->offset)
+                best = obj;
+        }
+        
+        if (!best) {
+            spin_unlock(&vram->objects_lock);
+            return false;
+        }
+        
+        /* 每个对象每轮只尝试一次 */
+        vram->defrag_cursor = best->offset;
+        
+        if (!best->owner_ops->get(best->owner_priv)) {
+            spin_unlock(&vram->objects_lock);
+            continue;
+        }
+        
+        mv->obj = best;
+        mv->ops = best->owner_ops;
+        mv->priv = best->owner_priv;
+        mv->size = best->size;
+        offset = best->offset;
+        spin_unlock(&vram->objects_lock);
+        
+        /* 块大小即对齐，目标块与原块对齐方式相同 */
+        mutex_lock(&vram->lock);
+        ret = drm_buddy_alloc_blocks(&vram->buddy, 0, offset, mv->size, mv->size,
+                                     &blocks, DRM_BUDDY_RANGE_ALLOCATION);
+        mutex_unlock(&vram->lock);
+        
+        if (ret) {
+            mv->ops->put(mv->priv);
+            continue;
+        }
+        
+        mv->block = list_first_entry(&blocks, struct drm_buddy_block, link);
+        list_del(&mv->block->link);
+        
+        return true;
+    }
+}
+
+/**
+ * fdca_vram_copy_range() - VRAM 内部拷贝
+ * @fdev: FDCA 设备
+ * @dst: 目标偏移
+ * @src: 源偏移
+ * @size: 字节数 (页对齐)
+ * 
+ * 无拷贝引擎时经 BAR 以页为单位中转
+ * 
+ * Return: 0 表示成功，负数表示错误
+ */
+static int fdca_vram_copy_range(struct fdca_device *fdev, u64 dst, u64 src, size_t size)
+{
+    void __iomem *vdst, *vsrc;
+    void *bounce;
+    size_t off;
+    int ret = -ENOMEM;
     
-    frag_before = fdca_vram_get_fragmentation(fdev);
+    bounce = (void *)__get_free_page(GFP_KERNEL);
+    if (!bounce)
+        return -ENOMEM;
     
-    mutex_lock(&vram->lock);
+    vsrc = ioremap_wc(fdev->vram_base + src, size);
+    if (!vsrc)
+        goto out_free;
+    
+    vdst = ioremap_wc(fdev->vram_base + dst, size);
+    if (!vdst)
+        goto out_unmap_src;
+    
+    for (off = 0; off < size; off += PAGE_SIZE) {
+        memcpy_fromio(bounce, vsrc + off, PAGE_SIZE);
+        memcpy_toio(vdst + off, bounce, PAGE_SIZE);
+        cond_resched();
+    }
+    ret = 0;
+    
+    iounmap(vdst);
+out_unmap_src:
+    iounmap(vsrc);
+out_free:
+    free_page((unsigned long)bounce);
+    return ret;
+}
+
+/**
+ * fdca_vram_defrag_move() - 执行一次搬移
+ * @fdev: FDCA 设备
+ * @mv: fdca_vram_defrag_pick() 的结果
+ */
+static void fdca_vram_defrag_move(struct fdca_device *fdev, struct fdca_vram_move *mv)
+{
+    struct fdca_vram_manager *vram = &fdev->mem_mgr->vram;
+    struct fdca_vram_object *obj = mv->obj;
+    u64 new_offset = drm_buddy_block_offset(mv->block);
+    u64 old_offset;
+    int ret;
     
-    /* 执行碎片整理 - 这里可以实现具体的整理算法 */
-    /* 当前版本只是一个占位符，未来可以实现更复杂的算法 */
-    msleep(100);  /* 模拟整理时间 */
+    /* 所有者拒绝时对象可能已被释放，不能再访问 */
+    ret = mv->ops->begin_move(mv->priv, obj);
+    if (ret)
+        goto err_free_block;
     
+    old_offset = obj->offset;
+    ret = fdca_vram_copy_range(fdev, new_offset, old_offset, mv->size);
+    if (ret) {
+        mv->ops->end_move(mv->priv, obj);
+        goto err_free_block;
+    }
+    
+    mutex_lock(&vram->lock);
+    drm_buddy_free_block(&vram->buddy, obj->block);
+    spin_lock(&vram->objects_lock);
+    obj->block = mv->block;
+    obj->offset = new_offset;
+    spin_unlock(&vram->objects_lock);
     mutex_unlock(&vram->lock);
     
-    frag_after = fdca_vram_get_fragmentation(fdev);
+    mv->ops->end_move(mv->priv, obj);
     
-    fdca_info(fdev, "VRAM 碎片整理完成: %u%% -> %u%%\n", frag_before, frag_after);
+    atomic64_inc(&vram->defrag_moves);
+    atomic64_add(mv->size, &vram->defrag_bytes);
     
+    fdca_dbg(fdev, "VRAM 搬移: 0x%llx -> 0x%llx, 大小=%zu\n",
+             old_offset, new_offset, mv->size);
+    return;
+    
+err_free_block:
+    mutex_lock(&vram->lock);
+    drm_buddy_free_block(&vram->buddy, mv->block);
+    mutex_unlock(&vram->lock);
+}
+
+/**
+ * fdca_vram_defrag_work() - 碎片整理工作函数
+ * @work: 工作结构
+ * 
+ * 运行一个时间片，本轮未完成时重新排队
+ */
+static void fdca_vram_defrag_work(struct work_struct *work)
+{
+    struct fdca_vram_manager *vram = container_of(work, struct fdca_vram_manager, defrag_work);
+    struct fdca_device *fdev = container_of(vram, struct fdca_memory_manager, vram)->fdev;
+    u64 deadline = ktime_get_ns() + FDCA_VRAM_DEFRAG_SLICE_NS;
+    struct fdca_vram_move mv;
+    bool found;
+    
+    /* 本轮第一个时间片: 缓存的小块先归还，让 buddy 合并 */
+    if (vram->defrag_cursor == vram->size)
+        fdca_vram_mag_drain(vram);
+    
+    do {
+        found = fdca_vram_defrag_pick(vram, &mv);
+        
+        if (!found)
+            break;
+        
+        fdca_vram_defrag_move(fdev, &mv);
+        mv.ops->put(mv.priv);
+    } while (ktime_get_ns() < deadline);
+    
+    if (found) {
+        schedule_work(&vram->defrag_work);
+        return;
+    }
+    
+    mutex_lock(&vram->lock);
+    fdca_info(fdev, "VRAM 碎片整理完成: 碎片率 %u%%, 累计搬移 %lld 个对象\n",
+              fdca_vram_get_fragmentation(fdev),
+              atomic64_read(&vram->defrag_moves));
     vram->defrag_in_progress = false;
+    mutex_unlock(&vram->lock);
 }
 
 /*
@@ -515,14 +1138,20 @@ void fdca_vram_get_stats(struct fdca_device *fdev, struct fdca_vram_stats *stats
     
     mutex_lock(&vram->lock);
     
+    /* 每 CPU 缓存中的块对用户而言是空闲的 */
     stats->total_size = vram->size;
-    stats->used_size = vram->used;
-    stats->available_size = vram->available;
+    stats->used_size = vram->used - atomic64_read(&vram->mag_cached);
+    stats->available_size = vram->available + atomic64_read(&vram->mag_cached);
     stats->fragmentation = fdca_vram_get_fragmentation(fdev);
     stats->alloc_count = atomic64_read(&vram->alloc_count);
     stats->free_count = atomic64_read(&vram->free_count);
     stats->large_page_count = atomic64_read(&vram->large_page_count);
     
+    stats->largest_free = fdca_vram_largest_free(vram);
+    stats->min_block_size = vram->buddy.chunk_size;
+    stats->num_orders = fdca_vram_free_histogram(vram, stats->free_blocks,
+                                                 ARRAY_SIZE(stats->free_blocks));
+    
     mutex_unlock(&vram->lock);
 }
 
@@ -558,6 +1187,11 @@ EXPORT_SYMBOL_GPL(fdca_vram_manager_init);
 EXPORT_SYMBOL_GPL(fdca_vram_manager_fini);
 EXPORT_SYMBOL_GPL(fdca_vram_alloc);
 EXPORT_SYMBOL_GPL(fdca_vram_free);
+EXPORT_SYMBOL_GPL(fdca_vram_object_offset);
+EXPORT_SYMBOL_GPL(fdca_vram_object_is_large);
+EXPORT_SYMBOL_GPL(fdca_vram_set_owner);
+EXPORT_SYMBOL_GPL(fdca_vram_copy_pages);
+EXPORT_SYMBOL_GPL(fdca_vram_clear);
 EXPORT_SYMBOL_GPL(fdca_vram_map);
 EXPORT_SYMBOL_GPL(fdca_vram_unmap);
 EXPORT_SYMBOL_GPL(fdca_vram_get_stats);
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * 内核命令队列管理器扩展性基准
+ *
+ * 队列管理器只供驱动内部提交命令，没有对应的 ioctl，因此经 debugfs
+ * cmdq_bench 在驱动内启动 1 到 64 个并发提交者，每个提交者保持 32 条
+ * 在途空命令。每一档报告每秒命令数和消费者每批合并的命令数。
+ * 需要 root (debugfs) 并以 sim_queue=1 加载驱动
+ */
+
+#include <getopt.h>
+
+#include "fdca_test.h"
+
+#define BENCH_MAX_THREADS       64
+
+struct cmdq_counts {
+    unsigned long long completed;
+    unsigned long long batches;
+};
+
+/* 读取 debugfs cmdq 中指定计算单元的完成数和批次数 */
+static int read_cmdq_counts(const struct fdca_dev *dev, const char *unit,
+                            struct cmdq_counts *counts)
+{
+    unsigned long long submitted, failed;
+    char buf[4096], name[8], *line, *save;
+    unsigned int id;
+
+    if (fdca_debugfs_read(dev, "cmdq", buf, sizeof(buf)) <= 0)
+        return -ENOENT;
+
+    for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        if (sscanf(line, "%7s %u %llu %llu %llu %llu", name, &id, &submitted,
+                   &counts->completed, &failed, &counts->batches) == 6 &&
+            !strcasecmp(name, unit))
+            return 0;
+    }
+
+    return -ENOENT;
+}
+
+int main(int argc, char **argv)
+{
+    const char *unit = "cau";
+    unsigned int cmds = 4096, threads, max_threads = BENCH_MAX_THREADS;
+    struct cmdq_counts before, after;
+    struct fdca_dev dev;
+    uint64_t start, elapsed;
+    char req[64];
+    int opt, ret, steps = 0;
+
+    while ((opt = getopt(argc, argv, "u:n:t:h")) != -1) {
+        switch (opt) {
+        case 'u':
+            unit = optarg;
+            break;
+        case 'n':
+            cmds = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            max_threads = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-u cau|cfu] [-n 每个提交者的命令数] [-t 最大提交者数]\n",
+                    argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (!cmds)
+        cmds = 4096;
+    if (!max_threads || max_threads > BENCH_MAX_THREADS)
+        max_threads = BENCH_MAX_THREADS;
+
+    fdca_test_init(&dev, FDCA_TEST_NEED_SIM);
+    if (read_cmdq_counts(&dev, unit, &before))
+        fdca_test_skip_all("debugfs cmdq 不可用 (需要 root)，或该单元没有队列管理器");
+
+    for (threads = 1; threads <= max_threads; threads <<= 1)
+        steps++;
+    fdca_test_plan(steps);
+
+    fdca_test_info("%s: 每个提交者 %u 条命令, 在途 32 条\n", unit, cmds);
+    fdca_test_info("%8s %14s %12s %12s\n", "threads", "cmds/s", "batches", "cmds/batch");
+
+    for (threads = 1; threads <= max_threads; threads <<= 1) {
+        read_cmdq_counts(&dev, unit, &before);
+
+        snprintf(req, sizeof(req), "%s %u %u", unit, threads, cmds);
+        start = fdca_now_ns();
+        ret = fdca_debugfs_write(&dev, "cmdq_bench", req);
+        elapsed = fdca_now_ns() - start;
+
+        if (!ret && !read_cmdq_counts(&dev, unit, &after)) {
+            unsigned long long batches = after.batches - before.batches;
+
+            fdca_test_info("%8u %14.0f %12llu %12.1f\n", threads,
+                           (double)threads * cmds * 1e9 / elapsed, batches,
+                           batches ? (double)(after.completed - before.completed) / batches : 0.0);
+        }
+
+        fdca_test_result(!ret, "%u submitters (%d)\n", threads, ret);
+    }
+
+    fdca_debugfs_dump(&dev, "cmdq");
+    close(dev.fd);
+
+    return fdca_test_exit();
+}
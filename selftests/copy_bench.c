@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * 异步拷贝引擎吞吐基准
+ *
+ * 在 GTT 与 VRAM 对象之间经 DRM_IOCTL_FDCA_COPY 拷贝，大小从 4KB 到
+ * 256MB (可调到 1GB)。每一档连续提交多次拷贝，只在最后一次带输出
+ * syncobj，等待它触发后计算 GB/s:
+ * 1. 上传: GTT -> VRAM
+ * 2. 下载: VRAM -> GTT
+ * 3. 经 VRAM 往返一次后校验数据
+ *
+ * 没有 DMA 引擎时描述符由 CPU 执行 (VRAM 一侧经 BAR)，不要求 sim_queue
+ */
+
+#include <getopt.h>
+
+#include "fdca_test.h"
+
+#define COPY_BENCH_BYTES        (1ULL << 30)    /* 每档拷贝的总字节数 */
+#define COPY_BENCH_MAX_COUNT    1000
+#define COPY_WAIT_NS            (60ULL * 1000 * 1000 * 1000)    /* 经 BAR 的大拷贝可能很慢 */
+#define COPY_VERIFY_SIZE        ((2ULL << 20) + 4096)   /* 跨越多个描述符的非 2 的幂大小 */
+
+struct copy_counts {
+    long long bytes;
+    long long busy_ns;
+};
+
+static void read_copy_counts(const struct fdca_dev *dev, struct copy_counts *c)
+{
+    memset(c, 0, sizeof(*c));
+    fdca_debugfs_value(dev, "copy", "bytes:", &c->bytes);
+    fdca_debugfs_value(dev, "copy", "busy_ns:", &c->busy_ns);
+}
+
+/**
+ * copy_submit() - 提交一段拷贝
+ * @syncobj: 非 0 时作为输出 syncobj，拷贝完成时触发
+ */
+static int copy_submit(int fd, uint32_t src, uint32_t dst, uint64_t size, uint32_t syncobj)
+{
+    struct drm_fdca_copy_region region = {
+        .src_handle = src,
+        .dst_handle = dst,
+        .size = size,
+    };
+    struct drm_fdca_syncobj out = { .handle = syncobj };
+    struct drm_fdca_copy args = {
+        .regions_ptr = (uintptr_t)&region,
+        .num_regions = 1,
+        .num_out_syncs = syncobj ? 1 : 0,
+        .out_syncs_ptr = (uintptr_t)&out,
+    };
+
+    return fdca_ioctl(fd, DRM_IOCTL_FDCA_COPY, &args);
+}
+
+/* 同一文件上的拷贝按提交顺序执行，等待最后一次即等待全部 */
+static int copy_round(int fd, uint32_t src, uint32_t dst, uint64_t size,
+                      unsigned int count, uint32_t syncobj)
+{
+    unsigned int i;
+    int ret = 0;
+
+    for (i = 0; i < count && !ret; i++)
+        ret = copy_submit(fd, src, dst, size, i == count - 1 ? syncobj : 0);
+    if (!ret)
+        ret = fdca_syncobj_wait(fd, syncobj, COPY_WAIT_NS);
+
+    return ret;
+}
+
+/* 按 4KB 到 @max_size 逐档拷贝 @src_flags 对象到 @dst_flags 对象 */
+static int bench_direction(const struct fdca_dev *dev, const char *name, uint32_t src_flags,
+                           uint32_t dst_flags, uint64_t max_size, uint32_t syncobj,
+                           bool have_debugfs)
+{
+    struct copy_counts before, after;
+    uint32_t src, dst;
+    uint64_t size, start, elapsed;
+    unsigned int count;
+    char str[24];
+    int ret;
+
+    ret = fdca_gem_create(dev->fd, max_size, src_flags, &src);
+    if (ret)
+        return ret;
+    ret = fdca_gem_create(dev->fd, max_size, dst_flags, &dst);
+    if (ret) {
+        fdca_gem_close(dev->fd, src);
+        return ret;
+    }
+
+    fdca_test_info("%s\n", name);
+    fdca_test_info("%6s %8s %10s %12s\n", "size", "count", "GB/s", "engine GB/s");
+
+    for (size = 4096; size <= max_size && !ret; size <<= 1) {
+        count = COPY_BENCH_BYTES / size;
+        if (count > COPY_BENCH_MAX_COUNT)
+            count = COPY_BENCH_MAX_COUNT;
+        if (count < 2)
+            count = 2;
+
+        if (have_debugfs)
+            read_copy_counts(dev, &before);
+
+        start = fdca_now_ns();
+        ret = copy_round(dev->fd, src, dst, size, count, syncobj);
+        elapsed = fdca_now_ns() - start;
+        if (ret)
+            break;
+
+        fdca_size_str(size, str, sizeof(str));
+        if (have_debugfs) {
+            read_copy_counts(dev, &after);
+            fdca_test_info("%6s %8u %10.2f %12.2f\n", str, count,
+                           (double)size * count / elapsed * 1e9 / (1ULL << 30),
+                           after.busy_ns > before.busy_ns ?
+                           (double)(after.bytes - before.bytes) /
+                           (after.busy_ns - before.busy_ns) * 1e9 / (1ULL << 30) : 0.0);
+        } else {
+            fdca_test_info("%6s %8u %10.2f\n", str, count,
+                           (double)size * count / elapsed * 1e9 / (1ULL << 30));
+        }
+    }
+
+    fdca_gem_close(dev->fd, dst);
+    fdca_gem_close(dev->fd, src);
+    return ret;
+}
+
+/* GTT -> VRAM -> GTT 往返后比较数据 */
+static int verify_roundtrip(const struct fdca_dev *dev, uint32_t syncobj)
+{
+    uint32_t src, vram, dst;
+    uint32_t *in = MAP_FAILED, *out = MAP_FAILED;
+    uint64_t i, n = COPY_VERIFY_SIZE / sizeof(*in);
+    int ret;
+
+    ret = fdca_gem_create(dev->fd, COPY_VERIFY_SIZE, FDCA_GEM_CREATE_GTT, &src);
+    if (ret)
+        return ret;
+    ret = fdca_gem_create(dev->fd, COPY_VERIFY_SIZE, 0, &vram);
+    if (ret)
+        goto out_src;
+    ret = fdca_gem_create(dev->fd, COPY_VERIFY_SIZE, FDCA_GEM_CREATE_GTT, &dst);
+    if (ret)
+        goto out_vram;
+
+    in = fdca_gem_mmap(dev->fd, src, COPY_VERIFY_SIZE, PROT_READ | PROT_WRITE);
+    out = fdca_gem_mmap(dev->fd, dst, COPY_VERIFY_SIZE, PROT_READ | PROT_WRITE);
+    if (in == MAP_FAILED || out == MAP_FAILED) {
+        ret = -errno;
+        goto out_unmap;
+    }
+
+    for (i = 0; i < n; i++) {
+        in[i] = (uint32_t)(i * 2654435761u);
+        out[i] = 0;
+    }
+
+    ret = copy_round(dev->fd, src, vram, COPY_VERIFY_SIZE, 1, syncobj);
+    if (!ret)
+        ret = copy_round(dev->fd, vram, dst, COPY_VERIFY_SIZE, 1, syncobj);
+
+    for (i = 0; i < n && !ret; i++) {
+        if (out[i] != in[i]) {
+            fdca_test_info("偏移 %llu 处数据不符: 0x%08x != 0x%08x\n",
+                           (unsigned long long)(i * sizeof(*in)), out[i], in[i]);
+            ret = -EIO;
+        }
+    }
+
+out_unmap:
+    if (in != MAP_FAILED)
+        munmap(in, COPY_VERIFY_SIZE);
+    if (out != MAP_FAILED)
+        munmap(out, COPY_VERIFY_SIZE);
+    fdca_gem_close(dev->fd, dst);
+out_vram:
+    fdca_gem_close(dev->fd, vram);
+out_src:
+    fdca_gem_close(dev->fd, src);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t max_size = 256ULL << 20;
+    struct copy_counts probe;
+    struct fdca_dev dev;
+    bool have_debugfs;
+    uint32_t syncobj;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "m:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            max_size = strtoull(optarg, NULL, 0) << 20;
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-m 最大拷贝大小 (MB，不超过 1024)]\n", argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (!max_size || max_size > (1ULL << 30))
+        max_size = 256ULL << 20;
+
+    fdca_test_init(&dev, 0);
+    fdca_test_plan(3);
+
+    ret = fdca_syncobj_create(dev.fd, &syncobj);
+    if (ret) {
+        fdca_test_info("syncobj 创建失败: %s\n", strerror(-ret));
+        return FDCA_TEST_FAIL;
+    }
+
+    have_debugfs = !fdca_debugfs_value(&dev, "copy", "bytes:", &probe.bytes);
+
+    ret = bench_direction(&dev, "上传 GTT -> VRAM", FDCA_GEM_CREATE_GTT, 0, max_size,
+                          syncobj, have_debugfs);
+    fdca_test_result(!ret, "upload (%d)\n", ret);
+
+    ret = bench_direction(&dev, "下载 VRAM -> GTT", 0, FDCA_GEM_CREATE_GTT, max_size,
+                          syncobj, have_debugfs);
+    fdca_test_result(!ret, "download (%d)\n", ret);
+
+    ret = verify_roundtrip(&dev, syncobj);
+    fdca_test_result(!ret, "round trip data (%d)\n", ret);
+
+    if (have_debugfs)
+        fdca_debugfs_dump(&dev, "copy");
+
+    fdca_syncobj_destroy(dev.fd, syncobj);
+    close(dev.fd);
+
+    return fdca_test_exit();
+}
@@ -0,0 +1,515 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * FDCA 自测公共部分
+ *
+ * 查找 fdca 计算加速设备节点及其 debugfs 目录，封装常用 ioctl 和计时。
+ * 结果按 TAP 格式输出，退出码与 kselftest 一致 (0 通过，1 失败，4 跳过)
+ */
+
+#ifndef __FDCA_TEST_H__
+#define __FDCA_TEST_H__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#ifndef BIT
+#define BIT(n)                  (1UL << (n))
+#endif
+
+#include "fdca_uapi.h"
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a)           (sizeof(a) / sizeof((a)[0]))
+#endif
+
+#define FDCA_TEST_PASS          0
+#define FDCA_TEST_FAIL          1
+#define FDCA_TEST_SKIP          4
+
+#define FDCA_TEST_MAX_MINORS    64
+#define FDCA_TEST_MAX_CMDS      64      /* fdca_submit_nop() 单批命令数上限 */
+#define FDCA_TEST_TIMEOUT_NS    (10ULL * 1000 * 1000 * 1000)
+
+/* fdca_test_init() 标志 */
+#define FDCA_TEST_NEED_SIM      BIT(0)   /* 要求 sim_queue=1，队列由驱动内的模拟消费者执行 */
+
+struct fdca_dev {
+    int fd;
+    int minor;
+    char debugfs[256];
+};
+
+static unsigned int fdca_test_count;
+static unsigned int fdca_test_failed;
+
+static inline void fdca_test_info(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    printf("# ");
+    vprintf(fmt, ap);
+    va_end(ap);
+    fflush(stdout);
+}
+
+static inline void fdca_test_plan(unsigned int count)
+{
+    printf("TAP version 13\n1..%u\n", count);
+}
+
+static inline void fdca_test_result(bool pass, const char *fmt, ...)
+{
+    va_list ap;
+
+    fdca_test_count++;
+    if (!pass)
+        fdca_test_failed++;
+
+    va_start(ap, fmt);
+    printf("%sok %u ", pass ? "" : "not ", fdca_test_count);
+    vprintf(fmt, ap);
+    va_end(ap);
+    fflush(stdout);
+}
+
+static inline void fdca_test_result_skip(const char *fmt, ...)
+{
+    va_list ap;
+
+    fdca_test_count++;
+    va_start(ap, fmt);
+    printf("ok %u # SKIP ", fdca_test_count);
+    vprintf(fmt, ap);
+    va_end(ap);
+    fflush(stdout);
+}
+
+static inline void __attribute__((noreturn)) fdca_test_skip_all(const char *reason)
+{
+    printf("TAP version 13\n1..0 # SKIP %s\n", reason);
+    exit(FDCA_TEST_SKIP);
+}
+
+static inline int fdca_test_exit(void)
+{
+    printf("# 通过 %u, 失败 %u\n", fdca_test_count - fdca_test_failed, fdca_test_failed);
+    return fdca_test_failed ? FDCA_TEST_FAIL : FDCA_TEST_PASS;
+}
+
+static inline uint64_t fdca_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* 把 4KB 到 1GB 的大小格式化为 "4K"、"2M"、"1G" */
+static inline const char *fdca_size_str(uint64_t size, char *buf, size_t len)
+{
+    if (size >= (1ULL << 30) && !(size & ((1ULL << 30) - 1)))
+        snprintf(buf, len, "%lluG", (unsigned long long)(size >> 30));
+    else if (size >= (1ULL << 20) && !(size & ((1ULL << 20) - 1)))
+        snprintf(buf, len, "%lluM", (unsigned long long)(size >> 20));
+    else
+        snprintf(buf, len, "%lluK", (unsigned long long)(size >> 10));
+    return buf;
+}
+
+/* === 延迟统计 === */
+
+#define FDCA_LAT_BUCKETS        40      /* 按纳秒取 log2 分档，第 i 档为 [2^(i-1), 2^i) */
+
+struct fdca_lat {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t hist[FDCA_LAT_BUCKETS];
+};
+
+static inline void fdca_lat_add(struct fdca_lat *lat, uint64_t ns)
+{
+    unsigned int i = ns ? 64 - __builtin_clzll(ns) : 0;
+
+    if (i >= FDCA_LAT_BUCKETS)
+        i = FDCA_LAT_BUCKETS - 1;
+
+    lat->count++;
+    lat->sum_ns += ns;
+    if (ns > lat->max_ns)
+        lat->max_ns = ns;
+    lat->hist[i]++;
+}
+
+static inline void fdca_lat_merge(struct fdca_lat *dst, const struct fdca_lat *src)
+{
+    unsigned int i;
+
+    dst->count += src->count;
+    dst->sum_ns += src->sum_ns;
+    if (src->max_ns > dst->max_ns)
+        dst->max_ns = src->max_ns;
+    for (i = 0; i < FDCA_LAT_BUCKETS; i++)
+        dst->hist[i] += src->hist[i];
+}
+
+/* 百分位所在分档的上界 (纳秒) */
+static inline uint64_t fdca_lat_percentile(const struct fdca_lat *lat, unsigned int pct)
+{
+    uint64_t target = (lat->count * pct + 99) / 100, seen = 0;
+    unsigned int i;
+
+    for (i = 0; i < FDCA_LAT_BUCKETS; i++) {
+        seen += lat->hist[i];
+        if (seen >= target)
+            return 1ULL << i;
+    }
+    return 1ULL << (FDCA_LAT_BUCKETS - 1);
+}
+
+static inline void fdca_lat_report(const char *name, const struct fdca_lat *lat)
+{
+    if (!lat->count)
+        return;
+
+    fdca_test_info("%s: %llu 次, 平均 %.2f us, p50 <%.2f us, p99 <%.2f us, 最大 %.2f us\n",
+                   name, (unsigned long long)lat->count,
+                   lat->sum_ns / 1e3 / lat->count,
+                   fdca_lat_percentile(lat, 50) / 1e3,
+                   fdca_lat_percentile(lat, 99) / 1e3, lat->max_ns / 1e3);
+}
+
+/* 与 libdrm 的 drmIoctl() 一样在 EINTR/EAGAIN 时重试，返回 0 或 -errno */
+static inline int fdca_ioctl(int fd, unsigned long request, void *arg)
+{
+    int ret;
+
+    do {
+        ret = ioctl(fd, request, arg);
+    } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+
+    return ret ? -errno : 0;
+}
+
+/* === 设备与 debugfs === */
+
+static inline bool fdca_sim_queue(void)
+{
+    char val = 'N';
+    FILE *f;
+
+    f = fopen("/sys/module/fdca/parameters/sim_queue", "r");
+    if (!f)
+        return false;
+    if (fread(&val, 1, 1, f) != 1)
+        val = 'N';
+    fclose(f);
+
+    return val == 'Y';
+}
+
+static inline bool fdca_is_fdca(int fd)
+{
+    char name[16] = "";
+    struct drm_version version = {
+        .name_len = sizeof(name) - 1,
+        .name = name,
+    };
+
+    if (fdca_ioctl(fd, DRM_IOCTL_VERSION, &version))
+        return false;
+
+    return !strcmp(name, "fdca");
+}
+
+/* debugfs 目录以 PCI 地址命名 (计算加速设备没有 primary 节点) */
+static inline void fdca_dev_debugfs(struct fdca_dev *dev)
+{
+    char link[PATH_MAX], target[PATH_MAX];
+    const char *name;
+    ssize_t len;
+
+    dev->debugfs[0] = '\0';
+    snprintf(link, sizeof(link), "/sys/class/accel/accel%d/device", dev->minor);
+    len = readlink(link, target, sizeof(target) - 1);
+    if (len <= 0)
+        return;
+    target[len] = '\0';
+
+    name = strrchr(target, '/');
+    name = name ? name + 1 : target;
+    snprintf(dev->debugfs, sizeof(dev->debugfs), "/sys/kernel/debug/fdca/%.64s", name);
+    if (access(dev->debugfs, R_OK))
+        dev->debugfs[0] = '\0';
+}
+
+/**
+ * fdca_dev_open() - 打开第一个 fdca 设备节点
+ *
+ * 每次打开得到独立的上下文
+ *
+ * Return: 0 表示成功，-ENODEV 表示没有 fdca 设备
+ */
+static inline int fdca_dev_open(struct fdca_dev *dev)
+{
+    char path[32];
+    int minor, fd;
+
+    for (minor = 0; minor < FDCA_TEST_MAX_MINORS; minor++) {
+        snprintf(path, sizeof(path), "/dev/accel/accel%d", minor);
+        fd = open(path, O_RDWR | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        if (fdca_is_fdca(fd)) {
+            dev->fd = fd;
+            dev->minor = minor;
+            fdca_dev_debugfs(dev);
+            return 0;
+        }
+        close(fd);
+    }
+
+    return -ENODEV;
+}
+
+/* 在同一设备上再打开一个上下文 */
+static inline int fdca_dev_reopen(const struct fdca_dev *dev)
+{
+    char path[32];
+
+    snprintf(path, sizeof(path), "/dev/accel/accel%d", dev->minor);
+    return open(path, O_RDWR | O_CLOEXEC);
+}
+
+/* 打开设备，条件不满足时整体跳过 */
+static inline void fdca_test_init(struct fdca_dev *dev, unsigned int flags)
+{
+    if (fdca_dev_open(dev))
+        fdca_test_skip_all("没有 fdca 设备");
+
+    if ((flags & FDCA_TEST_NEED_SIM) && !fdca_sim_queue())
+        fdca_test_skip_all("需要以 sim_queue=1 加载 fdca");
+}
+
+/**
+ * fdca_debugfs_read() - 读取设备 debugfs 文件
+ *
+ * Return: 读取的字节数，负数表示错误 (未挂载 debugfs 时为 -ENOENT)
+ */
+static inline ssize_t fdca_debugfs_read(const struct fdca_dev *dev, const char *name,
+                                        char *buf, size_t size)
+{
+    char path[PATH_MAX];
+    ssize_t len, total = 0;
+    int fd;
+
+    if (!dev->debugfs[0])
+        return -ENOENT;
+
+    snprintf(path, sizeof(path), "%s/%s", dev->debugfs, name);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+
+    while ((size_t)total < size - 1) {
+        len = read(fd, buf + total, size - 1 - total);
+        if (len <= 0)
+            break;
+        total += len;
+    }
+    buf[total] = '\0';
+    close(fd);
+
+    return total;
+}
+
+/* 写入 debugfs 文件，写操作同步完成 */
+static inline int fdca_debugfs_write(const struct fdca_dev *dev, const char *name,
+                                     const char *str)
+{
+    char path[PATH_MAX];
+    ssize_t len;
+    int fd, ret = 0;
+
+    if (!dev->debugfs[0])
+        return -ENOENT;
+
+    snprintf(path, sizeof(path), "%s/%s", dev->debugfs, name);
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+
+    len = write(fd, str, strlen(str));
+    if (len < 0)
+        ret = -errno;
+    close(fd);
+
+    return ret;
+}
+
+/* 以 TAP 注释形式输出整个 debugfs 文件 */
+static inline void fdca_debugfs_dump(const struct fdca_dev *dev, const char *name)
+{
+    char buf[16384], *line, *save;
+
+    if (fdca_debugfs_read(dev, name, buf, sizeof(buf)) <= 0)
+        return;
+
+    fdca_test_info("--- %s ---\n", name);
+    for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+        fdca_test_info("%s\n", line);
+}
+
+/**
+ * fdca_debugfs_value() - 读取 debugfs 文件中紧跟 @key 的数值
+ *
+ * Return: 0 表示成功，-ENOENT 表示文件或键不存在
+ */
+static inline int fdca_debugfs_value(const struct fdca_dev *dev, const char *name,
+                                     const char *key, long long *val)
+{
+    char buf[16384], *pos, *end;
+
+    if (fdca_debugfs_read(dev, name, buf, sizeof(buf)) <= 0)
+        return -ENOENT;
+
+    pos = strstr(buf, key);
+    if (!pos)
+        return -ENOENT;
+
+    *val = strtoll(pos + strlen(key), &end, 10);
+    return end == pos + strlen(key) ? -ENOENT : 0;
+}
+
+/* === ioctl 封装 === */
+
+static inline int fdca_gem_create(int fd, uint64_t size, uint32_t flags, uint32_t *handle)
+{
+    struct drm_fdca_gem_create args = {
+        .size = size,
+        .flags = flags,
+    };
+    int ret;
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_FDCA_GEM_CREATE, &args);
+    if (!ret)
+        *handle = args.handle;
+    return ret;
+}
+
+static inline int fdca_gem_close(int fd, uint32_t handle)
+{
+    struct drm_gem_close args = { .handle = handle };
+
+    return fdca_ioctl(fd, DRM_IOCTL_GEM_CLOSE, &args);
+}
+
+/* 映射整个对象，失败返回 MAP_FAILED */
+static inline void *fdca_gem_mmap(int fd, uint32_t handle, uint64_t size, int prot)
+{
+    struct drm_fdca_gem_mmap args = { .handle = handle };
+
+    if (fdca_ioctl(fd, DRM_IOCTL_FDCA_GEM_MMAP, &args))
+        return MAP_FAILED;
+
+    return mmap(NULL, size, prot, MAP_SHARED, fd, args.offset);
+}
+
+/**
+ * fdca_submit_nop() - 提交一批只有 16 字节负载的空命令
+ * @flags: FDCA_SUBMIT_CAU 或 FDCA_SUBMIT_CFU，可加 FDCA_SUBMIT_SYNC
+ * @fence_in: 输入 fence ID，0 表示无
+ * @fence_out: 输出：批次 fence ID
+ *
+ * 模拟后端只解析包头，不解释命令类型
+ */
+static inline int fdca_submit_nop(int fd, uint32_t flags, uint32_t num_cmds,
+                                  uint32_t fence_in, uint32_t *fence_out)
+{
+    static const uint64_t payload[2];
+    struct drm_fdca_command cmds[FDCA_TEST_MAX_CMDS];
+    struct drm_fdca_submit args = {
+        .flags = flags,
+        .num_cmds = num_cmds,
+        .cmds_ptr = (uintptr_t)cmds,
+        .fence_in = fence_in,
+    };
+    uint32_t i;
+    int ret;
+
+    if (!num_cmds || num_cmds > FDCA_TEST_MAX_CMDS)
+        return -EINVAL;
+
+    memset(cmds, 0, sizeof(cmds));
+    for (i = 0; i < num_cmds; i++) {
+        cmds[i].size = sizeof(payload);
+        cmds[i].data_ptr = (uintptr_t)payload;
+    }
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_FDCA_SUBMIT, &args);
+    if (!ret && fence_out)
+        *fence_out = args.fence_out;
+    return ret;
+}
+
+static inline int fdca_wait(int fd, uint32_t fence_id, uint64_t timeout_ns,
+                            uint32_t flags, uint32_t *result)
+{
+    struct drm_fdca_wait args = {
+        .fence_id = fence_id,
+        .timeout_ns = timeout_ns,
+        .flags = flags,
+    };
+    int ret;
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_FDCA_WAIT, &args);
+    if (result)
+        *result = args.result;
+    return ret;
+}
+
+static inline int fdca_syncobj_create(int fd, uint32_t *handle)
+{
+    struct drm_syncobj_create args = { 0 };
+    int ret;
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_SYNCOBJ_CREATE, &args);
+    if (!ret)
+        *handle = args.handle;
+    return ret;
+}
+
+static inline int fdca_syncobj_destroy(int fd, uint32_t handle)
+{
+    struct drm_syncobj_destroy args = { .handle = handle };
+
+    return fdca_ioctl(fd, DRM_IOCTL_SYNCOBJ_DESTROY, &args);
+}
+
+/* 等待二值 syncobj 被提交并触发，超时为相对时间 */
+static inline int fdca_syncobj_wait(int fd, uint32_t handle, uint64_t timeout_ns)
+{
+    struct drm_syncobj_wait args = {
+        .handles = (uintptr_t)&handle,
+        .timeout_nsec = (int64_t)(fdca_now_ns() + timeout_ns),
+        .count_handles = 1,
+        .flags = DRM_SYNCOBJ_WAIT_FLAGS_WAIT_FOR_SUBMIT,
+    };
+
+    return fdca_ioctl(fd, DRM_IOCTL_SYNCOBJ_WAIT, &args);
+}
+
+#endif /* __FDCA_TEST_H__ */
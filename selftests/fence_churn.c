@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * fence 表压力测试
+ *
+ * 多个线程在若干上下文上反复提交空批次并等待其 fence，每个线程保持
+ * 若干个在途 fence。默认 16 个线程、4 个上下文、共 10 万个 fence，
+ * 等待使用 FDCA_WAIT_NO_SPIN，全部经过中断回调唤醒。
+ *
+ * 报告提交到等待返回的延迟分布，并从 debugfs fences 取驱动测得的
+ * 触发到唤醒延迟。需要以 sim_queue=1 加载驱动
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+
+#include "fdca_test.h"
+
+#define CHURN_MAX_DEPTH         64
+
+struct churn_thread {
+    pthread_t tid;
+    int fd;
+    unsigned int count;
+    unsigned int depth;
+    uint32_t wait_flags;
+
+    unsigned int submitted;
+    unsigned int submit_errors;
+    unsigned int wait_errors;
+    int first_error;
+    struct fdca_lat lat;
+};
+
+static void churn_error(struct churn_thread *t, int ret)
+{
+    if (!t->first_error)
+        t->first_error = ret;
+}
+
+/* 保持 depth 个在途 fence，按提交顺序等待最早的一个 */
+static void *churn_thread_fn(void *arg)
+{
+    struct churn_thread *t = arg;
+    uint32_t fences[CHURN_MAX_DEPTH];
+    uint64_t submit_ns[CHURN_MAX_DEPTH];
+    unsigned int head = 0, tail = 0, slot;
+    uint32_t result;
+    int ret;
+
+    for (;;) {
+        if (t->submitted + t->submit_errors < t->count && tail - head < t->depth) {
+            slot = tail % t->depth;
+            submit_ns[slot] = fdca_now_ns();
+            ret = fdca_submit_nop(t->fd, FDCA_SUBMIT_CAU, 1, 0, &fences[slot]);
+            if (ret) {
+                t->submit_errors++;
+                churn_error(t, ret);
+                continue;
+            }
+            t->submitted++;
+            tail++;
+            continue;
+        }
+
+        if (head == tail)
+            break;
+
+        slot = head++ % t->depth;
+        ret = fdca_wait(t->fd, fences[slot], FDCA_TEST_TIMEOUT_NS, t->wait_flags, &result);
+        if (ret) {
+            t->wait_errors++;
+            churn_error(t, ret);
+            continue;
+        }
+
+        fdca_lat_add(&t->lat, fdca_now_ns() - submit_ns[slot]);
+    }
+
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "用法: %s [-n fence 数] [-t 线程数] [-c 上下文数] [-d 在途深度] [-s]\n"
+            "  -s  允许等待先轮询 (默认 FDCA_WAIT_NO_SPIN)\n", prog);
+    exit(FDCA_TEST_FAIL);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int total = 100000, nthreads = 16, nctx = 4, depth = 4, i;
+    uint32_t wait_flags = FDCA_WAIT_NO_SPIN;
+    long long created0 = 0, created1 = 0, waits0 = 0, waits1 = 0;
+    long long avg0 = 0, avg1 = 0, max1 = 0;
+    struct fdca_lat lat = { 0 };
+    uint64_t start, elapsed;
+    unsigned int submitted = 0, submit_errors = 0, wait_errors = 0;
+    struct churn_thread *threads;
+    struct fdca_dev dev;
+    int *fds, opt, first_error = 0;
+    bool have_debugfs;
+
+    while ((opt = getopt(argc, argv, "n:t:c:d:sh")) != -1) {
+        switch (opt) {
+        case 'n':
+            total = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            nthreads = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            nctx = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            depth = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            wait_flags = 0;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (!total || !nthreads || !nctx || !depth || depth > CHURN_MAX_DEPTH)
+        usage(argv[0]);
+    if (nctx > nthreads)
+        nctx = nthreads;
+
+    fdca_test_init(&dev, FDCA_TEST_NEED_SIM);
+    fdca_test_plan(3);
+
+    fds = calloc(nctx, sizeof(*fds));
+    threads = calloc(nthreads, sizeof(*threads));
+    if (!fds || !threads) {
+        perror("calloc");
+        return FDCA_TEST_FAIL;
+    }
+
+    /* 每个上下文有独立的 fence 表，同一上下文的线程并发查找和触发 */
+    fds[0] = dev.fd;
+    for (i = 1; i < nctx; i++) {
+        fds[i] = fdca_dev_reopen(&dev);
+        if (fds[i] < 0) {
+            perror("open");
+            return FDCA_TEST_FAIL;
+        }
+    }
+
+    have_debugfs = !fdca_debugfs_value(&dev, "fences", "created:", &created0);
+    if (have_debugfs) {
+        fdca_debugfs_value(&dev, "fences", "waits:", &waits0);
+        fdca_debugfs_value(&dev, "fences", "wakeup_avg_ns:", &avg0);
+    }
+
+    fdca_test_info("%u 个 fence, %u 个线程, %u 个上下文, 在途深度 %u, %s\n",
+                   total, nthreads, nctx, depth, wait_flags ? "不轮询" : "轮询后睡眠");
+
+    start = fdca_now_ns();
+    for (i = 0; i < nthreads; i++) {
+        threads[i].fd = fds[i % nctx];
+        threads[i].count = total / nthreads + (i < total % nthreads);
+        threads[i].depth = depth;
+        threads[i].wait_flags = wait_flags;
+        if (pthread_create(&threads[i].tid, NULL, churn_thread_fn, &threads[i])) {
+            perror("pthread_create");
+            return FDCA_TEST_FAIL;
+        }
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        struct churn_thread *t = &threads[i];
+
+        pthread_join(t->tid, NULL);
+        submitted += t->submitted;
+        submit_errors += t->submit_errors;
+        wait_errors += t->wait_errors;
+        if (!first_error)
+            first_error = t->first_error;
+        fdca_lat_merge(&lat, &t->lat);
+    }
+    elapsed = fdca_now_ns() - start;
+
+    fdca_test_info("%.0f fence/s\n", submitted * 1e9 / elapsed);
+    fdca_lat_report("提交到唤醒", &lat);
+
+    fdca_test_result(!submit_errors, "submit (%u 次失败, 首个错误 %d)\n",
+                     submit_errors, first_error);
+    fdca_test_result(!wait_errors && submitted == total, "wait (%u 次失败)\n", wait_errors);
+
+    if (have_debugfs) {
+        fdca_debugfs_value(&dev, "fences", "created:", &created1);
+        fdca_debugfs_value(&dev, "fences", "waits:", &waits1);
+        fdca_debugfs_value(&dev, "fences", "wakeup_avg_ns:", &avg1);
+        fdca_debugfs_value(&dev, "fences", "wakeup_max_ns:", &max1);
+
+        /* 计数自驱动加载起累加，由前后两次读数推出本次运行的平均值 */
+        if (waits1 > waits0)
+            fdca_test_info("驱动测得触发到唤醒: %lld 次睡眠等待, 平均 %lld ns, 历史最大 %lld ns\n",
+                           waits1 - waits0,
+                           (avg1 * waits1 - avg0 * waits0) / (waits1 - waits0), max1);
+
+        fdca_test_result(created1 - created0 >= submitted,
+                         "debugfs fences 计数 (新建 %lld)\n", created1 - created0);
+    } else {
+        fdca_test_result_skip("debugfs 不可用\n");
+    }
+
+    for (i = 1; i < nctx; i++)
+        close(fds[i]);
+    close(dev.fd);
+    free(threads);
+    free(fds);
+
+    return fdca_test_exit();
+}
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * 小 VRAM 对象并发创建压力测试
+ *
+ * 1 个到 N 个线程 (默认为在线 CPU 数) 各自在独立的上下文上反复创建和
+ * 释放小 VRAM 对象，每个线程保持 64 个对象存活。报告每一档的每秒创建数、
+ * 相对单线程的加速比，以及 debugfs vram_free 中每 CPU 缓存的命中、
+ * 补充和归还次数。
+ *
+ * 运行期间把 bo_cache_mb 置 0，使释放的对象回到 VRAM 分配器而不是
+ * GEM 对象缓存 (需要 root，否则保持原值并在输出中注明)。不要求 sim_queue
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+
+#include "fdca_test.h"
+
+#define STRESS_LIVE_OBJECTS     64
+#define BO_CACHE_PARAM          "/sys/module/fdca/parameters/bo_cache_mb"
+
+struct stress_thread {
+    pthread_t tid;
+    int fd;
+    uint64_t size;
+    unsigned int count;
+    unsigned int created;
+    int error;
+};
+
+struct mag_counts {
+    long long hits;
+    long long refills;
+    long long flushes;
+};
+
+static void *stress_thread_fn(void *arg)
+{
+    struct stress_thread *t = arg;
+    uint32_t live[STRESS_LIVE_OBJECTS];
+    unsigned int i, slot;
+    int ret;
+
+    for (i = 0; i < t->count; i++) {
+        slot = i % STRESS_LIVE_OBJECTS;
+        if (i >= STRESS_LIVE_OBJECTS)
+            fdca_gem_close(t->fd, live[slot]);
+
+        ret = fdca_gem_create(t->fd, t->size, 0, &live[slot]);
+        if (ret) {
+            t->error = ret;
+            break;
+        }
+        t->created++;
+    }
+
+    for (slot = 0; slot < STRESS_LIVE_OBJECTS && slot < t->created; slot++)
+        fdca_gem_close(t->fd, live[slot]);
+
+    return NULL;
+}
+
+static void read_mag_counts(const struct fdca_dev *dev, struct mag_counts *c)
+{
+    memset(c, 0, sizeof(*c));
+    fdca_debugfs_value(dev, "vram_free", "命中 ", &c->hits);
+    fdca_debugfs_value(dev, "vram_free", "补充 ", &c->refills);
+    fdca_debugfs_value(dev, "vram_free", "归还 ", &c->flushes);
+}
+
+/* 读取 bo_cache_mb，失败返回负数 */
+static long bo_cache_read(void)
+{
+    FILE *f;
+    long val;
+    int n;
+
+    f = fopen(BO_CACHE_PARAM, "r");
+    if (!f)
+        return -errno;
+    n = fscanf(f, "%ld", &val);
+    fclose(f);
+
+    return n == 1 ? val : -EINVAL;
+}
+
+static int bo_cache_write(long val)
+{
+    FILE *f;
+
+    f = fopen(BO_CACHE_PARAM, "w");
+    if (!f)
+        return -errno;
+    fprintf(f, "%ld\n", val);
+
+    return fclose(f) ? -errno : 0;
+}
+
+static int run_step(struct stress_thread *threads, unsigned int nthreads, double *rate)
+{
+    unsigned int i, created = 0;
+    uint64_t start;
+    int error = 0;
+
+    start = fdca_now_ns();
+    for (i = 0; i < nthreads; i++) {
+        threads[i].created = 0;
+        threads[i].error = 0;
+        error = -pthread_create(&threads[i].tid, NULL, stress_thread_fn, &threads[i]);
+        if (error) {
+            nthreads = i;
+            break;
+        }
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(threads[i].tid, NULL);
+        created += threads[i].created;
+        if (!error)
+            error = threads[i].error;
+    }
+    *rate = created * 1e9 / (fdca_now_ns() - start);
+
+    return error;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int count = 20000, max_threads, nthreads, steps = 0, i;
+    uint64_t size = 4096;
+    struct stress_thread *threads;
+    struct mag_counts before, after;
+    double rate, base = 0;
+    long old_cache;
+    struct fdca_dev dev;
+    int opt, ret;
+
+    max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "s:n:t:h")) != -1) {
+        switch (opt) {
+        case 's':
+            size = strtoull(optarg, NULL, 0) << 10;
+            break;
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            max_threads = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-s 对象大小 (KB)] [-n 每线程创建数] [-t 最大线程数]\n",
+                    argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (!size || !count || !max_threads) {
+        fprintf(stderr, "参数不能为 0\n");
+        return FDCA_TEST_FAIL;
+    }
+
+    fdca_test_init(&dev, 0);
+
+    for (nthreads = 1; nthreads < max_threads; nthreads <<= 1)
+        steps++;
+    fdca_test_plan(steps + 1);
+
+    threads = calloc(max_threads, sizeof(*threads));
+    if (!threads)
+        return FDCA_TEST_FAIL;
+
+    /* 每个线程独立的上下文，避免句柄表的竞争 */
+    for (i = 0; i < max_threads; i++) {
+        threads[i].fd = i ? fdca_dev_reopen(&dev) : dev.fd;
+        threads[i].size = size;
+        threads[i].count = count;
+        if (threads[i].fd < 0) {
+            perror("open");
+            return FDCA_TEST_FAIL;
+        }
+    }
+
+    old_cache = bo_cache_read();
+    ret = old_cache < 0 ? (int)old_cache : bo_cache_write(0);
+    if (ret) {
+        fdca_test_info("无法关闭 GEM 对象缓存 (%d)，部分释放的对象会被缓存复用\n", ret);
+        old_cache = -1;
+    }
+
+    fdca_test_info("对象 %llu KB, 每线程 %u 次创建\n", (unsigned long long)(size >> 10), count);
+    fdca_test_info("%8s %14s %8s %10s %10s %10s\n", "threads", "creates/s", "speedup",
+                   "mag_hits", "refills", "flushes");
+
+    /* 1、2、4 ... 直到 max_threads */
+    for (nthreads = 1; ; nthreads = nthreads * 2 < max_threads ? nthreads * 2 : max_threads) {
+        read_mag_counts(&dev, &before);
+        ret = run_step(threads, nthreads, &rate);
+        read_mag_counts(&dev, &after);
+
+        if (nthreads == 1)
+            base = rate;
+        fdca_test_info("%8u %14.0f %7.2fx %10lld %10lld %10lld\n", nthreads, rate,
+                       base ? rate / base : 0.0, after.hits - before.hits,
+                       after.refills - before.refills, after.flushes - before.flushes);
+        fdca_test_result(!ret, "%u threads (%d)\n", nthreads, ret);
+
+        if (nthreads == max_threads)
+            break;
+    }
+
+    if (old_cache > 0)
+        bo_cache_write(old_cache);
+
+    fdca_debugfs_dump(&dev, "vram_free");
+
+    for (i = 1; i < max_threads; i++)
+        close(threads[i].fd);
+    close(dev.fd);
+    free(threads);
+
+    return fdca_test_exit();
+}
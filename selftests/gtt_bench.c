@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * GTT 映射与解映射吞吐基准
+ *
+ * GTT 映射只在驱动内部发生，没有单独的 ioctl，因此经 debugfs gtt_bench
+ * 在驱动内对 4KB 到 1GB 的一组系统页反复调用 fdca_gtt_map_pages() 和
+ * fdca_gtt_unmap_pages()。每一档由 debugfs gtt 前后读数求出该档的
+ * map/unmap 每秒页数。
+ * 需要 root (debugfs)，不要求 sim_queue
+ */
+
+#include <getopt.h>
+
+#include "fdca_test.h"
+
+#define GTT_BENCH_BYTES         (2ULL << 30)    /* 每档映射的总字节数 */
+#define GTT_BENCH_MAX_COUNT     10000
+
+struct gtt_row {
+    unsigned long long maps;
+    unsigned long long map_rate;
+    unsigned long long unmaps;
+    unsigned long long unmap_rate;
+};
+
+/* 读取 debugfs gtt 中映射大小为 @size_kb 的一行 */
+static int read_gtt_row(const struct fdca_dev *dev, unsigned long size_kb, struct gtt_row *row)
+{
+    char buf[4096], *line, *save;
+    unsigned long kb;
+
+    if (fdca_debugfs_read(dev, "gtt", buf, sizeof(buf)) <= 0)
+        return -ENOENT;
+
+    for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        if (sscanf(line, "%lu %llu %llu %llu %llu", &kb, &row->maps, &row->map_rate,
+                   &row->unmaps, &row->unmap_rate) == 5 && kb == size_kb)
+            return 0;
+    }
+
+    return -ENOENT;
+}
+
+/* 由累计次数和累计速率还原该档的总耗时 (ns) */
+static double row_ns(unsigned long long calls, unsigned long long rate, uint64_t pages)
+{
+    return rate ? (double)calls * pages * 1e9 / rate : 0;
+}
+
+/* 两次读数之间新增的调用的每秒页数 */
+static double delta_rate(unsigned long long calls0, unsigned long long rate0,
+                         unsigned long long calls1, unsigned long long rate1, uint64_t pages)
+{
+    double ns = row_ns(calls1, rate1, pages) - row_ns(calls0, rate0, pages);
+
+    return ns > 0 ? (calls1 - calls0) * pages * 1e9 / ns : 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t max_size = 1ULL << 30, size, pages, start, elapsed;
+    struct gtt_row before, after;
+    unsigned int count, steps = 0;
+    struct fdca_dev dev;
+    char req[64], name[16];
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "m:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            max_size = strtoull(optarg, NULL, 0) << 20;
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-m 最大映射大小 (MB，不超过 1024)]\n", argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (!max_size || max_size > (1ULL << 30))
+        max_size = 1ULL << 30;
+
+    fdca_test_init(&dev, 0);
+    if (read_gtt_row(&dev, 4, &before))
+        fdca_test_skip_all("debugfs gtt 不可用 (需要 root)");
+
+    for (size = 4096; size <= max_size; size <<= 1)
+        steps++;
+    fdca_test_plan(steps);
+
+    fdca_test_info("%6s %8s %14s %14s %12s\n", "size", "count", "map_pages/s",
+                   "unmap_pages/s", "wall_ms");
+
+    for (size = 4096; size <= max_size; size <<= 1) {
+        pages = size / 4096;
+        count = GTT_BENCH_BYTES / size;
+        if (count > GTT_BENCH_MAX_COUNT)
+            count = GTT_BENCH_MAX_COUNT;
+        if (count < 4)
+            count = 4;
+
+        read_gtt_row(&dev, size >> 10, &before);
+
+        /* 写操作包含分配和释放系统页，只作参考；速率以驱动内计时为准 */
+        snprintf(req, sizeof(req), "%llu %u", (unsigned long long)(size >> 10), count);
+        start = fdca_now_ns();
+        ret = fdca_debugfs_write(&dev, "gtt_bench", req);
+        elapsed = fdca_now_ns() - start;
+
+        fdca_size_str(size, name, sizeof(name));
+        if (ret == -ENOSPC || ret == -ENOMEM) {
+            fdca_test_result_skip("%s: GTT 空间或内存不足\n", name);
+            continue;
+        }
+
+        if (!ret && !read_gtt_row(&dev, size >> 10, &after))
+            fdca_test_info("%6s %8u %14.0f %14.0f %12.1f\n", name, count,
+                           delta_rate(before.maps, before.map_rate, after.maps,
+                                      after.map_rate, pages),
+                           delta_rate(before.unmaps, before.unmap_rate, after.unmaps,
+                                      after.unmap_rate, pages),
+                           elapsed / 1e6);
+
+        fdca_test_result(!ret, "%s map/unmap (%d)\n", name, ret);
+    }
+
+    fdca_debugfs_dump(&dev, "gtt");
+    close(dev.fd);
+
+    return fdca_test_exit();
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * GEM mmap 缺页与顺序读带宽基准
+ *
+ * 分别映射普通 VRAM 对象、FDCA_GEM_CREATE_LARGE_PAGE 的 VRAM 对象和
+ * GTT 对象，顺序读两遍: 第一遍包含缺页，第二遍页表已经建立。
+ * 由 debugfs memory 前后读数得到每个对象的 4KB 缺页次数、
+ * 实际映射的页数和 2MB 缺页次数。
+ *
+ * 不执行命令，不要求 sim_queue；VRAM 经 BAR 访问，带宽取决于平台
+ */
+
+#include <getopt.h>
+
+#include "fdca_test.h"
+
+struct fault_counts {
+    long long faults;
+    long long pages;
+    long long huge;
+};
+
+static void read_fault_counts(const struct fdca_dev *dev, struct fault_counts *c)
+{
+    memset(c, 0, sizeof(*c));
+    fdca_debugfs_value(dev, "memory", "4KB 缺页: ", &c->faults);
+    fdca_debugfs_value(dev, "memory", "(映射 ", &c->pages);
+    fdca_debugfs_value(dev, "memory", "2MB 缺页: ", &c->huge);
+}
+
+/* 顺序读整个映射，返回 GB/s */
+static double read_pass(const volatile uint64_t *ptr, uint64_t size)
+{
+    uint64_t i, n = size / sizeof(*ptr), sum = 0, start;
+
+    start = fdca_now_ns();
+    for (i = 0; i < n; i++)
+        sum += ptr[i];
+    __asm__ volatile("" : : "r"(sum));
+
+    return size / ((fdca_now_ns() - start) / 1e9) / (1ULL << 30);
+}
+
+static void bench_object(const struct fdca_dev *dev, const char *name, uint32_t flags,
+                         uint64_t size, bool have_debugfs)
+{
+    struct fault_counts before, after;
+    double cold, warm;
+    uint32_t handle;
+    void *ptr;
+    int ret;
+
+    ret = fdca_gem_create(dev->fd, size, flags, &handle);
+    if (ret == -ENOSPC || ret == -ENOMEM) {
+        fdca_test_result_skip("%s: 内存不足\n", name);
+        return;
+    }
+    if (ret) {
+        fdca_test_result(false, "%s: 创建失败 (%d)\n", name, ret);
+        return;
+    }
+
+    ptr = fdca_gem_mmap(dev->fd, handle, size, PROT_READ | PROT_WRITE);
+    if (ptr == MAP_FAILED) {
+        fdca_test_result(false, "%s: mmap 失败 (%d)\n", name, -errno);
+        fdca_gem_close(dev->fd, handle);
+        return;
+    }
+
+    if (have_debugfs)
+        read_fault_counts(dev, &before);
+
+    cold = read_pass(ptr, size);
+    warm = read_pass(ptr, size);
+
+    if (have_debugfs) {
+        read_fault_counts(dev, &after);
+        fdca_test_info("%-10s 首遍 %6.2f GB/s, 再读 %6.2f GB/s, 4KB 缺页 %lld (映射 %lld 页), "
+                       "2MB 缺页 %lld\n", name, cold, warm, after.faults - before.faults,
+                       after.pages - before.pages, after.huge - before.huge);
+    } else {
+        fdca_test_info("%-10s 首遍 %6.2f GB/s, 再读 %6.2f GB/s\n", name, cold, warm);
+    }
+
+    munmap(ptr, size);
+    fdca_gem_close(dev->fd, handle);
+    fdca_test_result(true, "%s\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t size = 64ULL << 20;
+    struct fault_counts probe;
+    struct fdca_dev dev;
+    bool have_debugfs;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:h")) != -1) {
+        switch (opt) {
+        case 's':
+            size = strtoull(optarg, NULL, 0) << 20;
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-s 对象大小 (MB)]\n", argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (!size)
+        size = 64ULL << 20;
+
+    fdca_test_init(&dev, 0);
+    fdca_test_plan(3);
+
+    have_debugfs = !fdca_debugfs_value(&dev, "memory", "4KB 缺页: ", &probe.faults);
+    fdca_test_info("对象大小 %llu MB\n", (unsigned long long)(size >> 20));
+
+    bench_object(&dev, "VRAM 4KB", 0, size, have_debugfs);
+    bench_object(&dev, "VRAM 2MB", FDCA_GEM_CREATE_LARGE_PAGE, size, have_debugfs);
+    bench_object(&dev, "GTT", FDCA_GEM_CREATE_GTT, size, have_debugfs);
+
+    close(dev.fd);
+
+    return fdca_test_exit();
+}
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * dma-buf 导入自测
+ *
+ * 以 udmabuf 作为本地导出者: 由 memfd 创建 dma-buf，经 PRIME_FD_TO_HANDLE
+ * 导入后依次测试:
+ * 1. 导入计数增加
+ * 2. VM_BIND 映射导入对象，等待输出 syncobj
+ * 3. 经 debugfs prime_move_notify 模拟导出者搬移后备，导入对象撤销附着映射
+ * 4. 引用该对象的提交重新建立映射，再次通知时再次撤销
+ * 5. VM_BIND 解除映射
+ *
+ * udmabuf 从不搬移后备，move_notify 只能由 debugfs 触发。
+ * 需要 root (debugfs、/dev/udmabuf) 并以 sim_queue=1 加载驱动
+ */
+
+#define _GNU_SOURCE             /* memfd_create()、F_ADD_SEALS */
+#include <getopt.h>
+#include <linux/udmabuf.h>
+
+#include "fdca_test.h"
+
+#define PRIME_VA                (1ULL << 30)    /* 低于 GTT 窗口的虚拟地址 */
+
+struct prime_counts {
+    long long imports;
+    long long move_notifies;
+};
+
+static int read_prime_counts(const struct fdca_dev *dev, struct prime_counts *c)
+{
+    memset(c, 0, sizeof(*c));
+    if (fdca_debugfs_value(dev, "memory", "导入: ", &c->imports) ||
+        fdca_debugfs_value(dev, "memory", "导出者撤销映射: ", &c->move_notifies))
+        return -ENOENT;
+    return 0;
+}
+
+/* 由 memfd 创建 udmabuf，返回 dma-buf 文件描述符或 -errno */
+static int udmabuf_create(uint64_t size)
+{
+    struct udmabuf_create args = {
+        .flags = UDMABUF_FLAGS_CLOEXEC,
+        .size = size,
+    };
+    int dev, memfd, ret;
+
+    dev = open("/dev/udmabuf", O_RDWR);
+    if (dev < 0)
+        return -errno;
+
+    /* udmabuf 要求 memfd 不能再缩小 */
+    memfd = memfd_create("fdca-prime", MFD_ALLOW_SEALING);
+    if (memfd < 0 || ftruncate(memfd, size) ||
+        fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    args.memfd = memfd;
+    ret = ioctl(dev, UDMABUF_CREATE, &args);
+    if (ret < 0)
+        ret = -errno;
+
+out:
+    if (memfd >= 0)
+        close(memfd);
+    close(dev);
+    return ret;
+}
+
+static int prime_import(int fd, int dmabuf, uint32_t *handle)
+{
+    struct drm_prime_handle args = { .fd = dmabuf };
+    int ret;
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_PRIME_FD_TO_HANDLE, &args);
+    if (!ret)
+        *handle = args.handle;
+    return ret;
+}
+
+/* 执行一个 VM_BIND 操作并等待输出 syncobj */
+static int vm_bind_sync(int fd, uint32_t op, uint32_t handle, uint64_t range)
+{
+    struct drm_fdca_vm_bind_op bop = {
+        .op = op,
+        .handle = op == FDCA_VM_BIND_OP_MAP ? handle : 0,
+        .va = PRIME_VA,
+        .range = range,
+    };
+    struct drm_fdca_syncobj out = { 0 };
+    struct drm_fdca_vm_bind args = {
+        .num_ops = 1,
+        .ops_ptr = (uintptr_t)&bop,
+        .num_out_syncs = 1,
+        .out_syncs_ptr = (uintptr_t)&out,
+    };
+    int ret;
+
+    ret = fdca_syncobj_create(fd, &out.handle);
+    if (ret)
+        return ret;
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_FDCA_VM_BIND, &args);
+    if (!ret)
+        ret = fdca_syncobj_wait(fd, out.handle, FDCA_TEST_TIMEOUT_NS);
+
+    fdca_syncobj_destroy(fd, out.handle);
+    return ret;
+}
+
+/* 同步提交一条引用 @handle 的空命令，提交固定对象时重新建立附着映射 */
+static int submit_with_bo(int fd, uint32_t handle)
+{
+    static const uint64_t payload[2];
+    struct drm_fdca_command cmd = {
+        .size = sizeof(payload),
+        .data_ptr = (uintptr_t)payload,
+    };
+    struct drm_fdca_submit args = {
+        .flags = FDCA_SUBMIT_CAU | FDCA_SUBMIT_SYNC,
+        .num_cmds = 1,
+        .cmds_ptr = (uintptr_t)&cmd,
+        .num_bos = 1,
+        .bos_ptr = (uintptr_t)&handle,
+    };
+
+    return fdca_ioctl(fd, DRM_IOCTL_FDCA_SUBMIT, &args);
+}
+
+/* 模拟导出者搬移后备，返回期间撤销的附着映射数或负数 */
+static long long move_notify(const struct fdca_dev *dev, int dmabuf)
+{
+    struct prime_counts before, after;
+    char buf[16];
+    int ret;
+
+    snprintf(buf, sizeof(buf), "%d", dmabuf);
+    read_prime_counts(dev, &before);
+    ret = fdca_debugfs_write(dev, "prime_move_notify", buf);
+    if (ret)
+        return ret;
+    read_prime_counts(dev, &after);
+
+    return after.move_notifies - before.move_notifies;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t size = 2ULL << 20;
+    struct prime_counts before, after;
+    struct fdca_dev dev;
+    uint32_t handle;
+    long long n;
+    int opt, dmabuf, ret;
+
+    while ((opt = getopt(argc, argv, "s:h")) != -1) {
+        switch (opt) {
+        case 's':
+            size = strtoull(optarg, NULL, 0) << 10;
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-s dma-buf 大小 (KB)]\n", argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (!size || size & 4095)
+        size = 2ULL << 20;
+
+    fdca_test_init(&dev, FDCA_TEST_NEED_SIM);
+    if (read_prime_counts(&dev, &before))
+        fdca_test_skip_all("debugfs memory 不可用 (需要 root)");
+
+    dmabuf = udmabuf_create(size);
+    if (dmabuf < 0) {
+        fdca_test_info("udmabuf 创建失败: %s\n", strerror(-dmabuf));
+        fdca_test_skip_all("需要 /dev/udmabuf (CONFIG_UDMABUF)");
+    }
+
+    fdca_test_plan(5);
+
+    ret = prime_import(dev.fd, dmabuf, &handle);
+    read_prime_counts(&dev, &after);
+    fdca_test_result(!ret && after.imports == before.imports + 1, "import udmabuf (%d)\n", ret);
+    if (ret)
+        return fdca_test_exit();
+
+    ret = vm_bind_sync(dev.fd, FDCA_VM_BIND_OP_MAP, handle, size);
+    fdca_test_result(!ret, "vm_bind map (%d)\n", ret);
+
+    n = move_notify(&dev, dmabuf);
+    fdca_test_result(n == 1, "move_notify invalidates the mapping (%lld)\n", n);
+
+    ret = submit_with_bo(dev.fd, handle);
+    n = ret ? ret : move_notify(&dev, dmabuf);
+    fdca_test_result(n == 1, "submit remaps after move_notify (%lld)\n", n);
+
+    ret = vm_bind_sync(dev.fd, FDCA_VM_BIND_OP_UNMAP, 0, size);
+    fdca_test_result(!ret, "vm_bind unmap (%d)\n", ret);
+
+    fdca_gem_close(dev.fd, handle);
+    close(dmabuf);
+
+    fdca_debugfs_dump(&dev, "memory");
+    close(dev.fd);
+
+    return fdca_test_exit();
+}
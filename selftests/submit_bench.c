@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * SUBMIT 环形缓冲提交基准
+ *
+ * 在一个上下文上连续调用 DRM_IOCTL_FDCA_SUBMIT，分三轮:
+ * 1. 异步提交单条命令，测每秒提交数和单次 ioctl 耗时
+ * 2. 异步提交 64 条命令的批次，测每秒命令数
+ * 3. FDCA_SUBMIT_SYNC 提交单条命令，测提交到完成的往返延迟
+ *
+ * 运行前后读取 debugfs queues，给出门铃次数与提交次数之比。
+ * 需要以 sim_queue=1 加载驱动
+ */
+
+#include <getopt.h>
+
+#include "fdca_test.h"
+
+#define BENCH_BATCH_CMDS        64
+
+struct queue_counts {
+    unsigned long long submits;
+    unsigned long long doorbells;
+};
+
+/* 累加 debugfs queues 中全部模拟队列的提交和门铃次数 */
+static int read_queue_counts(const struct fdca_dev *dev, struct queue_counts *counts)
+{
+    unsigned long long submits, doorbells;
+    char buf[16384], sim[8], *line, *save;
+    unsigned int ctx, id;
+    int type;
+
+    if (fdca_debugfs_read(dev, "queues", buf, sizeof(buf)) <= 0)
+        return -ENOENT;
+
+    memset(counts, 0, sizeof(*counts));
+    line = strtok_r(buf, "\n", &save);          /* 表头 */
+    while ((line = strtok_r(NULL, "\n", &save))) {
+        if (sscanf(line, "%u %d %u %7s %llu %llu", &ctx, &type, &id, sim,
+                   &submits, &doorbells) != 6 || strcmp(sim, "yes"))
+            continue;
+        counts->submits += submits;
+        counts->doorbells += doorbells;
+    }
+
+    return 0;
+}
+
+/**
+ * submit_round() - 连续提交 @count 次，记录每次 ioctl 的耗时
+ *
+ * 异步提交时最后等待一次最新的 fence，计入总耗时
+ *
+ * Return: 0 表示全部成功，否则为首个错误
+ */
+static int submit_round(int fd, uint32_t flags, uint32_t num_cmds, unsigned int count,
+                        struct fdca_lat *lat, uint64_t *elapsed)
+{
+    uint64_t start, t0, t1;
+    uint32_t fence = 0;
+    unsigned int i;
+    int ret = 0;
+
+    start = fdca_now_ns();
+    for (i = 0; i < count; i++) {
+        t0 = fdca_now_ns();
+        ret = fdca_submit_nop(fd, flags, num_cmds, 0, &fence);
+        t1 = fdca_now_ns();
+        if (ret)
+            break;
+        fdca_lat_add(lat, t1 - t0);
+    }
+
+    if (!ret && !(flags & FDCA_SUBMIT_SYNC))
+        ret = fdca_wait(fd, fence, FDCA_TEST_TIMEOUT_NS, 0, NULL);
+    *elapsed = fdca_now_ns() - start;
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int count = 100000;
+    struct queue_counts before, after;
+    struct fdca_lat lat;
+    struct fdca_dev dev;
+    uint64_t elapsed;
+    bool have_debugfs;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-n 单条命令的提交次数]\n", argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (count < 10)
+        count = 10;
+
+    fdca_test_init(&dev, FDCA_TEST_NEED_SIM);
+    fdca_test_plan(4);
+
+    /* 首次提交创建队列和调度实体，不计入结果 */
+    ret = fdca_submit_nop(dev.fd, FDCA_SUBMIT_CAU | FDCA_SUBMIT_SYNC, 1, 0, NULL);
+    if (ret) {
+        fdca_test_info("预热提交失败: %s\n", strerror(-ret));
+        return FDCA_TEST_FAIL;
+    }
+
+    have_debugfs = !read_queue_counts(&dev, &before);
+
+    memset(&lat, 0, sizeof(lat));
+    ret = submit_round(dev.fd, FDCA_SUBMIT_CAU, 1, count, &lat, &elapsed);
+    fdca_test_info("异步单条: %.0f submits/s\n", lat.count * 1e9 / elapsed);
+    fdca_lat_report("异步单条 ioctl 耗时", &lat);
+    fdca_test_result(!ret, "async submit, 1 cmd (%d)\n", ret);
+
+    memset(&lat, 0, sizeof(lat));
+    ret = submit_round(dev.fd, FDCA_SUBMIT_CAU, BENCH_BATCH_CMDS, count / 10, &lat, &elapsed);
+    fdca_test_info("异步批次: %.0f submits/s, %.0f cmds/s\n", lat.count * 1e9 / elapsed,
+                   lat.count * BENCH_BATCH_CMDS * 1e9 / elapsed);
+    fdca_lat_report("异步批次 ioctl 耗时", &lat);
+    fdca_test_result(!ret, "async submit, %u cmds (%d)\n", BENCH_BATCH_CMDS, ret);
+
+    memset(&lat, 0, sizeof(lat));
+    ret = submit_round(dev.fd, FDCA_SUBMIT_CAU | FDCA_SUBMIT_SYNC, 1, count / 10,
+                       &lat, &elapsed);
+    fdca_test_info("同步单条: %.0f submits/s\n", lat.count * 1e9 / elapsed);
+    fdca_lat_report("同步单条往返", &lat);
+    fdca_test_result(!ret, "sync submit, 1 cmd (%d)\n", ret);
+
+    /* 每个批次只写一次门铃，门铃次数不应超过提交次数 */
+    if (have_debugfs && !read_queue_counts(&dev, &after) &&
+        after.submits > before.submits) {
+        unsigned long long submits = after.submits - before.submits;
+        unsigned long long doorbells = after.doorbells - before.doorbells;
+
+        fdca_test_info("门铃 %llu 次 / 提交 %llu 次\n", doorbells, submits);
+        fdca_test_result(doorbells <= submits, "one doorbell per batch\n");
+        fdca_debugfs_dump(&dev, "queues");
+    } else {
+        fdca_test_result_skip("debugfs queues 不可用\n");
+    }
+
+    close(dev.fd);
+
+    return fdca_test_exit();
+}
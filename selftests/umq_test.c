@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * 用户态提交队列自测
+ *
+ * 创建用户态队列并映射环、门铃页和完成页，直接写命令包和写指针提交，
+ * 轮询完成页等待驱动内的模拟消费者线程写回 seqno:
+ * 1. 完成页只能只读映射
+ * 2. 逐批提交并等待，测门铃到完成的延迟；写满环后继续绕回
+ * 3. 保持多批在途，测每秒命令包数
+ * 4. 非法命令包使队列停止，完成页给出错误码
+ *
+ * 需要以 sim_queue=1 加载驱动
+ */
+
+#include <getopt.h>
+
+#include "fdca_test.h"
+
+#define UMQ_BATCH_PKTS          8
+#define UMQ_PAYLOAD             16
+#define UMQ_PKT_LEN             (16 + UMQ_PAYLOAD)
+#define UMQ_BATCH_LEN           (UMQ_BATCH_PKTS * UMQ_PKT_LEN)
+#define UMQ_INFLIGHT            16      /* 流水轮的在途批次数 */
+
+struct umq_pkt {
+    uint32_t type;
+    uint32_t size;
+    uint32_t flags;
+    uint32_t seqno;
+};
+
+struct umq {
+    uint32_t id;
+    uint32_t ring_size;
+    uint8_t *ring;
+    struct drm_fdca_umq_doorbell *doorbell;
+    const struct drm_fdca_umq_fence *fence;
+    uint32_t wptr;
+    uint32_t seqno;
+};
+
+static int umq_create(int fd, struct umq *q)
+{
+    struct drm_fdca_umq_create args = { .flags = FDCA_SUBMIT_CAU };
+    void *ptr;
+    int ret;
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_FDCA_UMQ_CREATE, &args);
+    if (ret)
+        return ret;
+
+    memset(q, 0, sizeof(*q));
+    q->id = args.umq_id;
+    q->ring_size = args.ring_size;
+
+    ptr = mmap(NULL, q->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, args.ring_offset);
+    if (ptr == MAP_FAILED)
+        return -errno;
+    q->ring = ptr;
+
+    ptr = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, args.doorbell_offset);
+    if (ptr == MAP_FAILED)
+        return -errno;
+    q->doorbell = ptr;
+
+    /* 完成页由设备写入，可写映射必须被拒绝 */
+    ptr = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, args.fence_offset);
+    if (ptr != MAP_FAILED) {
+        munmap(ptr, 4096);
+        return -EINVAL;
+    }
+
+    ptr = mmap(NULL, 4096, PROT_READ, MAP_SHARED, fd, args.fence_offset);
+    if (ptr == MAP_FAILED)
+        return -errno;
+    q->fence = ptr;
+
+    /* 写指针从门铃页的当前值继续 */
+    q->wptr = __atomic_load_n(&q->doorbell->wptr, __ATOMIC_ACQUIRE);
+    q->seqno = __atomic_load_n(&q->fence->seqno, __ATOMIC_ACQUIRE);
+
+    return 0;
+}
+
+static void umq_destroy(int fd, struct umq *q)
+{
+    struct drm_fdca_umq_destroy args = { .umq_id = q->id };
+
+    fdca_ioctl(fd, DRM_IOCTL_FDCA_UMQ_DESTROY, &args);
+
+    /* 销毁后映射保持有效，munmap 之后内存才释放 */
+    if (q->fence)
+        munmap((void *)q->fence, 4096);
+    if (q->doorbell)
+        munmap(q->doorbell, 4096);
+    if (q->ring)
+        munmap(q->ring, q->ring_size);
+}
+
+/* 环内写入，超出末尾时绕回 */
+static void umq_write(struct umq *q, const void *data, uint32_t len)
+{
+    uint32_t pos = q->wptr & (q->ring_size - 1);
+    uint32_t first = len < q->ring_size - pos ? len : q->ring_size - pos;
+
+    memcpy(q->ring + pos, data, first);
+    memcpy(q->ring, (const uint8_t *)data + first, len - first);
+    q->wptr += len;
+}
+
+/* 写入一批命令包，最后一个包带 FENCE，返回该批的 seqno (尚未敲门铃) */
+static uint32_t umq_write_batch(struct umq *q)
+{
+    uint8_t pkt[UMQ_PKT_LEN] = { 0 };
+    struct umq_pkt *hdr = (struct umq_pkt *)pkt;
+    unsigned int i;
+
+    for (i = 0; i < UMQ_BATCH_PKTS; i++) {
+        hdr->size = UMQ_PAYLOAD;
+        hdr->flags = 0;
+        hdr->seqno = 0;
+        if (i == UMQ_BATCH_PKTS - 1) {
+            hdr->flags = FDCA_UMQ_PKT_FENCE | FDCA_UMQ_PKT_LAST;
+            hdr->seqno = ++q->seqno;
+        }
+        umq_write(q, pkt, sizeof(pkt));
+    }
+
+    return q->seqno;
+}
+
+static void umq_ring_doorbell(struct umq *q)
+{
+    __atomic_store_n(&q->doorbell->wptr, q->wptr, __ATOMIC_RELEASE);
+}
+
+static bool umq_seqno_passed(const struct umq *q, uint32_t seqno)
+{
+    return (int32_t)(__atomic_load_n(&q->fence->seqno, __ATOMIC_ACQUIRE) - seqno) >= 0;
+}
+
+/* 轮询完成页，返回 0、-ETIME 或队列停止时的错误码 */
+static int umq_wait(const struct umq *q, uint32_t seqno)
+{
+    uint64_t deadline = fdca_now_ns() + FDCA_TEST_TIMEOUT_NS;
+
+    while (!umq_seqno_passed(q, seqno)) {
+        if (__atomic_load_n(&q->fence->error, __ATOMIC_ACQUIRE))
+            return -(int)q->fence->error;
+        if (fdca_now_ns() > deadline)
+            return -ETIME;
+    }
+
+    return 0;
+}
+
+/* 逐批提交并等待，次数足以让写指针绕环多圈 */
+static int test_sync(struct umq *q, unsigned int batches)
+{
+    struct fdca_lat lat = { 0 };
+    uint32_t seqno;
+    uint64_t t0;
+    unsigned int i;
+    int ret = 0;
+
+    for (i = 0; i < batches; i++) {
+        seqno = umq_write_batch(q);
+        t0 = fdca_now_ns();
+        umq_ring_doorbell(q);
+        ret = umq_wait(q, seqno);
+        if (ret)
+            break;
+        fdca_lat_add(&lat, fdca_now_ns() - t0);
+    }
+
+    fdca_test_info("写指针绕环 %u 圈\n", q->wptr / q->ring_size);
+    fdca_lat_report("门铃到完成", &lat);
+    return ret;
+}
+
+/* 保持 UMQ_INFLIGHT 批在途，每批单独敲门铃 */
+static int test_pipelined(struct umq *q, unsigned int batches)
+{
+    uint32_t first = q->seqno + 1, last = q->seqno + batches;
+    uint64_t start, elapsed;
+    unsigned int i;
+    int ret;
+
+    if (UMQ_INFLIGHT * UMQ_BATCH_LEN > q->ring_size)
+        return -ENOSPC;
+
+    start = fdca_now_ns();
+    for (i = 0; i < batches; i++) {
+        /* 环中最多容纳 UMQ_INFLIGHT 批，等待最早的一批腾出空间 */
+        if (i >= UMQ_INFLIGHT) {
+            ret = umq_wait(q, first + i - UMQ_INFLIGHT);
+            if (ret)
+                return ret;
+        }
+        umq_write_batch(q);
+        umq_ring_doorbell(q);
+    }
+
+    ret = umq_wait(q, last);
+    elapsed = fdca_now_ns() - start;
+    if (!ret)
+        fdca_test_info("流水提交: %.0f 批/s, %.0f 包/s\n", batches * 1e9 / elapsed,
+                       (double)batches * UMQ_BATCH_PKTS * 1e9 / elapsed);
+
+    return ret;
+}
+
+/* 负载长度超过写指针范围的包使模拟消费者停止队列 */
+static int test_bad_packet(struct umq *q)
+{
+    struct umq_pkt hdr = {
+        .size = q->ring_size,
+        .flags = FDCA_UMQ_PKT_FENCE,
+        .seqno = q->seqno + 1,
+    };
+    uint64_t deadline = fdca_now_ns() + FDCA_TEST_TIMEOUT_NS;
+    uint32_t error;
+
+    umq_write(q, &hdr, sizeof(hdr));
+    umq_ring_doorbell(q);
+
+    while (!(error = __atomic_load_n(&q->fence->error, __ATOMIC_ACQUIRE))) {
+        if (fdca_now_ns() > deadline)
+            return -ETIME;
+    }
+
+    if (umq_seqno_passed(q, hdr.seqno))
+        return -EINVAL;
+
+    return error == EINVAL ? 0 : -(int)error;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int batches = 100000;
+    struct fdca_dev dev;
+    struct umq q;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            batches = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-n 批次数]\n", argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (!batches)
+        batches = 100000;
+
+    fdca_test_init(&dev, FDCA_TEST_NEED_SIM);
+    fdca_test_plan(4);
+
+    ret = umq_create(dev.fd, &q);
+    fdca_test_result(!ret, "create and map (%d)\n", ret);
+    if (ret)
+        return fdca_test_exit();
+
+    fdca_test_info("队列 %u: 环 %u 字节, 每批 %u 个包\n", q.id, q.ring_size, UMQ_BATCH_PKTS);
+
+    ret = test_sync(&q, batches / 10);
+    fdca_test_result(!ret, "doorbell and fence page, sync (%d)\n", ret);
+
+    ret = test_pipelined(&q, batches);
+    fdca_test_result(!ret, "doorbell and fence page, pipelined (%d)\n", ret);
+
+    ret = test_bad_packet(&q);
+    fdca_test_result(!ret, "bad packet stops the queue (%d)\n", ret);
+
+    umq_destroy(dev.fd, &q);
+    close(dev.fd);
+
+    return fdca_test_exit();
+}
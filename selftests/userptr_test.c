@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * 用户指针对象自测
+ *
+ * 以匿名内存创建 GEM_USERPTR 对象，分两种模式测量:
+ * 1. 固定模式: 创建 ioctl 内固定全部页面，测创建耗时
+ * 2. 通知模式: 创建时不固定，首次 SUBMIT 引用该对象时才固定，
+ *    测首次使用延迟 (减去不引用对象的同步提交往返)
+ * 3. 通知模式对象的内存被 MADV_DONTNEED 丢弃后，对象的映射被撤销，
+ *    下一次使用重新固定页面
+ *
+ * 每一步与 debugfs memory "用户指针对象" 一节的固定次数、页数和
+ * 通知撤销次数核对。需要 root (debugfs) 并以 sim_queue=1 加载驱动
+ */
+
+#include <getopt.h>
+
+#include "fdca_test.h"
+
+#define USERPTR_ROUNDS          8       /* 每个大小重复的次数，取平均 */
+
+static const uint64_t userptr_sizes[] = {
+    4ULL << 10, 64ULL << 10, 2ULL << 20, 16ULL << 20, 64ULL << 20, 256ULL << 20, 1ULL << 30,
+};
+
+struct pin_counts {
+    long long pins;
+    long long pages;
+    long long invalidations;
+};
+
+static int read_pin_counts(const struct fdca_dev *dev, struct pin_counts *c)
+{
+    memset(c, 0, sizeof(*c));
+    if (fdca_debugfs_value(dev, "memory", "固定: ", &c->pins) ||
+        fdca_debugfs_value(dev, "memory", " 次, ", &c->pages) ||
+        fdca_debugfs_value(dev, "memory", "通知撤销: ", &c->invalidations))
+        return -ENOENT;
+    return 0;
+}
+
+static int userptr_create(int fd, void *addr, uint64_t size, uint32_t flags, uint32_t *handle)
+{
+    struct drm_fdca_gem_userptr args = {
+        .addr = (uintptr_t)addr,
+        .size = size,
+        .flags = flags,
+    };
+    int ret;
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_FDCA_GEM_USERPTR, &args);
+    if (!ret)
+        *handle = args.handle;
+    return ret;
+}
+
+/* 同步提交一条空命令，@handle 非 0 时作业引用该对象 */
+static int submit_sync(int fd, uint32_t handle, uint64_t *ns)
+{
+    static const uint64_t payload[2];
+    struct drm_fdca_command cmd = {
+        .size = sizeof(payload),
+        .data_ptr = (uintptr_t)payload,
+    };
+    struct drm_fdca_submit args = {
+        .flags = FDCA_SUBMIT_CAU | FDCA_SUBMIT_SYNC,
+        .num_cmds = 1,
+        .cmds_ptr = (uintptr_t)&cmd,
+        .num_bos = handle ? 1 : 0,
+        .bos_ptr = (uintptr_t)&handle,
+    };
+    uint64_t start = fdca_now_ns();
+    int ret;
+
+    ret = fdca_ioctl(fd, DRM_IOCTL_FDCA_SUBMIT, &args);
+    *ns = fdca_now_ns() - start;
+    return ret;
+}
+
+static void *map_anon(uint64_t size)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+/* 固定模式: 创建耗时与固定计数 */
+static int test_pinned(const struct fdca_dev *dev, uint64_t size)
+{
+    struct pin_counts before, after;
+    uint64_t start, total = 0;
+    uint32_t handle;
+    unsigned int i;
+    char name[24];
+    void *ptr;
+    int ret = 0;
+
+    ptr = map_anon(size);
+    if (!ptr)
+        return -ENOMEM;
+
+    read_pin_counts(dev, &before);
+    for (i = 0; i < USERPTR_ROUNDS; i++) {
+        start = fdca_now_ns();
+        ret = userptr_create(dev->fd, ptr, size, 0, &handle);
+        total += fdca_now_ns() - start;
+        if (ret)
+            break;
+        fdca_gem_close(dev->fd, handle);
+    }
+    read_pin_counts(dev, &after);
+    munmap(ptr, size);
+    if (ret)
+        return ret;
+
+    fdca_test_info("固定模式 %5s: 创建 %8.1f us, 固定 %lld 次 %lld 页\n",
+                   fdca_size_str(size, name, sizeof(name)), total / 1e3 / USERPTR_ROUNDS,
+                   after.pins - before.pins, after.pages - before.pages);
+
+    if (after.pins - before.pins != USERPTR_ROUNDS ||
+        after.pages - before.pages != (long long)(USERPTR_ROUNDS * size / 4096))
+        return -EINVAL;
+
+    return 0;
+}
+
+/* 通知模式: 创建不固定，首次提交固定一次，之后的提交不再固定 */
+static int test_notifier(const struct fdca_dev *dev, uint64_t size, uint64_t base_ns)
+{
+    struct pin_counts c0, c1, c2;
+    uint64_t first, warm;
+    uint32_t handle;
+    char name[24];
+    void *ptr;
+    int ret;
+
+    ptr = map_anon(size);
+    if (!ptr)
+        return -ENOMEM;
+
+    read_pin_counts(dev, &c0);
+    ret = userptr_create(dev->fd, ptr, size, FDCA_USERPTR_NOTIFIER, &handle);
+    if (ret)
+        goto out_unmap;
+
+    ret = submit_sync(dev->fd, handle, &first);
+    read_pin_counts(dev, &c1);
+    if (!ret)
+        ret = submit_sync(dev->fd, handle, &warm);
+    read_pin_counts(dev, &c2);
+    fdca_gem_close(dev->fd, handle);
+    if (ret)
+        goto out_unmap;
+
+    fdca_test_info("通知模式 %5s: 首次使用 +%8.1f us, 再次使用 +%6.1f us, 固定 %lld 页\n",
+                   fdca_size_str(size, name, sizeof(name)),
+                   ((double)first - base_ns) / 1e3, ((double)warm - base_ns) / 1e3,
+                   c1.pages - c0.pages);
+
+    if (c1.pins - c0.pins != 1 || c2.pins != c1.pins)
+        ret = -EINVAL;
+
+out_unmap:
+    munmap(ptr, size);
+    return ret;
+}
+
+/* 丢弃 CPU 页面触发失效通知，下一次使用重新固定 */
+static int test_invalidate(const struct fdca_dev *dev, uint64_t size)
+{
+    struct pin_counts c0, c1, c2;
+    uint32_t handle;
+    uint64_t ns;
+    void *ptr;
+    int ret;
+
+    ptr = map_anon(size);
+    if (!ptr)
+        return -ENOMEM;
+
+    ret = userptr_create(dev->fd, ptr, size, FDCA_USERPTR_NOTIFIER, &handle);
+    if (ret)
+        goto out_unmap;
+
+    ret = submit_sync(dev->fd, handle, &ns);
+    if (ret)
+        goto out_close;
+
+    read_pin_counts(dev, &c0);
+    if (madvise(ptr, size, MADV_DONTNEED)) {
+        ret = -errno;
+        goto out_close;
+    }
+    read_pin_counts(dev, &c1);
+
+    ret = submit_sync(dev->fd, handle, &ns);
+    read_pin_counts(dev, &c2);
+    if (ret)
+        goto out_close;
+
+    fdca_test_info("MADV_DONTNEED: 通知撤销 %lld 次, 重新固定 %lld 次, 耗时 %.1f us\n",
+                   c1.invalidations - c0.invalidations, c2.pins - c1.pins, ns / 1e3);
+
+    if (c1.invalidations - c0.invalidations != 1 || c2.pins - c1.pins != 1)
+        ret = -EINVAL;
+
+out_close:
+    fdca_gem_close(dev->fd, handle);
+out_unmap:
+    munmap(ptr, size);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t max_size = 64ULL << 20, base_ns = 0, ns;
+    struct pin_counts probe;
+    struct fdca_dev dev;
+    unsigned int i;
+    int opt, ret, err;
+
+    while ((opt = getopt(argc, argv, "m:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            max_size = strtoull(optarg, NULL, 0) << 20;
+            break;
+        default:
+            fprintf(stderr, "用法: %s [-m 最大对象大小 (MB)]\n", argv[0]);
+            return FDCA_TEST_FAIL;
+        }
+    }
+    if (!max_size)
+        max_size = 64ULL << 20;
+
+    fdca_test_init(&dev, FDCA_TEST_NEED_SIM);
+    if (read_pin_counts(&dev, &probe))
+        fdca_test_skip_all("debugfs memory 不可用 (需要 root)");
+    fdca_test_plan(3);
+
+    /* 不引用对象的同步提交往返，作为首次使用延迟的基线 */
+    for (i = 0; i < USERPTR_ROUNDS; i++) {
+        ret = submit_sync(dev.fd, 0, &ns);
+        if (ret) {
+            fdca_test_info("基线提交失败: %s\n", strerror(-ret));
+            return FDCA_TEST_FAIL;
+        }
+        if (i)
+            base_ns += ns;
+    }
+    base_ns /= USERPTR_ROUNDS - 1;
+    fdca_test_info("同步提交往返基线 %.1f us\n", base_ns / 1e3);
+
+    err = 0;
+    for (i = 0; i < ARRAY_SIZE(userptr_sizes) && userptr_sizes[i] <= max_size && !err; i++)
+        err = test_pinned(&dev, userptr_sizes[i]);
+    fdca_test_result(!err, "pinned create (%d)\n", err);
+
+    err = 0;
+    for (i = 0; i < ARRAY_SIZE(userptr_sizes) && userptr_sizes[i] <= max_size && !err; i++)
+        err = test_notifier(&dev, userptr_sizes[i], base_ns);
+    fdca_test_result(!err, "notifier first use (%d)\n", err);
+
+    ret = test_invalidate(&dev, 2ULL << 20);
+    fdca_test_result(!ret, "notifier invalidate and revalidate (%d)\n", ret);
+
+    fdca_debugfs_dump(&dev, "memory");
+    close(dev.fd);
+
+    return fdca_test_exit();
+}